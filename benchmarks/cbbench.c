@@ -0,0 +1,911 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/*
+ * Emulator benchmark suite.
+ *
+ * Each scenario builds an emulator configuration, then times a fixed number of main clock ticks
+ * running the same guest workload: a loop of indexed RAM read-modify-writes and a subroutine that
+ * polls the ACIA and VIA status registers and writes a VIA port. Setup is not timed. Every scenario
+ * is repeated and the best and median times are reported, along with the effective emulated clock
+ * rate. The dbginfo scenarios instead time loading a generated debug info file of the given size.
+ *
+ * Results are written as JSON with information about the host, so they can be tracked across
+ * commits:
+ *
+ *   cbbench [-o FILE] [-r REPEATS] [-c CYCLES] [-l LABEL] [-s SCENARIO]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "emulator.h"
+#include "memory.h"
+#include "via.h"
+#include "dbginfo.h"
+#include "recorder.h"
+#include "vcd.h"
+#include "cb6502.h"
+#include "log.h"
+
+#define BENCH_DEFAULT_REPEATS   5
+#define BENCH_DEFAULT_CYCLES    1000000
+#define BENCH_MAX_REPEATS       64
+
+#ifndef CBBENCH_BUILD_TYPE
+#define CBBENCH_BUILD_TYPE ""
+#endif
+
+#ifndef CBBENCH_COMPILER
+#define CBBENCH_COMPILER ""
+#endif
+
+/* Memory map shared by all scenarios, matching the CB6502 platform. */
+#define RAM_BASE        0x0000
+#define RAM_SIZE        0x8000
+#define ACIA_BASE       0x8000
+#define VIA_BASE        0x8010
+#define VIA_SIZE        0x0010
+#define ROM_BASE        0x8000
+#define ROM_MAP_START   0x8080
+#define ROM_SIZE        0x8000
+
+#define PROGRAM_ADDR    0x8100
+#define SUBROUTINE_ADDR 0x8120
+
+#define ACIA_SOCKET_FMT "/tmp/cbbench-%ld.sock"
+
+typedef struct bench_scenario_s bench_scenario_t;
+
+/**
+ * Runs a single iteration of a scenario.
+ *
+ * @param[in] scenario  The scenario to run.
+ * @param[out] secs     Time taken by the timed portion of the scenario.
+ *
+ * @return true if the scenario ran successfully.
+ */
+typedef bool (*bench_run_t)(const bench_scenario_t *scenario, double *secs);
+
+struct bench_scenario_s
+{
+    const char *name;       /**< Scenario name. */
+    unsigned int param;     /**< Scaling parameter, such as the number of clocks. */
+    cpu_engine_t engine;    /**< CPU engine used by emulated scenarios. */
+    bench_run_t run;        /**< Iteration function. */
+    bool emulated;          /**< Whether the scenario runs emulated cycles. */
+};
+
+typedef struct
+{
+    double best;
+    double median;
+    bool ok;
+} bench_result_t;
+
+static uint64_t num_cycles = BENCH_DEFAULT_CYCLES;
+static unsigned int num_repeats = BENCH_DEFAULT_REPEATS;
+static uint8_t flat_memory[0x10000];
+static uint8_t rom_image[ROM_SIZE];
+static volatile unsigned int sink;
+
+static bool bench_cpu_flat(const bench_scenario_t *scenario, double *secs);
+static bool bench_cpu_via(const bench_scenario_t *scenario, double *secs);
+static bool bench_platform(const bench_scenario_t *scenario, double *secs);
+static bool bench_clocks(const bench_scenario_t *scenario, double *secs);
+static bool bench_bus_conns(const bench_scenario_t *scenario, double *secs);
+static bool bench_tracers(const bench_scenario_t *scenario, double *secs);
+static bool bench_io_tracers(const bench_scenario_t *scenario, double *secs);
+static bool bench_recorder(const bench_scenario_t *scenario, double *secs);
+static bool bench_vcd(const bench_scenario_t *scenario, double *secs);
+static bool bench_dbginfo(const bench_scenario_t *scenario, double *secs);
+
+static const bench_scenario_t scenarios[] = {
+    { "cpu_flat",        0,       CPU_ENGINE_CYCLE,    bench_cpu_flat,      true },
+    { "cpu_via",         0,       CPU_ENGINE_CYCLE,    bench_cpu_via,       true },
+    { "cb6502",          0,       CPU_ENGINE_CYCLE,    bench_platform,      true },
+    { "clocks",          0,       CPU_ENGINE_CYCLE,    bench_clocks,        true },
+    { "clocks",          1,       CPU_ENGINE_CYCLE,    bench_clocks,        true },
+    { "clocks",          2,       CPU_ENGINE_CYCLE,    bench_clocks,        true },
+    { "clocks",          4,       CPU_ENGINE_CYCLE,    bench_clocks,        true },
+    { "clocks",          8,       CPU_ENGINE_CYCLE,    bench_clocks,        true },
+    { "clocks",          16,      CPU_ENGINE_CYCLE,    bench_clocks,        true },
+    { "bus_conns",       1,       CPU_ENGINE_CYCLE,    bench_bus_conns,     true },
+    { "bus_conns",       4,       CPU_ENGINE_CYCLE,    bench_bus_conns,     true },
+    { "bus_conns",       16,      CPU_ENGINE_CYCLE,    bench_bus_conns,     true },
+    { "bus_conns",       64,      CPU_ENGINE_CYCLE,    bench_bus_conns,     true },
+    { "bus_conns",       256,     CPU_ENGINE_CYCLE,    bench_bus_conns,     true },
+    { "tracers",         0,       CPU_ENGINE_CYCLE,    bench_tracers,       true },
+    { "tracers",         1,       CPU_ENGINE_CYCLE,    bench_tracers,       true },
+    { "tracers",         4,       CPU_ENGINE_CYCLE,    bench_tracers,       true },
+    { "tracers",         16,      CPU_ENGINE_CYCLE,    bench_tracers,       true },
+    { "io_tracers",      1,       CPU_ENGINE_CYCLE,    bench_io_tracers,    true },
+    { "io_tracers",      16,      CPU_ENGINE_CYCLE,    bench_io_tracers,    true },
+    { "recorder",        0,       CPU_ENGINE_CYCLE,    bench_recorder,      true },
+    { "vcd",             0,       CPU_ENGINE_CYCLE,    bench_vcd,           true },
+    { "dbginfo_load",    1000,    CPU_ENGINE_CYCLE,    bench_dbginfo,       false },
+    { "dbginfo_load",    4000,    CPU_ENGINE_CYCLE,    bench_dbginfo,       false },
+    { "dbginfo_load",    16000,   CPU_ENGINE_CYCLE,    bench_dbginfo,       false },
+};
+
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/**
+ * Writes the benchmark workload and reset vector into a 64K address space image.
+ *
+ * @param[out] space    The address space to populate.
+ */
+static void bench_load_program(uint8_t *space)
+{
+    static const uint8_t program[] = {
+        0xa2, 0x00,                     /* LDX #0           */
+        0xbd, 0x00, 0x03,               /* LDA $0300,X      */
+        0x69, 0x01,                     /* ADC #1           */
+        0x9d, 0x00, 0x03,               /* STA $0300,X      */
+        0x20, 0x20, 0x81,               /* JSR $8120        */
+        0xe8,                           /* INX              */
+        0xd0, 0xf2,                     /* BNE $8102        */
+        0x4c, 0x00, 0x81                /* JMP $8100        */
+    };
+    static const uint8_t subroutine[] = {
+        0xad, 0x01, 0x80,               /* LDA $8001        */
+        0xad, 0x1d, 0x80,               /* LDA $801D        */
+        0x8e, 0x10, 0x80,               /* STX $8010        */
+        0x60                            /* RTS              */
+    };
+
+    memcpy(&space[PROGRAM_ADDR], program, sizeof(program));
+    memcpy(&space[SUBROUTINE_ADDR], subroutine, sizeof(subroutine));
+    space[0xfffc] = (uint8_t)(PROGRAM_ADDR & 0xff);
+    space[0xfffd] = (uint8_t)(PROGRAM_ADDR >> 8);
+}
+
+static double bench_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static double bench_ticks(cbemu_t emu)
+{
+    double start;
+    uint64_t cycle;
+
+    start = bench_now();
+
+    for(cycle = 0; cycle < num_cycles; ++cycle)
+    {
+        emu_tick(emu);
+    }
+
+    return bench_now() - start;
+}
+
+static cbemu_t bench_emu_init(cpu_engine_t engine)
+{
+    emu_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.mainclk_config.timing_type = CLOCK_FREQ;
+    config.mainclk_config.timing.freq = 1000000;
+    config.cpu_engine = engine;
+
+    return emu_init(&config);
+}
+
+static uint8_t flat_read(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return flat_memory[addr];
+}
+
+static void flat_write(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    flat_memory[addr] = value;
+}
+
+static const bus_handlers_t flat_handlers = {
+    flat_write,
+    flat_read,
+    flat_read
+};
+
+/**
+ * Creates an emulator with flat RAM split across a number of equally sized bus connections.
+ *
+ * @param[in] engine    CPU engine to use.
+ * @param[in] conns     Number of bus connections. Must be a power of 2, no more than 256.
+ *
+ * @return The emulator, or NULL on error.
+ */
+static cbemu_t bench_flat_init(cpu_engine_t engine, unsigned int conns)
+{
+    cbemu_t emu;
+    bus_decode_params_t params;
+    uint32_t size = 0x10000 / conns;
+    uint32_t start;
+
+    memset(flat_memory, 0, sizeof(flat_memory));
+    bench_load_program(flat_memory);
+
+    emu = bench_emu_init(engine);
+
+    if(emu == NULL)
+    {
+        return NULL;
+    }
+
+    params.type = BUSDECODE_RANGE;
+
+    for(start = 0; start < 0x10000; start += size)
+    {
+        params.value.range.addr_start = (uint16_t)start;
+        params.value.range.addr_end = (uint16_t)(start + size - 1);
+
+        if(emu_bus_register(emu, &params, &flat_handlers, NULL) == NULL)
+        {
+            emu_cleanup(emu);
+            return NULL;
+        }
+    }
+
+    return emu;
+}
+
+static bool bench_cpu_flat(const bench_scenario_t *scenario, double *secs)
+{
+    cbemu_t emu = bench_flat_init(scenario->engine, 1);
+
+    if(emu == NULL)
+    {
+        return false;
+    }
+
+    *secs = bench_ticks(emu);
+    emu_cleanup(emu);
+
+    return true;
+}
+
+static bool bench_cpu_via(const bench_scenario_t *scenario, double *secs)
+{
+    cbemu_t emu;
+    memory_t ram = NULL;
+    memory_t rom = NULL;
+    via_t via = NULL;
+    bus_decode_params_t decoder;
+    bool ok = false;
+
+    memset(flat_memory, 0, sizeof(flat_memory));
+    bench_load_program(flat_memory);
+
+    emu = bench_emu_init(scenario->engine);
+
+    if(emu == NULL)
+    {
+        return false;
+    }
+
+    ram = memory_init(RAM_SIZE, 0);
+    rom = memory_init(ROM_SIZE, MEMFLAG_ROM);
+    via = via_init(emu);
+
+    if(ram != NULL && rom != NULL && via != NULL)
+    {
+        decoder.type = BUSDECODE_RANGE;
+        decoder.value.range.addr_start = RAM_BASE;
+        decoder.value.range.addr_end = RAM_BASE + RAM_SIZE - 1;
+        memory_register(ram, emu, &decoder, RAM_BASE);
+
+        decoder.value.range.addr_start = ROM_MAP_START;
+        decoder.value.range.addr_end = 0xFFFF;
+        memory_register(rom, emu, &decoder, ROM_BASE);
+        memory_load_data(rom, ROM_SIZE, &flat_memory[ROM_BASE], 0, false, 0);
+
+        decoder.value.range.addr_start = VIA_BASE;
+        decoder.value.range.addr_end = VIA_BASE + VIA_SIZE - 1;
+        via_register(via, &decoder, VIA_BASE, false);
+
+        *secs = bench_ticks(emu);
+        ok = true;
+    }
+
+    if(via != NULL)
+    {
+        via_cleanup(via);
+    }
+
+    if(rom != NULL)
+    {
+        memory_cleanup(rom);
+    }
+
+    if(ram != NULL)
+    {
+        memory_cleanup(ram);
+    }
+
+    emu_cleanup(emu);
+
+    return ok;
+}
+
+static bool bench_platform(const bench_scenario_t *scenario, double *secs)
+{
+    char path[] = "/tmp/cbbench-rom-XXXXXX";
+    char sock_path[64];
+    cbemu_t emu;
+    FILE *out;
+    int fd;
+    bool ok;
+
+    memset(flat_memory, 0, sizeof(flat_memory));
+    bench_load_program(flat_memory);
+    memcpy(rom_image, &flat_memory[ROM_BASE], ROM_SIZE);
+
+    fd = mkstemp(path);
+
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    out = fdopen(fd, "wb");
+
+    if(out == NULL)
+    {
+        close(fd);
+        remove(path);
+        return false;
+    }
+
+    ok = fwrite(rom_image, 1, ROM_SIZE, out) == ROM_SIZE;
+    fclose(out);
+
+    snprintf(sock_path, sizeof(sock_path), ACIA_SOCKET_FMT, (long)getpid());
+    remove(sock_path);
+
+    if(ok)
+    {
+        ok = cb6502_init(path, sock_path, &emu);
+    }
+
+    remove(path);
+
+    if(!ok)
+    {
+        return false;
+    }
+
+    /* The platform enables debug logging. */
+    log_set_level(lWARNING);
+
+    *secs = bench_ticks(emu);
+    cb6502_destroy();
+    remove(sock_path);
+
+    return true;
+}
+
+static void bench_clock_tick(clk_t clk, clock_edge_t edge, void *userdata)
+{
+    ++sink;
+}
+
+static bool bench_clocks(const bench_scenario_t *scenario, double *secs)
+{
+    clock_config_t config;
+    cbemu_t emu;
+    clk_t clk;
+    unsigned int index;
+
+    emu = bench_flat_init(scenario->engine, 1);
+
+    if(emu == NULL)
+    {
+        return false;
+    }
+
+    /* Baud rate clocks are the most common derived clock. */
+    config.timing_type = CLOCK_FREQ;
+    config.timing.freq = 1843200;
+
+    for(index = 0; index < scenario->param; ++index)
+    {
+        clk = clock_add(emu, &config);
+
+        if(clk == NULL || clock_register_tick(clk, bench_clock_tick, NULL) == NULL)
+        {
+            emu_cleanup(emu);
+            return false;
+        }
+    }
+
+    *secs = bench_ticks(emu);
+    emu_cleanup(emu);
+
+    return true;
+}
+
+static bool bench_bus_conns(const bench_scenario_t *scenario, double *secs)
+{
+    cbemu_t emu = bench_flat_init(scenario->engine, scenario->param);
+
+    if(emu == NULL)
+    {
+        return false;
+    }
+
+    *secs = bench_ticks(emu);
+    emu_cleanup(emu);
+
+    return true;
+}
+
+static void bench_trace(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata)
+{
+    sink += value;
+}
+
+static bool bench_tracers(const bench_scenario_t *scenario, double *secs)
+{
+    cbemu_t emu;
+    unsigned int index;
+
+    emu = bench_flat_init(scenario->engine, 1);
+
+    if(emu == NULL)
+    {
+        return false;
+    }
+
+    for(index = 0; index < scenario->param; ++index)
+    {
+        if(emu_bus_add_tracer(emu, bench_trace, NULL) == NULL)
+        {
+            emu_cleanup(emu);
+            return false;
+        }
+    }
+
+    *secs = bench_ticks(emu);
+    emu_cleanup(emu);
+
+    return true;
+}
+
+/* Tracers filtered to the VIA registers, as would be left running in a normal session. */
+static bool bench_io_tracers(const bench_scenario_t *scenario, double *secs)
+{
+    bus_trace_filter_t filter;
+    cbemu_t emu;
+    unsigned int index;
+
+    emu = bench_flat_init(scenario->engine, 1);
+
+    if(emu == NULL)
+    {
+        return false;
+    }
+
+    filter.decode.type = BUSDECODE_MASK;
+    filter.decode.value.mask.addr_mask = 0xFFF0;
+    filter.decode.value.mask.addr_value = VIA_BASE;
+    filter.ops = BUS_TRACE_READ | BUS_TRACE_WRITE;
+    filter.divisor = 0;
+
+    for(index = 0; index < scenario->param; ++index)
+    {
+        if(emu_bus_add_tracer_filtered(emu, &filter, bench_trace, NULL) == NULL)
+        {
+            emu_cleanup(emu);
+            return false;
+        }
+    }
+
+    *secs = bench_ticks(emu);
+    emu_cleanup(emu);
+
+    return true;
+}
+
+/* Records every bus transaction to a file. The time includes draining the recorder. */
+static bool bench_recorder(const bench_scenario_t *scenario, double *secs)
+{
+    char path[] = "/tmp/cbbench-trace-XXXXXX";
+    recorder_t recorder;
+    cbemu_t emu;
+    double start;
+    bool ok;
+    int fd;
+
+    fd = mkstemp(path);
+
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    close(fd);
+
+    emu = bench_flat_init(scenario->engine, 1);
+    recorder = (emu != NULL) ? recorder_init(emu, path, NULL) : NULL;
+
+    if(recorder == NULL)
+    {
+        emu_cleanup(emu);
+        remove(path);
+        return false;
+    }
+
+    start = bench_now();
+    bench_ticks(emu);
+    ok = recorder_cleanup(recorder);
+    *secs = bench_now() - start;
+
+    emu_cleanup(emu);
+    remove(path);
+
+    return ok;
+}
+
+/* Captures the CPU bus to a VCD file. The time includes draining the writer. */
+static bool bench_vcd(const bench_scenario_t *scenario, double *secs)
+{
+    char path[] = "/tmp/cbbench-vcd-XXXXXX";
+    vcd_t vcd;
+    cbemu_t emu;
+    double start;
+    bool ok;
+    int fd;
+
+    fd = mkstemp(path);
+
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    close(fd);
+
+    emu = bench_flat_init(scenario->engine, 1);
+    vcd = (emu != NULL) ? vcd_init(emu, path) : NULL;
+
+    if(vcd == NULL || !vcd_start(vcd))
+    {
+        vcd_cleanup(vcd);
+        emu_cleanup(emu);
+        remove(path);
+        return false;
+    }
+
+    start = bench_now();
+    bench_ticks(emu);
+    ok = vcd_cleanup(vcd);
+    *secs = bench_now() - start;
+
+    emu_cleanup(emu);
+    remove(path);
+
+    return ok;
+}
+
+static void bench_dbginfo_error(const cc65_parseerror *error)
+{
+    fprintf(stderr, "%s:%u:%u %s\n", error->name, error->line, error->column, error->errormsg);
+}
+
+/**
+ * Writes a debug info file with one line, span and label per entry, spread over a 32K segment.
+ *
+ * @param[in] out       File to write.
+ * @param[in] entries   Number of entries to generate.
+ */
+static void bench_write_dbginfo(FILE *out, unsigned int entries)
+{
+    unsigned int index;
+
+    fprintf(out, "version\tmajor=2,minor=0\n");
+    fprintf(out, "info\tcsym=0,file=1,lib=0,line=%u,mod=1,scope=1,seg=1,span=%u,sym=%u,type=0\n",
+            entries, entries, entries);
+    fprintf(out, "file\tid=0,name=\"bench.s\",size=%u,mtime=0x00000000,mod=0\n", entries * 16);
+
+    for(index = 0; index < entries; ++index)
+    {
+        fprintf(out, "line\tid=%u,file=0,line=%u,span=%u\n", index, index + 1, index);
+    }
+
+    fprintf(out, "mod\tid=0,name=\"bench.o\",file=0\n");
+    fprintf(out, "scope\tid=0,name=\"\",mod=0,size=%u\n", ROM_SIZE);
+    fprintf(out, "seg\tid=0,name=\"CODE\",start=0x%06X,size=0x%04X,addrsize=absolute,type=ro\n", ROM_BASE, ROM_SIZE);
+
+    for(index = 0; index < entries; ++index)
+    {
+        fprintf(out, "span\tid=%u,seg=0,start=%u,size=2\n", index, (index * 2) % (ROM_SIZE - 1));
+    }
+
+    for(index = 0; index < entries; ++index)
+    {
+        fprintf(out, "sym\tid=%u,name=\"label%u\",addrsize=absolute,scope=0,def=%u,val=0x%04X,seg=0,type=lab\n",
+                index, index, index, ROM_BASE + (index * 2) % (ROM_SIZE - 1));
+    }
+}
+
+static bool bench_dbginfo(const bench_scenario_t *scenario, double *secs)
+{
+    char path[] = "/tmp/cbbench-dbg-XXXXXX";
+    cc65_dbginfo dbginfo;
+    FILE *out;
+    double start;
+    int fd;
+
+    fd = mkstemp(path);
+
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    out = fdopen(fd, "w");
+
+    if(out == NULL)
+    {
+        close(fd);
+        remove(path);
+        return false;
+    }
+
+    bench_write_dbginfo(out, scenario->param);
+    fclose(out);
+
+    start = bench_now();
+    dbginfo = cc65_read_dbginfo(path, bench_dbginfo_error);
+    *secs = bench_now() - start;
+
+    remove(path);
+
+    if(dbginfo == NULL)
+    {
+        return false;
+    }
+
+    cc65_free_dbginfo(dbginfo);
+
+    return true;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+    double lhs = *(const double *)a;
+    double rhs = *(const double *)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static bench_result_t bench_run(const bench_scenario_t *scenario)
+{
+    double times[BENCH_MAX_REPEATS];
+    bench_result_t result;
+    unsigned int index;
+
+    result.ok = true;
+
+    for(index = 0; index < num_repeats && result.ok; ++index)
+    {
+        result.ok = scenario->run(scenario, &times[index]);
+    }
+
+    if(result.ok)
+    {
+        qsort(times, num_repeats, sizeof(times[0]), bench_compare);
+        result.best = times[0];
+        result.median = times[num_repeats / 2];
+    }
+
+    return result;
+}
+
+static void json_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+
+    for(; *str != '\0'; ++str)
+    {
+        if(*str == '"' || *str == '\\')
+        {
+            fprintf(out, "\\%c", *str);
+        }
+        else if((unsigned char)*str < 0x20)
+        {
+            fprintf(out, "\\u%04x", (unsigned char)*str);
+        }
+        else
+        {
+            fputc(*str, out);
+        }
+    }
+
+    fputc('"', out);
+}
+
+/* Gets the host CPU model, falling back to an empty string. */
+static void bench_cpu_model(char *model, size_t size)
+{
+    char line[256];
+    char *value;
+    FILE *cpuinfo;
+
+    model[0] = '\0';
+    cpuinfo = fopen("/proc/cpuinfo", "r");
+
+    if(cpuinfo == NULL)
+    {
+        return;
+    }
+
+    while(fgets(line, sizeof(line), cpuinfo) != NULL)
+    {
+        if(strncmp(line, "model name", 10) == 0 && (value = strchr(line, ':')) != NULL)
+        {
+            value += strspn(value + 1, " \t") + 1;
+            value[strcspn(value, "\n")] = '\0';
+            snprintf(model, size, "%s", value);
+            break;
+        }
+    }
+
+    fclose(cpuinfo);
+}
+
+static void bench_write_host(FILE *out, const char *label)
+{
+    struct utsname uts;
+    char model[128];
+    char timestamp[32];
+    time_t now = time(NULL);
+
+    if(uname(&uts) != 0)
+    {
+        memset(&uts, 0, sizeof(uts));
+    }
+
+    bench_cpu_model(model, sizeof(model));
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "  \"label\": ");
+    json_string(out, label);
+    fprintf(out, ",\n  \"timestamp\": ");
+    json_string(out, timestamp);
+    fprintf(out, ",\n  \"host\": {\n    \"system\": ");
+    json_string(out, uts.sysname);
+    fprintf(out, ",\n    \"release\": ");
+    json_string(out, uts.release);
+    fprintf(out, ",\n    \"machine\": ");
+    json_string(out, uts.machine);
+    fprintf(out, ",\n    \"cpu\": ");
+    json_string(out, model);
+    fprintf(out, ",\n    \"cores\": %ld,\n    \"compiler\": ", sysconf(_SC_NPROCESSORS_ONLN));
+    json_string(out, CBBENCH_COMPILER);
+    fprintf(out, ",\n    \"build_type\": ");
+    json_string(out, CBBENCH_BUILD_TYPE);
+    fprintf(out, "\n  },\n  \"cycles\": %" PRIu64 ",\n  \"repeats\": %u,\n", num_cycles, num_repeats);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out_path = NULL;
+    const char *label = "";
+    const char *only = NULL;
+    const bench_scenario_t *scenario;
+    bench_result_t result;
+    FILE *out = stdout;
+    bool first = true;
+    bool ok = true;
+    unsigned int index;
+    int opt;
+
+    while((opt = getopt(argc, argv, "o:r:c:l:s:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'r':
+                num_repeats = (unsigned int)strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                num_cycles = strtoull(optarg, NULL, 0);
+                break;
+            case 'l':
+                label = optarg;
+                break;
+            case 's':
+                only = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-o FILE] [-r REPEATS] [-c CYCLES] [-l LABEL] [-s SCENARIO]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(num_repeats == 0 || num_repeats > BENCH_MAX_REPEATS || num_cycles == 0)
+    {
+        fprintf(stderr, "Repeats must be 1-%u and cycles non-zero\n", BENCH_MAX_REPEATS);
+        return 1;
+    }
+
+    if(out_path != NULL)
+    {
+        out = fopen(out_path, "w");
+
+        if(out == NULL)
+        {
+            perror(out_path);
+            return 1;
+        }
+    }
+
+    log_set_level(lWARNING);
+
+    fprintf(out, "{\n");
+    bench_write_host(out, label);
+    fprintf(out, "  \"results\": [");
+
+    for(index = 0; index < NUM_SCENARIOS; ++index)
+    {
+        scenario = &scenarios[index];
+
+        if(only != NULL && strcmp(only, scenario->name) != 0)
+        {
+            continue;
+        }
+
+        result = bench_run(scenario);
+
+        if(!result.ok)
+        {
+            fprintf(stderr, "%s/%u: failed\n", scenario->name, scenario->param);
+            ok = false;
+            continue;
+        }
+
+        fprintf(out, "%s\n    { \"name\": \"%s\", \"param\": %u, \"best_s\": %.6f, \"median_s\": %.6f",
+                first ? "" : ",", scenario->name, scenario->param, result.best, result.median);
+
+        if(scenario->emulated)
+        {
+            fprintf(out, ", \"mhz\": %.3f", (double)num_cycles / result.best / 1e6);
+        }
+
+        fprintf(out, " }");
+        first = false;
+
+        if(out != stdout)
+        {
+            if(scenario->emulated)
+            {
+                printf("%-14s %6u %10.3f MHz\n", scenario->name, scenario->param, (double)num_cycles / result.best / 1e6);
+            }
+            else
+            {
+                printf("%-14s %6u %10.3f ms\n", scenario->name, scenario->param, result.best * 1e3);
+            }
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -8,7 +8,12 @@ typedef enum
 {
     BUSDECODE_RANGE,    /**< Address range */
     BUSDECODE_MASK,     /**< Specific address bit values */
-    BUSDECODE_CUSTOM    /**< Custom callback-defined logic */
+    BUSDECODE_CUSTOM,   /**< Custom callback-defined logic, called on every access */
+    BUSDECODE_CUSTOM_STATIC,  /**< Custom callback whose result depends only on the address and
+                                   direction. It is evaluated for every address at registration. */
+    BUSDECODE_CUSTOM_DYNAMIC  /**< Custom callback whose result may change, which must be signalled
+                                   with emu_bus_decode_invalidate. Results are cached a page at a
+                                   time until then. */
 } bus_decode_type_t;
 
 /** Parameters for Address Range bus decoding */
@@ -47,7 +52,7 @@ typedef struct
     {
         bus_decode_range_t range; /**< Address Range parameters */
         bus_decode_mask_t mask;   /**< Address Bitmask parameters */
-        bus_decode_cb_t custom;   /**< Custom callback */
+        bus_decode_cb_t custom;   /**< Custom callback, for all of the custom types */
     } value;
 } bus_decode_params_t;
 
@@ -58,6 +63,7 @@ typedef void *bus_cb_handle_t;
 typedef enum
 {
     SYNC = 0x01, /**< Used during a read operation to denote the SYNC pin would be high on the 6502 bus. */
+    DUMMY = 0x02, /**< Used during a read operation to denote the CPU discards the value read. */
 } bus_flags_t;
 
 /** Defines the type of signals to the emulator/CPU from the bus that can be controlled externally. */
@@ -74,6 +80,15 @@ typedef uint32_t bus_signal_voter_t;
 
 #define BUS_SIGNAL_INVALID_VOTER (UINT32_MAX)
 
+/**
+ * Signal watcher callback, made when a signal becomes asserted or deasserted.
+ *
+ * @param signal[in]    The signal that changed.
+ * @param asserted[in]  Indicates whether the signal is now asserted, i.e. has at least one vote.
+ * @param userdata[in]  Userdata supplied by the callback owner
+ */
+typedef void (*bus_signal_cb_t)(bus_signal_t signal, bool asserted, void *userdata);
+
 /**
  * Bus write callback.
  *
@@ -93,6 +108,19 @@ typedef void (*bus_write_cb_t)(uint16_t addr, uint8_t value, bus_flags_t flags,
  */
 typedef uint8_t (*bus_read_cb_t)(uint16_t addr, bus_flags_t flags, void *userdata);
 
+/**
+ * Bus direct access callback. Used by the debugger and other tools to copy whole pages to or from
+ * a device without going through the read and write handlers.
+ *
+ * @param addr[in] Page aligned address of a page that is entirely decoded to the connection
+ * @param write[in] Indicates the page will be written through the pointer, rather than only read
+ * @param userdata[in] Userdata supplied by the callback owner
+ *
+ * @return Pointer to the 256 bytes backing the page, or NULL if the page can't be accessed
+ *         directly, e.g. because reading it currently has a different result.
+ */
+typedef uint8_t *(*bus_direct_cb_t)(uint16_t addr, bool write, void *userdata);
+
 /**
  * Bus trace debug callback. This can be registered to trace memory operations without actually
  * controlling the memory bus.
@@ -104,6 +132,48 @@ typedef uint8_t (*bus_read_cb_t)(uint16_t addr, bus_flags_t flags, void *userdat
  */
 typedef void (*bus_trace_cb_t)(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *param);
 
+/** Types of bus operations that a tracer can be filtered on. */
+typedef enum
+{
+    BUS_TRACE_READ = 0x01,  /**< Read operations other than opcode fetches, including dummy reads. */
+    BUS_TRACE_WRITE = 0x02, /**< Write operations. */
+    BUS_TRACE_SYNC = 0x04,  /**< Opcode fetches, i.e. reads with the SYNC flag. */
+    BUS_TRACE_ALL = 0x07,   /**< All bus operations. */
+} bus_trace_ops_t;
+
+/** Filter applied to a bus tracer before its callback is made. */
+typedef struct
+{
+    /** Addresses to trace. Only BUSDECODE_RANGE and BUSDECODE_MASK are supported. */
+    bus_decode_params_t decode;
+
+    /** Combination of bus_trace_ops_t for the operations to trace. */
+    uint8_t ops;
+
+    /** Sampling divisor. Only every Nth matching operation is traced. 0 or 1 traces every operation. */
+    uint32_t divisor;
+} bus_trace_filter_t;
+
+/** Number of 256 byte pages the bus access counters are kept for. */
+#define BUS_COUNTER_PAGES   0x100
+
+/** Bus access counts for a page of the address space or a bus connection. */
+typedef struct
+{
+    uint64_t reads;     /**< Committed reads other than opcode fetches, including dummy reads. */
+    uint64_t writes;    /**< Write operations. */
+    uint64_t fetches;   /**< Opcode fetches, i.e. reads with the SYNC flag. */
+} bus_counters_t;
+
+/** Bus access counts for a registered bus connection. */
+typedef struct
+{
+    bus_cb_handle_t handle;     /**< The bus connection. */
+    const char *name;           /**< Name of the connection, or NULL if it has not been named. */
+    bus_decode_params_t params; /**< Address decoding parameters of the connection. */
+    bus_counters_t counters;    /**< Accesses that were decoded to the connection. */
+} bus_conn_counters_t;
+
 /** Container for bus callback functions */
 typedef struct
 {
@@ -119,11 +189,19 @@ typedef struct
      *  debugger), but does *not* want to actually perform a read that may cause such
      *  a read-triggered action. */
     bus_read_cb_t peek;
+
+    /** Optional. Provides direct access to the memory backing a page, for devices such as RAM
+     *  and ROM that have a buffer. Peeks and pokes of whole pages are then a copy. */
+    bus_direct_cb_t direct;
 } bus_handlers_t;
 
 /**
  * Registers a bus connection with a set of handler callbacks with the specific decoder parameters
  *
+ * Overlaps with the decoders of other connections are found when registering, and reported once.
+ * Only the overlapping addresses, and pages shared with custom decoders, are checked for multiple
+ * connections driving the bus on each read.
+ *
  * @param[in] emu       The emulator core
  * @param[in] params    Address decoding parameters for the bus connection
  * @param[in] handlers  Handler functions called when the bus address matches the decoding
@@ -141,6 +219,64 @@ bus_cb_handle_t emu_bus_register(cbemu_t emu, const bus_decode_params_t *params,
  */
 void emu_bus_unregister(cbemu_t emu, bus_cb_handle_t handle);
 
+/**
+ * Discards the cached results of a connection's custom decoder. This must be called whenever the
+ * mapping of a BUSDECODE_CUSTOM_DYNAMIC decoder changes, such as on a write to a bank register,
+ * and may be called from within the connection's own bus handlers. The results are evaluated
+ * again a page at a time as pages are accessed. A BUSDECODE_CUSTOM_STATIC decoder is evaluated
+ * again immediately. Other connections are unaffected.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] handle    The registered bus handle
+ */
+void emu_bus_decode_invalidate(cbemu_t emu, bus_cb_handle_t handle);
+
+/**
+ * Names a registered bus connection, for reporting purposes.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] handle    The registered bus handle
+ * @param[in] name      Name of the connection. The string must remain valid while the connection
+ *                      is registered.
+ */
+void emu_bus_set_name(cbemu_t emu, bus_cb_handle_t handle, const char *name);
+
+/**
+ * Enables or disables counting of bus accesses per page and per connection. Counting is disabled
+ * by default, and the counts are kept when it is disabled.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] enable    Indicates whether counting should be enabled or disabled.
+ */
+void emu_bus_enable_counters(cbemu_t emu, bool enable);
+
+/**
+ * Resets all of the per-page and per-connection access counts to 0.
+ *
+ * @param[in] emu       The emulator core
+ */
+void emu_bus_reset_counters(cbemu_t emu);
+
+/**
+ * Takes a snapshot of the per-page access counts.
+ *
+ * @param[in] emu       The emulator core
+ * @param[out] pages    Buffer of BUS_COUNTER_PAGES entries, populated with the counts of each page.
+ */
+void emu_bus_get_page_counters(cbemu_t emu, bus_counters_t *pages);
+
+/**
+ * Takes a snapshot of the per-connection access counts, in the order the connections were
+ * registered. A read or write decoded by multiple connections is counted by each of them.
+ *
+ * @param[in] emu       The emulator core
+ * @param[out] conns    Buffer to populate with the counts of each connection.
+ * @param[in] max       The number of entries available in the buffer.
+ *
+ * @return The total number of registered connections, which may be more than max.
+ */
+unsigned int emu_bus_get_conn_counters(cbemu_t emu, bus_conn_counters_t *conns, unsigned int max);
+
 /**
  * Adds a bus tracer callback to the bus. This is called on every bus transaction to allow
  * debugging, testing, or monitoring of bus activity.
@@ -153,6 +289,20 @@ void emu_bus_unregister(cbemu_t emu, bus_cb_handle_t handle);
  */
 bus_cb_handle_t emu_bus_add_tracer(cbemu_t emu, const bus_trace_cb_t callback, void *userdata);
 
+/**
+ * Adds a bus tracer callback that is only called for bus transactions matching a filter. Pages
+ * that no tracer is interested in are flagged in the bus decode table, so accesses to them skip
+ * tracer dispatch entirely.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] filter    Filter for the bus transactions to trace
+ * @param[in] callback  Tracer callback to be called for each matching bus transaction
+ * @param[in] userdata  App-specific user data provided to the callback when made
+ *
+ * @return A handle for the registered callback or NULL on error
+ */
+bus_cb_handle_t emu_bus_add_tracer_filtered(cbemu_t emu, const bus_trace_filter_t *filter, const bus_trace_cb_t callback, void *userdata);
+
 /**
  * Removes a previously registered tracer callback
  *
@@ -189,4 +339,33 @@ void emu_bus_unregister_sig_voter(cbemu_t emu, bus_signal_voter_t voter);
  */
 void emu_bus_sig_vote(cbemu_t emu, bus_signal_voter_t voter, bus_signal_t signal, bool voted);
 
+/**
+ * Gets whether a signal is currently asserted, i.e. whether any voter has a vote on it.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] signal    The signal to check
+ *
+ * @return true if the signal is asserted.
+ */
+bool emu_bus_sig_asserted(cbemu_t emu, bus_signal_t signal);
+
+/**
+ * Adds a signal watcher callback, called whenever a signal becomes asserted or deasserted.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] callback  Callback to be called for each signal change
+ * @param[in] userdata  App-specific user data provided to the callback when made
+ *
+ * @return A handle for the registered callback or NULL on error
+ */
+bus_cb_handle_t emu_bus_add_sig_watcher(cbemu_t emu, bus_signal_cb_t callback, void *userdata);
+
+/**
+ * Removes a previously registered signal watcher callback
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] handle    Handle of the previously registered callback
+ */
+void emu_bus_remove_sig_watcher(cbemu_t emu, bus_cb_handle_t handle);
+
 #endif /* end of include guard: __BUS_API_H__ */
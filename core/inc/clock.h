@@ -6,7 +6,8 @@
 #include "emu_types.h"
 
 /**
- * Maximum clock frequency represented by the minimum tick precision of 1ns.
+ * Maximum clock frequency. Clocks are scheduled exactly at any frequency, but their periods are
+ * reported with a resolution of 1ns.
  */
 #define CLOCK_MAX_FREQUENCY 1000000000UL
 
@@ -77,6 +78,19 @@ typedef void *clock_cb_handle_t;
  */
 typedef void (*clock_tick_cb_t)(clk_t clk, clock_edge_t edge, void *userdata);
 
+/** Handle for registered sync handlers. */
+typedef void *clock_sync_handle_t;
+
+/**
+ * Callback prototype for catching a lazily synchronized device up with its clock. The device
+ * simulates the elapsed cycles in bulk rather than being called on every tick.
+ *
+ * @param[in] clk       The clock the handler follows.
+ * @param[in] cycles    Number of active edges of the clock since the last synchronization.
+ * @param[in] userdata  App-specific userdata for the registered handler
+ */
+typedef void (*clock_sync_cb_t)(clk_t clk, uint64_t cycles, void *userdata);
+
 /**
  * Adds a clock to the core emulator.
  *
@@ -135,6 +149,63 @@ clock_cb_handle_t clock_register_tick_edges(clk_t clk, clock_tick_cb_t callback,
  */
 void clock_unregister_tick(clock_cb_handle_t handle);
 
+/**
+ * Suspends a registered tick handler, so it is no longer called until it is resumed. This may be
+ * called from within any tick handler, including the one being suspended.
+ *
+ * @param[in] handle    Handle of the registered callback to suspend
+ */
+void clock_suspend_tick(clock_cb_handle_t handle);
+
+/**
+ * Resumes a suspended tick handler. It is called after the other handlers of the clock from then
+ * on, including for the current edge if the clock is dispatching a tick.
+ *
+ * @param[in] handle    Handle of the registered callback to resume
+ */
+void clock_resume_tick(clock_cb_handle_t handle);
+
+/**
+ * Registers a sync handler for a given clock. Instead of being called on every tick, the device
+ * calls clock_sync before any access to its state, such as a bus access to its registers, and
+ * schedules a deadline with clock_sync_schedule for anything it must do unprompted, such as
+ * raising an interrupt. The handler is only called from those points.
+ *
+ * @param[in] clk       The clock the device follows
+ * @param[in] callback  The handler to be called to catch up with the clock
+ * @param[in] userdata  App specific data to be passed on each callback
+ *
+ * @return A handle for the registered handler or NULL on error
+ */
+clock_sync_handle_t clock_register_sync(clk_t clk, clock_sync_cb_t callback, void *userdata);
+
+/**
+ * Un-registers a previously registered sync handler. This must not be called from within the
+ * handler itself.
+ *
+ * @param[in] handle    Handle of the registered handler to remove
+ */
+void clock_unregister_sync(clock_sync_handle_t handle);
+
+/**
+ * Brings a device up to date with its clock, calling its handler with the cycles elapsed since
+ * the last synchronization, if there are any.
+ *
+ * @param[in] handle    Handle of the registered handler
+ */
+void clock_sync(clock_sync_handle_t handle);
+
+/**
+ * Schedules the next synchronization of a device, replacing any previous deadline. When the
+ * deadline is reached, the handler is called on the active edge of the clock, after its tick
+ * handlers.
+ *
+ * @param[in] handle    Handle of the registered handler
+ * @param[in] cycles    Number of cycles after the last synchronization, or 0 to cancel the
+ *                      deadline
+ */
+void clock_sync_schedule(clock_sync_handle_t handle, uint64_t cycles);
+
 /**
  * Get the frequency in hertz of the given clock
  *
@@ -0,0 +1,119 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/**
+ * @file
+ * @brief Guest code coverage
+ *
+ * Coverage is tracked with a bitmap of every address an opcode was fetched from, along with
+ * bitmaps of which conditional branches were taken and not taken. The CPU updates the bitmaps
+ * directly as it executes, so coverage is cheap enough to leave enabled for entire regression
+ * runs.
+ *
+ * The collected maps can be exported in lcov tracefile format by mapping addresses back to
+ * source lines using cc65 debug information.
+ */
+#ifndef __COVERAGE_H__
+#define __COVERAGE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "dbginfo.h"
+#include "emulator.h"
+
+/**
+ * Handle for a coverage instance.
+ */
+typedef struct coverage_s *coverage_t;
+
+/**
+ * Branch outcomes recorded for a conditional branch instruction.
+ */
+typedef enum
+{
+    COVERAGE_BRANCH_NONE        = 0x00, /**< The branch has not been executed. */
+    COVERAGE_BRANCH_TAKEN       = 0x01, /**< The branch has been taken. */
+    COVERAGE_BRANCH_NOT_TAKEN   = 0x02  /**< The branch has fallen through. */
+} coverage_branch_t;
+
+/**
+ * Creates a coverage map and attaches it to an emulator instance. Coverage is recorded
+ * immediately. Only one coverage map may be attached to an emulator at a time.
+ *
+ * @param[in] emulator  The emulator instance to collect coverage for.
+ *
+ * @return The coverage instance, or NULL if there was an error.
+ */
+coverage_t coverage_init(cbemu_t emulator);
+
+/**
+ * Clears all collected coverage.
+ *
+ * @param[in] handle The coverage handle.
+ */
+void coverage_reset(coverage_t handle);
+
+/**
+ * Checks whether an opcode has been executed from an address.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] addr      The address to check.
+ *
+ * @return true if an opcode was fetched from the address.
+ */
+bool coverage_is_executed(coverage_t handle, uint16_t addr);
+
+/**
+ * Gets the recorded outcomes of a conditional branch instruction.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] addr      Address of the branch opcode.
+ *
+ * @return Bitwise OR of the coverage_branch_t outcomes seen.
+ */
+unsigned int coverage_get_branch(coverage_t handle, uint16_t addr);
+
+/**
+ * Gets the number of unique addresses opcodes have been executed from.
+ *
+ * @param[in] handle The coverage handle.
+ *
+ * @return The number of executed addresses.
+ */
+unsigned int coverage_get_executed_count(coverage_t handle);
+
+/**
+ * Writes the collected coverage as an lcov tracefile. Only spans of code (spans without type
+ * information) are reported. Line hit counts are 0 or 1, as the map only records whether an
+ * address has been executed.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] dbginfo   Debug info used to map addresses to source lines.
+ * @param[in] out       Stream to write the tracefile to.
+ * @param[in] test_name Test name to record in the tracefile, or NULL for none.
+ *
+ * @return true if the tracefile was written successfully.
+ */
+bool coverage_write_lcov(coverage_t handle, cc65_dbginfo dbginfo, FILE *out, const char *test_name);
+
+/**
+ * Writes the collected coverage as an lcov tracefile to a file.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] dbginfo   Debug info used to map addresses to source lines.
+ * @param[in] filename  The file to write.
+ * @param[in] test_name Test name to record in the tracefile, or NULL for none.
+ *
+ * @return true if the tracefile was written successfully.
+ */
+bool coverage_dump_lcov(coverage_t handle, cc65_dbginfo dbginfo, const char *filename, const char *test_name);
+
+/**
+ * Detaches a coverage map from its emulator and frees it.
+ *
+ * @param[in] handle The coverage handle.
+ */
+void coverage_cleanup(coverage_t handle);
+
+#endif /* end of include guard: __COVERAGE_H__ */
@@ -30,6 +30,46 @@ typedef uint32_t debug_breakpoint_t;
  */
 #define BREAKPOINT_HANDLE_SW_REQUEST 0xffffffff
 
+/**
+ * Maximum number of breakpoints, including watchpoints, that may be set at once.
+ */
+#define DEBUG_MAX_BREAKPOINTS 16
+
+/**
+ * Bus operations that can trigger a watchpoint.
+ */
+typedef enum
+{
+    DEBUG_WATCH_READ   = 0x01, /**< Any read of a watched address. */
+    DEBUG_WATCH_WRITE  = 0x02, /**< Any write to a watched address. */
+    DEBUG_WATCH_CHANGE = 0x04, /**< A write that changes the value at a watched address. */
+} debug_watch_ops_t;
+
+/**
+ * Parameters of a watchpoint.
+ */
+typedef struct
+{
+    uint16_t addr_start;    /**< First address watched. */
+    uint16_t addr_end;      /**< Last address watched (inclusive). */
+    uint8_t ops;            /**< Combination of debug_watch_ops_t. */
+    bool match_value;       /**< Only trigger when the value read or written equals value. */
+    uint8_t value;          /**< Value to match when match_value is set. */
+} debug_watch_t;
+
+/**
+ * Information about the access that triggered a watchpoint.
+ */
+typedef struct
+{
+    debug_breakpoint_t handle;  /**< The handle of the watchpoint. */
+    uint16_t address;           /**< Address that was accessed. */
+    uint8_t value;              /**< Value that was read or written. */
+    bool write;                 /**< Indicates whether the access was a write. */
+    uint16_t pc;                /**< Address of the instruction that made the access. */
+    uint64_t cycle;             /**< CPU cycle of the access. */
+} debug_watch_hit_t;
+
 /**
  * Structure representing information that can be queried about a debugger breakpoint.
  */
@@ -50,6 +90,17 @@ typedef struct breakpoint_info_s
      * (Note: This is not currently used)
      */
     const char *label;
+
+    /**
+     * For watchpoints, the combination of debug_watch_ops_t that trigger it. 0 for execution
+     * breakpoints.
+     */
+    uint8_t watch_ops;
+
+    /**
+     * For watchpoints, the last address watched. The first is given by address.
+     */
+    uint16_t end_address;
 } breakpoint_info_t;
 
 /**
@@ -74,6 +125,15 @@ typedef struct
  */
 debug_t debug_init(cbemu_t emulator);
 
+/**
+ * Frees a debugger instance, removing any watchpoints from the bus. Commands already in the
+ * mailbox are run first, so no thread is left waiting in debug_call. Other threads must have
+ * stopped posting before this is called, as a post made during or after it uses the freed handle.
+ *
+ * @param[in] handle The debugger handle.
+ */
+void debug_cleanup(debug_t handle);
+
 /**
  * Loads label information for an executing image. The file should be in the VICES label format,
  * as generated by the cc65 toolchain.
@@ -108,6 +168,31 @@ bool debug_set_breakpoint_addr(debug_t handle, debug_breakpoint_t *breakpoint_ha
  */
 bool debug_set_breakpoint_label(debug_t handle, debug_breakpoint_t *breakpoint_handle, const char *label);
 
+/**
+ * Sets a watchpoint on a range of addresses. Watchpoints share their handles with execution
+ * breakpoints and are reported in the same way, once the instruction that made the access has
+ * completed. Only the pages containing the range are checked, so accesses elsewhere run at full
+ * speed. Dummy reads made by the CPU do not trigger read watchpoints.
+ *
+ * @param[in] handle The debugger handle.
+ * @param[out] breakpoint_handle On success, set to the handle of the created watchpoint.
+ * @param[in] watch The watchpoint parameters.
+ *
+ * @return true if the watchpoint was set successfully.
+ */
+bool debug_set_watchpoint(debug_t handle, debug_breakpoint_t *breakpoint_handle, const debug_watch_t *watch);
+
+/**
+ * Gets the details of the access that triggered the watchpoint that stopped the last run, next or
+ * finish operation.
+ *
+ * @param[in] handle The debugger handle.
+ * @param[out] hit Populated with the access details.
+ *
+ * @return true if the last operation stopped due to a watchpoint.
+ */
+bool debug_get_watch_hit(debug_t handle, debug_watch_hit_t *hit);
+
 /**
  * Clears a previously set breakpoint.
  *
@@ -149,13 +234,28 @@ bool debug_next(debug_t handle, debug_breakpoint_t *breakpoint_hit);
 void debug_step(debug_t handle);
 
 /**
- * Runs the emulator indefinitely until broken.
+ * Runs the emulator indefinitely until broken. emu_stop breaks it like debug_break, and a break
+ * or stop requested before it starts is dropped.
  *
  * @param[in] handle The debugger handle.
  * @param[out] breakpoint_hit Populated with the handle of the breakpoint that caused execution to stop.
  */
 void debug_run(debug_t handle, debug_breakpoint_t *breakpoint_hit);
 
+/**
+ * Runs the emulator for a slice of at least a number of CPU cycles, stopping early on a break.
+ * The slice is made of whole instructions, so may overrun by part of one. Like emu_run_slice, it
+ * also stops for emu_stop, and a break or stop requested since the last slice ends it before it
+ * runs. EMU_EVENT_SLICE is raised on return, along with EMU_EVENT_BREAK if it stopped early.
+ *
+ * @param[in] handle The debugger handle.
+ * @param[in] cycles The number of CPU cycles to run.
+ * @param[out] breakpoint_hit If this function returns @c true, this will be populated with the handle of the breakpoint that was hit.
+ *
+ * @return @c true if execution stopped early due to a breakpoint or break request.
+ */
+bool debug_run_slice(debug_t handle, uint64_t cycles, debug_breakpoint_t *breakpoint_hit);
+
 /**
  * Forced an external break (i.e. input from user to break).
  *
@@ -163,6 +263,62 @@ void debug_run(debug_t handle, debug_breakpoint_t *breakpoint_hit);
  */
 void debug_break(debug_t handle);
 
+/**
+ * Function run on the emulation thread by a command posted to the debugger.
+ *
+ * @param[in] handle The debugger handle.
+ * @param[in] userdata The userdata given when the command was posted.
+ */
+typedef void (*debug_cmd_fn_t)(debug_t handle, void *userdata);
+
+/**
+ * Posts a command to the debugger from any thread, returning without waiting for it to run. The
+ * command is run on the emulation thread, where it may use any of the debugger functions, such as
+ * debug_break to pause a run or debug_set_breakpoint_addr to add a breakpoint. Commands are taken
+ * from a lock-free mailbox every few hundred instructions while running, and by
+ * debug_process_commands while stopped. They are run in the order they were posted.
+ *
+ * @param[in] handle The debugger handle.
+ * @param[in] fn The function to run.
+ * @param[in] userdata Passed to fn.
+ *
+ * @return @c true if the command was posted, or @c false if it couldn't be allocated.
+ */
+bool debug_post(debug_t handle, debug_cmd_fn_t fn, void *userdata);
+
+/**
+ * Posts a command to the debugger like debug_post, then blocks until it has run. This must not be
+ * called from the emulation thread, which would never get to run it. While the emulator is
+ * stopped, the call only returns once the emulation thread runs debug_process_commands, such as
+ * when woken through debug_get_command_fd.
+ *
+ * @param[in] handle The debugger handle.
+ * @param[in] fn The function to run.
+ * @param[in] userdata Passed to fn.
+ *
+ * @return @c true once the command has run.
+ */
+bool debug_call(debug_t handle, debug_cmd_fn_t fn, void *userdata);
+
+/**
+ * Runs any commands waiting in the mailbox. The debugger does this itself while running, so this
+ * is only needed to serve commands while the emulator is stopped.
+ *
+ * @param[in] handle The debugger handle.
+ */
+void debug_process_commands(debug_t handle);
+
+/**
+ * Gets a file descriptor that polls readable while commands are waiting in the mailbox, so a
+ * stopped emulation thread can wait for them alongside its other input. It stays readable until
+ * debug_process_commands is called. The descriptor must not be read or closed directly.
+ *
+ * @param[in] handle The debugger handle.
+ *
+ * @return The file descriptor, or -1 if the host has no descriptor to wait on.
+ */
+int debug_get_command_fd(debug_t handle);
+
 /**
  * Execute until return for current subroutine.
  *
@@ -211,4 +367,17 @@ uint8_t debug_peek(debug_t handle, uint16_t addr);
  */
 void debug_dump(debug_t handle, uint16_t addr, uint16_t *len, uint8_t *buffer);
 
+/**
+ * Dumps a section of the emulator memory space using the debugger, copying pages of memory
+ * devices directly rather than peeking each address. The result is the same as debug_dump for
+ * devices whose peeks return the contents of their memory.
+ *
+ * @param[in] handle    The debugger handle.
+ * @param[in] addr      The base address to begin the dump at.
+ * @param[in,out] len   As input, the length of memory data to dump from the base address.
+ *                      On output, the amount of data actually copied into the buffer.
+ * @param[out] buffer   Buffer to dump the memory data into.
+ */
+void debug_dump_fast(debug_t handle, uint16_t addr, uint16_t *len, uint8_t *buffer);
+
 #endif /* end of include guard: __DEBUGGER_H__ */
@@ -10,4 +10,12 @@
  */
 typedef struct cbemu_s *cbemu_t;
 
+/**
+ * CPU execution engines. Any new engine must pass cpu_fuzz_tester against the reference.
+ */
+typedef enum
+{
+    CPU_ENGINE_CYCLE    /**< Reference engine, stepping the CPU state machine one bus cycle per tick. */
+} cpu_engine_t;
+
 #endif /* end of include guard: __EMU_TYPES_H__ */
@@ -5,13 +5,73 @@
 #include "bus.h"
 #include "clock.h"
 
+/**
+ * Events reported through the emulator's event file descriptor.
+ */
+typedef enum
+{
+    EMU_EVENT_SLICE  = 0x01,    /**< A call to emu_run_slice has returned. */
+    EMU_EVENT_BREAK  = 0x02,    /**< Execution was stopped by emu_stop, or a breakpoint was hit. */
+    EMU_EVENT_OUTPUT = 0x04,    /**< A device has output waiting for the host, such as the ACIA. */
+} emu_event_t;
+
 typedef struct
 {
     clock_config_t mainclk_config;
+    cpu_engine_t cpu_engine;    /**< CPU execution engine. Defaults to the cycle-accurate engine. */
 } emu_config_t;
 
 cbemu_t emu_init(const emu_config_t *config);
 void emu_cleanup(cbemu_t emu);
 void emu_tick(cbemu_t emu);
 
+/**
+ * Runs the emulator for up to a number of main clock cycles, then returns. The slice ends early
+ * if emu_stop is called, and runs no cycles if it was called since the last slice.
+ * EMU_EVENT_SLICE is raised on return.
+ *
+ * @param[in] emu       The emulator instance
+ * @param[in] cycles    The maximum number of main clock cycles to run
+ *
+ * @return The number of main clock cycles run
+ */
+uint64_t emu_run_slice(cbemu_t emu, uint64_t cycles);
+
+/**
+ * Ends the current run slice at the next cycle, or the next one to start, raising EMU_EVENT_BREAK.
+ * This may be called from any thread, or by a device during the slice. debug_run, debug_next and
+ * debug_finish also end at the next instruction, and drop a stop raised before they start.
+ *
+ * @param[in] emu   The emulator instance
+ */
+void emu_stop(cbemu_t emu);
+
+/**
+ * Gets a file descriptor that polls readable while events are pending, for use with poll, epoll
+ * or similar. The descriptor is created on the first call, which should be made before the
+ * emulator is run. It belongs to the emulator and must not be read or closed directly.
+ *
+ * @param[in] emu   The emulator instance
+ *
+ * @return The file descriptor, or -1 if one couldn't be created or the host doesn't support it
+ */
+int emu_get_event_fd(cbemu_t emu);
+
+/**
+ * Takes the pending events, clearing them and the readiness of the event file descriptor.
+ *
+ * @param[in] emu   The emulator instance
+ *
+ * @return The combination of emu_event_t that were pending
+ */
+uint32_t emu_get_events(cbemu_t emu);
+
+/**
+ * Raises events, making the event file descriptor readable if they weren't already pending.
+ *
+ * @param[in] emu       The emulator instance
+ * @param[in] events    The combination of emu_event_t to raise
+ */
+void emu_raise_events(cbemu_t emu, uint32_t events);
+
 #endif /* end of include guard: __EMULATOR_H__ */
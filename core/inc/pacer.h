@@ -0,0 +1,108 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/**
+ * @file
+ * @brief Real-time pacing of the emulator
+ *
+ * Keeps emulated time in step with wall-clock time, so the emulator runs at the configured
+ * frequency of its main clock instead of as fast as the host allows. The pacer follows the main
+ * clock in slices of emulated time. At the end of each slice it sleeps until the wall-clock time
+ * at which that slice should end, so it needs no changes to the loop driving the emulator.
+ *
+ * When the emulator falls behind, such as while it is stopped in the debugger or the host is
+ * loaded, it runs without sleeping to catch up, but never by more than the catch-up limit. Any
+ * time beyond that is dropped rather than made up.
+ *
+ * A file descriptor can be given for the pacer to wait on while it sleeps, so input arriving for
+ * an idle emulated system wakes it without the latency of the rest of the slice.
+ */
+#ifndef __PACER_H__
+#define __PACER_H__
+
+#include <stdint.h>
+#include "emulator.h"
+
+/** Default length of a slice of emulated time, in microseconds. */
+#define PACER_DEFAULT_SLICE_US      1000
+
+/** Default limit on how far behind wall-clock time the emulator catches up, in microseconds. */
+#define PACER_DEFAULT_CATCHUP_US    100000
+
+/**
+ * Handle for a pacer instance.
+ */
+typedef struct pacer_s *pacer_t;
+
+/**
+ * Pacing statistics.
+ */
+typedef struct
+{
+    uint64_t slices;        /**< Number of slices run. */
+    uint64_t late_slices;   /**< Number of slices that ended after their wall-clock deadline. */
+    uint64_t slept_ns;      /**< Total time spent sleeping. */
+    uint64_t dropped_ns;    /**< Total time dropped by the catch-up limit. */
+    uint64_t woken_slices;  /**< Number of sleeps ended early by the wait file descriptor. */
+} pacer_stats_t;
+
+/**
+ * Creates a pacer for an emulator, running it at real time from now on.
+ *
+ * @param[in] emulator  The emulator instance to pace.
+ * @param[in] slice_us  Length of a slice of emulated time in microseconds, or 0 for the default.
+ *
+ * @return The pacer instance, or NULL if there was an error.
+ */
+pacer_t pacer_init(cbemu_t emulator, uint32_t slice_us);
+
+/**
+ * Stops pacing and frees a pacer.
+ *
+ * @param[in] handle    The pacer handle.
+ */
+void pacer_cleanup(pacer_t handle);
+
+/**
+ * Sets the speed of the emulator as a multiple of real time.
+ *
+ * @param[in] handle        The pacer handle.
+ * @param[in] multiplier    Speed multiplier, or 0 to run without pacing.
+ */
+void pacer_set_turbo(pacer_t handle, unsigned int multiplier);
+
+/**
+ * Sets how far behind wall-clock time the emulator may fall before the difference is dropped.
+ *
+ * @param[in] handle    The pacer handle.
+ * @param[in] limit_us  The catch-up limit in microseconds.
+ */
+void pacer_set_catchup(pacer_t handle, uint32_t limit_us);
+
+/**
+ * Sets a file descriptor to wait on while sleeping, such as one that becomes readable when input
+ * arrives for the emulated system. A sleep ends early when it polls readable, so the input is
+ * handled straight away rather than at the end of the slice.
+ *
+ * @param[in] handle    The pacer handle.
+ * @param[in] fd        The file descriptor, or -1 for none.
+ */
+void pacer_set_wait_fd(pacer_t handle, int fd);
+
+/**
+ * Restarts pacing from the current time, without catching up on any time that has passed. This
+ * should be called when the emulator resumes after being deliberately paused.
+ *
+ * @param[in] handle    The pacer handle.
+ */
+void pacer_resync(pacer_t handle);
+
+/**
+ * Gets the pacing statistics.
+ *
+ * @param[in] handle    The pacer handle.
+ * @param[out] stats    Filled in with the statistics.
+ */
+void pacer_get_stats(pacer_t handle, pacer_stats_t *stats);
+
+#endif /* end of include guard: __PACER_H__ */
@@ -0,0 +1,159 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/**
+ * @file
+ * @brief Per-function cycle profiler
+ *
+ * The profiler follows the CPU's shadow call stack (JSR/RTS and interrupt entry/RTI) and
+ * attributes every CPU cycle to the function at the top of the stack. Functions are keyed by
+ * their entry address and symbolized using cc65 debug information when available.
+ *
+ * Cycles are also aggregated per unique call stack, which allows exporting the profile as
+ * folded stacks or speedscope JSON. Memory use depends only on the number of unique call stacks,
+ * not the length of the run.
+ */
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "dbginfo.h"
+#include "emulator.h"
+
+/**
+ * Handle for a profiler instance.
+ */
+typedef struct profiler_s *profiler_t;
+
+/**
+ * Output formats for a complete profile.
+ */
+typedef enum
+{
+    PROFILER_FORMAT_REPORT,     /**< Human readable per-function report. */
+    PROFILER_FORMAT_FOLDED,     /**< Folded stacks ("main;sd_read;spi_xfer 12345"), as used by flamegraph tools. */
+    PROFILER_FORMAT_SPEEDSCOPE  /**< speedscope JSON sampled profile. */
+} profiler_format_t;
+
+/**
+ * Profiling information for a single function.
+ */
+typedef struct profiler_func_info_s
+{
+    /**
+     * Entry address of the function.
+     */
+    uint16_t address;
+
+    /**
+     * Symbol name of the function, or NULL if it could not be resolved.
+     */
+    const char *name;
+
+    /**
+     * Number of times the function was entered.
+     */
+    uint64_t calls;
+
+    /**
+     * Cycles spent in the function, including any functions it called.
+     */
+    uint64_t inclusive;
+
+    /**
+     * Cycles spent in the function itself.
+     */
+    uint64_t exclusive;
+
+    /**
+     * Indicates the function was entered via an interrupt or BRK vector.
+     */
+    bool interrupt;
+} profiler_func_info_t;
+
+/**
+ * Creates a profiler and attaches it to an emulator instance. Profiling begins immediately.
+ *
+ * @param[in] emulator  The emulator instance to profile.
+ *
+ * @return The profiler instance, or NULL if there was an error.
+ */
+profiler_t profiler_init(cbemu_t emulator);
+
+/**
+ * Provide the profiler with cc65 debug info used to symbolize function addresses.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] dbginfo   The debug info to use, or NULL to clear it.
+ */
+void profiler_set_dbginfo(profiler_t handle, cc65_dbginfo dbginfo);
+
+/**
+ * Discards all collected profiling data and restarts profiling from the current cycle.
+ *
+ * @param[in] handle The profiler handle.
+ */
+void profiler_reset(profiler_t handle);
+
+/**
+ * Gets the number of cycles elapsed since profiling was started or reset.
+ *
+ * @param[in] handle The profiler handle.
+ *
+ * @return Total profiled cycles.
+ */
+uint64_t profiler_get_total_cycles(profiler_t handle);
+
+/**
+ * Gets the collected profiling information, sorted by exclusive cycles in descending order.
+ * Functions still executing are included with the cycles consumed so far.
+ *
+ * @param[in] handle The profiler handle.
+ * @param[in,out] num_funcs On entry, indicates the number of entries available in the supplied buffer.
+ *                          On return, indicates the number of entries populated into the buffer.
+ * @param[out] funcs Buffer of function information structures to populate.
+ * @param[out] total_funcs If supplied, populated with the total number of profiled functions.
+ */
+void profiler_get_functions(profiler_t handle, unsigned int *num_funcs, profiler_func_info_t *funcs, unsigned int *total_funcs);
+
+/**
+ * Writes a human readable profile report.
+ *
+ * @param[in] handle        The profiler handle.
+ * @param[in] out           Stream to write the report to.
+ * @param[in] max_entries   Maximum number of functions to report, or 0 for all of them.
+ */
+void profiler_report(profiler_t handle, FILE *out, unsigned int max_entries);
+
+/**
+ * Writes the full profile in the given format.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] out       Stream to write the profile to.
+ * @param[in] format    The output format.
+ *
+ * @return true if the profile was written successfully.
+ */
+bool profiler_write(profiler_t handle, FILE *out, profiler_format_t format);
+
+/**
+ * Writes the full profile in the given format to a file.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] filename  The file to write.
+ * @param[in] format    The output format.
+ *
+ * @return true if the profile was written successfully.
+ */
+bool profiler_dump(profiler_t handle, const char *filename, profiler_format_t format);
+
+/**
+ * Detaches a profiler from its emulator and frees it.
+ *
+ * @param[in] handle The profiler handle.
+ */
+void profiler_cleanup(profiler_t handle);
+
+#endif /* end of include guard: __PROFILER_H__ */
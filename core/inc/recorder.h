@@ -0,0 +1,107 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/**
+ * @file
+ * @brief Binary bus trace recorder
+ *
+ * The recorder attaches a bus tracer that appends a fixed-size record for each bus transaction
+ * to a single-producer/single-consumer ring. A background thread drains the ring to a file in
+ * large writes, so the emulation loop only pays for copying the record. If the writer falls
+ * behind and the ring fills, the emulation loop waits for it rather than dropping records.
+ *
+ * The file starts with a recorder_file_header_t, followed by recorder_record_t records in the
+ * order the transactions were made, and ends with the block index described in tracefile.h.
+ * All fields are stored in host byte order.
+ */
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "emulator.h"
+
+/** Magic number at the start of a trace file. */
+#define RECORDER_MAGIC      "CB6502TR"
+
+/** Version of the trace file format. */
+#define RECORDER_VERSION    2
+
+/**
+ * Handle for a recorder instance.
+ */
+typedef struct recorder_s *recorder_t;
+
+/**
+ * Flags stored with each record.
+ */
+typedef enum
+{
+    RECORD_WRITE = 0x01,    /**< The transaction was a write. */
+    RECORD_SYNC  = 0x02,    /**< The transaction was an opcode fetch. */
+    RECORD_DUMMY = 0x04,    /**< The transaction was a read discarded by the CPU. */
+} recorder_flags_t;
+
+/**
+ * Header at the start of a trace file.
+ */
+typedef struct
+{
+    char magic[8];          /**< RECORDER_MAGIC, without a terminator. */
+    uint16_t version;       /**< RECORDER_VERSION. */
+    uint16_t record_size;   /**< Size of each record in bytes. */
+    uint32_t reserved;      /**< Reserved, written as 0. */
+} recorder_file_header_t;
+
+/**
+ * A single recorded bus transaction.
+ */
+typedef struct
+{
+    uint64_t cycle;         /**< CPU cycle the transaction was made on. */
+    uint16_t pc;            /**< Address of the instruction making the transaction. */
+    uint16_t addr;          /**< Address of the transaction. */
+    uint8_t value;          /**< Value read or written. */
+    uint8_t flags;          /**< Combination of recorder_flags_t. */
+    uint16_t reserved;      /**< Reserved, written as 0. */
+} recorder_record_t;
+
+/**
+ * Creates a recorder and starts recording bus transactions to a file.
+ *
+ * @param[in] emulator  The emulator instance to record.
+ * @param[in] filename  The file to record to. It is truncated if it exists.
+ * @param[in] filter    Filter for the transactions to record, or NULL to record all of them.
+ *
+ * @return The recorder instance, or NULL if there was an error.
+ */
+recorder_t recorder_init(cbemu_t emulator, const char *filename, const bus_trace_filter_t *filter);
+
+/**
+ * Gets the number of records made so far.
+ *
+ * @param[in] handle    The recorder handle.
+ *
+ * @return The number of records.
+ */
+uint64_t recorder_get_count(recorder_t handle);
+
+/**
+ * Gets the number of times recording had to wait for the writer thread to free space in the ring.
+ *
+ * @param[in] handle    The recorder handle.
+ *
+ * @return The number of waits.
+ */
+uint64_t recorder_get_stalls(recorder_t handle);
+
+/**
+ * Stops recording, writes any remaining records, closes the file and frees the recorder.
+ *
+ * @param[in] handle    The recorder handle.
+ *
+ * @return true if every record was written to the file.
+ */
+bool recorder_cleanup(recorder_t handle);
+
+#endif /* end of include guard: __RECORDER_H__ */
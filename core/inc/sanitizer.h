@@ -0,0 +1,170 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/**
+ * @file
+ * @brief Shadow-memory sanitizer for guest firmware
+ *
+ * The sanitizer keeps per-byte shadow state for RAM and ROM regions of the address space and
+ * reports firmware bugs that are otherwise hard to find on hardware:
+ *  - Reads of RAM that has never been written.
+ *  - Stack pointer wrap within page 1, in either direction.
+ *  - Writes into a ROM region.
+ *
+ * Only pages containing a registered region are checked, via the bus decode table, so accesses
+ * to any other page are unaffected. Each offending address is reported once.
+ */
+#ifndef __SANITIZER_H__
+#define __SANITIZER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "dbginfo.h"
+#include "emulator.h"
+
+/**
+ * Handle for a sanitizer instance.
+ */
+typedef struct sanitizer_s *sanitizer_t;
+
+/**
+ * Types of memory regions tracked by the sanitizer.
+ */
+typedef enum
+{
+    SANITIZER_REGION_RAM,   /**< Writable memory, which must be written before it is read. */
+    SANITIZER_REGION_ROM    /**< Read-only memory, which must not be written. */
+} sanitizer_region_t;
+
+/**
+ * Conditions detected by the sanitizer.
+ */
+typedef enum
+{
+    SANITIZER_UNINIT_READ,      /**< RAM was read before it was written. */
+    SANITIZER_STACK_OVERFLOW,   /**< A push wrapped the stack pointer from $00 to $FF. */
+    SANITIZER_STACK_UNDERFLOW,  /**< A pull wrapped the stack pointer from $FF to $00. */
+    SANITIZER_ROM_WRITE,        /**< ROM was written. */
+    SANITIZER_NUM_ERRORS
+} sanitizer_error_t;
+
+/**
+ * Details of a detected condition.
+ */
+typedef struct sanitizer_report_s
+{
+    /**
+     * The condition detected.
+     */
+    sanitizer_error_t error;
+
+    /**
+     * Address of the instruction that caused the condition.
+     */
+    uint16_t pc;
+
+    /**
+     * Address accessed. For stack conditions, this is the stack address accessed.
+     */
+    uint16_t addr;
+
+    /**
+     * Nearest symbol at or before the PC, or NULL if it could not be resolved.
+     */
+    const char *symbol;
+
+    /**
+     * Offset of the PC from the symbol.
+     */
+    uint16_t offset;
+
+    /**
+     * CPU cycle the condition was detected at.
+     */
+    uint64_t cycle;
+} sanitizer_report_t;
+
+/**
+ * Callback for sanitizer reports.
+ *
+ * @param[in] report    The details of the condition. Only valid for the duration of the call.
+ * @param[in] userdata  Userdata supplied when the callback was set.
+ */
+typedef void (*sanitizer_report_cb_t)(const sanitizer_report_t *report, void *userdata);
+
+/**
+ * Creates a sanitizer and attaches it to an emulator instance. No memory is checked until
+ * regions are added. Only one sanitizer may be attached to an emulator at a time.
+ *
+ * @param[in] emulator  The emulator instance to check.
+ *
+ * @return The sanitizer instance, or NULL if there was an error.
+ */
+sanitizer_t sanitizer_init(cbemu_t emulator);
+
+/**
+ * Adds a region of memory to be checked. All RAM in the region is marked as uninitialized.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] start     The first address of the region.
+ * @param[in] end       The last address of the region (inclusive).
+ * @param[in] type      The type of memory in the region.
+ *
+ * @return true if the region was added.
+ */
+bool sanitizer_add_region(sanitizer_t handle, uint16_t start, uint16_t end, sanitizer_region_t type);
+
+/**
+ * Marks RAM as initialized, such as after it has been loaded externally.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] start     The first address to mark.
+ * @param[in] end       The last address to mark (inclusive).
+ */
+void sanitizer_mark_initialized(sanitizer_t handle, uint16_t start, uint16_t end);
+
+/**
+ * Provide the sanitizer with cc65 debug info used to symbolize reports.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] dbginfo   The debug info to use, or NULL to clear it.
+ */
+void sanitizer_set_dbginfo(sanitizer_t handle, cc65_dbginfo dbginfo);
+
+/**
+ * Sets the callback used to deliver reports. By default, reports are logged as warnings.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] callback  The callback, or NULL to restore logging.
+ * @param[in] userdata  Userdata supplied to the callback.
+ */
+void sanitizer_set_callback(sanitizer_t handle, sanitizer_report_cb_t callback, void *userdata);
+
+/**
+ * Gets the number of times a condition has been reported.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] error     The condition.
+ *
+ * @return The number of reports.
+ */
+unsigned int sanitizer_get_count(sanitizer_t handle, sanitizer_error_t error);
+
+/**
+ * Formats a report as a single line of text.
+ *
+ * @param[in] report    The report to format.
+ * @param[out] buffer   Buffer to populate.
+ * @param[in] size      Size of the buffer.
+ */
+void sanitizer_format_report(const sanitizer_report_t *report, char *buffer, size_t size);
+
+/**
+ * Detaches a sanitizer from its emulator and frees it.
+ *
+ * @param[in] handle The sanitizer handle.
+ */
+void sanitizer_cleanup(sanitizer_t handle);
+
+#endif /* end of include guard: __SANITIZER_H__ */
@@ -0,0 +1,241 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/**
+ * @file
+ * @brief Emulator state snapshots
+ *
+ * Captures the whole state of an emulator into a memory buffer, and restores it again, so a
+ * machine can be returned to a known point such as just after boot without rerunning the ROM.
+ *
+ * The CPU, bus and clocks are captured by the core. Every device with state of its own registers
+ * hooks that serialize and deserialize it, which are called in the order they were registered.
+ * A snapshot holds a section for each hook, and can only be restored into an emulator built the
+ * same way, with the same devices registered in the same order. It holds host byte order and
+ * structure layouts, so is not portable between builds.
+ *
+ * Before capturing, every device synchronized lazily with its clock is brought up to date, so
+ * the hooks see its current state. Host-side state, such as input buffered by a transport or the
+ * contents of a disk image, is not part of the machine and is not captured.
+ *
+ * Devices with large memories save them with snapshot_write_pages, after the rest of their state,
+ * and track the pages written since the last snapshot in a dirty bitmap. A delta snapshot then
+ * holds only those pages, along with the rest of every device's state, relative to the snapshot
+ * saved or restored just before it. A delta can't be restored by itself. It is collapsed onto the
+ * snapshot it follows, which may itself be the result of collapsing a chain of deltas.
+ *
+ * Snapshots must be saved and restored on the emulation thread, between ticks.
+ */
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "emulator.h"
+
+/** Maximum length of the name of a hook, including the terminator. */
+#define SNAPSHOT_MAX_NAME   16
+
+/** Size of the pages dirty memory is tracked in, as a power of 2. */
+#define SNAPSHOT_PAGE_SHIFT 8
+#define SNAPSHOT_PAGE_SIZE  (1 << SNAPSHOT_PAGE_SHIFT)
+
+/** Size in bytes of a dirty bitmap for a memory of the given size. */
+#define SNAPSHOT_DIRTY_SIZE(_size)  (((((_size) + SNAPSHOT_PAGE_SIZE - 1) >> SNAPSHOT_PAGE_SHIFT) + 7) / 8)
+
+/** Marks the page holding an offset within a memory as written since the last snapshot. */
+#define SNAPSHOT_MARK_DIRTY(_map, _offset)  ((_map)[(_offset) >> (SNAPSHOT_PAGE_SHIFT + 3)] |= (uint8_t)(1 << (((_offset) >> SNAPSHOT_PAGE_SHIFT) & 0x07)))
+
+/**
+ * Handle for a snapshot buffer.
+ */
+typedef struct snapshot_s *snapshot_t;
+
+/**
+ * Handle for registered snapshot hooks.
+ */
+typedef struct snapshot_hook_s *snapshot_hook_t;
+
+/**
+ * Hook serializing the state of a device into a snapshot, using snapshot_write.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] userdata  Userdata supplied when the hook was registered.
+ *
+ * @return true if the state was written.
+ */
+typedef bool (*snapshot_save_cb_t)(snapshot_t snap, void *userdata);
+
+/**
+ * Hook deserializing the state of a device from a snapshot, using snapshot_read. It must read
+ * exactly what its save hook wrote.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[in] userdata  Userdata supplied when the hook was registered.
+ *
+ * @return true if the state was read and is valid.
+ */
+typedef bool (*snapshot_restore_cb_t)(snapshot_t snap, void *userdata);
+
+/**
+ * Registers the hooks of a device. Sections are saved and restored in the order the hooks are
+ * registered.
+ *
+ * @param[in] emu       The emulator instance.
+ * @param[in] name      Name of the device, identifying its section. Names need not be unique.
+ * @param[in] save      The hook serializing the device's state.
+ * @param[in] restore   The hook deserializing the device's state.
+ * @param[in] userdata  Passed to the hooks.
+ *
+ * @return A handle for the registered hooks, or NULL on error.
+ */
+snapshot_hook_t snapshot_register(cbemu_t emu, const char *name, snapshot_save_cb_t save, snapshot_restore_cb_t restore, void *userdata);
+
+/**
+ * Unregisters the hooks of a device.
+ *
+ * @param[in] hook  Handle returned by snapshot_register.
+ */
+void snapshot_unregister(snapshot_hook_t hook);
+
+/**
+ * Creates an empty snapshot buffer. A buffer can be saved into repeatedly, reusing its memory.
+ *
+ * @return The snapshot handle, or NULL on error.
+ */
+snapshot_t snapshot_init(void);
+
+/**
+ * Frees a snapshot buffer.
+ *
+ * @param[in] snap  The snapshot handle.
+ */
+void snapshot_cleanup(snapshot_t snap);
+
+/**
+ * Captures the state of an emulator, replacing the contents of a snapshot.
+ *
+ * @param[in] emu   The emulator instance.
+ * @param[in] snap  The snapshot to save into.
+ *
+ * @return true if the state was captured.
+ */
+bool snapshot_save(cbemu_t emu, snapshot_t snap);
+
+/**
+ * Captures the changes to an emulator since it was saved to or restored from a snapshot, replacing
+ * the contents of another snapshot. Pages of memory that haven't been written are left out.
+ *
+ * @param[in] emu       The emulator instance.
+ * @param[in] snap      The snapshot to save into.
+ * @param[in] parent    The snapshot the emulator was last saved to or restored from.
+ *
+ * @return true if the changes were captured, or false if the parent is not the last snapshot.
+ */
+bool snapshot_save_delta(cbemu_t emu, snapshot_t snap, snapshot_t parent);
+
+/**
+ * Applies a delta snapshot to the snapshot it follows. The result replaces the contents of the
+ * base, and is a full snapshot if the base was, or a delta covering both otherwise.
+ *
+ * @param[in] base  The snapshot the delta was saved relative to.
+ * @param[in] delta The delta snapshot.
+ *
+ * @return true if the delta was applied.
+ */
+bool snapshot_collapse(snapshot_t base, snapshot_t delta);
+
+/**
+ * Checks whether a snapshot is a delta, which must be collapsed before it can be restored.
+ *
+ * @param[in] snap  The snapshot handle.
+ *
+ * @return true if the snapshot holds a delta.
+ */
+bool snapshot_is_delta(snapshot_t snap);
+
+/**
+ * Restores the state of an emulator from a snapshot. The sections are checked against the
+ * registered hooks before anything is restored, but if a hook then fails, the emulator is left
+ * partly restored.
+ *
+ * @param[in] emu   The emulator instance.
+ * @param[in] snap  The snapshot to restore.
+ *
+ * @return true if the state was restored.
+ */
+bool snapshot_restore(cbemu_t emu, snapshot_t snap);
+
+/**
+ * Gets the serialized contents of a snapshot, such as to write to a file.
+ *
+ * @param[in] snap  The snapshot handle.
+ * @param[out] size Set to the size of the contents in bytes.
+ *
+ * @return The contents, which remain valid until the snapshot is next changed.
+ */
+const uint8_t *snapshot_get_data(snapshot_t snap, size_t *size);
+
+/**
+ * Replaces the contents of a snapshot with previously serialized contents. They are checked
+ * when restored.
+ *
+ * @param[in] snap  The snapshot handle.
+ * @param[in] data  The serialized contents.
+ * @param[in] size  Size of the contents in bytes.
+ *
+ * @return true if the contents were copied.
+ */
+bool snapshot_set_data(snapshot_t snap, const uint8_t *data, size_t size);
+
+/**
+ * Appends state to the section being saved. Only valid within a save hook.
+ *
+ * @param[in] snap  The snapshot being saved.
+ * @param[in] data  The state to append.
+ * @param[in] size  Size of the state in bytes.
+ *
+ * @return true if the state was appended.
+ */
+bool snapshot_write(snapshot_t snap, const void *data, size_t size);
+
+/**
+ * Reads the next state from the section being restored. Only valid within a restore hook.
+ *
+ * @param[in] snap  The snapshot being restored.
+ * @param[out] data Filled in with the state.
+ * @param[in] size  Size of the state in bytes.
+ *
+ * @return true if the state was read, or false if the section is too short.
+ */
+bool snapshot_read(snapshot_t snap, void *data, size_t size);
+
+/**
+ * Appends the pages of a memory to the section being saved. A full snapshot holds every page,
+ * while a delta only holds those marked in the dirty bitmap, which is then cleared. Only valid
+ * within a save hook, after any other state has been written.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] data      The memory.
+ * @param[in] size      Size of the memory in bytes.
+ * @param[in,out] dirty Bitmap of pages written since the last snapshot, of SNAPSHOT_DIRTY_SIZE(size).
+ *
+ * @return true if the pages were appended.
+ */
+bool snapshot_write_pages(snapshot_t snap, const uint8_t *data, size_t size, uint8_t *dirty);
+
+/**
+ * Reads the pages of a memory from the section being restored, and clears its dirty bitmap. Only
+ * valid within a restore hook.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[out] data     The memory.
+ * @param[in] size      Size of the memory in bytes, which must match the size saved.
+ * @param[out] dirty    Bitmap of pages written since the last snapshot, of SNAPSHOT_DIRTY_SIZE(size).
+ *
+ * @return true if the pages were read.
+ */
+bool snapshot_read_pages(snapshot_t snap, uint8_t *data, size_t size, uint8_t *dirty);
+
+#endif /* end of include guard: __SNAPSHOT_H__ */
@@ -0,0 +1,184 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/**
+ * @file
+ * @brief Indexed bus trace files
+ *
+ * Trace files written by the recorder end with a block index, so that queries over very large
+ * traces don't need to scan every record. Each block covers TRACEFILE_BLOCK_RECORDS consecutive
+ * records and summarizes the cycles they span, the range of PCs that made them, and which pages
+ * were accessed and written. Queries use the index to skip blocks that can't contain a match.
+ *
+ * The index is an array of tracefile_block_t following the last record, and is located by a
+ * tracefile_footer_t at the very end of the file. Files without an index, such as one from a
+ * recording that was interrupted, are indexed in memory when opened.
+ *
+ * Files are memory mapped, so records returned by queries point directly into the file and are
+ * valid until it is closed.
+ */
+#ifndef __TRACEFILE_H__
+#define __TRACEFILE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "recorder.h"
+
+/** Magic number at the start of the index footer. */
+#define TRACEFILE_INDEX_MAGIC       "CB6502IX"
+
+/** Number of records summarized by each index block. */
+#define TRACEFILE_BLOCK_RECORDS     4096
+
+/** Number of bytes in a page bitmap. */
+#define TRACEFILE_PAGE_BYTES        32
+
+/**
+ * Handle for an open trace file.
+ */
+typedef struct tracefile_s *tracefile_t;
+
+/**
+ * Summary of a block of records.
+ */
+typedef struct
+{
+    uint64_t first_cycle;                   /**< Cycle of the first record in the block. */
+    uint64_t last_cycle;                    /**< Cycle of the last record in the block. */
+    uint16_t min_pc;                        /**< Lowest PC of any record in the block. */
+    uint16_t max_pc;                        /**< Highest PC of any record in the block. */
+    uint32_t syncs;                         /**< Number of opcode fetches in the block. */
+    uint8_t pages[TRACEFILE_PAGE_BYTES];    /**< Bitmap of pages accessed in the block. */
+    uint8_t writes[TRACEFILE_PAGE_BYTES];   /**< Bitmap of pages written in the block. */
+} tracefile_block_t;
+
+/**
+ * Footer at the end of an indexed trace file.
+ */
+typedef struct
+{
+    char magic[8];          /**< TRACEFILE_INDEX_MAGIC, without a terminator. */
+    uint64_t index_offset;  /**< File offset of the first index block. */
+    uint64_t num_blocks;    /**< Number of index blocks. */
+    uint64_t num_records;   /**< Number of records in the file. */
+} tracefile_footer_t;
+
+/**
+ * Parameters for a query of the records in a trace file. All ranges are inclusive.
+ */
+typedef struct
+{
+    uint16_t addr_start;    /**< First address to match. */
+    uint16_t addr_end;      /**< Last address to match. */
+    uint16_t pc_start;      /**< First PC to match. */
+    uint16_t pc_end;        /**< Last PC to match. */
+    uint64_t cycle_start;   /**< First cycle to match. */
+    uint64_t cycle_end;     /**< Last cycle to match. */
+    bool writes_only;       /**< Only match write records. */
+} tracefile_query_t;
+
+/**
+ * Callback made for each record matching a query.
+ *
+ * @param[in] record    The matching record.
+ * @param[in] userdata  Userdata supplied with the query.
+ *
+ * @return true to continue the query, or false to stop it.
+ */
+typedef bool (*tracefile_cb_t)(const recorder_record_t *record, void *userdata);
+
+/**
+ * Opens and maps a trace file.
+ *
+ * @param[in] filename  The trace file to open.
+ *
+ * @return The trace file handle, or NULL if the file could not be opened or is not a trace file.
+ */
+tracefile_t tracefile_open(const char *filename);
+
+/**
+ * Gets the number of records in a trace file.
+ *
+ * @param[in] handle    The trace file handle.
+ *
+ * @return The number of records.
+ */
+uint64_t tracefile_get_count(tracefile_t handle);
+
+/**
+ * Gets a record by its position in a trace file.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] index     The index of the record.
+ *
+ * @return The record, or NULL if the index is out of range.
+ */
+const recorder_record_t *tracefile_get_record(tracefile_t handle, uint64_t index);
+
+/**
+ * Finds the first record made on or after a cycle.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] cycle     The cycle to find.
+ *
+ * @return The index of the record, or the number of records if there is none.
+ */
+uint64_t tracefile_find_cycle(tracefile_t handle, uint64_t cycle);
+
+/**
+ * Finds the last write to an address made before a cycle.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] addr      The address written.
+ * @param[in] before    Only writes made before this cycle are considered.
+ *
+ * @return The write record, or NULL if the address was not written.
+ */
+const recorder_record_t *tracefile_last_write(tracefile_t handle, uint16_t addr, uint64_t before);
+
+/**
+ * Calls back for each record matching a query, in the order they were recorded.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] query     The query parameters.
+ * @param[in] callback  Callback made for each matching record.
+ * @param[in] userdata  Userdata supplied to the callback.
+ *
+ * @return The number of matching records.
+ */
+uint64_t tracefile_query(tracefile_t handle, const tracefile_query_t *query, tracefile_cb_t callback, void *userdata);
+
+/**
+ * Calls back for the opcode fetches around a cycle, in the order they were recorded. This gives
+ * the history of instructions executed leading up to and following an event.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] cycle     The cycle of the event.
+ * @param[in] before    Maximum number of fetches made before the cycle.
+ * @param[in] after     Maximum number of fetches made on or after the cycle.
+ * @param[in] callback  Callback made for each fetch.
+ * @param[in] userdata  Userdata supplied to the callback.
+ *
+ * @return The number of fetches.
+ */
+uint64_t tracefile_pc_history(tracefile_t handle, uint64_t cycle, unsigned int before, unsigned int after,
+                              tracefile_cb_t callback, void *userdata);
+
+/**
+ * Formats a record as a single line of text.
+ *
+ * @param[in] record    The record to format.
+ * @param[out] buffer   Buffer to populate.
+ * @param[in] size      Size of the buffer.
+ */
+void tracefile_format_record(const recorder_record_t *record, char *buffer, size_t size);
+
+/**
+ * Unmaps and closes a trace file.
+ *
+ * @param[in] handle    The trace file handle.
+ */
+void tracefile_close(tracefile_t handle);
+
+#endif /* end of include guard: __TRACEFILE_H__ */
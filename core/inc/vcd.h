@@ -0,0 +1,107 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+/**
+ * @file
+ * @brief Streaming VCD waveform writer
+ *
+ * Writes Value Change Dump files that can be viewed in GTKWave or similar tools. The CPU bus
+ * (address, data, RWB and SYNC) and the IRQB, NMIB and RDY pins are always included, and devices
+ * can add their own signals, such as port pins, before the capture is started.
+ *
+ * Value changes are stamped with the emulated time, derived from the CPU cycle count and the
+ * period of the main clock, and are handed to a background thread through a ring. The thread
+ * formats them and writes them to the file, so the emulation thread only pays for queueing
+ * changes. As with the bus trace recorder, the emulation thread waits for the writer rather
+ * than dropping changes if the ring fills.
+ *
+ * All signals must be set from the emulation thread.
+ */
+#ifndef __VCD_H__
+#define __VCD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "emulator.h"
+
+/** Maximum number of signals in a capture, including the CPU signals. */
+#define VCD_MAX_SIGNALS     64
+
+/** Maximum width of a signal in bits. */
+#define VCD_MAX_WIDTH       32
+
+/** Returned when a signal could not be added. */
+#define VCD_INVALID_SIGNAL  (-1)
+
+/**
+ * Handle for a VCD writer instance.
+ */
+typedef struct vcd_s *vcd_t;
+
+/**
+ * Handle for a signal within a capture.
+ */
+typedef int vcd_signal_t;
+
+/**
+ * Creates a VCD writer. Signals may be added until the capture is started.
+ *
+ * @param[in] emulator  The emulator instance to capture.
+ * @param[in] filename  The file to write. It is truncated if it exists.
+ *
+ * @return The VCD writer instance, or NULL if there was an error.
+ */
+vcd_t vcd_init(cbemu_t emulator, const char *filename);
+
+/**
+ * Adds a signal to the capture.
+ *
+ * @param[in] handle    The VCD writer handle.
+ * @param[in] scope     Name of the module the signal belongs to.
+ * @param[in] name      Name of the signal.
+ * @param[in] width     Width of the signal in bits, from 1 to VCD_MAX_WIDTH.
+ * @param[in] initial   Value of the signal when the capture starts.
+ *
+ * @return The signal handle, or VCD_INVALID_SIGNAL if it could not be added or the capture has
+ *         already started.
+ */
+vcd_signal_t vcd_add_signal(vcd_t handle, const char *scope, const char *name, uint8_t width, uint32_t initial);
+
+/**
+ * Writes the file header and starts capturing.
+ *
+ * @param[in] handle    The VCD writer handle.
+ *
+ * @return true if the capture was started.
+ */
+bool vcd_start(vcd_t handle);
+
+/**
+ * Sets the value of a signal at the current emulated time. Setting a signal to its current value
+ * does nothing. Values set before the capture starts become the initial value.
+ *
+ * @param[in] handle    The VCD writer handle.
+ * @param[in] signal    The signal to set.
+ * @param[in] value     The new value of the signal.
+ */
+void vcd_set_signal(vcd_t handle, vcd_signal_t signal, uint32_t value);
+
+/**
+ * Gets the number of value changes captured so far.
+ *
+ * @param[in] handle    The VCD writer handle.
+ *
+ * @return The number of value changes.
+ */
+uint64_t vcd_get_count(vcd_t handle);
+
+/**
+ * Stops capturing, writes any remaining changes, closes the file and frees the writer.
+ *
+ * @param[in] handle    The VCD writer handle.
+ *
+ * @return true if every change was written to the file.
+ */
+bool vcd_cleanup(vcd_t handle);
+
+#endif /* end of include guard: __VCD_H__ */
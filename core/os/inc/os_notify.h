@@ -0,0 +1,58 @@
+#ifndef __OS_NOTIFY_H__
+#define __OS_NOTIFY_H__
+
+/**
+ * Handle type for a notifier, which is a flag that can be waited on through a file descriptor.
+ */
+typedef void *os_notify_t;
+
+/**
+ * Creates a notifier, initially clear.
+ *
+ * @return The notifier handle, or NULL if unable to create it
+ */
+os_notify_t os_notify_create(void);
+
+/**
+ * Destroys a notifier, closing its file descriptor.
+ *
+ * @param[in] handle The notifier handle
+ */
+void os_notify_destroy(os_notify_t handle);
+
+/**
+ * Gets the file descriptor of a notifier, which polls readable while the notifier is set. The
+ * descriptor must not be read or closed directly.
+ *
+ * @param[in] handle The notifier handle
+ *
+ * @return The file descriptor, or -1 if the host has no descriptor to wait on
+ */
+int os_notify_fd(os_notify_t handle);
+
+/**
+ * Sets a notifier. This may be called from any thread.
+ *
+ * @param[in] handle The notifier handle
+ */
+void os_notify_set(os_notify_t handle);
+
+/**
+ * Clears a notifier. This may be called from any thread.
+ *
+ * @param[in] handle The notifier handle
+ */
+void os_notify_clear(os_notify_t handle);
+
+/**
+ * Waits until one of a set of file descriptors polls readable, such as a notifier's and standard
+ * input.
+ *
+ * @param[in] fds   The file descriptors to wait on
+ * @param[in] count Number of file descriptors
+ *
+ * @return The index of the first readable file descriptor, or -1 if the host can't wait on them
+ */
+int os_wait_fds(const int *fds, unsigned int count);
+
+#endif /* end of include guard: __OS_NOTIFY_H__ */
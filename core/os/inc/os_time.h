@@ -0,0 +1,33 @@
+#ifndef __OS_TIME_H__
+#define __OS_TIME_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Gets the current time of a monotonic clock, which is unaffected by changes to the system time.
+ *
+ * @return The current time in nanoseconds, from an unspecified starting point
+ */
+uint64_t os_time_ns(void);
+
+/**
+ * Sleeps until the monotonic clock of os_time_ns reaches a given time. Returns immediately if it
+ * already has.
+ *
+ * @param[in] deadline  The time to sleep until, in nanoseconds
+ */
+void os_sleep_until_ns(uint64_t deadline);
+
+/**
+ * Sleeps like os_sleep_until_ns, but returns early if a file descriptor polls readable. Where the
+ * host can't wait on file descriptors, this just sleeps.
+ *
+ * @param[in] fd        The file descriptor to wait on
+ * @param[in] deadline  The time to sleep until, in nanoseconds
+ *
+ * @return true if the file descriptor became readable before the deadline
+ */
+bool os_wait_fd_until_ns(int fd, uint64_t deadline);
+
+#endif /* end of include guard: __OS_TIME_H__ */
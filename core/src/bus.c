@@ -1,11 +1,21 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "emu_priv_types.h"
 #include "bus.h"
+#include "bus_priv.h"
 #include "log.h"
 
 #define MAX_SIG_VOTERS  (sizeof(bus_signal_voter_t) * 8)
 
+/** Cached results of a custom decoder. */
+typedef struct
+{
+    uint8_t valid[BUS_NUM_PAGES / 8];   /**< Pages whose results are cached */
+    uint8_t read[0x10000 / 8];          /**< Addresses decoded for reads */
+    uint8_t write[0x10000 / 8];         /**< Addresses decoded for writes */
+} bus_decode_cache_t;
+
 /** Tracking structure for a bus connection. */
 typedef struct bus_conn_s
 {
@@ -13,6 +23,9 @@ typedef struct bus_conn_s
     bus_decode_params_t params; /**< Address decode parameters for the connection */
     bus_handlers_t handlers;    /**< Memory operation handler callbacks */
     void *userdata;             /**< User parameter for callbacks */
+    const char *name;           /**< Name for reporting, or NULL */
+    bus_counters_t counters;    /**< Accesses decoded to the connection */
+    bus_decode_cache_t *cache;  /**< Cached custom decoder results, or NULL */
 } bus_conn_t;
 
 /** Tracking structure for a bus tracer */
@@ -21,11 +34,38 @@ typedef struct bus_tracer_s
     listnode_t list;            /**< list node */
     bus_trace_cb_t callback;    /**< Callback function */
     void *userdata;             /**< User parameter for callback */
+    bus_trace_filter_t filter;  /**< Operations to trace */
+    uint32_t count;             /**< Matching operations since the last traced one */
 } bus_tracer_t;
 
+/** Tracking structure for a signal watcher */
+typedef struct bus_sig_watcher_s
+{
+    listnode_t list;            /**< list node */
+    bus_signal_cb_t callback;   /**< Callback function */
+    void *userdata;             /**< User parameter for callback */
+} bus_sig_watcher_t;
+
+/** How a decoder covers a page of the address space. */
+typedef enum
+{
+    BUS_COVER_NONE,     /**< No address in the page is decoded. */
+    BUS_COVER_PARTIAL,  /**< Some addresses in the page may be decoded. */
+    BUS_COVER_FULL,     /**< Every address in the page is decoded. */
+} bus_cover_t;
+
+/** Filter used for tracers that are called on every bus transaction. */
+static const bus_trace_filter_t bus_trace_all = {
+    { BUSDECODE_RANGE, { { 0x0000, 0xFFFF } } },
+    BUS_TRACE_ALL,
+    0
+};
+
 static bool bus_match_addr(bus_decode_params_t *params, uint16_t addr, bool write, void *userdata);
 static bool bus_validate_params(const bus_decode_params_t *params);
-static uint8_t bus_read_peek_i(bus_t *bus, uint16_t addr, bool peek, bool sync);
+static uint8_t bus_read_peek_i(bus_t *bus, uint16_t addr, bool peek, bus_flags_t flags);
+static void bus_trace(bus_t *bus, uint16_t addr, uint8_t value, bool write, bus_flags_t flags);
+static bus_cover_t bus_conn_cover(bus_conn_t *conn, uint16_t base);
 
 /**
  * Determines if a given bus connection parameters matches a given address
@@ -50,6 +90,8 @@ static bool bus_match_addr(bus_decode_params_t *params, uint16_t addr, bool writ
             match = ((addr & params->value.mask.addr_mask) == params->value.mask.addr_value);
             break;
         case BUSDECODE_CUSTOM:
+        case BUSDECODE_CUSTOM_STATIC:
+        case BUSDECODE_CUSTOM_DYNAMIC:
             match = params->value.custom(addr, write, userdata);
             break;
         default:
@@ -80,7 +122,9 @@ static bool bus_validate_params(const bus_decode_params_t *params)
             valid = params->value.mask.addr_mask != 0;
             break;
         case BUSDECODE_CUSTOM:
-            valid = true;
+        case BUSDECODE_CUSTOM_STATIC:
+        case BUSDECODE_CUSTOM_DYNAMIC:
+            valid = params->value.custom != NULL;
             break;
         default:
             valid = false;
@@ -90,37 +134,317 @@ static bool bus_validate_params(const bus_decode_params_t *params)
     return valid;
 }
 
+/**
+ * Evaluates a custom decoder for every address in a page, caching the results
+ *
+ * @param[in] conn  The bus connection, which must have a cache
+ * @param[in] page  The page to evaluate
+ */
+static void bus_cache_fill(bus_conn_t *conn, unsigned int page)
+{
+    bus_decode_cache_t *cache = conn->cache;
+    uint32_t addr;
+
+    memset(&cache->read[page * 32], 0, 32);
+    memset(&cache->write[page * 32], 0, 32);
+
+    for(addr = page << 8; addr < ((page + 1) << 8); ++addr)
+    {
+        if(conn->params.value.custom((uint16_t)addr, false, conn->userdata))
+            cache->read[addr >> 3] |= (uint8_t)(1 << (addr & 7));
+
+        if(conn->params.value.custom((uint16_t)addr, true, conn->userdata))
+            cache->write[addr >> 3] |= (uint8_t)(1 << (addr & 7));
+    }
+
+    cache->valid[page >> 3] |= (uint8_t)(1 << (page & 7));
+}
+
+/**
+ * Evaluates a custom decoder for every address, caching the results
+ *
+ * @param[in] conn  The bus connection, which must have a cache
+ */
+static void bus_cache_fill_all(bus_conn_t *conn)
+{
+    unsigned int page;
+
+    for(page = 0; page < BUS_NUM_PAGES; ++page)
+    {
+        bus_cache_fill(conn, page);
+    }
+}
+
+/**
+ * Determines if a bus connection decodes a given address, using cached custom decoder results
+ * where available
+ *
+ * @param[in] conn      The bus connection to check
+ * @param[in] addr      The address to check for a match
+ * @param[in] write     Indicates whether the requested operation is a write
+ *
+ * @return true if the connection decodes the address
+ */
+static inline bool bus_conn_match(bus_conn_t *conn, uint16_t addr, bool write)
+{
+    bus_decode_cache_t *cache = conn->cache;
+
+    if(cache == NULL)
+    {
+        return bus_match_addr(&conn->params, addr, write, conn->userdata);
+    }
+
+    if(!(cache->valid[addr >> 11] & (1 << ((addr >> 8) & 7))))
+    {
+        bus_cache_fill(conn, addr >> 8);
+    }
+
+    return ((write ? cache->write : cache->read)[addr >> 3] & (1 << (addr & 7))) != 0;
+}
+
+/**
+ * Determines if a tracer filter's decode parameters match any address within a page
+ *
+ * @param[in] params    The decode parameters to check. Must be a range or mask.
+ * @param[in] page      The page to check
+ *
+ * @return true if any address in the page matches
+ */
+static bool bus_filter_page(const bus_decode_params_t *params, unsigned int page)
+{
+    uint16_t addr;
+
+    if(params->type == BUSDECODE_RANGE)
+    {
+        return (page >= (unsigned int)(params->value.range.addr_start >> 8)) &&
+               (page <= (unsigned int)(params->value.range.addr_end >> 8));
+    }
+
+    /* The low byte is free to be whatever the mask requires. */
+    addr = (uint16_t)((page << 8) | (params->value.mask.addr_value & 0x00FF));
+
+    return (addr & params->value.mask.addr_mask) == params->value.mask.addr_value;
+}
+
+/**
+ * Adds or removes a tracer from the decode table entries of the pages its filter includes
+ *
+ * @param[in] bus       The bus instance
+ * @param[in] tracer    The tracer to add or remove
+ * @param[in] add       Indicates whether the tracer is being added or removed
+ */
+static void bus_tracer_pages(bus_t *bus, const bus_tracer_t *tracer, bool add)
+{
+    unsigned int page;
+
+    for(page = 0; page < BUS_NUM_PAGES; ++page)
+    {
+        if(bus_filter_page(&tracer->filter.decode, page))
+        {
+            if(add)
+                ++bus->pages[page].tracers;
+            else
+                --bus->pages[page].tracers;
+        }
+    }
+}
+
+/**
+ * Calls the tracers whose filters match a committed bus transaction
+ *
+ * @param[in] bus   The bus instance
+ * @param[in] addr  Address of the operation
+ * @param[in] value Value that was read or written
+ * @param[in] write Indicates whether the operation is a read or write
+ * @param[in] flags Flags for the operation
+ */
+static void bus_trace(bus_t *bus, uint16_t addr, uint8_t value, bool write, bus_flags_t flags)
+{
+    listnode_t *cur;
+    bus_tracer_t *tracer;
+    uint8_t op;
+
+    if(bus->pages[addr >> 8].tracers == 0)
+    {
+        return;
+    }
+
+    if(write)
+        op = BUS_TRACE_WRITE;
+    else if(flags & SYNC)
+        op = BUS_TRACE_SYNC;
+    else
+        op = BUS_TRACE_READ;
+
+    list_iterate(&bus->tracelist, cur)
+    {
+        tracer = list_container(cur, bus_tracer_t, list);
+
+        if(!(tracer->filter.ops & op) || !bus_match_addr(&tracer->filter.decode, addr, write, NULL))
+        {
+            continue;
+        }
+
+        if(tracer->filter.divisor > 1 && ++tracer->count < tracer->filter.divisor)
+        {
+            continue;
+        }
+
+        tracer->count = 0;
+        tracer->callback(addr, value, write, flags, tracer->userdata);
+    }
+}
+
+/**
+ * Counts a committed bus transaction
+ *
+ * @param[in] counters  The counters to update
+ * @param[in] write     Indicates whether the operation is a read or write operation
+ * @param[in] flags     Flags for the operation
+ */
+static inline void bus_count(bus_counters_t *counters, bool write, bus_flags_t flags)
+{
+    if(write)
+        ++counters->writes;
+    else if(flags & SYNC)
+        ++counters->fetches;
+    else
+        ++counters->reads;
+}
+
+/**
+ * Recomputes the addresses that more than one connection may decode. Reads and writes of other
+ * addresses stop at the first connection that decodes them. Uncached and dynamic custom decoders
+ * can't be analysed, so every address in a page they share with another connection is included.
+ *
+ * @param[in] bus   The bus instance
+ * @param[in] added A newly registered connection to report overlaps for, or NULL
+ */
+static void bus_update_shared(bus_t *bus, bus_conn_t *added)
+{
+    listnode_t *cur;
+    bus_conn_t *conn;
+    unsigned int page;
+    unsigned int touching;
+    unsigned int matches;
+    uint32_t addr;
+    uint32_t overlaps = 0;
+    uint32_t first_overlap = 0;
+    bool custom;
+
+    memset(bus->shared, 0, sizeof(bus->shared));
+
+    for(page = 0; page < BUS_NUM_PAGES; ++page)
+    {
+        touching = 0;
+        custom = false;
+
+        list_iterate(&bus->connlist, cur)
+        {
+            conn = list_container(cur, bus_conn_t, list);
+
+            if(bus_conn_cover(conn, (uint16_t)(page << 8)) != BUS_COVER_NONE)
+            {
+                ++touching;
+                custom = custom || (conn->params.type == BUSDECODE_CUSTOM) || (conn->params.type == BUSDECODE_CUSTOM_DYNAMIC);
+            }
+        }
+
+        if(touching < 2)
+        {
+            continue;
+        }
+
+        if(custom)
+        {
+            memset(&bus->shared[page * 32], 0xFF, 32);
+            continue;
+        }
+
+        /* Only pages touched by several connections need checking address by address. */
+        for(addr = page << 8; addr < ((page + 1) << 8); ++addr)
+        {
+            matches = 0;
+
+            list_iterate(&bus->connlist, cur)
+            {
+                conn = list_container(cur, bus_conn_t, list);
+
+                if(bus_conn_match(conn, (uint16_t)addr, false) || bus_conn_match(conn, (uint16_t)addr, true))
+                    ++matches;
+            }
+
+            if(matches > 1)
+            {
+                bus->shared[addr >> 3] |= (uint8_t)(1 << (addr & 7));
+
+                if(added != NULL && (bus_conn_match(added, (uint16_t)addr, false) || bus_conn_match(added, (uint16_t)addr, true)))
+                {
+                    if(overlaps == 0)
+                        first_overlap = addr;
+
+                    ++overlaps;
+                }
+            }
+        }
+    }
+
+    if(overlaps > 0)
+    {
+        log_print(lWARNING, "Bus connection overlaps another at %u addresses, starting at 0x%04x. Reads of them are checked for multiple drivers.", overlaps, first_overlap);
+    }
+}
+
 /**
  * Internal helper for handling both read and peek operations
  *
  * @param[in] bus   The bus instance
  * @param[in] addr  Address to read or peek
  * @param[in] peek  Indicates whether this is read or peek
- * @param[in] sync  Indicates whether this is a sync (opcode) read
+ * @param[in] flags Flags for the read operation (SYNC or DUMMY)
  *
  * @return The result of the read or peek operation
  */
-static uint8_t bus_read_peek_i(bus_t *bus, uint16_t addr, bool peek, bool sync)
+static uint8_t bus_read_peek_i(bus_t *bus, uint16_t addr, bool peek, bus_flags_t flags)
 {
     uint8_t ret;
     uint8_t conn_read_val;
     bool matched = false;
+    bool counting;
+    bool shared;
     listnode_t *cur;
     bus_conn_t *conn;
-    bus_tracer_t *tracer;
     bus_read_cb_t cb;
 
+    if(!peek && (bus->pages[addr >> 8].flags & BUS_PAGE_MONITOR))
+    {
+        bus->monitor(addr, 0, false, flags, bus->monitor_data);
+    }
+
+    counting = !peek && bus->counting;
+    shared = (bus->shared[addr >> 3] & (1 << (addr & 7))) != 0;
+
+    if(counting)
+    {
+        bus_count(&bus->counters[addr >> 8], false, flags);
+    }
+
     list_iterate(&bus->connlist, cur)
     {
         conn = list_container(cur, bus_conn_t, list);
 
-        if(bus_match_addr(&conn->params, addr, true, conn->userdata))
+        if(bus_conn_match(conn, addr, false))
         {
+            if(counting)
+            {
+                bus_count(&conn->counters, false, flags);
+            }
+
             cb = peek ? conn->handlers.peek : conn->handlers.read;
 
             if(cb)
             {
-                conn_read_val = cb(addr, sync ? SYNC : 0, conn->userdata);
+                conn_read_val = cb(addr, flags, conn->userdata);
 
                 if((matched) && (conn_read_val != ret))
                 {
@@ -132,6 +456,10 @@ static uint8_t bus_read_peek_i(bus_t *bus, uint16_t addr, bool peek, bool sync)
                     ret = conn_read_val;
                 }
             }
+
+            /* No other connection decodes the address. */
+            if(!shared)
+                break;
         }
     }
 
@@ -143,22 +471,45 @@ static uint8_t bus_read_peek_i(bus_t *bus, uint16_t addr, bool peek, bool sync)
     /* only trace on actual bus transactions */
     if(!peek)
     {
-        list_iterate(&bus->tracelist, cur)
+        if(bus->pages[addr >> 8].flags & BUS_PAGE_WATCH)
         {
-            tracer = list_container(cur, bus_tracer_t, list);
-
-            tracer->callback(addr, ret, false, sync ? SYNC : 0, tracer->userdata);
+            bus->watch(addr, ret, false, flags, bus->watch_data);
         }
 
+        bus_trace(bus, addr, ret, false, flags);
+
         /* Only log the last operation if it is committed. */
         bus->lastop.write = false;
         bus->lastop.addr = addr;
-        bus->lastop.flags = sync ? SYNC : 0;
+        bus->lastop.flags = flags;
     }
 
     return ret;
 }
 
+/**
+ * Tells the signal watchers about a signal, if its state has changed.
+ *
+ * @param[in] bus       Bus instance
+ * @param[in] signal    The signal
+ * @param[in] was       Whether the signal was asserted before
+ * @param[in] asserted  Whether the signal is asserted now
+ */
+static void bus_sig_changed(bus_t *bus, bus_signal_t signal, bool was, bool asserted)
+{
+    bus_sig_watcher_t *watcher;
+    listnode_t *cur;
+
+    if(was != asserted)
+    {
+        list_iterate(&bus->siglist, cur)
+        {
+            watcher = list_container(cur, bus_sig_watcher_t, list);
+            watcher->callback(signal, asserted, watcher->userdata);
+        }
+    }
+}
+
 /**
  * Internal function to initialize a bus instance
  *
@@ -172,11 +523,115 @@ bool bus_init(cbemu_t emu)
 
     list_init(&bus->connlist);
     list_init(&bus->tracelist);
+    list_init(&bus->siglist);
+    memset(bus->pages, 0, sizeof(bus->pages));
+    memset(bus->shared, 0, sizeof(bus->shared));
+    bus->monitor = NULL;
+    bus->monitor_data = NULL;
+    bus->watch = NULL;
+    bus->watch_data = NULL;
+    bus->counting = false;
+    memset(bus->counters, 0, sizeof(bus->counters));
     bus->init = true;
 
     return true;
 }
 
+/**
+ * Snapshot hook saving the signal votes and last operation of the bus.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] userdata  Emulator context
+ *
+ * @return true if the state was written
+ */
+bool bus_snapshot_save(snapshot_t snap, void *userdata)
+{
+    bus_t *bus = &((cbemu_t)userdata)->bus;
+    uint32_t sigflags = (uint32_t)bus->sigvotes.flags;
+    uint8_t write = bus->lastop.write ? 1 : 0;
+    uint32_t opflags = (uint32_t)bus->lastop.flags;
+
+    return snapshot_write(snap, &bus->sigvotes.allocated, sizeof(bus->sigvotes.allocated)) &&
+           snapshot_write(snap, &bus->sigvotes.irq, sizeof(bus->sigvotes.irq)) &&
+           snapshot_write(snap, &bus->sigvotes.nmi, sizeof(bus->sigvotes.nmi)) &&
+           snapshot_write(snap, &bus->sigvotes.rdy, sizeof(bus->sigvotes.rdy)) &&
+           snapshot_write(snap, &bus->sigvotes.be, sizeof(bus->sigvotes.be)) &&
+           snapshot_write(snap, &sigflags, sizeof(sigflags)) &&
+           snapshot_write(snap, &bus->lastop.addr, sizeof(bus->lastop.addr)) &&
+           snapshot_write(snap, &bus->lastop.val, sizeof(bus->lastop.val)) &&
+           snapshot_write(snap, &write, sizeof(write)) &&
+           snapshot_write(snap, &opflags, sizeof(opflags));
+}
+
+/**
+ * Snapshot hook restoring the signal votes and last operation of the bus. Signal watchers are told
+ * about each signal the restore asserts or deasserts. The cached results of dynamic decoders are
+ * discarded, as the devices they depend on are restored too.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[in] userdata  Emulator context
+ *
+ * @return true if the state was read and matches the registered voters
+ */
+bool bus_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    bus_t *bus = &((cbemu_t)userdata)->bus;
+    bus_sigvotes_t sigvotes;
+    bus_sigvotes_t old;
+    bus_op_t lastop;
+    uint32_t sigflags;
+    uint8_t write;
+    uint32_t opflags;
+    listnode_t *node;
+    bus_conn_t *conn;
+
+    if(!snapshot_read(snap, &sigvotes.allocated, sizeof(sigvotes.allocated)) ||
+       !snapshot_read(snap, &sigvotes.irq, sizeof(sigvotes.irq)) ||
+       !snapshot_read(snap, &sigvotes.nmi, sizeof(sigvotes.nmi)) ||
+       !snapshot_read(snap, &sigvotes.rdy, sizeof(sigvotes.rdy)) ||
+       !snapshot_read(snap, &sigvotes.be, sizeof(sigvotes.be)) ||
+       !snapshot_read(snap, &sigflags, sizeof(sigflags)) ||
+       !snapshot_read(snap, &lastop.addr, sizeof(lastop.addr)) ||
+       !snapshot_read(snap, &lastop.val, sizeof(lastop.val)) ||
+       !snapshot_read(snap, &write, sizeof(write)) ||
+       !snapshot_read(snap, &opflags, sizeof(opflags)))
+    {
+        return false;
+    }
+
+    /* Votes are per voter, so only carry over between the same set of voters. */
+    if(sigvotes.allocated != bus->sigvotes.allocated)
+    {
+        return false;
+    }
+
+    sigvotes.flags = (bus_sv_flags_t)sigflags;
+    lastop.write = (write != 0);
+    lastop.flags = (bus_flags_t)opflags;
+
+    old = bus->sigvotes;
+    bus->sigvotes = sigvotes;
+    bus->lastop = lastop;
+
+    bus_sig_changed(bus, BUS_SIG_IRQ, old.irq != 0, sigvotes.irq != 0);
+    bus_sig_changed(bus, BUS_SIG_NMI, old.nmi != 0, sigvotes.nmi != 0);
+    bus_sig_changed(bus, BUS_SIG_RDY, old.rdy != 0, sigvotes.rdy != 0);
+    bus_sig_changed(bus, BUS_SIG_BE, old.be != 0, sigvotes.be != 0);
+
+    list_iterate(&bus->connlist, node)
+    {
+        conn = list_container(node, bus_conn_t, list);
+
+        if(conn->params.type == BUSDECODE_CUSTOM_DYNAMIC)
+        {
+            memset(conn->cache->valid, 0, sizeof(conn->cache->valid));
+        }
+    }
+
+    return true;
+}
+
 /**
  * Internal function to clean up a bus instance
  *
@@ -187,6 +642,7 @@ void bus_cleanup(cbemu_t emu)
     bus_t *bus = &emu->bus;
     bus_conn_t *conn;
     bus_tracer_t *tracer;
+    bus_sig_watcher_t *watcher;
     listnode_t *tail;
 
     if(!bus->init)
@@ -202,6 +658,7 @@ void bus_cleanup(cbemu_t emu)
 
         conn = list_container(tail, bus_conn_t, list);
 
+        free(conn->cache);
         free(conn);
     }
 
@@ -215,6 +672,17 @@ void bus_cleanup(cbemu_t emu)
 
         free(tracer);
     }
+
+    while(!list_empty(&bus->siglist))
+    {
+        tail = list_tail(&bus->siglist);
+
+        list_remove(tail);
+
+        watcher = list_container(tail, bus_sig_watcher_t, list);
+
+        free(watcher);
+    }
 }
 
 /**
@@ -231,7 +699,7 @@ uint8_t bus_read(cbemu_t emu, uint16_t addr)
 {
     bus_t *bus = &emu->bus;
 
-    return bus_read_peek_i(bus, addr, false, false);
+    return bus_read_peek_i(bus, addr, false, 0);
 }
 
 /**
@@ -250,7 +718,22 @@ uint8_t bus_sync_read(cbemu_t emu, uint16_t addr)
 {
     bus_t *bus = &emu->bus;
 
-    return bus_read_peek_i(bus, addr, false, true);
+    return bus_read_peek_i(bus, addr, false, SYNC);
+}
+
+/**
+ * Internal bus access function to perform a bus read operation whose value is discarded by the
+ * CPU, such as the extra reads made during indexing or stack operations. This is a committed
+ * read operation, but is flagged as DUMMY so monitors can ignore it.
+ *
+ * @param[in] emu   Emulator context
+ * @param[in] addr  Address to read on the bus
+ */
+void bus_dummy_read(cbemu_t emu, uint16_t addr)
+{
+    bus_t *bus = &emu->bus;
+
+    (void)bus_read_peek_i(bus, addr, false, DUMMY);
 }
 
 /**
@@ -268,53 +751,276 @@ uint8_t bus_peek(cbemu_t emu, uint16_t addr)
 {
     bus_t *bus = &emu->bus;
 
-    return bus_read_peek_i(bus, addr, true, false);
+    return bus_read_peek_i(bus, addr, true, 0);
 }
 
 /**
- * Internal bus access function to perfrom a write operation. This will attempt
- * to decode the address and write the given value to the appropriate bus connection.
+ * Determines how a bus connection's decoder covers a page.
  *
- * @param[in] emu   Emulator context
- * @param[in] addr  Address to write on the bus
- * @param[in] value Value to write to the given address
+ * @param[in] params    The bus connection parameters to check
+ * @param[in] base      Page aligned address of the page
+ *
+ * @return BUS_COVER_NONE if no address in the page is decoded, BUS_COVER_FULL if every address is
+ *         decoded, or BUS_COVER_PARTIAL otherwise, including for custom decoders.
  */
-void bus_write(cbemu_t emu, uint16_t addr, uint8_t value)
+static bus_cover_t bus_page_cover(const bus_decode_params_t *params, uint16_t base)
 {
-    bus_t *bus = &emu->bus;
-    listnode_t *cur;
-    bus_conn_t *conn;
-    bus_tracer_t *tracer;
-    bus_read_cb_t cb;
+    uint16_t end = base | 0x00FF;
 
-    list_iterate(&bus->connlist, cur)
+    switch(params->type)
     {
-        conn = list_container(cur, bus_conn_t, list);
+        case BUSDECODE_RANGE:
+            if(params->value.range.addr_end < base || params->value.range.addr_start > end)
+                return BUS_COVER_NONE;
 
-        if(bus_match_addr(&conn->params, addr, false, conn->userdata))
-        {
-            if(conn->handlers.write)
-            {
-                conn->handlers.write(addr, value, 0, conn->userdata);
-            }
-        }
-    }
+            if(params->value.range.addr_start <= base && params->value.range.addr_end >= end)
+                return BUS_COVER_FULL;
 
-    list_iterate(&bus->tracelist, cur)
-    {
-        tracer = list_container(cur, bus_tracer_t, list);
+            return BUS_COVER_PARTIAL;
 
-        tracer->callback(addr, value, true, 0, tracer->userdata);
-    }
+        case BUSDECODE_MASK:
+            if(((base ^ params->value.mask.addr_value) & params->value.mask.addr_mask & 0xFF00) != 0)
+                return BUS_COVER_NONE;
 
-    emu->bus.lastop.write = true;
-    emu->bus.lastop.addr = addr;
-    emu->bus.lastop.val = value;
-    emu->bus.lastop.flags = 0;
+            if((params->value.mask.addr_mask & 0x00FF) == 0)
+                return BUS_COVER_FULL;
+
+            return BUS_COVER_PARTIAL;
+
+        default:
+            return BUS_COVER_PARTIAL;
+    }
 }
 
 /**
- * Replays the last bus operation. If it was a read, the result is discarded.
+ * Determines how a bus connection covers a page, using the cached results of static custom
+ * decoders.
+ *
+ * @param[in] conn      The bus connection to check
+ * @param[in] base      Page aligned address of the page
+ *
+ * @return How the connection covers the page, for reads or writes.
+ */
+static bus_cover_t bus_conn_cover(bus_conn_t *conn, uint16_t base)
+{
+    unsigned int index;
+    unsigned int offset = (base >> 8) * 32;
+    bool any = false;
+    bool all = true;
+
+    if(conn->params.type != BUSDECODE_CUSTOM_STATIC)
+    {
+        return bus_page_cover(&conn->params, base);
+    }
+
+    for(index = offset; index < offset + 32; ++index)
+    {
+        any = any || ((conn->cache->read[index] | conn->cache->write[index]) != 0);
+        all = all && ((conn->cache->read[index] & conn->cache->write[index]) == 0xFF);
+    }
+
+    if(!any)
+        return BUS_COVER_NONE;
+
+    return all ? BUS_COVER_FULL : BUS_COVER_PARTIAL;
+}
+
+/**
+ * Gets direct access to a page, if it is decoded entirely by a single connection that provides
+ * it.
+ *
+ * @param[in] bus   The bus instance
+ * @param[in] base  Page aligned address of the page
+ * @param[in] write Indicates the page will be written through the pointer
+ *
+ * @return Pointer to the 256 bytes backing the page, or NULL if it can't be accessed directly.
+ */
+static uint8_t *bus_page_direct(bus_t *bus, uint16_t base, bool write)
+{
+    listnode_t *cur;
+    bus_conn_t *conn;
+    bus_conn_t *found = NULL;
+
+    list_iterate(&bus->connlist, cur)
+    {
+        conn = list_container(cur, bus_conn_t, list);
+
+        switch(bus_conn_cover(conn, base))
+        {
+            case BUS_COVER_NONE:
+                break;
+
+            case BUS_COVER_FULL:
+                if(found != NULL)
+                    return NULL;
+
+                found = conn;
+                break;
+
+            default:
+                return NULL;
+        }
+    }
+
+    if(found == NULL || found->handlers.direct == NULL)
+    {
+        return NULL;
+    }
+
+    return found->handlers.direct(base, write, found->userdata);
+}
+
+/**
+ * Internal bus access function to peek a range of addresses. The decode is resolved once per
+ * page, and pages decoded entirely by a connection with direct access are copied from its
+ * buffer. Other pages are peeked a byte at a time.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] addr      First address to peek
+ * @param[in] len       Number of bytes to peek. The range must not extend past 0xFFFF.
+ * @param[out] buffer   Buffer to populate with the peeked values
+ */
+void bus_peek_range(cbemu_t emu, uint16_t addr, uint32_t len, uint8_t *buffer)
+{
+    bus_t *bus = &emu->bus;
+    uint32_t cur = addr;
+    uint32_t end = (uint32_t)addr + len;
+    uint32_t chunk;
+    uint32_t index;
+    uint8_t *direct;
+
+    while(cur < end)
+    {
+        chunk = 0x100 - (cur & 0xFF);
+
+        if(chunk > end - cur)
+            chunk = end - cur;
+
+        direct = bus_page_direct(bus, (uint16_t)(cur & 0xFF00), false);
+
+        if(direct != NULL)
+        {
+            memcpy(buffer, &direct[cur & 0xFF], chunk);
+        }
+        else
+        {
+            for(index = 0; index < chunk; ++index)
+            {
+                buffer[index] = bus_read_peek_i(bus, (uint16_t)(cur + index), true, 0);
+            }
+        }
+
+        buffer += chunk;
+        cur += chunk;
+    }
+}
+
+/**
+ * Internal bus access function to poke a range of addresses, changing the contents of memory
+ * without performing bus writes. Only pages decoded entirely by a connection with direct access
+ * can be poked, and the rest of the range is skipped. Pokes bypass any write protection of the
+ * device, such as for ROM.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] addr      First address to poke
+ * @param[in] len       Number of bytes to poke. The range must not extend past 0xFFFF.
+ * @param[in] buffer    Values to poke
+ *
+ * @return The number of bytes poked.
+ */
+uint32_t bus_poke_range(cbemu_t emu, uint16_t addr, uint32_t len, const uint8_t *buffer)
+{
+    bus_t *bus = &emu->bus;
+    uint32_t cur = addr;
+    uint32_t end = (uint32_t)addr + len;
+    uint32_t chunk;
+    uint32_t poked = 0;
+    uint8_t *direct;
+
+    while(cur < end)
+    {
+        chunk = 0x100 - (cur & 0xFF);
+
+        if(chunk > end - cur)
+            chunk = end - cur;
+
+        direct = bus_page_direct(bus, (uint16_t)(cur & 0xFF00), true);
+
+        if(direct != NULL)
+        {
+            memcpy(&direct[cur & 0xFF], buffer, chunk);
+            poked += chunk;
+        }
+
+        buffer += chunk;
+        cur += chunk;
+    }
+
+    return poked;
+}
+
+/**
+ * Internal bus access function to perfrom a write operation. This will attempt
+ * to decode the address and write the given value to the appropriate bus connection.
+ *
+ * @param[in] emu   Emulator context
+ * @param[in] addr  Address to write on the bus
+ * @param[in] value Value to write to the given address
+ */
+void bus_write(cbemu_t emu, uint16_t addr, uint8_t value)
+{
+    bus_t *bus = &emu->bus;
+    listnode_t *cur;
+    bus_conn_t *conn;
+    bus_read_cb_t cb;
+
+    if(bus->pages[addr >> 8].flags & BUS_PAGE_MONITOR)
+    {
+        bus->monitor(addr, value, true, 0, bus->monitor_data);
+    }
+
+    if(bus->counting)
+    {
+        bus_count(&bus->counters[addr >> 8], true, 0);
+    }
+
+    list_iterate(&bus->connlist, cur)
+    {
+        conn = list_container(cur, bus_conn_t, list);
+
+        if(bus_conn_match(conn, addr, true))
+        {
+            if(bus->counting)
+            {
+                bus_count(&conn->counters, true, 0);
+            }
+
+            if(conn->handlers.write)
+            {
+                conn->handlers.write(addr, value, 0, conn->userdata);
+            }
+
+            /* No other connection decodes the address. */
+            if(!(bus->shared[addr >> 3] & (1 << (addr & 7))))
+                break;
+        }
+    }
+
+    if(bus->pages[addr >> 8].flags & BUS_PAGE_WATCH)
+    {
+        bus->watch(addr, value, true, 0, bus->watch_data);
+    }
+
+    bus_trace(bus, addr, value, true, 0);
+
+    emu->bus.lastop.write = true;
+    emu->bus.lastop.addr = addr;
+    emu->bus.lastop.val = value;
+    emu->bus.lastop.flags = 0;
+}
+
+/**
+ * Replays the last bus operation. If it was a read, the result is discarded.
  *
  * @param[in] emu   Emulator context
  */
@@ -326,13 +1032,135 @@ void bus_replay(cbemu_t emu)
     }
     else
     {
-        (void)bus_read_peek_i(&emu->bus, emu->bus.lastop.addr, false, (emu->bus.lastop.flags & SYNC) ? true : false);
+        (void)bus_read_peek_i(&emu->bus, emu->bus.lastop.addr, false, emu->bus.lastop.flags);
+    }
+}
+
+/**
+ * Sets the bus monitor. Only a single monitor may be set at a time.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] monitor   The monitor callback, or NULL to clear it.
+ * @param[in] userdata  Userdata supplied to the callback.
+ *
+ * @return true if the monitor was set, or false if another monitor is already set.
+ */
+bool bus_set_monitor(cbemu_t emu, bus_monitor_cb_t monitor, void *userdata)
+{
+    unsigned int page;
+
+    if(monitor != NULL && emu->bus.monitor != NULL)
+    {
+        return false;
+    }
+
+    if(monitor == NULL)
+    {
+        /* Nothing may be reported once the monitor is gone. */
+        for(page = 0; page < BUS_NUM_PAGES; ++page)
+        {
+            emu->bus.pages[page].flags &= ~BUS_PAGE_MONITOR;
+        }
+    }
+
+    emu->bus.monitor = monitor;
+    emu->bus.monitor_data = userdata;
+
+    return true;
+}
+
+/**
+ * Enables or disables monitoring for a range of pages.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] first     The first page to update.
+ * @param[in] last      The last page to update (inclusive).
+ * @param[in] enable    Indicates whether monitoring should be enabled or disabled.
+ */
+void bus_monitor_pages(cbemu_t emu, uint8_t first, uint8_t last, bool enable)
+{
+    unsigned int page;
+
+    if(enable && emu->bus.monitor == NULL)
+    {
+        return;
+    }
+
+    for(page = first; page <= last; ++page)
+    {
+        if(enable)
+            emu->bus.pages[page].flags |= BUS_PAGE_MONITOR;
+        else
+            emu->bus.pages[page].flags &= ~BUS_PAGE_MONITOR;
+    }
+}
+
+/**
+ * Sets the bus watch. Only a single watch may be set at a time.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] watch     The watch callback, or NULL to clear it.
+ * @param[in] userdata  Userdata supplied to the callback.
+ *
+ * @return true if the watch was set, or false if another watch is already set.
+ */
+bool bus_set_watch(cbemu_t emu, bus_watch_cb_t watch, void *userdata)
+{
+    unsigned int page;
+
+    if(watch != NULL && emu->bus.watch != NULL)
+    {
+        return false;
+    }
+
+    if(watch == NULL)
+    {
+        /* Nothing may be reported once the watch is gone. */
+        for(page = 0; page < BUS_NUM_PAGES; ++page)
+        {
+            emu->bus.pages[page].flags &= ~BUS_PAGE_WATCH;
+        }
+    }
+
+    emu->bus.watch = watch;
+    emu->bus.watch_data = userdata;
+
+    return true;
+}
+
+/**
+ * Enables or disables watching for a range of pages.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] first     The first page to update.
+ * @param[in] last      The last page to update (inclusive).
+ * @param[in] enable    Indicates whether watching should be enabled or disabled.
+ */
+void bus_watch_pages(cbemu_t emu, uint8_t first, uint8_t last, bool enable)
+{
+    unsigned int page;
+
+    if(enable && emu->bus.watch == NULL)
+    {
+        return;
+    }
+
+    for(page = first; page <= last; ++page)
+    {
+        if(enable)
+            emu->bus.pages[page].flags |= BUS_PAGE_WATCH;
+        else
+            emu->bus.pages[page].flags &= ~BUS_PAGE_WATCH;
     }
 }
 
 /**
  * Registers a bus connection with a set of handler callbacks with the specific decoder parameters
  *
+ * Overlaps with the decoders of other connections are found when registering, and reported once.
+ * Only the overlapping addresses, and pages shared with custom decoders, are checked for multiple
+ * connections driving the bus on each read.
+ *
  * @param[in] emu       The emulator core
  * @param[in] params    Address decoding parameters for the bus connection
  * @param[in] handlers  Handler functions called when the bus address matches the decoding
@@ -356,8 +1184,29 @@ bus_cb_handle_t emu_bus_register(cbemu_t emu, const bus_decode_params_t *params,
         conn->params = *params;
         conn->handlers = *handlers;
         conn->userdata = userdata;
+        conn->name = NULL;
+        memset(&conn->counters, 0, sizeof(conn->counters));
+        conn->cache = NULL;
+
+        if(params->type == BUSDECODE_CUSTOM_STATIC || params->type == BUSDECODE_CUSTOM_DYNAMIC)
+        {
+            conn->cache = malloc(sizeof(bus_decode_cache_t));
+
+            if(conn->cache == NULL)
+            {
+                free(conn);
+                return NULL;
+            }
+
+            memset(conn->cache->valid, 0, sizeof(conn->cache->valid));
+
+            /* Static results are baked in up front so overlaps can be analysed exactly. */
+            if(params->type == BUSDECODE_CUSTOM_STATIC)
+                bus_cache_fill_all(conn);
+        }
 
         list_add_tail(&emu->bus.connlist, &conn->list);
+        bus_update_shared(&emu->bus, conn);
     }
 
     return conn;
@@ -377,11 +1226,151 @@ void emu_bus_unregister(cbemu_t emu, bus_cb_handle_t handle)
     {
         /* TODO For safety, should maybe call list_contains. */
         list_remove(&conn->list);
+        bus_update_shared(&emu->bus, NULL);
 
+        free(conn->cache);
         free(conn);
     }
 }
 
+/**
+ * Discards the cached results of a connection's custom decoder. This must be called whenever the
+ * mapping of a BUSDECODE_CUSTOM_DYNAMIC decoder changes, such as on a write to a bank register,
+ * and may be called from within the connection's own bus handlers. The results are evaluated
+ * again a page at a time as pages are accessed. A BUSDECODE_CUSTOM_STATIC decoder is evaluated
+ * again immediately. Other connections are unaffected.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] handle    The registered bus handle
+ */
+void emu_bus_decode_invalidate(cbemu_t emu, bus_cb_handle_t handle)
+{
+    bus_conn_t *conn = (bus_conn_t *)handle;
+
+    if(emu == NULL || conn == NULL || conn->cache == NULL)
+    {
+        return;
+    }
+
+    memset(conn->cache->valid, 0, sizeof(conn->cache->valid));
+
+    if(conn->params.type == BUSDECODE_CUSTOM_STATIC)
+    {
+        bus_cache_fill_all(conn);
+        bus_update_shared(&emu->bus, NULL);
+    }
+}
+
+/**
+ * Names a registered bus connection, for reporting purposes.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] handle    The registered bus handle
+ * @param[in] name      Name of the connection. The string must remain valid while the connection
+ *                      is registered.
+ */
+void emu_bus_set_name(cbemu_t emu, bus_cb_handle_t handle, const char *name)
+{
+    bus_conn_t *conn = (bus_conn_t *)handle;
+
+    if(conn != NULL)
+    {
+        conn->name = name;
+    }
+}
+
+/**
+ * Enables or disables counting of bus accesses per page and per connection. Counting is disabled
+ * by default, and the counts are kept when it is disabled.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] enable    Indicates whether counting should be enabled or disabled.
+ */
+void emu_bus_enable_counters(cbemu_t emu, bool enable)
+{
+    if(emu != NULL)
+    {
+        emu->bus.counting = enable;
+    }
+}
+
+/**
+ * Resets all of the per-page and per-connection access counts to 0.
+ *
+ * @param[in] emu       The emulator core
+ */
+void emu_bus_reset_counters(cbemu_t emu)
+{
+    listnode_t *cur;
+    bus_conn_t *conn;
+
+    if(emu == NULL)
+    {
+        return;
+    }
+
+    memset(emu->bus.counters, 0, sizeof(emu->bus.counters));
+
+    list_iterate(&emu->bus.connlist, cur)
+    {
+        conn = list_container(cur, bus_conn_t, list);
+        memset(&conn->counters, 0, sizeof(conn->counters));
+    }
+}
+
+/**
+ * Takes a snapshot of the per-page access counts.
+ *
+ * @param[in] emu       The emulator core
+ * @param[out] pages    Buffer of BUS_COUNTER_PAGES entries, populated with the counts of each page.
+ */
+void emu_bus_get_page_counters(cbemu_t emu, bus_counters_t *pages)
+{
+    if(emu != NULL && pages != NULL)
+    {
+        memcpy(pages, emu->bus.counters, sizeof(emu->bus.counters));
+    }
+}
+
+/**
+ * Takes a snapshot of the per-connection access counts, in the order the connections were
+ * registered. A read or write decoded by multiple connections is counted by each of them.
+ *
+ * @param[in] emu       The emulator core
+ * @param[out] conns    Buffer to populate with the counts of each connection.
+ * @param[in] max       The number of entries available in the buffer.
+ *
+ * @return The total number of registered connections, which may be more than max.
+ */
+unsigned int emu_bus_get_conn_counters(cbemu_t emu, bus_conn_counters_t *conns, unsigned int max)
+{
+    listnode_t *cur;
+    bus_conn_t *conn;
+    unsigned int count = 0;
+
+    if(emu == NULL)
+    {
+        return 0;
+    }
+
+    list_iterate(&emu->bus.connlist, cur)
+    {
+        conn = list_container(cur, bus_conn_t, list);
+
+        if(conns != NULL && count < max)
+        {
+            conns[count].handle = conn;
+            conns[count].name = conn->name;
+            conns[count].params = conn->params;
+            conns[count].counters = conn->counters;
+        }
+
+        ++count;
+    }
+
+    return count;
+}
+
 /**
  * Adds a bus tracer callback to the bus. This is called on every bus transaction to allow
  * debugging, testing, or monitoring of bus activity.
@@ -393,10 +1382,34 @@ void emu_bus_unregister(cbemu_t emu, bus_cb_handle_t handle)
  * @return A handle for the registered callback or NULL on error
  */
 bus_cb_handle_t emu_bus_add_tracer(cbemu_t emu, const bus_trace_cb_t callback, void *userdata)
+{
+    return emu_bus_add_tracer_filtered(emu, &bus_trace_all, callback, userdata);
+}
+
+/**
+ * Adds a bus tracer callback that is only called for bus transactions matching a filter. Pages
+ * that no tracer is interested in are flagged in the bus decode table, so accesses to them skip
+ * tracer dispatch entirely.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] filter    Filter for the bus transactions to trace
+ * @param[in] callback  Tracer callback to be called for each matching bus transaction
+ * @param[in] userdata  App-specific user data provided to the callback when made
+ *
+ * @return A handle for the registered callback or NULL on error
+ */
+bus_cb_handle_t emu_bus_add_tracer_filtered(cbemu_t emu, const bus_trace_filter_t *filter, const bus_trace_cb_t callback, void *userdata)
 {
     bus_tracer_t *tracer;
 
-    if(emu == NULL || callback == NULL)
+    if(emu == NULL || filter == NULL || callback == NULL)
+    {
+        return NULL;
+    }
+
+    /* Custom decoders can't be resolved to pages of the decode table. */
+    if((filter->decode.type != BUSDECODE_RANGE && filter->decode.type != BUSDECODE_MASK) || !bus_validate_params(&filter->decode) ||
+       (filter->ops & BUS_TRACE_ALL) == 0)
     {
         return NULL;
     }
@@ -407,8 +1420,11 @@ bus_cb_handle_t emu_bus_add_tracer(cbemu_t emu, const bus_trace_cb_t callback, v
     {
         tracer->callback = callback;
         tracer->userdata = userdata;
+        tracer->filter = *filter;
+        tracer->count = 0;
 
         list_add_tail(&emu->bus.tracelist, &tracer->list);
+        bus_tracer_pages(&emu->bus, tracer, true);
     }
 
     return tracer;
@@ -426,6 +1442,7 @@ void emu_bus_remove_tracer(cbemu_t emu, bus_cb_handle_t handle)
 
     if(tracer != NULL)
     {
+        bus_tracer_pages(&emu->bus, tracer, false);
         list_remove(&tracer->list);
 
         free(tracer);
@@ -489,6 +1506,7 @@ void emu_bus_sig_vote(cbemu_t emu, bus_signal_voter_t voter, bus_signal_t signal
 {
     bus_signal_voter_t *mask;
     bus_sigvotes_t *sigvotes;
+    bool asserted;
 
     if((emu == NULL) || ((emu->bus.sigvotes.allocated & voter) == 0))
     {
@@ -523,6 +1541,8 @@ void emu_bus_sig_vote(cbemu_t emu, bus_signal_voter_t voter, bus_signal_t signal
             return;
     }
 
+    asserted = (*mask != 0);
+
     if(voted)
     {
         *mask |= voter;
@@ -531,4 +1551,85 @@ void emu_bus_sig_vote(cbemu_t emu, bus_signal_voter_t voter, bus_signal_t signal
     {
         *mask &= ~voter;
     }
+
+    bus_sig_changed(&emu->bus, signal, asserted, *mask != 0);
+}
+
+/**
+ * Gets whether a signal is currently asserted, i.e. whether any voter has a vote on it.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] signal    The signal to check
+ *
+ * @return true if the signal is asserted.
+ */
+bool emu_bus_sig_asserted(cbemu_t emu, bus_signal_t signal)
+{
+    if(emu == NULL)
+    {
+        return false;
+    }
+
+    switch(signal)
+    {
+        case BUS_SIG_IRQ:
+            return emu->bus.sigvotes.irq != 0;
+        case BUS_SIG_NMI:
+            return emu->bus.sigvotes.nmi != 0;
+        case BUS_SIG_RDY:
+            return emu->bus.sigvotes.rdy != 0;
+        case BUS_SIG_BE:
+            return emu->bus.sigvotes.be != 0;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Adds a signal watcher callback, called whenever a signal becomes asserted or deasserted.
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] callback  Callback to be called for each signal change
+ * @param[in] userdata  App-specific user data provided to the callback when made
+ *
+ * @return A handle for the registered callback or NULL on error
+ */
+bus_cb_handle_t emu_bus_add_sig_watcher(cbemu_t emu, bus_signal_cb_t callback, void *userdata)
+{
+    bus_sig_watcher_t *watcher;
+
+    if(emu == NULL || callback == NULL)
+    {
+        return NULL;
+    }
+
+    watcher = malloc(sizeof(bus_sig_watcher_t));
+
+    if(watcher != NULL)
+    {
+        watcher->callback = callback;
+        watcher->userdata = userdata;
+
+        list_add_tail(&emu->bus.siglist, &watcher->list);
+    }
+
+    return watcher;
+}
+
+/**
+ * Removes a previously registered signal watcher callback
+ *
+ * @param[in] emu       The emulator core
+ * @param[in] handle    Handle of the previously registered callback
+ */
+void emu_bus_remove_sig_watcher(cbemu_t emu, bus_cb_handle_t handle)
+{
+    bus_sig_watcher_t *watcher = (bus_sig_watcher_t *)handle;
+
+    if(watcher != NULL)
+    {
+        list_remove(&watcher->list);
+
+        free(watcher);
+    }
 }
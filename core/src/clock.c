@@ -10,7 +10,30 @@
 #define HZ_NS_CONVERT 1000000000UL
 
 /**
- * Allocates and initializes a clock structure
+ * Computes the greatest common divisor of two integers
+ *
+ * @param[in] a     First integer
+ * @param[in] b     Second integer
+ *
+ * @return The greatest common divisor
+ */
+static uint64_t clock_gcd(uint64_t a, uint64_t b)
+{
+    uint64_t rem;
+
+    while(b != 0)
+    {
+        rem = a % b;
+        a = b;
+        b = rem;
+    }
+
+    return a;
+}
+
+/**
+ * Allocates and initializes a clock structure. Its phase length is set once it is added to a
+ * timebase.
  *
  * @param[in] config    The clock's configuration parameters
  *
@@ -19,6 +42,7 @@
 static clk_t clock_alloc_clk(const clock_config_t *config)
 {
     clk_t clk;
+    uint64_t gcd;
 
     /* Checking entry in the union for 0 checks both. */
     if((config == NULL) || (config->timing.freq == 0) || ((config->timing_type == CLOCK_FREQ) && (config->timing.freq > CLOCK_MAX_FREQUENCY)))
@@ -37,6 +61,11 @@ static clk_t clock_alloc_clk(const clock_config_t *config)
 
             /* Calculate frequency rounded to the nearest hz. */
             clk->freq = (HZ_NS_CONVERT + (clk->period >> 1)) / clk->period;
+
+            /* The exact frequency is 1e9 / period, in lowest terms. */
+            gcd = clock_gcd(HZ_NS_CONVERT, clk->period);
+            clk->freq_num = HZ_NS_CONVERT / gcd;
+            clk->freq_den = clk->period / gcd;
         }
         else
         {
@@ -44,16 +73,86 @@ static clk_t clock_alloc_clk(const clock_config_t *config)
 
             /* Calculate period rounded to the nearest ns. */
             clk->period = (HZ_NS_CONVERT + (clk->freq >> 1)) / clk->freq;
+
+            clk->freq_num = clk->freq;
+            clk->freq_den = 1;
         }
 
-        /* Start ticks out for the inactive phase, always rounding down. */
-        clk->ticks = clk->period / 2;
+        clk->deadline = CLOCK_SYNC_NONE;
         list_init(&clk->callbacks);
+        list_init(&clk->suspended);
+        list_init(&clk->syncs);
     }
 
     return clk;
 }
 
+/**
+ * Computes the length of the phases of a clock in a given timebase
+ *
+ * @param[in] clk       The clock
+ * @param[in] timebase  The timebase, which must be a multiple of the clock's frequency numerator
+ *
+ * @return The phase length in timebase units, or 0 if it is too long to be represented
+ */
+static uint64_t clock_phase_len(clk_t clk, uint64_t timebase)
+{
+    uint64_t scale = timebase / clk->freq_num;
+
+    if(scale > UINT64_MAX / clk->freq_den)
+    {
+        return 0;
+    }
+
+    return scale * clk->freq_den;
+}
+
+/**
+ * Changes the timebase to a multiple of the current one, rescaling the phases and remaining ticks
+ * of every clock.
+ *
+ * @param[in] cxt       The clock module context
+ * @param[in] timebase  The new timebase
+ *
+ * @return true if every clock could be represented in the new timebase
+ */
+static bool clock_set_timebase(clk_cxt_t *cxt, uint64_t timebase)
+{
+    uint64_t scale = timebase / cxt->timebase;
+    listnode_t *node;
+    clk_t clk;
+
+    if(clock_phase_len(cxt->mainClk, timebase) == 0)
+    {
+        return false;
+    }
+
+    list_iterate(&cxt->clks, node)
+    {
+        clk = list_container(node, struct clk_s, node);
+
+        if(clock_phase_len(clk, timebase) == 0)
+        {
+            return false;
+        }
+    }
+
+    /* Remaining ticks never exceed a phase, so they can't overflow either. */
+    cxt->mainClk->phase = clock_phase_len(cxt->mainClk, timebase);
+    cxt->mainClk->ticks *= scale;
+
+    list_iterate(&cxt->clks, node)
+    {
+        clk = list_container(node, struct clk_s, node);
+        clk->phase = clock_phase_len(clk, timebase);
+        clk->ticks *= scale;
+    }
+
+    cxt->timebase = timebase;
+
+    return true;
+}
+
 /**
  * Frees an allocated clock structure and its resources
  *
@@ -63,6 +162,8 @@ static void clock_free_clk(clk_t clk)
 {
     /* Free the list of callbacks. This can be done with the generic list free function. */
     list_free_offset(&clk->callbacks, clk_cb_entry_t, node);
+    list_free_offset(&clk->suspended, clk_cb_entry_t, node);
+    list_free_offset(&clk->syncs, clk_sync_entry_t, node);
 
     /* Free the entry itself */
     free(clk);
@@ -84,6 +185,110 @@ static void clock_list_free_cb(listnode_t *node, void *param)
     clock_free_clk(clk);
 }
 
+/**
+ * Recomputes the earliest deadline of the sync handlers of a clock
+ *
+ * @param[in] clk   Clock to update
+ */
+static void clock_update_deadline(clk_t clk)
+{
+    listnode_t *node;
+    clk_sync_entry_t *entry;
+
+    clk->deadline = CLOCK_SYNC_NONE;
+
+    list_iterate(&clk->syncs, node)
+    {
+        entry = list_container(node, clk_sync_entry_t, node);
+
+        if(entry->deadline < clk->deadline)
+        {
+            clk->deadline = entry->deadline;
+        }
+    }
+}
+
+/**
+ * Inserts a clock into the list of derived clocks, keeping it sorted by remaining ticks.
+ *
+ * @param[in] cxt   Clock module context
+ * @param[in] clk   Clock to insert
+ */
+static void clock_insert_sorted(clk_cxt_t *cxt, clk_t clk)
+{
+    listnode_t *node;
+    clk_t listptr;
+
+    list_iterate(&cxt->clks, node)
+    {
+        listptr = list_container(node, struct clk_s, node);
+
+        if(listptr->ticks >= clk->ticks)
+        {
+            list_insert_before(node, &clk->node);
+            return;
+        }
+    }
+
+    list_add_tail(&cxt->clks, &clk->node);
+}
+
+/**
+ * Finds a clock by its snapshot id
+ *
+ * @param[in] cxt   Clock module context
+ * @param[in] id    Id of the clock
+ *
+ * @return The clock, or NULL if there is no clock with the id
+ */
+static clk_t clock_find_id(clk_cxt_t *cxt, uint32_t id)
+{
+    listnode_t *node;
+    clk_t clk;
+
+    if(id == cxt->mainClk->id)
+    {
+        return cxt->mainClk;
+    }
+
+    list_iterate(&cxt->clks, node)
+    {
+        clk = list_container(node, struct clk_s, node);
+
+        if(clk->id == id)
+        {
+            return clk;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Synchronizes every device of a clock whose deadline has been reached
+ *
+ * @param[in] clk   Clock whose deadline has been reached
+ */
+static void clock_run_deadlines(clk_t clk)
+{
+    listnode_t *node;
+    clk_sync_entry_t *entry;
+
+    list_iterate(&clk->syncs, node)
+    {
+        entry = list_container(node, clk_sync_entry_t, node);
+
+        if(entry->deadline <= clk->cycles)
+        {
+            /* The handler normally schedules its next deadline while catching up. */
+            entry->deadline = CLOCK_SYNC_NONE;
+            clock_sync(entry);
+        }
+    }
+
+    clock_update_deadline(clk);
+}
+
 /**
  * Helper function for walking the list of tick callbacks for a given clock
  * and calling each of them.
@@ -99,14 +304,32 @@ static void clock_make_callbacks(clk_t clk, bool active_edge)
 
     edge = active_edge ? CLOCK_NEGEDGE : CLOCK_POSEDGE;
 
-    list_iterate(&clk->callbacks, node)
+    /* Callbacks may suspend, resume or unregister handlers, which keep the next one up to date. */
+    node = list_head(&clk->callbacks);
+
+    while(node != &clk->callbacks)
     {
         entry = list_container(node, clk_cb_entry_t, node);
+        clk->next_cb = node->next;
 
         if(entry->edges & edge)
         {
             entry->callback(clk, edge, entry->userdata);
         }
+
+        node = clk->next_cb;
+    }
+
+    clk->next_cb = NULL;
+
+    if(active_edge)
+    {
+        clk->cycles++;
+
+        if(clk->cycles >= clk->deadline)
+        {
+            clock_run_deadlines(clk);
+        }
     }
 }
 
@@ -131,6 +354,9 @@ bool clock_init(cbemu_t emu, const clock_config_t *config, clock_tick_cb_t main_
     if(emu->clk.mainClk != NULL)
     {
         emu->clk.main_hlr = main_clk_hlr;
+        emu->clk.timebase = emu->clk.mainClk->freq_num;
+        emu->clk.mainClk->phase = emu->clk.mainClk->freq_den;
+        emu->clk.mainClk->ticks = emu->clk.mainClk->phase;
     }
 
     emu->clk.init = (emu->clk.mainClk != NULL);
@@ -174,8 +400,8 @@ clk_t clock_get_core_clk(cbemu_t emu)
 static void clock_main_half_tick(cbemu_t emu)
 {
     clk_t headClk;
-    clk_period_t remainingTicks;
-    clk_period_t ticksToConsume;
+    uint64_t remainingTicks;
+    uint64_t ticksToConsume;
     bool rerunLoop = false;
     bool mainTicked = false;
     listnode_t *iter;
@@ -188,14 +414,7 @@ static void clock_main_half_tick(cbemu_t emu)
 
     cxt = &emu->clk;
 
-    if(cxt->mainClk->cur_phase)
-    {
-        remainingTicks = cxt->mainClk->period/2;
-    }
-    else
-    {
-        remainingTicks = cxt->mainClk->period - (cxt->mainClk->period / 2);
-    }
+    remainingTicks = cxt->mainClk->phase;
 
     if(list_empty(&cxt->clks))
     {
@@ -225,17 +444,7 @@ static void clock_main_half_tick(cbemu_t emu)
                  * later as we consume the time for each clock. */
                 ticksToConsume = headClk->ticks;
                 list_remove(&headClk->node);
-
-                if(headClk->cur_phase)
-                {
-                    /* Always round down for inactive phase. */
-                    headClk->ticks = headClk->period / 2;
-                }
-                else
-                {
-                    /* Always round up/complete the cycle in active phase. */
-                    headClk->ticks = headClk->period - (headClk->period / 2);
-                }
+                headClk->ticks = headClk->phase;
 
                 clock_make_callbacks(headClk, headClk->cur_phase);
                 headClk->cur_phase = !headClk->cur_phase;
@@ -328,28 +537,43 @@ clk_t clock_add(cbemu_t emu, const clock_config_t *config)
     clk_t clk;
     clk_t listptr;
     listnode_t *node;
-    bool added = false;
+    bool valid;
+    uint64_t gcd;
+    uint64_t timebase;
 
     clk = clock_alloc_clk(config);
 
     if(clk != NULL)
     {
-        list_iterate(&emu->clk.clks, node)
+        /* Extend the timebase so it divides the new clock's phases exactly too. */
+        gcd = clock_gcd(emu->clk.timebase, clk->freq_num);
+        valid = (emu->clk.timebase / gcd <= UINT64_MAX / clk->freq_num);
+
+        /* Check the new clock fits before committing the timebase, which rescales the others. */
+        if(valid)
         {
-            listptr = list_container(node, struct clk_s, node);
+            timebase = (emu->clk.timebase / gcd) * clk->freq_num;
+            clk->phase = clock_phase_len(clk, timebase);
+            valid = (clk->phase != 0);
+        }
 
-            if(listptr->ticks >= clk->ticks)
-            {
-                list_insert_before(node, &clk->node);
-                added = true;
-                break;
-            }
+        if(valid)
+        {
+            valid = clock_set_timebase(&emu->clk, timebase);
         }
 
-        if(!added)
+        if(!valid)
         {
-            list_add_tail(&emu->clk.clks, &clk->node);
+            log_print(lWARNING, "Clock of %u Hz can't be scheduled exactly with the existing clocks\n", clk->freq);
+            clock_free_clk(clk);
+            return NULL;
         }
+
+        /* Start out in the inactive phase. */
+        clk->ticks = clk->phase;
+        clk->id = ++emu->clk.last_id;
+
+        clock_insert_sorted(&emu->clk, clk);
     }
 
     list_iterate(&emu->clk.clks, node)
@@ -403,6 +627,8 @@ clock_cb_handle_t clock_register_tick(clk_t clk, clock_tick_cb_t callback, void
         entry->callback = callback;
         entry->userdata = userdata;
         entry->edges = CLOCK_NEGEDGE;
+        entry->clk = clk;
+        entry->suspended = false;
         list_add_tail(&clk->callbacks, &entry->node);
     }
 
@@ -435,12 +661,29 @@ clock_cb_handle_t clock_register_tick_edges(clk_t clk, clock_tick_cb_t callback,
         entry->callback = callback;
         entry->userdata = userdata;
         entry->edges = edges;
+        entry->clk = clk;
+        entry->suspended = false;
         list_add_tail(&clk->callbacks, &entry->node);
     }
 
     return entry;
 }
 
+/**
+ * Removes a tick handler from the list it is on, skipping over it if it was the next to be called.
+ *
+ * @param[in] entry     The tick handler to remove
+ */
+static void clock_unlink_tick(clk_cb_entry_t *entry)
+{
+    if(entry->clk->next_cb == &entry->node)
+    {
+        entry->clk->next_cb = entry->node.next;
+    }
+
+    list_remove(&entry->node);
+}
+
 /**
  * Un-registers a previously registered tack handler for a clock
  *
@@ -453,11 +696,170 @@ void clock_unregister_tick(clock_cb_handle_t handle)
         return;
     }
 
-    list_remove(&((clk_cb_entry_t *)handle)->node);
+    clock_unlink_tick((clk_cb_entry_t *)handle);
 
     free(handle);
 }
 
+/**
+ * Suspends a registered tick handler, so it is no longer called until it is resumed. This may be
+ * called from within any tick handler, including the one being suspended.
+ *
+ * @param[in] handle    Handle of the registered callback to suspend
+ */
+void clock_suspend_tick(clock_cb_handle_t handle)
+{
+    clk_cb_entry_t *entry = (clk_cb_entry_t *)handle;
+
+    if((entry == NULL) || entry->suspended)
+    {
+        return;
+    }
+
+    clock_unlink_tick(entry);
+    list_add_tail(&entry->clk->suspended, &entry->node);
+    entry->suspended = true;
+}
+
+/**
+ * Resumes a suspended tick handler. It is called after the other handlers of the clock from then
+ * on, including for the current edge if the clock is dispatching a tick.
+ *
+ * @param[in] handle    Handle of the registered callback to resume
+ */
+void clock_resume_tick(clock_cb_handle_t handle)
+{
+    clk_cb_entry_t *entry = (clk_cb_entry_t *)handle;
+
+    if((entry == NULL) || !entry->suspended)
+    {
+        return;
+    }
+
+    list_remove(&entry->node);
+    list_add_tail(&entry->clk->callbacks, &entry->node);
+    entry->suspended = false;
+
+    /* If callbacks are being made and the last has been reached, this one is next. */
+    if(entry->clk->next_cb == &entry->clk->callbacks)
+    {
+        entry->clk->next_cb = &entry->node;
+    }
+}
+
+/**
+ * Registers a sync handler for a given clock. Instead of being called on every tick, the device
+ * calls clock_sync before any access to its state, such as a bus access to its registers, and
+ * schedules a deadline with clock_sync_schedule for anything it must do unprompted, such as
+ * raising an interrupt. The handler is only called from those points.
+ *
+ * @param[in] clk       The clock the device follows
+ * @param[in] callback  The handler to be called to catch up with the clock
+ * @param[in] userdata  App specific data to be passed on each callback
+ *
+ * @return A handle for the registered handler or NULL on error
+ */
+clock_sync_handle_t clock_register_sync(clk_t clk, clock_sync_cb_t callback, void *userdata)
+{
+    clk_sync_entry_t *entry;
+
+    if((clk == NULL) || (callback == NULL))
+    {
+        return NULL;
+    }
+
+    entry = malloc(sizeof(clk_sync_entry_t));
+
+    if(entry != NULL)
+    {
+        entry->callback = callback;
+        entry->userdata = userdata;
+        entry->clk = clk;
+        entry->last = clk->cycles;
+        entry->deadline = CLOCK_SYNC_NONE;
+        list_add_tail(&clk->syncs, &entry->node);
+    }
+
+    return entry;
+}
+
+/**
+ * Un-registers a previously registered sync handler. This must not be called from within the
+ * handler itself.
+ *
+ * @param[in] handle    Handle of the registered handler to remove
+ */
+void clock_unregister_sync(clock_sync_handle_t handle)
+{
+    clk_sync_entry_t *entry = (clk_sync_entry_t *)handle;
+
+    if(entry == NULL)
+    {
+        return;
+    }
+
+    list_remove(&entry->node);
+    clock_update_deadline(entry->clk);
+
+    free(entry);
+}
+
+/**
+ * Brings a device up to date with its clock, calling its handler with the cycles elapsed since
+ * the last synchronization, if there are any.
+ *
+ * @param[in] handle    Handle of the registered handler
+ */
+void clock_sync(clock_sync_handle_t handle)
+{
+    clk_sync_entry_t *entry = (clk_sync_entry_t *)handle;
+    uint64_t cycles;
+
+    if(entry == NULL)
+    {
+        return;
+    }
+
+    cycles = entry->clk->cycles - entry->last;
+
+    if(cycles > 0)
+    {
+        /* Mark the device as synchronized first, as the handler may access it again. */
+        entry->last = entry->clk->cycles;
+        entry->callback(entry->clk, cycles, entry->userdata);
+    }
+}
+
+/**
+ * Schedules the next synchronization of a device, replacing any previous deadline. When the
+ * deadline is reached, the handler is called on the active edge of the clock, after its tick
+ * handlers.
+ *
+ * @param[in] handle    Handle of the registered handler
+ * @param[in] cycles    Number of cycles after the last synchronization, or 0 to cancel the
+ *                      deadline
+ */
+void clock_sync_schedule(clock_sync_handle_t handle, uint64_t cycles)
+{
+    clk_sync_entry_t *entry = (clk_sync_entry_t *)handle;
+
+    if(entry == NULL)
+    {
+        return;
+    }
+
+    entry->deadline = (cycles == 0) ? CLOCK_SYNC_NONE : entry->last + cycles;
+
+    if(entry->deadline < entry->clk->deadline)
+    {
+        entry->clk->deadline = entry->deadline;
+    }
+    else
+    {
+        clock_update_deadline(entry->clk);
+    }
+}
+
 /**
  * Get the frequency in hertz of the given clock
  *
@@ -491,3 +893,222 @@ clk_period_t clock_get_period(clk_t clk)
 
     return clk->period;
 }
+
+/**
+ * Brings every device registered with a sync handler on a clock up to date.
+ *
+ * @param[in] clk   The clock
+ */
+static void clock_sync_clk(clk_t clk)
+{
+    listnode_t *node;
+
+    list_iterate(&clk->syncs, node)
+    {
+        clock_sync(list_container(node, clk_sync_entry_t, node));
+    }
+}
+
+/**
+ * Brings every device registered with a sync handler, on any clock, up to date.
+ *
+ * @param[in] emu   The main emulator context.
+ */
+void clock_sync_all(cbemu_t emu)
+{
+    listnode_t *node;
+
+    clock_sync_clk(emu->clk.mainClk);
+
+    list_iterate(&emu->clk.clks, node)
+    {
+        clock_sync_clk(list_container(node, struct clk_s, node));
+    }
+}
+
+/**
+ * Writes the phase of a clock to a snapshot.
+ *
+ * @param[in] snap  The snapshot being saved
+ * @param[in] clk   The clock
+ *
+ * @return true if the state was written
+ */
+static bool clock_save_clk(snapshot_t snap, clk_t clk)
+{
+    uint8_t cur_phase = clk->cur_phase ? 1 : 0;
+
+    return snapshot_write(snap, &clk->id, sizeof(clk->id)) &&
+           snapshot_write(snap, &clk->ticks, sizeof(clk->ticks)) &&
+           snapshot_write(snap, &cur_phase, sizeof(cur_phase)) &&
+           snapshot_write(snap, &clk->cycles, sizeof(clk->cycles));
+}
+
+/**
+ * Snapshot hook saving the phase of every clock.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] userdata  The main emulator context.
+ *
+ * @return true if the state was written.
+ */
+bool clock_snapshot_save(snapshot_t snap, void *userdata)
+{
+    cbemu_t emu = (cbemu_t)userdata;
+    listnode_t *node;
+    uint32_t count = 1;
+    bool result;
+
+    list_iterate(&emu->clk.clks, node)
+    {
+        ++count;
+    }
+
+    result = snapshot_write(snap, &emu->clk.timebase, sizeof(emu->clk.timebase)) &&
+             snapshot_write(snap, &count, sizeof(count)) &&
+             clock_save_clk(snap, emu->clk.mainClk);
+
+    list_iterate(&emu->clk.clks, node)
+    {
+        result = result && clock_save_clk(snap, list_container(node, struct clk_s, node));
+    }
+
+    return result;
+}
+
+/**
+ * Moves the last synchronization of every sync handler of a clock to its current cycle count,
+ * keeping the distance to any deadline.
+ *
+ * @param[in] clk   The clock
+ */
+static void clock_rebase_syncs(clk_t clk)
+{
+    listnode_t *node;
+    clk_sync_entry_t *entry;
+
+    list_iterate(&clk->syncs, node)
+    {
+        entry = list_container(node, clk_sync_entry_t, node);
+
+        if(entry->deadline != CLOCK_SYNC_NONE)
+        {
+            entry->deadline = clk->cycles + (entry->deadline - entry->last);
+        }
+
+        entry->last = clk->cycles;
+    }
+
+    clock_update_deadline(clk);
+}
+
+/**
+ * Snapshot hook restoring the phase of every clock. Pending sync deadlines keep their distance
+ * from the last synchronization, which becomes the restored point in time.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[in] userdata  The main emulator context.
+ *
+ * @return true if the snapshot holds a valid state for exactly the clocks of the emulator. The
+ *         clocks are left unchanged otherwise.
+ */
+bool clock_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    cbemu_t emu = (cbemu_t)userdata;
+    clk_cxt_t *cxt = &emu->clk;
+    clk_snapshot_rec_t *recs;
+    listnode_t sorted;
+    listnode_t *node;
+    uint64_t timebase;
+    uint32_t count;
+    uint32_t live = 1;
+    uint32_t index;
+    uint32_t prev;
+    uint32_t id;
+    uint8_t cur_phase;
+    bool result = true;
+
+    if(!snapshot_read(snap, &timebase, sizeof(timebase)) || !snapshot_read(snap, &count, sizeof(count)))
+    {
+        return false;
+    }
+
+    list_iterate(&cxt->clks, node)
+    {
+        ++live;
+    }
+
+    /* The phases are only meaningful with the same set of clocks. */
+    if(timebase != cxt->timebase || count != live)
+    {
+        return false;
+    }
+
+    recs = malloc(count * sizeof(clk_snapshot_rec_t));
+    if(recs == NULL)
+    {
+        return false;
+    }
+
+    /* Check every record before changing any clock, so a bad snapshot leaves them all alone. */
+    for(index = 0; result && index < count; ++index)
+    {
+        result = snapshot_read(snap, &id, sizeof(id)) &&
+                 snapshot_read(snap, &recs[index].ticks, sizeof(recs[index].ticks)) &&
+                 snapshot_read(snap, &cur_phase, sizeof(cur_phase)) &&
+                 snapshot_read(snap, &recs[index].cycles, sizeof(recs[index].cycles));
+
+        if(result)
+        {
+            recs[index].clk = clock_find_id(cxt, id);
+            recs[index].cur_phase = (cur_phase != 0);
+
+            result = (recs[index].clk != NULL) && (recs[index].ticks != 0) &&
+                     (recs[index].ticks <= recs[index].clk->phase);
+        }
+
+        /* With the counts equal, no repeats means every clock has a record. */
+        for(prev = 0; result && prev < index; ++prev)
+        {
+            result = (recs[prev].clk != recs[index].clk);
+        }
+    }
+
+    if(result)
+    {
+        for(index = 0; index < count; ++index)
+        {
+            recs[index].clk->ticks = recs[index].ticks;
+            recs[index].clk->cur_phase = recs[index].cur_phase;
+            recs[index].clk->cycles = recs[index].cycles;
+        }
+
+        /* Re-sort the derived clocks by their restored remaining ticks. */
+        list_init(&sorted);
+
+        while(!list_empty(&cxt->clks))
+        {
+            node = list_head(&cxt->clks);
+            list_remove(node);
+            list_add_tail(&sorted, node);
+        }
+
+        while(!list_empty(&sorted))
+        {
+            node = list_head(&sorted);
+            list_remove(node);
+            clock_insert_sorted(cxt, list_container(node, struct clk_s, node));
+        }
+
+        clock_rebase_syncs(cxt->mainClk);
+
+        list_iterate(&cxt->clks, node)
+        {
+            clock_rebase_syncs(list_container(node, struct clk_s, node));
+        }
+    }
+
+    free(recs);
+
+    return result;
+}
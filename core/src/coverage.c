@@ -0,0 +1,533 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "coverage.h"
+#include "cpu_priv.h"
+#include "bus_priv.h"
+
+#define COVERAGE_INIT_LINES     256
+
+/** Conditional branches: BPL, BMI, BVC, BVS, BCC, BCS, BNE and BEQ. */
+#define COVERAGE_IS_BXX(_op)    (((_op) & 0x1f) == 0x10)
+
+#ifdef SUPPORT_65C02
+/** BBR and BBS. */
+#define COVERAGE_IS_BBX(_op)    (((_op) & 0x0f) == 0x0f)
+#else
+#define COVERAGE_IS_BBX(_op)    false
+#endif
+
+struct coverage_s
+{
+    cbemu_t emu;
+    cpu_coverage_t maps;
+};
+
+/** An address range attributed to a single source line. */
+typedef struct
+{
+    unsigned int source_id;
+    unsigned long line;
+    cc65_line_type type;
+    uint16_t start;
+    uint16_t end;
+} coverage_line_t;
+
+/** Lines collected from the debug info, as a growable array. */
+typedef struct
+{
+    coverage_line_t *lines;
+    unsigned int num_lines;
+    unsigned int alloc_lines;
+} coverage_lines_t;
+
+/**
+ * Adds a line record to the collected lines.
+ *
+ * @param[in] lines     The collected lines.
+ * @param[in] line      The line data from the debug info.
+ * @param[in] span      The span the line is attached to.
+ *
+ * @return true if the line was added.
+ */
+static bool coverage_add_line(coverage_lines_t *lines, const cc65_linedata *line, const cc65_spandata *span)
+{
+    coverage_line_t *record;
+    unsigned int alloc;
+
+    if(lines->num_lines == lines->alloc_lines)
+    {
+        alloc = lines->alloc_lines * 2;
+        record = realloc(lines->lines, alloc * sizeof(coverage_line_t));
+
+        if(record == NULL)
+        {
+            return false;
+        }
+
+        lines->lines = record;
+        lines->alloc_lines = alloc;
+    }
+
+    record = &lines->lines[lines->num_lines++];
+    record->source_id = line->source_id;
+    record->line = line->source_line;
+    record->type = line->line_type;
+    record->start = (uint16_t)span->span_start;
+    record->end = (uint16_t)span->span_end;
+
+    return true;
+}
+
+/**
+ * Collects the source lines attached to every code span in the debug info.
+ *
+ * @param[in] dbginfo   The debug info.
+ * @param[out] lines    The collected lines.
+ *
+ * @return true if the lines were collected.
+ */
+static bool coverage_collect_lines(cc65_dbginfo dbginfo, coverage_lines_t *lines)
+{
+    const cc65_spaninfo *spans;
+    const cc65_lineinfo *lineinfo;
+    unsigned int span;
+    unsigned int line;
+    bool result = true;
+
+    lines->num_lines = 0;
+    lines->alloc_lines = COVERAGE_INIT_LINES;
+    lines->lines = malloc(lines->alloc_lines * sizeof(coverage_line_t));
+
+    if(lines->lines == NULL)
+    {
+        return false;
+    }
+
+    spans = cc65_get_spanlist(dbginfo);
+
+    if(spans == NULL)
+    {
+        return true;
+    }
+
+    for(span = 0; span < spans->count && result; ++span)
+    {
+        /* Spans with type information were generated by data directives. */
+        if(spans->data[span].type_id != CC65_INV_ID || spans->data[span].line_count == 0)
+        {
+            continue;
+        }
+
+        lineinfo = cc65_line_byspan(dbginfo, spans->data[span].span_id);
+
+        if(lineinfo == NULL)
+        {
+            continue;
+        }
+
+        for(line = 0; line < lineinfo->count && result; ++line)
+        {
+            /* Macro expansions are reported against the line that invoked them. */
+            if(lineinfo->data[line].line_type == CC65_LINE_MACRO)
+            {
+                continue;
+            }
+
+            result = coverage_add_line(lines, &lineinfo->data[line], &spans->data[span]);
+        }
+
+        cc65_free_lineinfo(dbginfo, lineinfo);
+    }
+
+    cc65_free_spaninfo(dbginfo, spans);
+
+    return result;
+}
+
+static int coverage_compare_lines(const void *a, const void *b)
+{
+    const coverage_line_t *line_a = (const coverage_line_t *)a;
+    const coverage_line_t *line_b = (const coverage_line_t *)b;
+
+    if(line_a->source_id != line_b->source_id)
+        return (line_a->source_id < line_b->source_id) ? -1 : 1;
+
+    if(line_a->line != line_b->line)
+        return (line_a->line < line_b->line) ? -1 : 1;
+
+    if(line_a->start != line_b->start)
+        return (line_a->start < line_b->start) ? -1 : 1;
+
+    if(line_a->end != line_b->end)
+        return (line_a->end < line_b->end) ? -1 : 1;
+
+    return 0;
+}
+
+/**
+ * Checks whether any opcode in an address range has been executed.
+ */
+static bool coverage_range_executed(coverage_t handle, uint16_t start, uint16_t end)
+{
+    uint32_t addr;
+
+    for(addr = start; addr <= end; ++addr)
+    {
+        if(CPU_COVERAGE_TEST(handle->maps.executed, addr))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Writes the branch records for a single line, and updates the branch totals.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] out       Stream to write to.
+ * @param[in] first     The first record for the line.
+ * @param[in] count     The number of records for the line.
+ * @param[in,out] found Number of branches found in the file.
+ * @param[in,out] hit   Number of branches hit in the file.
+ */
+static void coverage_write_branches(coverage_t handle, FILE *out, const coverage_line_t *first, unsigned int count, unsigned int *found, unsigned int *hit)
+{
+    const coverage_line_t *record;
+    unsigned int block = 0;
+    unsigned int index;
+    unsigned int outcomes;
+    uint32_t addr;
+    uint8_t opcode;
+
+    for(index = 0; index < count; ++index)
+    {
+        record = &first[index];
+
+        if(index > 0 && coverage_compare_lines(record, record - 1) == 0)
+        {
+            continue;
+        }
+
+        for(addr = record->start; addr <= record->end; ++addr)
+        {
+            outcomes = coverage_get_branch(handle, (uint16_t)addr);
+
+            if(outcomes == COVERAGE_BRANCH_NONE)
+            {
+                /* Assembly lines hold a single instruction, so an unexecuted branch can still be
+                 * reported by checking the opcode at the start of the span. */
+                if(addr != record->start || record->type != CC65_LINE_ASM || CPU_COVERAGE_TEST(handle->maps.executed, addr))
+                {
+                    continue;
+                }
+
+                opcode = bus_peek(handle->emu, (uint16_t)addr);
+
+                if(!COVERAGE_IS_BXX(opcode) && !COVERAGE_IS_BBX(opcode))
+                {
+                    continue;
+                }
+
+                fprintf(out, "BRDA:%lu,%u,0,-\n", record->line, block);
+                fprintf(out, "BRDA:%lu,%u,1,-\n", record->line, block);
+            }
+            else
+            {
+                fprintf(out, "BRDA:%lu,%u,0,%d\n", record->line, block, (outcomes & COVERAGE_BRANCH_TAKEN) ? 1 : 0);
+                fprintf(out, "BRDA:%lu,%u,1,%d\n", record->line, block, (outcomes & COVERAGE_BRANCH_NOT_TAKEN) ? 1 : 0);
+
+                *hit += ((outcomes & COVERAGE_BRANCH_TAKEN) ? 1 : 0) + ((outcomes & COVERAGE_BRANCH_NOT_TAKEN) ? 1 : 0);
+            }
+
+            *found += 2;
+            ++block;
+        }
+    }
+}
+
+/**
+ * Writes the lcov record for a single source file.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] dbginfo   The debug info.
+ * @param[in] out       Stream to write to.
+ * @param[in] test_name Test name, or NULL.
+ * @param[in] lines     All line records for the source file, sorted by line.
+ * @param[in] count     The number of line records.
+ */
+static void coverage_write_source(coverage_t handle, cc65_dbginfo dbginfo, FILE *out, const char *test_name, const coverage_line_t *lines, unsigned int count)
+{
+    const cc65_sourceinfo *source;
+    unsigned int lines_found = 0;
+    unsigned int lines_hit = 0;
+    unsigned int branches_found = 0;
+    unsigned int branches_hit = 0;
+    unsigned int index;
+    unsigned int end;
+    bool executed;
+
+    source = cc65_source_byid(dbginfo, lines[0].source_id);
+
+    if(source == NULL || source->count == 0)
+    {
+        return;
+    }
+
+    fprintf(out, "TN:%s\n", test_name != NULL ? test_name : "");
+    fprintf(out, "SF:%s\n", source->data[0].source_name);
+
+    cc65_free_sourceinfo(dbginfo, source);
+
+    for(index = 0; index < count; index = end)
+    {
+        for(end = index + 1; end < count && lines[end].line == lines[index].line; ++end);
+
+        coverage_write_branches(handle, out, &lines[index], end - index, &branches_found, &branches_hit);
+    }
+
+    fprintf(out, "BRF:%u\n", branches_found);
+    fprintf(out, "BRH:%u\n", branches_hit);
+
+    for(index = 0; index < count; index = end)
+    {
+        executed = false;
+
+        for(end = index; end < count && lines[end].line == lines[index].line; ++end)
+        {
+            executed = executed || coverage_range_executed(handle, lines[end].start, lines[end].end);
+        }
+
+        fprintf(out, "DA:%lu,%d\n", lines[index].line, executed ? 1 : 0);
+
+        ++lines_found;
+
+        if(executed)
+        {
+            ++lines_hit;
+        }
+    }
+
+    fprintf(out, "LF:%u\n", lines_found);
+    fprintf(out, "LH:%u\n", lines_hit);
+    fprintf(out, "end_of_record\n");
+}
+
+/**
+ * Creates a coverage map and attaches it to an emulator instance. Coverage is recorded
+ * immediately. Only one coverage map may be attached to an emulator at a time.
+ *
+ * @param[in] emulator  The emulator instance to collect coverage for.
+ *
+ * @return The coverage instance, or NULL if there was an error.
+ */
+coverage_t coverage_init(cbemu_t emulator)
+{
+    coverage_t handle;
+
+    if(emulator == NULL || emulator->cpu.coverage != NULL)
+    {
+        return NULL;
+    }
+
+    handle = malloc(sizeof(struct coverage_s));
+
+    if(handle == NULL)
+    {
+        return NULL;
+    }
+
+    memset(handle, 0, sizeof(struct coverage_s));
+
+    handle->emu = emulator;
+    emulator->cpu.coverage = &handle->maps;
+
+    return handle;
+}
+
+/**
+ * Clears all collected coverage.
+ *
+ * @param[in] handle The coverage handle.
+ */
+void coverage_reset(coverage_t handle)
+{
+    if(handle != NULL)
+    {
+        memset(&handle->maps, 0, sizeof(handle->maps));
+    }
+}
+
+/**
+ * Checks whether an opcode has been executed from an address.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] addr      The address to check.
+ *
+ * @return true if an opcode was fetched from the address.
+ */
+bool coverage_is_executed(coverage_t handle, uint16_t addr)
+{
+    if(handle == NULL)
+    {
+        return false;
+    }
+
+    return CPU_COVERAGE_TEST(handle->maps.executed, addr);
+}
+
+/**
+ * Gets the recorded outcomes of a conditional branch instruction.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] addr      Address of the branch opcode.
+ *
+ * @return Bitwise OR of the coverage_branch_t outcomes seen.
+ */
+unsigned int coverage_get_branch(coverage_t handle, uint16_t addr)
+{
+    unsigned int outcomes = COVERAGE_BRANCH_NONE;
+
+    if(handle == NULL)
+    {
+        return outcomes;
+    }
+
+    if(CPU_COVERAGE_TEST(handle->maps.taken, addr))
+        outcomes |= COVERAGE_BRANCH_TAKEN;
+
+    if(CPU_COVERAGE_TEST(handle->maps.not_taken, addr))
+        outcomes |= COVERAGE_BRANCH_NOT_TAKEN;
+
+    return outcomes;
+}
+
+/**
+ * Gets the number of unique addresses opcodes have been executed from.
+ *
+ * @param[in] handle The coverage handle.
+ *
+ * @return The number of executed addresses.
+ */
+unsigned int coverage_get_executed_count(coverage_t handle)
+{
+    unsigned int count = 0;
+    unsigned int index;
+    uint8_t bits;
+
+    if(handle == NULL)
+    {
+        return 0;
+    }
+
+    for(index = 0; index < CPU_COVERAGE_MAP_SIZE; ++index)
+    {
+        for(bits = handle->maps.executed[index]; bits != 0; bits &= (uint8_t)(bits - 1))
+        {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Writes the collected coverage as an lcov tracefile. Only spans of code (spans without type
+ * information) are reported. Line hit counts are 0 or 1, as the map only records whether an
+ * address has been executed.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] dbginfo   Debug info used to map addresses to source lines.
+ * @param[in] out       Stream to write the tracefile to.
+ * @param[in] test_name Test name to record in the tracefile, or NULL for none.
+ *
+ * @return true if the tracefile was written successfully.
+ */
+bool coverage_write_lcov(coverage_t handle, cc65_dbginfo dbginfo, FILE *out, const char *test_name)
+{
+    coverage_lines_t lines;
+    unsigned int index;
+    unsigned int end;
+
+    if(handle == NULL || dbginfo == NULL || out == NULL)
+    {
+        return false;
+    }
+
+    if(!coverage_collect_lines(dbginfo, &lines))
+    {
+        free(lines.lines);
+        return false;
+    }
+
+    qsort(lines.lines, lines.num_lines, sizeof(coverage_line_t), coverage_compare_lines);
+
+    for(index = 0; index < lines.num_lines; index = end)
+    {
+        for(end = index + 1; end < lines.num_lines && lines.lines[end].source_id == lines.lines[index].source_id; ++end);
+
+        coverage_write_source(handle, dbginfo, out, test_name, &lines.lines[index], end - index);
+    }
+
+    free(lines.lines);
+
+    return !ferror(out);
+}
+
+/**
+ * Writes the collected coverage as an lcov tracefile to a file.
+ *
+ * @param[in] handle    The coverage handle.
+ * @param[in] dbginfo   Debug info used to map addresses to source lines.
+ * @param[in] filename  The file to write.
+ * @param[in] test_name Test name to record in the tracefile, or NULL for none.
+ *
+ * @return true if the tracefile was written successfully.
+ */
+bool coverage_dump_lcov(coverage_t handle, cc65_dbginfo dbginfo, const char *filename, const char *test_name)
+{
+    FILE *out;
+    bool result;
+
+    if(handle == NULL || filename == NULL)
+    {
+        return false;
+    }
+
+    out = fopen(filename, "w");
+
+    if(out == NULL)
+    {
+        return false;
+    }
+
+    result = coverage_write_lcov(handle, dbginfo, out, test_name);
+
+    return (fclose(out) == 0) && result;
+}
+
+/**
+ * Detaches a coverage map from its emulator and frees it.
+ *
+ * @param[in] handle The coverage handle.
+ */
+void coverage_cleanup(coverage_t handle)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    if(handle->emu->cpu.coverage == &handle->maps)
+    {
+        handle->emu->cpu.coverage = NULL;
+    }
+
+    free(handle);
+}
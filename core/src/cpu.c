@@ -8,6 +8,7 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "bus_priv_types.h"
 #include "cpu_priv.h"
@@ -26,6 +27,9 @@
 
 #define BASE_STACK     0x100
 
+/* RMBx/SMBx/BBRx/BBSx encode the bit number in bits 4-6 of the opcode. */
+#define opcode_bit(opcode) (((opcode) >> 4) & 0x07)
+
 #define saveaccum(cpu) cpu.regs.a = (uint8_t)((cpu.result) & 0x00FF)
 
 
@@ -78,17 +82,106 @@
             clearoverflow(status); \
     } while(0)
 
+static void cpu_notify(cbemu_t emu, cpu_event_t event, const cpu_call_frame_t *frame);
+
+/* The reset sequence decrements the stack pointer from whatever value it was left at, so
+ * wrapping during reset is expected. */
+#define stack_wrap_valid(cpu) (((cpu)->op_state < VEC0) || ((cpu)->vec_src != RST_VEC))
+
 //a few general functions used by various other functions
 void push8(cbemu_t emu, uint8_t pushval)
 {
     bus_write(emu, BASE_STACK + emu->cpu.regs.sp--, pushval);
+
+    if(emu->cpu.regs.sp == 0xFF && stack_wrap_valid(&emu->cpu))
+    {
+        cpu_notify(emu, CPU_EVENT_STACK_OVERFLOW, NULL);
+    }
 }
 
 uint8_t pull8(cbemu_t emu)
 {
+    if(emu->cpu.regs.sp == 0xFF)
+    {
+        cpu_notify(emu, CPU_EVENT_STACK_UNDERFLOW, NULL);
+    }
+
     return bus_read(emu, BASE_STACK + ++emu->cpu.regs.sp);
 }
 
+/**
+ * Notifies all registered hooks of a call stack event.
+ *
+ * @param[in] emu   The emulator instance.
+ * @param[in] event The event to report.
+ * @param[in] frame The frame pushed or popped.
+ */
+static void cpu_notify(cbemu_t emu, cpu_event_t event, const cpu_call_frame_t *frame)
+{
+    listnode_t *cur;
+    cpu_hook_t *hook;
+
+    list_iterate(&emu->cpu.hooks, cur)
+    {
+        hook = list_container(cur, cpu_hook_t, list);
+
+        hook->callback(emu, event, frame, hook->userdata);
+    }
+}
+
+/**
+ * Pushes a new frame onto the shadow call stack. If the stack is full, the outermost
+ * frame is discarded to make room.
+ *
+ * @param[in] emu       The emulator instance.
+ * @param[in] type      What created the frame.
+ * @param[in] target    Entry address of the subroutine or handler.
+ * @param[in] sp        Stack pointer prior to the return address being pushed.
+ */
+static void cpu_push_frame(cbemu_t emu, cpu_call_type_t type, uint16_t target, uint16_t sp)
+{
+    cpu_callstack_t *stack = &emu->cpu.callstack;
+    cpu_call_frame_t *frame;
+
+    if(stack->depth == CPU_CALLSTACK_DEPTH)
+    {
+        memmove(&stack->frames[0], &stack->frames[1], sizeof(cpu_call_frame_t) * (CPU_CALLSTACK_DEPTH - 1));
+        --stack->depth;
+        ++stack->dropped;
+    }
+
+    frame = &stack->frames[stack->depth++];
+    frame->target = target;
+    frame->sp = sp;
+    frame->type = type;
+    frame->entry_cycle = emu->cpu.cycles;
+
+    cpu_notify(emu, CPU_EVENT_CALL, frame);
+}
+
+/**
+ * Pops all frames whose return address lies at or below the given stack pointer, i.e. has
+ * been pulled off of the stack. Frames are matched by stack pointer rather than by type so
+ * that frames abandoned by stack manipulation are unwound, and returns that don't release a
+ * frame (e.g. the RTS jump table idiom) are ignored.
+ *
+ * @param[in] emu   The emulator instance.
+ * @param[in] sp    The stack pointer to unwind to.
+ */
+static void cpu_pop_frames(cbemu_t emu, uint16_t sp)
+{
+    cpu_callstack_t *stack = &emu->cpu.callstack;
+    cpu_call_frame_t frame;
+
+    while(stack->depth > 0 && stack->frames[stack->depth-1].sp <= sp)
+    {
+        /* Copy the frame out so hooks see a stable frame after the depth changes. */
+        frame = stack->frames[--stack->depth];
+
+        cpu_notify(emu, CPU_EVENT_RETURN, &frame);
+    }
+}
+
 void cpu_reset()
 {
 #if 0
@@ -126,7 +219,7 @@ static inline void advance_state(cpu_t *cpu, op_state_t new_state, bool memcycle
 static void imp(cbemu_t emu)
 {
     /* Implied opcodes take 2 cycles, reading the next PC an additional time. */
-    (void)bus_read(emu, emu->cpu.regs.pc);
+    bus_dummy_read(emu, emu->cpu.regs.pc);
     advance_state(&emu->cpu, OP0, false);
 }
 
@@ -134,7 +227,7 @@ static void imp(cbemu_t emu)
 static void acc(cbemu_t emu)
 {
     /* Implied opcodes take 2 cycles, reading the next PC an additional time. */
-    (void)bus_read(emu, emu->cpu.regs.pc);
+    bus_dummy_read(emu, emu->cpu.regs.pc);
     advance_state(&emu->cpu, OP0, false);
 }
 
@@ -165,7 +258,7 @@ static void zpx(cbemu_t emu)
     else
     {
         emu->cpu.ea = (emu->cpu.ea + (uint16_t)emu->cpu.regs.x) & 0x00FF;
-        (void)bus_read(emu, emu->cpu.regs.pc++);
+        bus_dummy_read(emu, emu->cpu.regs.pc++);
         advance_state(&emu->cpu, OP0, true);
     }
 }
@@ -181,7 +274,7 @@ static void zpy(cbemu_t emu)
     else
     {
         emu->cpu.ea = (emu->cpu.ea + (uint16_t)emu->cpu.regs.y) & 0x00FF;
-        (void)bus_read(emu, emu->cpu.regs.pc++);
+        bus_dummy_read(emu, emu->cpu.regs.pc++);
         advance_state(&emu->cpu, OP0, true);
     }
 }
@@ -264,7 +357,7 @@ static void absx(cbemu_t emu)
     else
     {
         /* Penalty cycle. Repeat read cycle on current PC. */
-        (void)bus_read(emu, emu->cpu.regs.pc++);
+        bus_dummy_read(emu, emu->cpu.regs.pc++);
         advance_state(&emu->cpu, OP0, true);
     }
 }
@@ -302,7 +395,7 @@ static void absy(cbemu_t emu)
     else
     {
         /* Penalty cycle. Repeat read cycle on current PC. */
-        (void)bus_read(emu, emu->cpu.regs.pc++);
+        bus_dummy_read(emu, emu->cpu.regs.pc++);
         advance_state(&emu->cpu, OP0, true);
     }
 }
@@ -323,7 +416,7 @@ static void ind(cbemu_t emu)
         case PARAM2:
             /* 65C02 always takes an extra cycle here. This is the workaround to the
              * NMOS 6502 issue if page-wrap on this on this opcode. */
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
             advance_state(&emu->cpu, PARAM3, true);
             break;
         case PARAM3:
@@ -350,7 +443,7 @@ static void indx(cbemu_t emu)
             break;
         case PARAM1:
             emu->cpu.tmpval = (emu->cpu.tmpval + (uint16_t)emu->cpu.regs.x) & 0x00FF;
-            (void)bus_read(emu, emu->cpu.regs.pc++);
+            bus_dummy_read(emu, emu->cpu.regs.pc++);
             advance_state(&emu->cpu, PARAM2, true);
             break;
         case PARAM2:
@@ -400,7 +493,7 @@ static void indy(cbemu_t emu)
             break;
         case PARAM3:
             /* Repeat the second zeropage read on page cross. */
-            (void)bus_read(emu, emu->cpu.tmpval);
+            bus_dummy_read(emu, emu->cpu.tmpval);
             advance_state(&emu->cpu, OP0, true);
             break;
         default:
@@ -450,7 +543,7 @@ static void abin(cbemu_t emu)
         case PARAM2:
             /* Bus re-reads same byte. Presumably this is to add X, handle
              * carry for indexing. */
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
             emu->cpu.tmpval += (uint16_t)emu->cpu.regs.x;
             advance_state(&emu->cpu, PARAM3, true);
             break;
@@ -485,11 +578,14 @@ static void zprel(cbemu_t emu)
              *      whether the second read is ignored or can actually affect the result if the
              *      value changes. For now, assume it is ignored.
              */
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, PARAM3, true);
             break;
         case PARAM3:
             emu->cpu.reladdr = bus_read(emu, emu->cpu.regs.pc++);
+            if(emu->cpu.reladdr & 0x80)
+                emu->cpu.reladdr |= 0xFF00;
+
             advance_state(&emu->cpu, OP0, false);
             break;
         default:
@@ -616,7 +712,7 @@ static void asl(cbemu_t emu)
             break;
         case OP1:
             /* Re-read the ea. */
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -628,6 +724,18 @@ static void asl(cbemu_t emu)
     }
 }
 
+/* Record the outcome of a conditional branch for coverage. */
+static inline void cover_branch(cbemu_t emu, bool taken)
+{
+    if(emu->cpu.coverage == NULL)
+        return;
+
+    if(taken)
+        CPU_COVERAGE_SET(emu->cpu.coverage->taken, emu->cpu.opaddr);
+    else
+        CPU_COVERAGE_SET(emu->cpu.coverage->not_taken, emu->cpu.opaddr);
+}
+
 static void bxx(cbemu_t emu)
 {
     uint8_t exp_flag;
@@ -643,16 +751,18 @@ static void bxx(cbemu_t emu)
 
             if(((emu->cpu.regs.status >> flag_shift) & 0x01) == exp_flag)
             {
+                cover_branch(emu, true);
                 /* PC stays the same from the bus standpoint. */
                 advance_state(&emu->cpu, OP1, true);
             }
             else
             {
+                cover_branch(emu, false);
                 advance_state(&emu->cpu, OPCODE, true);
             }
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
 
             if((emu->cpu.regs.pc & 0xFF00) != ((emu->cpu.regs.pc + emu->cpu.reladdr) & 0xFF00))
             {
@@ -667,7 +777,7 @@ static void bxx(cbemu_t emu)
             }
             break;
         case OP2:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
             emu->cpu.regs.pc += emu->cpu.reladdr;
             advance_state(&emu->cpu, OPCODE, true);
             break;
@@ -698,7 +808,7 @@ static void bra(cbemu_t emu)
             advance_state(&emu->cpu, OP1, true);
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
 
             if((emu->cpu.regs.pc & 0xFF00) != ((emu->cpu.regs.pc + emu->cpu.reladdr) & 0xFF00))
             {
@@ -711,7 +821,7 @@ static void bra(cbemu_t emu)
             }
             break;
         case OP2:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
             emu->cpu.regs.pc += emu->cpu.reladdr;
             advance_state(&emu->cpu, OPCODE, true);
             break;
@@ -827,7 +937,7 @@ static void dec(cbemu_t emu)
              * EA read. */
             if(addrtable[emu->cpu.opcode] == ABSX && !CPU_CHECK_FLAG(&emu->cpu, CPU_PAGE_BOUNDARY))
             {
-                (void)bus_read(emu, emu->cpu.ea);
+                bus_dummy_read(emu, emu->cpu.ea);
                 advance_state(&emu->cpu, OP1, true);
             }
             else
@@ -854,7 +964,7 @@ static void dec(cbemu_t emu)
             }
             break;
         case OP2:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP3, true);
             break;
         case OP3:
@@ -913,7 +1023,7 @@ static void inc(cbemu_t emu)
              * EA read. */
             if(addrtable[emu->cpu.opcode] == ABSX && !CPU_CHECK_FLAG(&emu->cpu, CPU_PAGE_BOUNDARY))
             {
-                (void)bus_read(emu, emu->cpu.ea);
+                bus_dummy_read(emu, emu->cpu.ea);
                 advance_state(&emu->cpu, OP1, true);
             }
             else
@@ -938,7 +1048,7 @@ static void inc(cbemu_t emu)
                 advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP3, true);
             break;
         case OP3:
@@ -986,7 +1096,7 @@ static void jsr(cbemu_t emu)
             break;
         case OP1:
             /* Ignored stack read. */
-            (void)bus_read(emu, BASE_STACK + emu->cpu.regs.sp);
+            bus_dummy_read(emu, BASE_STACK + emu->cpu.regs.sp);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1000,6 +1110,7 @@ static void jsr(cbemu_t emu)
         case OP4:
             emu->cpu.ea |= (uint16_t)bus_read(emu, emu->cpu.regs.pc) << 8;
             emu->cpu.regs.pc = emu->cpu.ea;
+            cpu_push_frame(emu, CPU_CALL_JSR, emu->cpu.ea, (uint8_t)(emu->cpu.regs.sp + 2));
             advance_state(&emu->cpu, OPCODE, true);
             break;
         default:
@@ -1073,7 +1184,7 @@ static void lsr(cbemu_t emu)
 
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1146,7 +1257,7 @@ static void pl_(cbemu_t emu)
             break;
         case OP1:
             /* Read the current stack pointer before it increments. */
-            (void)bus_read(emu, BASE_STACK + emu->cpu.regs.sp);
+            bus_dummy_read(emu, BASE_STACK + emu->cpu.regs.sp);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1205,7 +1316,7 @@ static void rol(cbemu_t emu)
             }
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1245,7 +1356,7 @@ static void ror(cbemu_t emu)
             }
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1265,7 +1376,7 @@ static void rti(cbemu_t emu)
             advance_state(&emu->cpu, OP1, true);
             break;
         case OP1:
-            (void)bus_read(emu, BASE_STACK+emu->cpu.regs.sp);
+            bus_dummy_read(emu, BASE_STACK+emu->cpu.regs.sp);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1279,6 +1390,7 @@ static void rti(cbemu_t emu)
         case OP4:
             emu->cpu.tmpval |= ((uint16_t)pull8(emu)) << 8;
             emu->cpu.regs.pc = emu->cpu.tmpval;
+            cpu_pop_frames(emu, emu->cpu.regs.sp);
             advance_state(&emu->cpu, OPCODE, true);
             break;
         default:
@@ -1294,7 +1406,7 @@ static void rts(cbemu_t emu)
             advance_state(&emu->cpu, OP1, true);
             break;
         case OP1:
-            (void)bus_read(emu, BASE_STACK+emu->cpu.regs.sp);
+            bus_dummy_read(emu, BASE_STACK+emu->cpu.regs.sp);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1308,7 +1420,8 @@ static void rts(cbemu_t emu)
             break;
         case OP4:
             /* Read the last PC of the JSR, then increment to the next op. */
-            (void)bus_read(emu, emu->cpu.regs.pc++);
+            bus_dummy_read(emu, emu->cpu.regs.pc++);
+            cpu_pop_frames(emu, emu->cpu.regs.sp);
             advance_state(&emu->cpu, OPCODE, true);
             break;
         default:
@@ -1392,14 +1505,14 @@ static void sta(cbemu_t emu)
         if((mode == ABSX || mode == ABSY) && !CPU_CHECK_FLAG(&emu->cpu, CPU_PAGE_BOUNDARY))
         {
             /* The extra cycle reads the eventual write address. */
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP1, true);
         }
         else if(mode == INDY && !CPU_CHECK_FLAG(&emu->cpu, CPU_PAGE_BOUNDARY))
         {
             /* Another special penalty op. This team, re-read the second zp
              * address. This shoudl still be in emu->cpu.tmpval. */
-            (void)bus_read(emu, emu->cpu.tmpval);
+            bus_dummy_read(emu, emu->cpu.tmpval);
             advance_state(&emu->cpu, OP1, true);
         }
         else
@@ -1430,7 +1543,7 @@ static void stx(cbemu_t emu)
         if((mode == ABSX || mode == ABSY) && !CPU_CHECK_FLAG(&emu->cpu, CPU_PAGE_BOUNDARY))
         {
             /* The extra cycle reads the eventual write address. */
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP1, true);
         }
         else
@@ -1461,7 +1574,7 @@ static void sty(cbemu_t emu)
         if((mode == ABSX || mode == ABSY) && !CPU_CHECK_FLAG(&emu->cpu, CPU_PAGE_BOUNDARY))
         {
             /* The extra cycle reads the eventual write address. */
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP1, true);
         }
         else
@@ -1492,7 +1605,7 @@ static void stz(cbemu_t emu)
         if((mode == ABSX || mode == ABSY) && !CPU_CHECK_FLAG(&emu->cpu, CPU_PAGE_BOUNDARY))
         {
             /* The extra cycle reads the eventual write address. */
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP1, true);
         }
         else
@@ -1582,7 +1695,7 @@ static void trb(cbemu_t emu)
             advance_state(&emu->cpu, OP1, true);
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1611,7 +1724,7 @@ static void tsb(cbemu_t emu)
             advance_state(&emu->cpu, OP1, true);
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1632,14 +1745,14 @@ static void rmb(cbemu_t emu)
     {
         case OP0:
             /* RMBX = 0x[0-7]7, so extract the bit to reset from the opcode. */
-            bit = (emu->cpu.opcode >> 8);
+            bit = opcode_bit(emu->cpu.opcode);
             value = getvalue(emu);
             emu->cpu.result = value & ~(1 << bit);
 
             advance_state(&emu->cpu, OP1, true);
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1660,14 +1773,14 @@ static void smb(cbemu_t emu)
     {
         case OP0:
             /* RMBX = 0x[0-7]7, so extract the bit to reset from the opcode. */
-            bit = (emu->cpu.opcode >> 8);
+            bit = opcode_bit(emu->cpu.opcode);
             value = getvalue(emu);
             emu->cpu.result = value | (1 << bit);
 
             advance_state(&emu->cpu, OP1, true);
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.ea);
+            bus_dummy_read(emu, emu->cpu.ea);
             advance_state(&emu->cpu, OP2, true);
             break;
         case OP2:
@@ -1686,20 +1799,22 @@ static void bbr(cbemu_t emu)
     switch(emu->cpu.op_state)
     {
         case OP0:
-            bit = (emu->cpu.opcode >> 8);
+            bit = opcode_bit(emu->cpu.opcode);
 
             /* The value has been cached here by the address mode handler. */
-            if((emu->cpu.value && (1 << bit)) == 0)
+            if((emu->cpu.value & (1 << bit)) == 0)
             {
+                cover_branch(emu, true);
                 advance_state(&emu->cpu, OP1, true);
             }
             else
             {
+                cover_branch(emu, false);
                 advance_state(&emu->cpu, OPCODE, true);
             }
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
 
             if((emu->cpu.regs.pc & 0xFF00) != ((emu->cpu.regs.pc + emu->cpu.reladdr) & 0xFF00))
             {
@@ -1714,7 +1829,7 @@ static void bbr(cbemu_t emu)
             }
             break;
         case OP2:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
             emu->cpu.regs.pc += emu->cpu.reladdr;
             advance_state(&emu->cpu, OPCODE, true);
             break;
@@ -1730,20 +1845,22 @@ static void bbs(cbemu_t emu)
     switch(emu->cpu.op_state)
     {
         case OP0:
-            bit = (emu->cpu.opcode >> 8);
+            bit = opcode_bit(emu->cpu.opcode);
 
             /* The value has been cached here by the address mode handler. */
-            if((emu->cpu.value && (1 << bit)) != 0)
+            if((emu->cpu.value & (1 << bit)) != 0)
             {
+                cover_branch(emu, true);
                 advance_state(&emu->cpu, OP1, true);
             }
             else
             {
+                cover_branch(emu, false);
                 advance_state(&emu->cpu, OPCODE, true);
             }
             break;
         case OP1:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
 
             if((emu->cpu.regs.pc & 0xFF00) != ((emu->cpu.regs.pc + emu->cpu.reladdr) & 0xFF00))
             {
@@ -1758,7 +1875,7 @@ static void bbs(cbemu_t emu)
             }
             break;
         case OP2:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
             emu->cpu.regs.pc += emu->cpu.reladdr;
             advance_state(&emu->cpu, OPCODE, true);
             break;
@@ -1772,11 +1889,11 @@ static void vector(cbemu_t emu)
     switch(emu->cpu.op_state)
     {
         case VEC0:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
             advance_state(&emu->cpu, VEC1, true);
             break;
         case VEC1:
-            (void)bus_read(emu, emu->cpu.regs.pc);
+            bus_dummy_read(emu, emu->cpu.regs.pc);
             advance_state(&emu->cpu, VEC2, true);
             break;
         case VEC2:
@@ -1829,6 +1946,28 @@ static void vector(cbemu_t emu)
         case VEC6:
             emu->cpu.ea |= (uint16_t)bus_read(emu, emu->cpu.tmpval+1) << 8;
             emu->cpu.regs.pc = emu->cpu.ea;
+
+            switch(emu->cpu.vec_src)
+            {
+                case BRK_VEC:
+                    cpu_push_frame(emu, CPU_CALL_BRK, emu->cpu.ea, (uint8_t)(emu->cpu.regs.sp + 3));
+                    break;
+                case NMI_VEC:
+                    cpu_push_frame(emu, CPU_CALL_NMI, emu->cpu.ea, (uint8_t)(emu->cpu.regs.sp + 3));
+                    break;
+                case IRQ_VEC:
+                    cpu_push_frame(emu, CPU_CALL_IRQ, emu->cpu.ea, (uint8_t)(emu->cpu.regs.sp + 3));
+                    break;
+                case RST_VEC:
+                    /* Nothing survives a reset. The reset frame is the outermost frame and can
+                     * never be returned from. */
+                    cpu_pop_frames(emu, CPU_FRAME_SP_BASE);
+                    cpu_push_frame(emu, CPU_CALL_RESET, emu->cpu.ea, CPU_FRAME_SP_BASE);
+                    break;
+                default:
+                    break;
+            }
+
             advance_state(&emu->cpu, OPCODE, true);
             break;
         default:
@@ -1950,6 +2089,7 @@ static const uint32_t ticktable[256] =
 bool cpu_init(cbemu_t emu)
 {
     memset(&emu->cpu, 0, sizeof(emu->cpu));
+    list_init(&emu->cpu.hooks);
     emu->cpu.regs.status |= FLAG_CONSTANT;
     emu->cpu.init = true;
 
@@ -1960,10 +2100,76 @@ bool cpu_init(cbemu_t emu)
     return true;
 }
 
+/**
+ * Releases resources held by the CPU.
+ *
+ * @param[in] emu The emulator instance.
+ */
+void cpu_cleanup(cbemu_t emu)
+{
+    if(!emu->cpu.init)
+    {
+        return;
+    }
+
+    list_free_offset(&emu->cpu.hooks, cpu_hook_t, list);
+    emu->cpu.init = false;
+}
+
+/**
+ * Registers a hook to be notified of CPU call stack events.
+ *
+ * @param[in] emu       The emulator instance.
+ * @param[in] callback  Callback to invoke on each event.
+ * @param[in] userdata  Userdata passed to the callback.
+ *
+ * @return Handle to the hook, or NULL on failure.
+ */
+cpu_hook_t *cpu_add_hook(cbemu_t emu, cpu_hook_cb_t callback, void *userdata)
+{
+    cpu_hook_t *hook;
+
+    if(emu == NULL || callback == NULL)
+    {
+        return NULL;
+    }
+
+    hook = malloc(sizeof(cpu_hook_t));
+
+    if(hook != NULL)
+    {
+        hook->callback = callback;
+        hook->userdata = userdata;
+
+        list_add_tail(&emu->cpu.hooks, &hook->list);
+    }
+
+    return hook;
+}
+
+/**
+ * Removes a previously registered CPU hook.
+ *
+ * @param[in] emu   The emulator instance.
+ * @param[in] hook  The hook to remove.
+ */
+void cpu_remove_hook(cbemu_t emu, cpu_hook_t *hook)
+{
+    if(emu == NULL || hook == NULL)
+    {
+        return;
+    }
+
+    list_remove(&hook->list);
+    free(hook);
+}
+
 void cpu_tick(cbemu_t emu)
 {
     CPU_CLEAR_FLAG(&emu->cpu, CPU_CYCLE_CONSUMED);
 
+    ++emu->cpu.cycles;
+
     if(emu->bus.sigvotes.rdy > 0)
     {
         /* If ready is de-asserted, then we need to hold the CPU state. The last bus operation
@@ -1989,6 +2195,12 @@ void cpu_tick(cbemu_t emu)
             }
             else
             {
+                emu->cpu.opaddr = emu->cpu.regs.pc;
+                CPU_CLEAR_FLAG(&emu->cpu, CPU_PAGE_BOUNDARY);
+
+                if(emu->cpu.coverage != NULL)
+                    CPU_COVERAGE_SET(emu->cpu.coverage->executed, emu->cpu.opaddr);
+
                 emu->cpu.opcode = bus_sync_read(emu, emu->cpu.regs.pc++);
                 CPU_SET_FLAG(&emu->cpu, CPU_CYCLE_CONSUMED);
                 emu->cpu.op_state = PARAM0;
@@ -2186,3 +2398,106 @@ bool cpu_is_sync(cbemu_t emu)
 {
     return emu->cpu.op_state == OPCODE;
 }
+
+/**
+ * Snapshot hook saving the registers, execution state and call stack of the CPU.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] userdata  The emulator instance.
+ *
+ * @return true if the state was written.
+ */
+bool cpu_snapshot_save(snapshot_t snap, void *userdata)
+{
+    cpu_t *cpu = &((cbemu_t)userdata)->cpu;
+    uint32_t vec_src = (uint32_t)cpu->vec_src;
+    uint32_t op_state = (uint32_t)cpu->op_state;
+    uint32_t flags = (uint32_t)cpu->flags;
+
+    return snapshot_write(snap, &cpu->regs.pc, sizeof(cpu->regs.pc)) &&
+           snapshot_write(snap, &cpu->regs.sp, sizeof(cpu->regs.sp)) &&
+           snapshot_write(snap, &cpu->regs.a, sizeof(cpu->regs.a)) &&
+           snapshot_write(snap, &cpu->regs.x, sizeof(cpu->regs.x)) &&
+           snapshot_write(snap, &cpu->regs.y, sizeof(cpu->regs.y)) &&
+           snapshot_write(snap, &cpu->regs.status, sizeof(cpu->regs.status)) &&
+           snapshot_write(snap, &cpu->ea, sizeof(cpu->ea)) &&
+           snapshot_write(snap, &cpu->reladdr, sizeof(cpu->reladdr)) &&
+           snapshot_write(snap, &cpu->value, sizeof(cpu->value)) &&
+           snapshot_write(snap, &cpu->result, sizeof(cpu->result)) &&
+           snapshot_write(snap, &cpu->opcode, sizeof(cpu->opcode)) &&
+           snapshot_write(snap, &cpu->tmpval, sizeof(cpu->tmpval)) &&
+           snapshot_write(snap, &vec_src, sizeof(vec_src)) &&
+           snapshot_write(snap, &op_state, sizeof(op_state)) &&
+           snapshot_write(snap, &flags, sizeof(flags)) &&
+           snapshot_write(snap, &cpu->opaddr, sizeof(cpu->opaddr)) &&
+           snapshot_write(snap, &cpu->cycles, sizeof(cpu->cycles)) &&
+           snapshot_write(snap, &cpu->callstack.depth, sizeof(cpu->callstack.depth)) &&
+           snapshot_write(snap, &cpu->callstack.dropped, sizeof(cpu->callstack.dropped)) &&
+           snapshot_write(snap, cpu->callstack.frames, cpu->callstack.depth * sizeof(cpu_call_frame_t));
+}
+
+/**
+ * Snapshot hook restoring the registers, execution state and call stack of the CPU.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[in] userdata  The emulator instance.
+ *
+ * @return true if the state was read and is valid.
+ */
+bool cpu_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    cpu_t *cpu = &((cbemu_t)userdata)->cpu;
+    cpu_t state;
+    uint32_t vec_src;
+    uint32_t op_state;
+    uint32_t flags;
+
+    memset(&state, 0, sizeof(state));
+
+    if(!snapshot_read(snap, &state.regs.pc, sizeof(state.regs.pc)) ||
+       !snapshot_read(snap, &state.regs.sp, sizeof(state.regs.sp)) ||
+       !snapshot_read(snap, &state.regs.a, sizeof(state.regs.a)) ||
+       !snapshot_read(snap, &state.regs.x, sizeof(state.regs.x)) ||
+       !snapshot_read(snap, &state.regs.y, sizeof(state.regs.y)) ||
+       !snapshot_read(snap, &state.regs.status, sizeof(state.regs.status)) ||
+       !snapshot_read(snap, &state.ea, sizeof(state.ea)) ||
+       !snapshot_read(snap, &state.reladdr, sizeof(state.reladdr)) ||
+       !snapshot_read(snap, &state.value, sizeof(state.value)) ||
+       !snapshot_read(snap, &state.result, sizeof(state.result)) ||
+       !snapshot_read(snap, &state.opcode, sizeof(state.opcode)) ||
+       !snapshot_read(snap, &state.tmpval, sizeof(state.tmpval)) ||
+       !snapshot_read(snap, &vec_src, sizeof(vec_src)) ||
+       !snapshot_read(snap, &op_state, sizeof(op_state)) ||
+       !snapshot_read(snap, &flags, sizeof(flags)) ||
+       !snapshot_read(snap, &state.opaddr, sizeof(state.opaddr)) ||
+       !snapshot_read(snap, &state.cycles, sizeof(state.cycles)) ||
+       !snapshot_read(snap, &state.callstack.depth, sizeof(state.callstack.depth)) ||
+       !snapshot_read(snap, &state.callstack.dropped, sizeof(state.callstack.dropped)))
+    {
+        return false;
+    }
+
+    if(vec_src > IRQ_VEC || op_state > VEC6 ||
+       state.callstack.depth > CPU_CALLSTACK_DEPTH ||
+       !snapshot_read(snap, state.callstack.frames, state.callstack.depth * sizeof(cpu_call_frame_t)))
+    {
+        return false;
+    }
+
+    /* Only replace the execution state, keeping hooks and coverage attached. */
+    cpu->regs = state.regs;
+    cpu->ea = state.ea;
+    cpu->reladdr = state.reladdr;
+    cpu->value = state.value;
+    cpu->result = state.result;
+    cpu->opcode = state.opcode;
+    cpu->tmpval = state.tmpval;
+    cpu->vec_src = (cpu_vec_src_t)vec_src;
+    cpu->op_state = (op_state_t)op_state;
+    cpu->flags = (cpu_flags_t)flags;
+    cpu->opaddr = state.opaddr;
+    cpu->cycles = state.cycles;
+    cpu->callstack = state.callstack;
+
+    return true;
+}
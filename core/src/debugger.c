@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 /* TODO portability from linux */
 #include <strings.h>
@@ -10,8 +12,9 @@
 #include "log.h"
 #include "cpu_priv.h"
 #include "bus_priv.h"
+#include "os_notify.h"
 
-#define MAX_BREAKPOINTS 8
+#define MAX_BREAKPOINTS DEBUG_MAX_BREAKPOINTS
 #define FNV1a_OFFSET_BASIS 2166136261
 #define FNV1a_PRIME        16777619
 #define LABEL_TABLE_SIZE 1024
@@ -21,6 +24,9 @@
 #define CMD_DELIM " "
 #define MAX_PARAMS 16
 
+/* Number of instructions run between checks of the command mailbox. */
+#define CMD_CHECK_INSTRUCTIONS 256
+
 typedef struct dbg_label_s
 {
     uint32_t hash;
@@ -36,13 +42,48 @@ typedef struct
     uint16_t addr;
     dbg_label_t *label;
     cc65_symboldata sym;
+    uint8_t watch_ops;  /* 0 for execution breakpoints. */
+    uint16_t addr_end;
+    bool match_value;
+    uint8_t value;
+    uint8_t *shadow;    /* Last known values of the range, for DEBUG_WATCH_CHANGE. */
 } breakpoint_t;
 
+/* A command in the mailbox. Asynchronous commands are allocated by debug_post and freed once run,
+ * while synchronous ones live on the stack of the thread waiting in debug_call. */
+typedef struct dbg_cmd_s
+{
+    _Atomic(struct dbg_cmd_s *) next;
+    debug_cmd_fn_t fn;
+    void *userdata;
+    bool async;
+    bool done;  /* Guarded by cmd_lock. */
+} dbg_cmd_t;
+
 struct debug_s
 {
     cbemu_t emu;
     volatile bool sw_break;
+
+    /* Intrusive MPSC queue of commands. Producers only ever swap cmd_head, and only the
+     * emulation thread touches cmd_tail, so neither side takes a lock. */
+    _Atomic(dbg_cmd_t *) cmd_head;
+    dbg_cmd_t *cmd_tail;
+    dbg_cmd_t cmd_stub;
+    unsigned int cmd_countdown;
+
+    /* Set when a command is posted, so a thread that is stopped can wait for commands. */
+    os_notify_t cmd_notify;
+
+    /* Only used to wake threads waiting in debug_call, never by the mailbox itself. */
+    pthread_mutex_t cmd_lock;
+    pthread_cond_t cmd_done;
+
     bool exit;
+    bool watching;
+    bool watch_pending;
+    bool watch_hit_valid;
+    debug_watch_hit_t watch_hit;
     breakpoint_t breakpoints[MAX_BREAKPOINTS];
     dbg_label_t labels[LABEL_TABLE_SIZE][LABEL_ENTRIES_PER_BUCKET];
     cc65_dbginfo dbginfo;
@@ -118,7 +159,7 @@ static bool dbg_eval_breakpoints(debug_t handle, uint16_t pc, debug_breakpoint_t
     uint8_t i;
     for(i=0; i<MAX_BREAKPOINTS; ++i)
     {
-        if(handle->breakpoints[i].used && handle->breakpoints[i].addr == pc)
+        if(handle->breakpoints[i].used && handle->breakpoints[i].watch_ops == 0 && handle->breakpoints[i].addr == pc)
         {
             if(bphandle)
                 *bphandle = (debug_breakpoint_t)i;
@@ -130,6 +171,184 @@ static bool dbg_eval_breakpoints(debug_t handle, uint16_t pc, debug_breakpoint_t
     return false;
 }
 
+/* Reports a watchpoint triggered during the last instruction, if any. */
+static bool dbg_eval_watchpoints(debug_t handle, debug_breakpoint_t *bphandle)
+{
+    if(!handle->watch_pending)
+        return false;
+
+    handle->watch_pending = false;
+
+    if(bphandle)
+        *bphandle = handle->watch_hit.handle;
+
+    return true;
+}
+
+/* Bus watch callback, only called for accesses to pages containing a watchpoint. */
+static void dbg_watch(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata)
+{
+    debug_t handle = (debug_t)userdata;
+    breakpoint_t *bp;
+    unsigned int index;
+    uint8_t current;
+    bool hit;
+
+    for(index = 0; index < MAX_BREAKPOINTS; ++index)
+    {
+        bp = &handle->breakpoints[index];
+
+        if(!bp->used || bp->watch_ops == 0 || addr < bp->addr || addr > bp->addr_end)
+            continue;
+
+        hit = false;
+
+        if(write)
+        {
+            if(bp->watch_ops & DEBUG_WATCH_WRITE)
+                hit = true;
+
+            if(bp->watch_ops & DEBUG_WATCH_CHANGE)
+            {
+                /* Peek rather than trusting the written value, in case the write was ignored. */
+                current = bus_peek(handle->emu, addr);
+
+                if(current != bp->shadow[addr - bp->addr])
+                    hit = true;
+
+                bp->shadow[addr - bp->addr] = current;
+            }
+        }
+        else if((bp->watch_ops & DEBUG_WATCH_READ) && !(flags & DUMMY))
+        {
+            hit = true;
+        }
+
+        if(hit && bp->match_value && value != bp->value)
+            hit = false;
+
+        /* The first hit of an instruction is the one reported. */
+        if(hit && !handle->watch_pending)
+        {
+            handle->watch_pending = true;
+            handle->watch_hit_valid = true;
+            handle->watch_hit.handle = (debug_breakpoint_t)index;
+            handle->watch_hit.address = addr;
+            handle->watch_hit.value = value;
+            handle->watch_hit.write = write;
+            handle->watch_hit.pc = handle->emu->cpu.opaddr;
+            handle->watch_hit.cycle = handle->emu->cpu.cycles;
+        }
+    }
+}
+
+/* Flags every page containing a watchpoint, so only accesses to those pages are checked. */
+static void dbg_update_watch_pages(debug_t handle)
+{
+    unsigned int index;
+    bool any = false;
+
+    bus_watch_pages(handle->emu, 0x00, 0xFF, false);
+
+    for(index = 0; index < MAX_BREAKPOINTS; ++index)
+    {
+        if(handle->breakpoints[index].used && handle->breakpoints[index].watch_ops != 0)
+        {
+            bus_watch_pages(handle->emu, handle->breakpoints[index].addr >> 8, handle->breakpoints[index].addr_end >> 8, true);
+            any = true;
+        }
+    }
+
+    /* Release the bus watch when it is no longer needed. */
+    if(!any && handle->watching)
+    {
+        bus_set_watch(handle->emu, NULL, NULL);
+        handle->watching = false;
+    }
+}
+
+static void dbg_push_cmd(debug_t handle, dbg_cmd_t *cmd)
+{
+    dbg_cmd_t *prev;
+
+    atomic_store_explicit(&cmd->next, NULL, memory_order_relaxed);
+
+    /* Claim the head, then link the previous head to the command. Until the link is stored, the
+     * consumer sees the queue as ending at prev. */
+    prev = atomic_exchange_explicit(&handle->cmd_head, cmd, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, cmd, memory_order_release);
+}
+
+/* Takes the oldest command from the mailbox. Returns NULL if it's empty, or if a producer is part
+ * way through adding the only command, in which case it is picked up on the next check. */
+static dbg_cmd_t *dbg_pop_cmd(debug_t handle)
+{
+    dbg_cmd_t *tail = handle->cmd_tail;
+    dbg_cmd_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if(tail == &handle->cmd_stub)
+    {
+        if(next == NULL)
+            return NULL;
+
+        handle->cmd_tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if(next != NULL)
+    {
+        handle->cmd_tail = next;
+        return tail;
+    }
+
+    if(tail != atomic_load_explicit(&handle->cmd_head, memory_order_acquire))
+        return NULL;
+
+    /* The tail is the last command, so put the stub behind it to be able to take it. */
+    dbg_push_cmd(handle, &handle->cmd_stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if(next != NULL)
+    {
+        handle->cmd_tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+/* Called once per instruction by the run loops, checking the mailbox every
+ * CMD_CHECK_INSTRUCTIONS. */
+static void dbg_check_commands(debug_t handle)
+{
+    if(--handle->cmd_countdown == 0)
+    {
+        handle->cmd_countdown = CMD_CHECK_INSTRUCTIONS;
+        debug_process_commands(handle);
+    }
+}
+
+/* Drops any break or stop requested before a run starts. */
+static void dbg_clear_break(debug_t handle)
+{
+    handle->sw_break = false;
+    atomic_store_explicit(&handle->emu->stop, false, memory_order_relaxed);
+}
+
+/* Checks for a break requested by debug_break or emu_stop. A stop is consumed here, so one raised
+ * during a run can't end a later run slice. */
+static bool dbg_break_requested(debug_t handle)
+{
+    if(atomic_load_explicit(&handle->emu->stop, memory_order_relaxed) &&
+       atomic_exchange_explicit(&handle->emu->stop, false, memory_order_relaxed))
+    {
+        handle->sw_break = true;
+    }
+
+    return handle->sw_break;
+}
+
 static void debug_step_i(debug_t handle)
 {
     do
@@ -159,9 +378,57 @@ debug_t debug_init(cbemu_t emulator)
 
     handle->emu = emulator;
 
+    atomic_init(&handle->cmd_stub.next, NULL);
+    atomic_init(&handle->cmd_head, &handle->cmd_stub);
+    handle->cmd_tail = &handle->cmd_stub;
+    handle->cmd_countdown = CMD_CHECK_INSTRUCTIONS;
+
+    /* Without a notifier, commands are still served while running and by debug_process_commands. */
+    handle->cmd_notify = os_notify_create();
+
+    if(pthread_mutex_init(&handle->cmd_lock, NULL) != 0)
+    {
+        os_notify_destroy(handle->cmd_notify);
+        free(handle);
+        return NULL;
+    }
+
+    if(pthread_cond_init(&handle->cmd_done, NULL) != 0)
+    {
+        pthread_mutex_destroy(&handle->cmd_lock);
+        os_notify_destroy(handle->cmd_notify);
+        free(handle);
+        return NULL;
+    }
+
     return handle;
 }
 
+void debug_cleanup(debug_t handle)
+{
+    unsigned int index;
+
+    if(handle == NULL)
+        return;
+
+    /* Run anything still in the mailbox, so no caller is left waiting. */
+    debug_process_commands(handle);
+
+    for(index = 0; index < MAX_BREAKPOINTS; ++index)
+    {
+        free(handle->breakpoints[index].shadow);
+    }
+
+    if(handle->watching)
+        bus_set_watch(handle->emu, NULL, NULL);
+
+    pthread_cond_destroy(&handle->cmd_done);
+    pthread_mutex_destroy(&handle->cmd_lock);
+    os_notify_destroy(handle->cmd_notify);
+
+    free(handle);
+}
+
 bool debug_load_labels(debug_t handle, const char *labels_file)
 {
     char line[256];
@@ -297,16 +564,96 @@ bool debug_set_breakpoint_label(debug_t handle, debug_breakpoint_t *breakpoint_h
     return false;
 }
 
-void debug_clear_breakpoint(debug_t handle, debug_breakpoint_t breakpoint_handle)
+bool debug_set_watchpoint(debug_t handle, debug_breakpoint_t *breakpoint_handle, const debug_watch_t *watch)
 {
     unsigned int index;
+    breakpoint_t *bp;
+
+    if(handle == NULL || breakpoint_handle == NULL || watch == NULL)
+        return false;
+
+    if(watch->addr_end < watch->addr_start || watch->ops == 0 ||
+       (watch->ops & ~(DEBUG_WATCH_READ | DEBUG_WATCH_WRITE | DEBUG_WATCH_CHANGE)) != 0)
+        return false;
+
+    for(index = 0; index < MAX_BREAKPOINTS; ++index)
+    {
+        if(!handle->breakpoints[index].used)
+            break;
+    }
+
+    if(index == MAX_BREAKPOINTS)
+        return false;
+
+    bp = &handle->breakpoints[index];
+
+    if(watch->ops & DEBUG_WATCH_CHANGE)
+    {
+        bp->shadow = malloc((size_t)watch->addr_end - watch->addr_start + 1);
+
+        if(bp->shadow == NULL)
+            return false;
+
+        bus_peek_range(handle->emu, watch->addr_start, (uint32_t)watch->addr_end - watch->addr_start + 1, bp->shadow);
+    }
+
+    if(!handle->watching)
+    {
+        /* Another user of the bus watch prevents setting watchpoints. */
+        if(!bus_set_watch(handle->emu, dbg_watch, handle))
+        {
+            free(bp->shadow);
+            bp->shadow = NULL;
+            return false;
+        }
+
+        handle->watching = true;
+    }
+
+    bp->used = true;
+    bp->addr = watch->addr_start;
+    bp->addr_end = watch->addr_end;
+    bp->label = NULL;
+    bp->sym_valid = false;
+    bp->watch_ops = watch->ops;
+    bp->match_value = watch->match_value;
+    bp->value = watch->value;
+
+    dbg_update_watch_pages(handle);
+
+    *breakpoint_handle = (debug_breakpoint_t)index;
+
+    return true;
+}
+
+bool debug_get_watch_hit(debug_t handle, debug_watch_hit_t *hit)
+{
+    if(handle == NULL || hit == NULL || !handle->watch_hit_valid)
+        return false;
+
+    *hit = handle->watch_hit;
+
+    return true;
+}
+
+void debug_clear_breakpoint(debug_t handle, debug_breakpoint_t breakpoint_handle)
+{
+    bool watchpoint;
 
     if(handle == NULL || breakpoint_handle >= MAX_BREAKPOINTS)
         return;
 
+    watchpoint = handle->breakpoints[breakpoint_handle].used && handle->breakpoints[breakpoint_handle].watch_ops != 0;
+
     handle->breakpoints[breakpoint_handle].used = false;
     handle->breakpoints[breakpoint_handle].label = NULL;
     handle->breakpoints[breakpoint_handle].sym_valid = false;
+    handle->breakpoints[breakpoint_handle].watch_ops = 0;
+    free(handle->breakpoints[breakpoint_handle].shadow);
+    handle->breakpoints[breakpoint_handle].shadow = NULL;
+
+    if(watchpoint)
+        dbg_update_watch_pages(handle);
 }
 
 void debug_get_breakpoints(debug_t handle, unsigned int *num_breakpoints, breakpoint_info_t *breakpoints, unsigned int *total_breakpoints)
@@ -330,6 +677,9 @@ void debug_get_breakpoints(debug_t handle, unsigned int *num_breakpoints, breakp
             {
                 breakpoints[out_index].address = handle->breakpoints[index].addr;
                 breakpoints[out_index].handle = (debug_breakpoint_t)index;
+                breakpoints[out_index].watch_ops = handle->breakpoints[index].watch_ops;
+                breakpoints[out_index].end_address = handle->breakpoints[index].watch_ops != 0 ?
+                    handle->breakpoints[index].addr_end : handle->breakpoints[index].addr;
 
                 if(handle->breakpoints[index].label != NULL)
                 {
@@ -360,17 +710,24 @@ bool debug_next(debug_t handle, debug_breakpoint_t *breakpoint_hit)
     if(handle == NULL)
         return false;
 
+    handle->watch_pending = false;
+    handle->watch_hit_valid = false;
+
+    dbg_clear_break(handle);
+
     if(cpu_is_subroutine(handle->emu))
     {
         pc = handle->emu->cpu.regs.pc;
         next_pc = pc + 3;
 
-        handle->sw_break = false;
-        while(!handle->sw_break && next_pc != CPU_GET_REG(handle->emu, pc))
+        debug_process_commands(handle);
+
+        while(!dbg_break_requested(handle) && next_pc != CPU_GET_REG(handle->emu, pc))
         {
             debug_step_i(handle);
+            dbg_check_commands(handle);
 
-            if(dbg_eval_breakpoints(handle, pc, breakpoint_hit))
+            if(dbg_eval_watchpoints(handle, breakpoint_hit) || dbg_eval_breakpoints(handle, pc, breakpoint_hit))
             {
                 return true;
             }
@@ -380,6 +737,8 @@ bool debug_next(debug_t handle, debug_breakpoint_t *breakpoint_hit)
 
         if(handle->sw_break)
         {
+            handle->sw_break = false;
+
             if(breakpoint_hit)
                 *breakpoint_hit = BREAKPOINT_HANDLE_SW_REQUEST;
 
@@ -387,8 +746,13 @@ bool debug_next(debug_t handle, debug_breakpoint_t *breakpoint_hit)
         }
     }
     else
+    {
         debug_step_i(handle);
 
+        if(dbg_eval_watchpoints(handle, breakpoint_hit))
+            return true;
+    }
+
     return false;
 }
 
@@ -398,6 +762,10 @@ void debug_step(debug_t handle)
         return;
 
     debug_step_i(handle);
+
+    /* The step stops regardless, so a watchpoint hit needs no reporting. */
+    handle->watch_pending = false;
+    handle->watch_hit_valid = false;
 }
 
 void debug_run(debug_t handle, debug_breakpoint_t *breakpoint_hit)
@@ -405,9 +773,13 @@ void debug_run(debug_t handle, debug_breakpoint_t *breakpoint_hit)
     if(handle == NULL)
         return;
 
-    handle->sw_break = false;
+    dbg_clear_break(handle);
+    handle->watch_pending = false;
+    handle->watch_hit_valid = false;
+
+    debug_process_commands(handle);
 
-    while(!handle->sw_break)
+    while(!dbg_break_requested(handle))
     {
         if(dbg_eval_breakpoints(handle, CPU_GET_REG(handle->emu, pc), breakpoint_hit))
         {
@@ -416,19 +788,170 @@ void debug_run(debug_t handle, debug_breakpoint_t *breakpoint_hit)
         else
         {
             debug_step_i(handle);
+
+            if(dbg_eval_watchpoints(handle, breakpoint_hit))
+                return;
+
+            dbg_check_commands(handle);
         }
     }
 
-    if(handle->sw_break && breakpoint_hit)
+    /* Consume the break, so it can't also end a later run slice. */
+    handle->sw_break = false;
+
+    if(breakpoint_hit)
         *breakpoint_hit = BREAKPOINT_HANDLE_SW_REQUEST;
 }
 
+bool debug_run_slice(debug_t handle, uint64_t cycles, debug_breakpoint_t *breakpoint_hit)
+{
+    uint64_t end;
+    bool stopped;
+
+    if(handle == NULL)
+        return false;
+
+    handle->watch_pending = false;
+    handle->watch_hit_valid = false;
+
+    debug_process_commands(handle);
+
+    end = handle->emu->cpu.cycles + cycles;
+
+    while(!handle->sw_break && !atomic_load_explicit(&handle->emu->stop, memory_order_relaxed) &&
+          handle->emu->cpu.cycles < end)
+    {
+        if(dbg_eval_breakpoints(handle, CPU_GET_REG(handle->emu, pc), breakpoint_hit))
+        {
+            emu_raise_events(handle->emu, EMU_EVENT_SLICE | EMU_EVENT_BREAK);
+            return true;
+        }
+
+        debug_step_i(handle);
+
+        if(dbg_eval_watchpoints(handle, breakpoint_hit))
+        {
+            emu_raise_events(handle->emu, EMU_EVENT_SLICE | EMU_EVENT_BREAK);
+            return true;
+        }
+
+        dbg_check_commands(handle);
+    }
+
+    /* Consume any break or stop, including one requested before the slice started. */
+    stopped = atomic_exchange_explicit(&handle->emu->stop, false, memory_order_relaxed);
+
+    if(handle->sw_break || stopped)
+    {
+        handle->sw_break = false;
+        emu_raise_events(handle->emu, EMU_EVENT_SLICE | EMU_EVENT_BREAK);
+
+        if(breakpoint_hit)
+            *breakpoint_hit = BREAKPOINT_HANDLE_SW_REQUEST;
+
+        return true;
+    }
+
+    emu_raise_events(handle->emu, EMU_EVENT_SLICE);
+
+    return false;
+}
+
 void debug_break(debug_t handle)
 {
     if(handle != NULL)
         handle->sw_break = true;
 }
 
+bool debug_post(debug_t handle, debug_cmd_fn_t fn, void *userdata)
+{
+    dbg_cmd_t *cmd;
+
+    if(handle == NULL || fn == NULL)
+        return false;
+
+    cmd = malloc(sizeof(dbg_cmd_t));
+
+    if(cmd == NULL)
+        return false;
+
+    cmd->fn = fn;
+    cmd->userdata = userdata;
+    cmd->async = true;
+    cmd->done = false;
+
+    dbg_push_cmd(handle, cmd);
+    os_notify_set(handle->cmd_notify);
+
+    return true;
+}
+
+bool debug_call(debug_t handle, debug_cmd_fn_t fn, void *userdata)
+{
+    dbg_cmd_t cmd;
+
+    if(handle == NULL || fn == NULL)
+        return false;
+
+    cmd.fn = fn;
+    cmd.userdata = userdata;
+    cmd.async = false;
+    cmd.done = false;
+
+    dbg_push_cmd(handle, &cmd);
+    os_notify_set(handle->cmd_notify);
+
+    pthread_mutex_lock(&handle->cmd_lock);
+
+    while(!cmd.done)
+    {
+        pthread_cond_wait(&handle->cmd_done, &handle->cmd_lock);
+    }
+
+    pthread_mutex_unlock(&handle->cmd_lock);
+
+    return true;
+}
+
+void debug_process_commands(debug_t handle)
+{
+    dbg_cmd_t *cmd;
+
+    if(handle == NULL)
+        return;
+
+    /* Clear the notifier before taking the commands. Commands posted in between then set it
+     * again, so none are left waiting without it being readable. */
+    os_notify_clear(handle->cmd_notify);
+
+    while((cmd = dbg_pop_cmd(handle)) != NULL)
+    {
+        cmd->fn(handle, cmd->userdata);
+
+        if(cmd->async)
+        {
+            free(cmd);
+        }
+        else
+        {
+            /* The waiter can't return, and take the command off its stack, until the lock is
+             * released. */
+            pthread_mutex_lock(&handle->cmd_lock);
+            cmd->done = true;
+            pthread_cond_broadcast(&handle->cmd_done);
+            pthread_mutex_unlock(&handle->cmd_lock);
+        }
+    }
+}
+
+int debug_get_command_fd(debug_t handle)
+{
+    if(handle == NULL)
+        return -1;
+
+    return os_notify_fd(handle->cmd_notify);
+}
+
 bool debug_finish(debug_t handle, debug_breakpoint_t *breakpoint_hit)
 {
     uint8_t opcode;
@@ -439,7 +962,13 @@ bool debug_finish(debug_t handle, debug_breakpoint_t *breakpoint_hit)
     if(handle == NULL)
         return false;
 
-    while(!is_ret && !handle->sw_break)
+    dbg_clear_break(handle);
+    handle->watch_pending = false;
+    handle->watch_hit_valid = false;
+
+    debug_process_commands(handle);
+
+    while(!is_ret && !dbg_break_requested(handle))
     {
         pc = CPU_GET_REG(handle->emu, pc);
 
@@ -467,11 +996,22 @@ bool debug_finish(debug_t handle, debug_breakpoint_t *breakpoint_hit)
         }
 
         debug_step_i(handle);
+
+        if(dbg_eval_watchpoints(handle, breakpoint_hit))
+        {
+            return true;
+        }
+
+        dbg_check_commands(handle);
     }
 
-    if(handle->sw_break && breakpoint_hit != NULL)
+    if(handle->sw_break)
     {
-        *breakpoint_hit = BREAKPOINT_HANDLE_SW_REQUEST;
+        handle->sw_break = false;
+
+        if(breakpoint_hit != NULL)
+            *breakpoint_hit = BREAKPOINT_HANDLE_SW_REQUEST;
+
         return true;
     }
 
@@ -571,3 +1111,36 @@ void debug_dump(debug_t handle, uint16_t addr, uint16_t *len, uint8_t *buffer)
 
     *len = (uint16_t)(end_addr - addr);
 }
+
+/**
+ * Dumps a section of the emulator memory space using the debugger, copying pages of memory
+ * devices directly rather than peeking each address. The result is the same as debug_dump for
+ * devices whose peeks return the contents of their memory.
+ *
+ * @param[in] handle    The debugger handle.
+ * @param[in] addr      The base address to begin the dump at.
+ * @param[in,out] len   As input, the length of memory data to dump from the base address.
+ *                      On output, the amount of data actually copied into the buffer.
+ * @param[out] buffer   Buffer to dump the memory data into.
+ */
+void debug_dump_fast(debug_t handle, uint16_t addr, uint16_t *len, uint8_t *buffer)
+{
+    uint32_t end_addr;
+
+    if((handle == NULL) || (len == NULL) || (*len == 0) || (buffer == NULL))
+    {
+        return;
+    }
+
+    end_addr = (uint32_t)addr + (uint32_t)*len;
+
+    /* Limit end_addr if len was too big and it rolled over. */
+    if(end_addr > 0x10000)
+    {
+        end_addr = 0x10000;
+    }
+
+    bus_peek_range(handle->emu, addr, end_addr - addr, buffer);
+
+    *len = (uint16_t)(end_addr - addr);
+}
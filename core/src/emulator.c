@@ -7,6 +7,7 @@
 #include "bus_priv.h"
 #include "clock_priv.h"
 #include "cpu_priv.h"
+#include "snapshot_priv.h"
 
 static void main_clock_handler(clk_t clk, clock_edge_t edge, void *userdata)
 {
@@ -20,7 +21,8 @@ cbemu_t emu_init(const emu_config_t *config)
     cbemu_t emu;
     bool initst;
 
-    if(config == NULL)
+    /* The cycle-accurate engine is the only one so far. */
+    if((config == NULL) || (config->cpu_engine != CPU_ENGINE_CYCLE))
     {
         return NULL;
     }
@@ -31,6 +33,8 @@ cbemu_t emu_init(const emu_config_t *config)
 
     if(emu != NULL)
     {
+        list_init(&emu->snapshot_hooks);
+
         initst = bus_init(emu);
 
         if(initst)
@@ -39,6 +43,15 @@ cbemu_t emu_init(const emu_config_t *config)
         if(initst)
             initst = cpu_init(emu);
 
+        /* The core's own state is saved ahead of any device. */
+        if(initst)
+            initst = (snapshot_register(emu, "clock", clock_snapshot_save, clock_snapshot_restore, emu) != NULL) &&
+                     (snapshot_register(emu, "bus", bus_snapshot_save, bus_snapshot_restore, emu) != NULL) &&
+                     (snapshot_register(emu, "cpu", cpu_snapshot_save, cpu_snapshot_restore, emu) != NULL);
+
+        atomic_init(&emu->events, 0);
+        atomic_init(&emu->stop, false);
+
         if(!initst)
         {
             emu_cleanup(emu);
@@ -58,6 +71,9 @@ void emu_cleanup(cbemu_t emu)
 
     bus_cleanup(emu);
     clock_cleanup(emu);
+    cpu_cleanup(emu);
+    os_notify_destroy(emu->notify);
+    snapshot_free_hooks(emu);
 
     free(emu);
 }
@@ -73,3 +89,86 @@ void emu_tick(cbemu_t emu)
      * handler back to tick the internal components. */
     clock_main_tick(emu);
 }
+
+uint64_t emu_run_slice(cbemu_t emu, uint64_t cycles)
+{
+    uint64_t ran = 0;
+
+    if(emu == NULL)
+    {
+        return 0;
+    }
+
+    while(ran < cycles && !atomic_load_explicit(&emu->stop, memory_order_relaxed))
+    {
+        clock_main_tick(emu);
+        ++ran;
+    }
+
+    /* Consume the stop, so one posted before the slice ends it straight away rather than being lost. */
+    atomic_exchange_explicit(&emu->stop, false, memory_order_relaxed);
+
+    emu_raise_events(emu, EMU_EVENT_SLICE);
+
+    return ran;
+}
+
+void emu_stop(cbemu_t emu)
+{
+    if(emu == NULL)
+    {
+        return;
+    }
+
+    atomic_store_explicit(&emu->stop, true, memory_order_relaxed);
+    emu_raise_events(emu, EMU_EVENT_BREAK);
+}
+
+int emu_get_event_fd(cbemu_t emu)
+{
+    if(emu == NULL)
+    {
+        return -1;
+    }
+
+    if(emu->notify == NULL)
+    {
+        emu->notify = os_notify_create();
+
+        /* Catch up with anything raised before there was a notifier. */
+        if(atomic_load_explicit(&emu->events, memory_order_acquire) != 0)
+        {
+            os_notify_set(emu->notify);
+        }
+    }
+
+    return os_notify_fd(emu->notify);
+}
+
+uint32_t emu_get_events(cbemu_t emu)
+{
+    if(emu == NULL)
+    {
+        return 0;
+    }
+
+    /* Clear the notifier before taking the events. Events raised in between then set it again,
+     * so none are left pending without it being readable. */
+    os_notify_clear(emu->notify);
+
+    return atomic_exchange_explicit(&emu->events, 0, memory_order_acq_rel);
+}
+
+void emu_raise_events(cbemu_t emu, uint32_t events)
+{
+    if(emu == NULL || events == 0)
+    {
+        return;
+    }
+
+    /* Only the first events raised since they were last taken need to set the notifier. */
+    if(atomic_fetch_or_explicit(&emu->events, events, memory_order_acq_rel) == 0)
+    {
+        os_notify_set(emu->notify);
+    }
+}
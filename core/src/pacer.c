@@ -0,0 +1,290 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pacer.h"
+#include "clock.h"
+#include "emu_priv_types.h"
+#include "os_time.h"
+
+#define NS_PER_US   1000ULL
+#define NS_PER_SEC  1000000000ULL
+
+/**
+ * Pacer instance
+ */
+struct pacer_s
+{
+    cbemu_t emu;                /**< The emulator being paced */
+    clock_sync_handle_t sync;   /**< Sync handler on the main clock, called at the end of each slice */
+    unsigned int turbo;         /**< Speed multiplier, or 0 when not pacing */
+    uint64_t slice_cycles;      /**< Main clock cycles per slice */
+    uint64_t divisor;           /**< Divisor converting cycles to wall-clock ns at the current speed */
+    uint64_t remainder;         /**< Fraction of a ns carried between slices, over divisor */
+    uint64_t deadline;          /**< Wall-clock time at which the current slice should end */
+    uint64_t catchup_ns;        /**< Catch-up limit */
+    bool anchoring;             /**< Indicates elapsed cycles are being discarded */
+    int wait_fd;                /**< File descriptor that ends a sleep early when readable, or -1 */
+    bool woken;                 /**< Indicates the last sleep was ended early by wait_fd */
+    pacer_stats_t stats;        /**< Pacing statistics */
+};
+
+/**
+ * Moves the deadline on by the wall-clock time of a number of main clock cycles. The time is
+ * kept exact by carrying the fraction of a ns from one slice to the next.
+ *
+ * @param[in] handle    The pacer instance
+ * @param[in] cycles    Number of main clock cycles
+ */
+static void pacer_advance(pacer_t handle, uint64_t cycles)
+{
+    clk_t clk = handle->emu->clk.mainClk;
+    uint64_t scaled;
+
+    /* Each cycle lasts freq_den / freq_num seconds, divided by the speed multiplier. */
+    scaled = cycles * NS_PER_SEC * clk->freq_den;
+
+    handle->deadline += scaled / handle->divisor;
+    handle->remainder += scaled % handle->divisor;
+
+    if(handle->remainder >= handle->divisor)
+    {
+        handle->deadline++;
+        handle->remainder -= handle->divisor;
+    }
+}
+
+/**
+ * Sync handler called at the end of each slice, which sleeps until wall-clock time catches up.
+ *
+ * @param[in] clk       The main clock
+ * @param[in] cycles    Number of cycles since the last slice
+ * @param[in] userdata  The pacer instance
+ */
+static void pacer_sync_cb(clk_t clk, uint64_t cycles, void *userdata)
+{
+    pacer_t handle = (pacer_t)userdata;
+    uint64_t now;
+    bool woken = false;
+
+    if(handle->anchoring || handle->turbo == 0)
+    {
+        return;
+    }
+
+    pacer_advance(handle, cycles);
+    handle->stats.slices++;
+
+    now = os_time_ns();
+
+    if(now < handle->deadline)
+    {
+        /* Input ends the sleep early, so it is seen by the emulator without waiting out the slice.
+         * That puts the emulator ahead of wall-clock time by up to a slice, so the following
+         * sleep runs to its deadline regardless, to stop input that is left unread from letting
+         * the emulator run away. */
+        if(handle->wait_fd >= 0 && !handle->woken)
+        {
+            woken = os_wait_fd_until_ns(handle->wait_fd, handle->deadline);
+        }
+        else
+        {
+            os_sleep_until_ns(handle->deadline);
+        }
+
+        if(woken)
+        {
+            handle->stats.woken_slices++;
+            handle->stats.slept_ns += os_time_ns() - now;
+        }
+        else
+        {
+            handle->stats.slept_ns += handle->deadline - now;
+        }
+    }
+    else
+    {
+        handle->stats.late_slices++;
+
+        if(now - handle->deadline > handle->catchup_ns)
+        {
+            handle->stats.dropped_ns += now - handle->deadline - handle->catchup_ns;
+            handle->deadline = now - handle->catchup_ns;
+        }
+    }
+
+    handle->woken = woken;
+
+    clock_sync_schedule(handle->sync, handle->slice_cycles);
+}
+
+/**
+ * Creates a pacer for an emulator, running it at real time from now on.
+ *
+ * @param[in] emulator  The emulator instance to pace.
+ * @param[in] slice_us  Length of a slice of emulated time in microseconds, or 0 for the default.
+ *
+ * @return The pacer instance, or NULL if there was an error.
+ */
+pacer_t pacer_init(cbemu_t emulator, uint32_t slice_us)
+{
+    pacer_t handle;
+    clk_t clk;
+
+    if(emulator == NULL)
+    {
+        return NULL;
+    }
+
+    handle = malloc(sizeof(struct pacer_s));
+
+    if(handle == NULL)
+    {
+        return NULL;
+    }
+
+    memset(handle, 0, sizeof(struct pacer_s));
+
+    if(slice_us == 0)
+    {
+        slice_us = PACER_DEFAULT_SLICE_US;
+    }
+
+    clk = clock_get_core_clk(emulator);
+
+    handle->emu = emulator;
+    handle->wait_fd = -1;
+    handle->catchup_ns = PACER_DEFAULT_CATCHUP_US * NS_PER_US;
+    handle->slice_cycles = ((uint64_t)clock_get_freq(clk) * slice_us) / (NS_PER_SEC / NS_PER_US);
+
+    if(handle->slice_cycles == 0)
+    {
+        handle->slice_cycles = 1;
+    }
+
+    handle->sync = clock_register_sync(clk, pacer_sync_cb, handle);
+
+    if(handle->sync == NULL)
+    {
+        free(handle);
+        return NULL;
+    }
+
+    pacer_set_turbo(handle, 1);
+
+    return handle;
+}
+
+/**
+ * Stops pacing and frees a pacer.
+ *
+ * @param[in] handle    The pacer handle.
+ */
+void pacer_cleanup(pacer_t handle)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    clock_unregister_sync(handle->sync);
+    free(handle);
+}
+
+/**
+ * Sets the speed of the emulator as a multiple of real time.
+ *
+ * @param[in] handle        The pacer handle.
+ * @param[in] multiplier    Speed multiplier, or 0 to run without pacing.
+ */
+void pacer_set_turbo(pacer_t handle, unsigned int multiplier)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    handle->turbo = multiplier;
+    handle->divisor = handle->emu->clk.mainClk->freq_num * multiplier;
+
+    pacer_resync(handle);
+}
+
+/**
+ * Sets how far behind wall-clock time the emulator may fall before the difference is dropped.
+ *
+ * @param[in] handle    The pacer handle.
+ * @param[in] limit_us  The catch-up limit in microseconds.
+ */
+void pacer_set_catchup(pacer_t handle, uint32_t limit_us)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    handle->catchup_ns = (uint64_t)limit_us * NS_PER_US;
+}
+
+/**
+ * Sets a file descriptor to wait on while sleeping, such as one that becomes readable when input
+ * arrives for the emulated system. A sleep ends early when it polls readable, so the input is
+ * handled straight away rather than at the end of the slice.
+ *
+ * @param[in] handle    The pacer handle.
+ * @param[in] fd        The file descriptor, or -1 for none.
+ */
+void pacer_set_wait_fd(pacer_t handle, int fd)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    handle->wait_fd = fd;
+    handle->woken = false;
+}
+
+/**
+ * Restarts pacing from the current time, without catching up on any time that has passed. This
+ * should be called when the emulator resumes after being deliberately paused.
+ *
+ * @param[in] handle    The pacer handle.
+ */
+void pacer_resync(pacer_t handle)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    /* Discard the cycles run so far, so the next slice starts now. */
+    handle->anchoring = true;
+    clock_sync(handle->sync);
+    handle->anchoring = false;
+
+    handle->deadline = os_time_ns();
+    handle->remainder = 0;
+    handle->woken = false;
+
+    clock_sync_schedule(handle->sync, (handle->turbo == 0) ? 0 : handle->slice_cycles);
+}
+
+/**
+ * Gets the pacing statistics.
+ *
+ * @param[in] handle    The pacer handle.
+ * @param[out] stats    Filled in with the statistics.
+ */
+void pacer_get_stats(pacer_t handle, pacer_stats_t *stats)
+{
+    if(handle == NULL || stats == NULL)
+    {
+        return;
+    }
+
+    *stats = handle->stats;
+}
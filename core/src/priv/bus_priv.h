@@ -2,6 +2,7 @@
 #define __BUS_PRIV_H__
 
 #include "emu_priv_types.h"
+#include "snapshot.h"
 
 /**
  * Internal function to initialize a bus instance
@@ -45,6 +46,16 @@ uint8_t bus_read(cbemu_t emu, uint16_t addr);
  */
 uint8_t bus_sync_read(cbemu_t emu, uint16_t addr);
 
+/**
+ * Internal bus access function to perform a bus read operation whose value is discarded by the
+ * CPU, such as the extra reads made during indexing or stack operations. This is a committed
+ * read operation, but is flagged as DUMMY so monitors can ignore it.
+ *
+ * @param[in] emu   Emulator context
+ * @param[in] addr  Address to read on the bus
+ */
+void bus_dummy_read(cbemu_t emu, uint16_t addr);
+
 /**
  * Internal bus access function to read from a given address without actually committing a read
  * operation (PHI2 tick). This is can be useful for debugging or poking the state of the system
@@ -58,6 +69,33 @@ uint8_t bus_sync_read(cbemu_t emu, uint16_t addr);
  */
 uint8_t bus_peek(cbemu_t emu, uint16_t addr);
 
+/**
+ * Internal bus access function to peek a range of addresses. The decode is resolved once per
+ * page, and pages decoded entirely by a connection with direct access are copied from its
+ * buffer. Other pages are peeked a byte at a time.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] addr      First address to peek
+ * @param[in] len       Number of bytes to peek. The range must not extend past 0xFFFF.
+ * @param[out] buffer   Buffer to populate with the peeked values
+ */
+void bus_peek_range(cbemu_t emu, uint16_t addr, uint32_t len, uint8_t *buffer);
+
+/**
+ * Internal bus access function to poke a range of addresses, changing the contents of memory
+ * without performing bus writes. Only pages decoded entirely by a connection with direct access
+ * can be poked, and the rest of the range is skipped. Pokes bypass any write protection of the
+ * device, such as for ROM.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] addr      First address to poke
+ * @param[in] len       Number of bytes to poke. The range must not extend past 0xFFFF.
+ * @param[in] buffer    Values to poke
+ *
+ * @return The number of bytes poked.
+ */
+uint32_t bus_poke_range(cbemu_t emu, uint16_t addr, uint32_t len, const uint8_t *buffer);
+
 /**
  * Internal bus access function to perfrom a write operation. This will attempt
  * to decode the address and write the given value to the appropriate bus connection.
@@ -75,4 +113,68 @@ void bus_write(cbemu_t emu, uint16_t addr, uint8_t value);
  */
 void bus_replay(cbemu_t emu);
 
+/**
+ * Sets the bus monitor. Only a single monitor may be set at a time.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] monitor   The monitor callback, or NULL to clear it.
+ * @param[in] userdata  Userdata supplied to the callback.
+ *
+ * @return true if the monitor was set, or false if another monitor is already set.
+ */
+bool bus_set_monitor(cbemu_t emu, bus_monitor_cb_t monitor, void *userdata);
+
+/**
+ * Enables or disables monitoring for a range of pages.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] first     The first page to update.
+ * @param[in] last      The last page to update (inclusive).
+ * @param[in] enable    Indicates whether monitoring should be enabled or disabled.
+ */
+void bus_monitor_pages(cbemu_t emu, uint8_t first, uint8_t last, bool enable);
+
+/**
+ * Sets the bus watch. Only a single watch may be set at a time.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] watch     The watch callback, or NULL to clear it.
+ * @param[in] userdata  Userdata supplied to the callback.
+ *
+ * @return true if the watch was set, or false if another watch is already set.
+ */
+bool bus_set_watch(cbemu_t emu, bus_watch_cb_t watch, void *userdata);
+
+/**
+ * Enables or disables watching for a range of pages.
+ *
+ * @param[in] emu       Emulator context
+ * @param[in] first     The first page to update.
+ * @param[in] last      The last page to update (inclusive).
+ * @param[in] enable    Indicates whether watching should be enabled or disabled.
+ */
+void bus_watch_pages(cbemu_t emu, uint8_t first, uint8_t last, bool enable);
+
+/**
+ * Snapshot hook saving the signal votes and last operation of the bus.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] userdata  Emulator context
+ *
+ * @return true if the state was written
+ */
+bool bus_snapshot_save(snapshot_t snap, void *userdata);
+
+/**
+ * Snapshot hook restoring the signal votes and last operation of the bus. Signal watchers are told
+ * about each signal the restore asserts or deasserts. The cached results of dynamic decoders are
+ * discarded, as the devices they depend on are restored too.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[in] userdata  Emulator context
+ *
+ * @return true if the state was read and matches the registered voters
+ */
+bool bus_snapshot_restore(snapshot_t snap, void *userdata);
+
 #endif /* end of include guard: __BUS_PRIV_H__ */
@@ -29,14 +29,65 @@ typedef struct
     bus_sv_flags_t flags; /**< Additional boolean flags for the votes context. */
 } bus_sigvotes_t;
 
+/** Number of 256 byte pages in the address space. */
+#define BUS_NUM_PAGES   0x100
+
+/** Flags for each page of the bus decode table. */
+typedef enum
+{
+    BUS_PAGE_MONITOR = 0x01, /**< Accesses to the page are reported to the bus monitor. */
+    BUS_PAGE_WATCH = 0x02,   /**< Accesses to the page are reported to the bus watch. */
+} bus_page_flags_t;
+
+/** Per-page decode information. */
+typedef struct
+{
+    uint8_t flags;      /**< Combination of bus_page_flags_t. */
+    uint16_t tracers;   /**< Number of tracers whose filter includes the page. */
+} bus_page_t;
+
+/**
+ * Bus monitor callback. Unlike tracers, the monitor is only called for pages that have been
+ * flagged with BUS_PAGE_MONITOR, and is called before the access is performed.
+ *
+ * @param[in] addr      Address of the operation.
+ * @param[in] value     Value being written, or 0 for reads.
+ * @param[in] write     Indicates whether the operation is a read or write operation.
+ * @param[in] flags     Flags for the operation.
+ * @param[in] userdata  Userdata supplied when the monitor was set.
+ */
+typedef void (*bus_monitor_cb_t)(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata);
+
+/**
+ * Bus watch callback. Like the monitor, the watch is only called for pages that have been
+ * flagged, in this case with BUS_PAGE_WATCH, but it is called once the access has been performed
+ * so the value read is known.
+ *
+ * @param[in] addr      Address of the operation.
+ * @param[in] value     Value read or written.
+ * @param[in] write     Indicates whether the operation is a read or write operation.
+ * @param[in] flags     Flags for the operation.
+ * @param[in] userdata  Userdata supplied when the watch was set.
+ */
+typedef void (*bus_watch_cb_t)(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata);
+
 /** Internal Bus context structure */
 typedef struct bus_s
 {
     bool init;              /**< Indicates if the bus context has been initialized. */
     listnode_t connlist;    /**< List of registered bus connections. */
     listnode_t tracelist;   /**< List of regisrered trace callbacks. */
+    listnode_t siglist;     /**< List of registered signal watcher callbacks. */
     bus_sigvotes_t sigvotes; /**< Information regarding external signal voting. */
     bus_op_t lastop; /**< Tracks the list bus operation performed. */
+    bus_page_t pages[BUS_NUM_PAGES]; /**< Per-page decode table. */
+    bus_monitor_cb_t monitor; /**< Monitor called for flagged pages, or NULL. */
+    void *monitor_data; /**< Userdata for the monitor callback. */
+    bus_watch_cb_t watch; /**< Watch called for flagged pages, or NULL. */
+    void *watch_data; /**< Userdata for the watch callback. */
+    uint8_t shared[0x10000 / 8]; /**< Bitmap of addresses that more than one connection may decode. */
+    bool counting; /**< Indicates whether accesses are being counted. */
+    bus_counters_t counters[BUS_NUM_PAGES]; /**< Per-page access counts. */
 } bus_t;
 
 #endif /* end of include guard: __BUS_PRIV_TYPES_H__ */
@@ -3,6 +3,7 @@
 
 #include "clock_priv_types.h"
 #include "clock.h"
+#include "snapshot.h"
 
 /**
  * Initializes the clock module
@@ -32,4 +33,33 @@ void clock_cleanup(cbemu_t emu);
  */
 void clock_main_tick(cbemu_t emu);
 
+/**
+ * Brings every device registered with a sync handler, on any clock, up to date.
+ *
+ * @param[in] emu   The main emulator context.
+ */
+void clock_sync_all(cbemu_t emu);
+
+/**
+ * Snapshot hook saving the phase of every clock.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] userdata  The main emulator context.
+ *
+ * @return true if the state was written.
+ */
+bool clock_snapshot_save(snapshot_t snap, void *userdata);
+
+/**
+ * Snapshot hook restoring the phase of every clock. Pending sync deadlines keep their distance
+ * from the last synchronization, which becomes the restored point in time.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[in] userdata  The main emulator context.
+ *
+ * @return true if the snapshot holds a valid state for exactly the clocks of the emulator. The
+ *         clocks are left unchanged otherwise.
+ */
+bool clock_snapshot_restore(snapshot_t snap, void *userdata);
+
 #endif /* end of include guard: __CLOCK_PRIV_H__ */
@@ -12,19 +12,57 @@ typedef struct
     clock_tick_cb_t callback;   /**< Callback function */
     void *userdata;             /**< App specific user data */
     clock_edge_t edges;         /**< Clock edges registered for this callback. */
+    clk_t clk;                  /**< Clock the callback is registered with. */
+    bool suspended;             /**< Indicates the callback is on the suspended list. */
     listnode_t node;            /**< List entry node */
 } clk_cb_entry_t;
 
+/**
+ * Tracking structure for registered sync handlers.
+ */
+typedef struct
+{
+    clock_sync_cb_t callback;   /**< Catch-up function */
+    void *userdata;             /**< App specific user data */
+    clk_t clk;                  /**< Clock followed by the handler */
+    uint64_t last;              /**< Clock cycle count at the last synchronization */
+    uint64_t deadline;          /**< Clock cycle count of the scheduled synchronization */
+    listnode_t node;            /**< List entry node */
+} clk_sync_entry_t;
+
+/** Deadline of a sync handler with nothing scheduled. */
+#define CLOCK_SYNC_NONE UINT64_MAX
+
+/**
+ * State of a clock read from a snapshot, held until the whole snapshot has been checked.
+ */
+typedef struct
+{
+    clk_t clk;                  /**< Clock the state belongs to */
+    uint64_t ticks;             /**< Remaining timebase units of the clock phase */
+    bool cur_phase;             /**< Next edge of the clock */
+    uint64_t cycles;            /**< Active edges of the clock so far */
+} clk_snapshot_rec_t;
+
 /**
  * Tracking structure for registerd clocks
  */
 struct clk_s
 {
-    clk_freq_t freq;            /**< Frequency of the clock */
-    clk_period_t period;        /**< Period of the clock (in ns) */
-    clk_period_t ticks;         /**< Remaining ns of the clock phase before it ticks */
+    clk_freq_t freq;            /**< Frequency of the clock, rounded to the nearest Hz */
+    clk_period_t period;        /**< Period of the clock (in ns), rounded to the nearest ns */
+    uint64_t freq_num;          /**< Numerator of the exact frequency of the clock in Hz */
+    uint64_t freq_den;          /**< Denominator of the exact frequency of the clock in Hz */
+    uint64_t phase;             /**< Length of each phase of the clock, in timebase units */
+    uint64_t ticks;             /**< Remaining timebase units of the clock phase before it ticks */
     bool cur_phase;             /**< Indicates whether the next edge is inactive (false) or active (true). */
     listnode_t callbacks;       /**< List head for registered callbacks. */
+    listnode_t suspended;       /**< List head for registered callbacks that are suspended. */
+    listnode_t *next_cb;        /**< Next callback to be called while callbacks are being made. */
+    uint64_t cycles;            /**< Number of active edges of the clock so far. */
+    uint64_t deadline;          /**< Earliest deadline of the registered sync handlers. */
+    listnode_t syncs;           /**< List head for registered sync handlers. */
+    uint32_t id;                /**< Identifies the clock in snapshots. The main clock is 0. */
     listnode_t node;            /**< List entry node */
 };
 
@@ -36,7 +74,10 @@ typedef struct clk_cxt_s
     bool init;          /**< Indicates if the clock context has been initialized. */
     listnode_t clks;    /**< List head for registered clocks list. This is always sorted for lowest to highest remaining ticks. */
     clk_t mainClk;      /**< Main bus clock */
+    uint64_t timebase;  /**< Multiple of every clock's frequency numerator. Scheduling is done in units
+                             of 1/(2 * timebase) seconds, which divide every clock phase exactly. */
     clock_tick_cb_t main_hlr; /**< Internal handler for main clock ticks. */
+    uint32_t last_id;   /**< Id given to the most recently added clock. */
 } clk_cxt_t;
 
 #endif /* end of include guard: __CLOCK_PRIV_TYPES__ */
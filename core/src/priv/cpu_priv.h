@@ -2,6 +2,7 @@
 #define __CPU_PRIV_H__
 
 #include "emu_priv_types.h"
+#include "snapshot.h"
 
 #define CPU_GET_REG(_emu, _reg)   (_emu)->cpu.regs._reg
 
@@ -10,6 +11,53 @@ void cpu_tick(cbemu_t emu);
 
 bool cpu_is_subroutine(cbemu_t emu);
 
+/**
+ * Registers a hook to be notified of CPU call stack events.
+ *
+ * @param[in] emu       The emulator instance.
+ * @param[in] callback  Callback to invoke on each event.
+ * @param[in] userdata  Userdata passed to the callback.
+ *
+ * @return Handle to the hook, or NULL on failure.
+ */
+cpu_hook_t *cpu_add_hook(cbemu_t emu, cpu_hook_cb_t callback, void *userdata);
+
+/**
+ * Removes a previously registered CPU hook.
+ *
+ * @param[in] emu   The emulator instance.
+ * @param[in] hook  The hook to remove.
+ */
+void cpu_remove_hook(cbemu_t emu, cpu_hook_t *hook);
+
+/**
+ * Releases resources held by the CPU.
+ *
+ * @param[in] emu The emulator instance.
+ */
+void cpu_cleanup(cbemu_t emu);
+
+/**
+ * Snapshot hook saving the registers, execution state and call stack of the CPU.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] userdata  The emulator instance.
+ *
+ * @return true if the state was written.
+ */
+bool cpu_snapshot_save(snapshot_t snap, void *userdata);
+
+/**
+ * Snapshot hook restoring the registers, execution state and call stack of the CPU. The snapshot
+ * must have been saved with the same engine, as the two track instructions in progress differently.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[in] userdata  The emulator instance.
+ *
+ * @return true if the state was read and is valid.
+ */
+bool cpu_snapshot_restore(snapshot_t snap, void *userdata);
+
 /* TODO this is just to enable the tester for now. */
 uint16_t cpu_get_pc(cbemu_t emu);
 bool cpu_is_sync(cbemu_t emu);
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "emu_types.h"
+#include "util.h"
 
 typedef struct
 {
@@ -58,6 +60,80 @@ typedef enum
 }
 cpu_flags_t;
 
+/** Maximum number of nested calls/interrupts tracked by the shadow call stack. */
+#define CPU_CALLSTACK_DEPTH 128
+
+/** Stack pointer value used for frames that can never be returned from (reset). */
+#define CPU_FRAME_SP_BASE 0x100
+
+/** Type of control transfer that created a call stack frame. */
+typedef enum
+{
+    CPU_CALL_JSR,
+    CPU_CALL_BRK,
+    CPU_CALL_NMI,
+    CPU_CALL_RESET,
+    CPU_CALL_IRQ
+} cpu_call_type_t;
+
+/** Shadow call stack frame, tracking a subroutine or interrupt handler invocation. */
+typedef struct
+{
+    uint16_t target;        /**< Entry address of the subroutine or handler. */
+    uint16_t sp;            /**< Stack pointer prior to the return address being pushed. */
+    cpu_call_type_t type;   /**< What created the frame. */
+    uint64_t entry_cycle;   /**< CPU cycle count when the frame was entered. */
+} cpu_call_frame_t;
+
+/** Shadow call stack maintained from JSR/RTS and interrupt entry/RTI. */
+typedef struct
+{
+    uint32_t depth;                                 /**< Number of valid frames. */
+    uint32_t dropped;                               /**< Number of outermost frames discarded due to overflow. */
+    cpu_call_frame_t frames[CPU_CALLSTACK_DEPTH];   /**< Frames, with the innermost at depth-1. */
+} cpu_callstack_t;
+
+/** Events reported to registered CPU hooks. */
+typedef enum
+{
+    CPU_EVENT_CALL,             /**< A frame was pushed onto the call stack. */
+    CPU_EVENT_RETURN,           /**< A frame was popped from the call stack. */
+    CPU_EVENT_STACK_OVERFLOW,   /**< A push wrapped the stack pointer from $00 to $FF. */
+    CPU_EVENT_STACK_UNDERFLOW   /**< A pull wrapped the stack pointer from $FF to $00. */
+} cpu_event_t;
+
+/**
+ * Callback for CPU events.
+ *
+ * @param[in] emu       The emulator instance.
+ * @param[in] event     The event that occurred.
+ * @param[in] frame     The frame that was pushed or popped, or NULL for stack pointer events.
+ * @param[in] userdata  Userdata supplied when the hook was registered.
+ */
+typedef void (*cpu_hook_cb_t)(cbemu_t emu, cpu_event_t event, const cpu_call_frame_t *frame, void *userdata);
+
+/** Registered CPU event hook. */
+typedef struct
+{
+    listnode_t list;
+    cpu_hook_cb_t callback;
+    void *userdata;
+} cpu_hook_t;
+
+/** Size of a bitmap holding one bit per CPU address. */
+#define CPU_COVERAGE_MAP_SIZE   (0x10000 / 8)
+
+/** Coverage bitmaps updated by the CPU while executing. */
+typedef struct
+{
+    uint8_t executed[CPU_COVERAGE_MAP_SIZE];    /**< Addresses an opcode was fetched from. */
+    uint8_t taken[CPU_COVERAGE_MAP_SIZE];       /**< Conditional branches that were taken. */
+    uint8_t not_taken[CPU_COVERAGE_MAP_SIZE];   /**< Conditional branches that were not taken. */
+} cpu_coverage_t;
+
+#define CPU_COVERAGE_SET(_map, _addr)   ((_map)[(_addr) >> 3] |= (uint8_t)(1 << ((_addr) & 0x07)))
+#define CPU_COVERAGE_TEST(_map, _addr)  (((_map)[(_addr) >> 3] & (1 << ((_addr) & 0x07))) != 0)
+
 typedef struct cpu_s
 {
     bool init;
@@ -71,6 +147,11 @@ typedef struct cpu_s
     cpu_vec_src_t vec_src;
     op_state_t op_state;
     cpu_flags_t flags;
+    uint16_t opaddr;            /**< Address the current opcode was fetched from. */
+    uint64_t cycles;            /**< Total number of cycles the CPU has been ticked. */
+    cpu_callstack_t callstack;  /**< Shadow call stack. */
+    listnode_t hooks;           /**< List of registered event hooks. */
+    cpu_coverage_t *coverage;   /**< Coverage bitmaps to update, or NULL if coverage is disabled. */
 } cpu_t;
 
 #define CPU_SET_FLAG(_cpu, _flag)       ((_cpu)->flags |= (_flag))
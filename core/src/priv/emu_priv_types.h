@@ -1,7 +1,10 @@
 #ifndef __EMU_PRIV_TYPES_H__
 #define __EMU_PRIV_TYPES_H__
 
+#include <stdatomic.h>
+
 #include "emu_types.h"
+#include "os_notify.h"
 #include "bus_priv_types.h"
 #include "clock_priv_types.h"
 #include "cpu_priv_types.h"
@@ -12,6 +15,13 @@ struct cbemu_s
     bus_t bus;      /**< The emulator instance's bus instance. */
     clk_cxt_t clk;  /**< The emulator instance's clock context */
     cpu_t cpu;
+    os_notify_t notify;     /**< Notifier that is set while events are pending, created on demand. */
+    atomic_uint events;     /**< Pending emu_event_t flags. */
+    atomic_bool stop;       /**< Requests the current run slice to end early. */
+    listnode_t snapshot_hooks; /**< Registered snapshot hooks, in the order their sections are saved. */
+    uint64_t snapshot_count;   /**< Number of snapshots saved, numbering each. */
+    uint64_t snapshot_seq;     /**< Number of the snapshot last saved or restored, or 0 if there is none
+                                    that deltas can follow. */
 };
 
 #endif /* end of include guard: __EMU_PRIV_TYPES_H__ */
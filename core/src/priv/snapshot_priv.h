@@ -0,0 +1,17 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+#ifndef __SNAPSHOT_PRIV_H__
+#define __SNAPSHOT_PRIV_H__
+
+#include "emu_priv_types.h"
+#include "snapshot.h"
+
+/**
+ * Frees any hooks still registered with an emulator.
+ *
+ * @param[in] emu   The emulator instance
+ */
+void snapshot_free_hooks(cbemu_t emu);
+
+#endif /* end of include guard: __SNAPSHOT_PRIV_H__ */
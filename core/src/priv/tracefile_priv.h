@@ -0,0 +1,38 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+#ifndef __TRACEFILE_PRIV_H__
+#define __TRACEFILE_PRIV_H__
+
+#include "tracefile.h"
+
+/**
+ * Growable array of index blocks, filled in as records are produced.
+ */
+typedef struct
+{
+    tracefile_block_t *blocks;  /**< The blocks, the last of which may be partial. */
+    uint64_t num_blocks;        /**< Number of blocks in use. */
+    uint64_t capacity;          /**< Number of blocks allocated. */
+    uint64_t num_records;       /**< Number of records added. */
+} tracefile_index_t;
+
+/**
+ * Adds records to an index.
+ *
+ * @param[in] index     The index to update.
+ * @param[in] records   The records to add.
+ * @param[in] count     The number of records.
+ *
+ * @return true if the records were added, or false if memory could not be allocated.
+ */
+bool tracefile_index_add(tracefile_index_t *index, const recorder_record_t *records, size_t count);
+
+/**
+ * Frees the memory used by an index.
+ *
+ * @param[in] index     The index to free.
+ */
+void tracefile_index_free(tracefile_index_t *index);
+
+#endif /* end of include guard: __TRACEFILE_PRIV_H__ */
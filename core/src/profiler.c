@@ -0,0 +1,957 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "profiler.h"
+#include "cpu_priv.h"
+
+#define PROFILER_NUM_ADDRS      0x10000
+#define PROFILER_INIT_FUNCS     64
+#define PROFILER_INIT_NODES     256
+
+/** Upper bound on the number of unique call stacks tracked. Deeper unique stacks are folded
+ *  into their parent once this is reached, so memory use is bounded for arbitrarily long runs. */
+#define PROFILER_MAX_NODES      0x40000
+
+#define PROFILER_ROOT_NODE      0
+
+/** Accumulated statistics for a single function. */
+typedef struct
+{
+    uint16_t address;       /**< Entry address of the function. */
+    bool interrupt;         /**< Function has been entered via an interrupt or BRK vector. */
+    uint32_t active;        /**< Number of frames for this function currently on the call stack. */
+    uint64_t entry_cycle;   /**< Entry cycle of the outermost active frame. */
+    uint64_t calls;         /**< Number of times the function was entered. */
+    uint64_t inclusive;     /**< Cycles spent in the function and its callees. */
+    uint64_t exclusive;     /**< Cycles spent in the function itself. */
+} prof_func_t;
+
+/** Calling context tree node, representing a unique call stack. */
+typedef struct
+{
+    uint16_t address;       /**< Entry address of the function at the top of this stack. */
+    uint32_t parent;        /**< Index of the calling node. */
+    uint32_t first_child;   /**< Index of the first callee node, or 0 if none. */
+    uint32_t next_sibling;  /**< Index of the next node with the same parent, or 0 if none. */
+    uint64_t self;          /**< Cycles spent with exactly this call stack. */
+} prof_node_t;
+
+struct profiler_s
+{
+    cbemu_t emu;
+    cpu_hook_t *hook;
+    cc65_dbginfo dbginfo;
+    uint64_t start_cycle;               /**< Cycle profiling was started at. */
+    uint64_t last_cycle;                /**< Cycle exclusive time has been attributed up to. */
+    uint16_t index[PROFILER_NUM_ADDRS]; /**< Function slot for each entry address, 0 if none. */
+    prof_func_t *funcs;                 /**< Function slots. Slot 0 is unused. */
+    uint32_t num_funcs;                 /**< Number of used slots, including slot 0. */
+    uint32_t alloc_funcs;               /**< Number of allocated slots. */
+    prof_node_t *nodes;                 /**< Calling context tree. Node 0 is the root. */
+    uint32_t num_nodes;                 /**< Number of used nodes, including the root. */
+    uint32_t alloc_nodes;               /**< Number of allocated nodes. */
+    uint32_t cur_node;                  /**< Node for the current call stack. */
+    uint32_t node_stack[CPU_CALLSTACK_DEPTH]; /**< Node for each depth of the CPU call stack. */
+    uint32_t dropped;                   /**< Last seen count of call stack overflow drops. */
+};
+
+/**
+ * Looks up the statistics slot for a function, allocating one if needed.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] addr      The entry address of the function.
+ *
+ * @return The function slot, or NULL if one could not be allocated.
+ */
+static prof_func_t *profiler_get_func(profiler_t handle, uint16_t addr)
+{
+    prof_func_t *funcs;
+    uint32_t alloc;
+
+    if(handle->index[addr] != 0)
+    {
+        return &handle->funcs[handle->index[addr]];
+    }
+
+    if(handle->num_funcs == PROFILER_NUM_ADDRS)
+    {
+        return NULL;
+    }
+
+    if(handle->num_funcs == handle->alloc_funcs)
+    {
+        alloc = handle->alloc_funcs * 2;
+
+        if(alloc > PROFILER_NUM_ADDRS)
+        {
+            alloc = PROFILER_NUM_ADDRS;
+        }
+
+        funcs = realloc(handle->funcs, alloc * sizeof(prof_func_t));
+
+        if(funcs == NULL)
+        {
+            return NULL;
+        }
+
+        handle->funcs = funcs;
+        handle->alloc_funcs = alloc;
+    }
+
+    handle->index[addr] = (uint16_t)handle->num_funcs;
+
+    funcs = &handle->funcs[handle->num_funcs++];
+    memset(funcs, 0, sizeof(prof_func_t));
+    funcs->address = addr;
+
+    return funcs;
+}
+
+/**
+ * Looks up the calling context tree node for a call from the given node, allocating one if
+ * needed. If the tree is full, the parent node is returned so the cycles are still accounted.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] parent    Index of the calling node.
+ * @param[in] addr      Entry address of the called function.
+ *
+ * @return Index of the node.
+ */
+static uint32_t profiler_get_node(profiler_t handle, uint32_t parent, uint16_t addr)
+{
+    prof_node_t *nodes;
+    prof_node_t *node;
+    uint32_t index;
+    uint32_t alloc;
+
+    for(index = handle->nodes[parent].first_child; index != 0; index = handle->nodes[index].next_sibling)
+    {
+        if(handle->nodes[index].address == addr)
+        {
+            return index;
+        }
+    }
+
+    if(handle->num_nodes == PROFILER_MAX_NODES)
+    {
+        return parent;
+    }
+
+    if(handle->num_nodes == handle->alloc_nodes)
+    {
+        alloc = handle->alloc_nodes * 2;
+
+        if(alloc > PROFILER_MAX_NODES)
+        {
+            alloc = PROFILER_MAX_NODES;
+        }
+
+        nodes = realloc(handle->nodes, alloc * sizeof(prof_node_t));
+
+        if(nodes == NULL)
+        {
+            return parent;
+        }
+
+        handle->nodes = nodes;
+        handle->alloc_nodes = alloc;
+    }
+
+    index = handle->num_nodes++;
+
+    node = &handle->nodes[index];
+    node->address = addr;
+    node->parent = parent;
+    node->first_child = 0;
+    node->self = 0;
+    node->next_sibling = handle->nodes[parent].first_child;
+    handle->nodes[parent].first_child = index;
+
+    return index;
+}
+
+/**
+ * Attributes all cycles since the last event to the given function and the current call stack.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] addr      Entry address of the function that was executing.
+ */
+static void profiler_charge(profiler_t handle, uint16_t addr)
+{
+    prof_func_t *func = profiler_get_func(handle, addr);
+    uint64_t now = handle->emu->cpu.cycles;
+
+    if(func != NULL)
+    {
+        func->exclusive += now - handle->last_cycle;
+    }
+
+    handle->nodes[handle->cur_node].self += now - handle->last_cycle;
+    handle->last_cycle = now;
+}
+
+/**
+ * Keeps the per-depth node stack aligned with the CPU call stack if the CPU had to discard
+ * outermost frames due to overflow.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] stack     The CPU call stack.
+ */
+static void profiler_sync_dropped(profiler_t handle, const cpu_callstack_t *stack)
+{
+    uint32_t drops = stack->dropped - handle->dropped;
+
+    if(drops == 0)
+    {
+        return;
+    }
+
+    if(drops >= CPU_CALLSTACK_DEPTH)
+    {
+        drops = CPU_CALLSTACK_DEPTH - 1;
+    }
+
+    memmove(&handle->node_stack[0], &handle->node_stack[drops], sizeof(uint32_t) * (CPU_CALLSTACK_DEPTH - drops));
+    handle->dropped = stack->dropped;
+}
+
+static void profiler_cpu_hook(cbemu_t emu, cpu_event_t event, const cpu_call_frame_t *frame, void *userdata)
+{
+    profiler_t handle = (profiler_t)userdata;
+    const cpu_callstack_t *stack = &emu->cpu.callstack;
+    prof_func_t *func;
+
+    if(event == CPU_EVENT_CALL)
+    {
+        /* The new frame has already been pushed, so the caller is one below it. */
+        if(stack->depth >= 2)
+        {
+            profiler_charge(handle, stack->frames[stack->depth-2].target);
+        }
+        else
+        {
+            handle->last_cycle = emu->cpu.cycles;
+        }
+
+        profiler_sync_dropped(handle, stack);
+
+        handle->cur_node = profiler_get_node(handle, (stack->depth >= 2) ? handle->node_stack[stack->depth-2] : PROFILER_ROOT_NODE, frame->target);
+        handle->node_stack[stack->depth-1] = handle->cur_node;
+
+        func = profiler_get_func(handle, frame->target);
+
+        if(func != NULL)
+        {
+            ++func->calls;
+
+            if(frame->type != CPU_CALL_JSR && frame->type != CPU_CALL_RESET)
+            {
+                func->interrupt = true;
+            }
+
+            if(func->active++ == 0)
+            {
+                func->entry_cycle = frame->entry_cycle;
+            }
+        }
+    }
+    else if(event == CPU_EVENT_RETURN)
+    {
+        profiler_charge(handle, frame->target);
+
+        handle->cur_node = (stack->depth > 0) ? handle->node_stack[stack->depth-1] : PROFILER_ROOT_NODE;
+
+        func = profiler_get_func(handle, frame->target);
+
+        if(func != NULL && func->active > 0)
+        {
+            /* Recursive calls are only counted once, when the outermost frame returns. */
+            if(--func->active == 0)
+            {
+                func->inclusive += emu->cpu.cycles - func->entry_cycle;
+            }
+        }
+    }
+}
+
+static const char *profiler_symbolize(profiler_t handle, uint16_t addr)
+{
+    const cc65_symbolinfo *syminfo;
+    const char *name = NULL;
+    unsigned int index;
+
+    if(handle->dbginfo == NULL)
+    {
+        return NULL;
+    }
+
+    syminfo = cc65_symbol_inrange(handle->dbginfo, addr, addr);
+
+    if(syminfo == NULL)
+    {
+        return NULL;
+    }
+
+    for(index = 0; index < syminfo->count; ++index)
+    {
+        if(syminfo->data[index].symbol_type != CC65_SYM_LABEL || syminfo->data[index].symbol_value != addr)
+        {
+            continue;
+        }
+
+        /* Prefer a global label over a cheap local one. The name pointer remains valid for the
+         * lifetime of the debug info. */
+        if(name == NULL || syminfo->data[index].parent_id == CC65_INV_ID)
+        {
+            name = syminfo->data[index].symbol_name;
+        }
+    }
+
+    cc65_free_symbolinfo(handle->dbginfo, syminfo);
+
+    return name;
+}
+
+static int profiler_compare_info(const void *a, const void *b)
+{
+    const profiler_func_info_t *info_a = (const profiler_func_info_t *)a;
+    const profiler_func_info_t *info_b = (const profiler_func_info_t *)b;
+
+    if(info_a->exclusive != info_b->exclusive)
+    {
+        return (info_a->exclusive < info_b->exclusive) ? 1 : -1;
+    }
+
+    return (int)info_a->address - (int)info_b->address;
+}
+
+/**
+ * Builds a sorted snapshot of all function statistics, including the cycles consumed so far by
+ * frames which are still active.
+ *
+ * @param[in] handle        The profiler handle.
+ * @param[out] num_infos    Number of entries in the returned snapshot.
+ *
+ * @return The allocated snapshot, or NULL if there are no functions or allocation failed.
+ */
+static profiler_func_info_t *profiler_snapshot(profiler_t handle, unsigned int *num_infos)
+{
+    profiler_func_info_t *infos;
+    const cpu_callstack_t *stack = &handle->emu->cpu.callstack;
+    uint64_t now = handle->emu->cpu.cycles;
+    prof_func_t *func;
+    uint32_t index;
+
+    *num_infos = 0;
+
+    if(handle->num_funcs <= 1)
+    {
+        return NULL;
+    }
+
+    infos = malloc(sizeof(profiler_func_info_t) * (handle->num_funcs - 1));
+
+    if(infos == NULL)
+    {
+        return NULL;
+    }
+
+    for(index = 1; index < handle->num_funcs; ++index)
+    {
+        func = &handle->funcs[index];
+
+        infos[index-1].address = func->address;
+        infos[index-1].name = profiler_symbolize(handle, func->address);
+        infos[index-1].calls = func->calls;
+        infos[index-1].exclusive = func->exclusive;
+        infos[index-1].inclusive = func->inclusive;
+        infos[index-1].interrupt = func->interrupt;
+
+        if(func->active > 0)
+        {
+            infos[index-1].inclusive += now - func->entry_cycle;
+        }
+    }
+
+    if(stack->depth > 0 && handle->index[stack->frames[stack->depth-1].target] != 0)
+    {
+        infos[handle->index[stack->frames[stack->depth-1].target] - 1].exclusive += now - handle->last_cycle;
+    }
+
+    *num_infos = handle->num_funcs - 1;
+
+    qsort(infos, *num_infos, sizeof(profiler_func_info_t), profiler_compare_info);
+
+    return infos;
+}
+
+/**
+ * Resolves the names of all profiled functions, indexed by function slot.
+ *
+ * @param[in] handle The profiler handle.
+ *
+ * @return Allocated array of names (NULL entries for unresolved functions), or NULL on error.
+ */
+static const char **profiler_resolve_names(profiler_t handle)
+{
+    const char **names;
+    uint32_t index;
+
+    names = malloc(sizeof(const char *) * handle->num_funcs);
+
+    if(names == NULL)
+    {
+        return NULL;
+    }
+
+    names[0] = NULL;
+
+    for(index = 1; index < handle->num_funcs; ++index)
+    {
+        names[index] = profiler_symbolize(handle, handle->funcs[index].address);
+    }
+
+    return names;
+}
+
+/**
+ * Gets the cycles spent with exactly the given call stack, including pending cycles if the
+ * node represents the current call stack.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] node      Index of the node.
+ *
+ * @return The number of cycles.
+ */
+static uint64_t profiler_node_self(profiler_t handle, uint32_t node)
+{
+    uint64_t self = handle->nodes[node].self;
+
+    if(node == handle->cur_node)
+    {
+        self += handle->emu->cpu.cycles - handle->last_cycle;
+    }
+
+    return self;
+}
+
+static void profiler_write_name(FILE *out, const char *name, uint16_t address, bool json)
+{
+    if(name == NULL)
+    {
+        fprintf(out, "$%04x", address);
+        return;
+    }
+
+    for(; *name != '\0'; ++name)
+    {
+        /* Neither format has a way to quote names, so strip characters that would break
+         * the format. cc65 symbols never contain them anyways. */
+        if(*name == ';' || *name == ' ' || (json && (*name == '"' || *name == '\\')))
+        {
+            fputc('_', out);
+        }
+        else
+        {
+            fputc(*name, out);
+        }
+    }
+}
+
+/**
+ * Callback for each call stack visited by profiler_walk().
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] path      Node indices from the outermost to the innermost frame.
+ * @param[in] depth     Number of entries in the path.
+ * @param[in] self      Cycles spent with exactly this call stack.
+ * @param[in] out       The stream being written.
+ * @param[in] names     Resolved function names, indexed by function slot.
+ * @param[in] first     Indicates this is the first call stack visited.
+ */
+typedef void (*profiler_walk_cb_t)(profiler_t handle, const uint32_t *path, uint32_t depth, uint64_t self, FILE *out, const char **names, bool first);
+
+/**
+ * Totals the cycles spent in every call stack below a node, not including the node itself.
+ */
+static uint64_t profiler_subtree_self(profiler_t handle, uint32_t top)
+{
+    uint64_t total = 0;
+    uint32_t node = handle->nodes[top].first_child;
+
+    while(node != 0)
+    {
+        total += profiler_node_self(handle, node);
+
+        if(handle->nodes[node].first_child != 0)
+        {
+            node = handle->nodes[node].first_child;
+            continue;
+        }
+
+        while(node != top && handle->nodes[node].next_sibling == 0)
+        {
+            node = handle->nodes[node].parent;
+        }
+
+        node = (node == top) ? 0 : handle->nodes[node].next_sibling;
+    }
+
+    return total;
+}
+
+/**
+ * Walks the calling context tree depth first, visiting every call stack with cycles attributed
+ * to it. Stacks deeper than CPU_CALLSTACK_DEPTH are cut short, with the cycles of the calls
+ * beyond that charged to the deepest frame written.
+ */
+static void profiler_walk(profiler_t handle, profiler_walk_cb_t callback, FILE *out, const char **names)
+{
+    uint32_t path[CPU_CALLSTACK_DEPTH];
+    uint32_t depth = 0;
+    uint32_t node;
+    uint64_t self;
+    bool first = true;
+
+    node = handle->nodes[PROFILER_ROOT_NODE].first_child;
+
+    while(node != 0)
+    {
+        path[depth++] = node;
+
+        self = profiler_node_self(handle, node);
+
+        if(depth == CPU_CALLSTACK_DEPTH)
+        {
+            self += profiler_subtree_self(handle, node);
+        }
+
+        if(self > 0)
+        {
+            callback(handle, path, depth, self, out, names, first);
+            first = false;
+        }
+
+        if(handle->nodes[node].first_child != 0 && depth < CPU_CALLSTACK_DEPTH)
+        {
+            node = handle->nodes[node].first_child;
+            continue;
+        }
+
+        /* Move on to the next sibling, climbing back up as each level is exhausted. */
+        while(depth > 0 && handle->nodes[path[depth-1]].next_sibling == 0)
+        {
+            --depth;
+        }
+
+        if(depth == 0)
+        {
+            break;
+        }
+
+        node = handle->nodes[path[--depth]].next_sibling;
+    }
+}
+
+static void profiler_folded_cb(profiler_t handle, const uint32_t *path, uint32_t depth, uint64_t self, FILE *out, const char **names, bool first)
+{
+    uint32_t index;
+    uint16_t address;
+
+    for(index = 0; index < depth; ++index)
+    {
+        address = handle->nodes[path[index]].address;
+
+        if(index > 0)
+        {
+            fputc(';', out);
+        }
+
+        profiler_write_name(out, names[handle->index[address]], address, false);
+    }
+
+    fprintf(out, " %" PRIu64 "\n", self);
+}
+
+static void profiler_samples_cb(profiler_t handle, const uint32_t *path, uint32_t depth, uint64_t self, FILE *out, const char **names, bool first)
+{
+    uint32_t index;
+
+    fprintf(out, "%s[", first ? "" : ",");
+
+    /* Frame indices map directly to function slots, offset by the unused slot 0. */
+    for(index = 0; index < depth; ++index)
+    {
+        fprintf(out, "%s%u", (index > 0) ? "," : "", handle->index[handle->nodes[path[index]].address] - 1);
+    }
+
+    fputc(']', out);
+}
+
+static void profiler_weights_cb(profiler_t handle, const uint32_t *path, uint32_t depth, uint64_t self, FILE *out, const char **names, bool first)
+{
+    fprintf(out, "%s%" PRIu64, first ? "" : ",", self);
+}
+
+/**
+ * Writes the call stacks in the folded stack format, one line per unique call stack with the
+ * frames separated by semicolons followed by the cycle count.
+ */
+static bool profiler_write_folded(profiler_t handle, FILE *out)
+{
+    const char **names = profiler_resolve_names(handle);
+
+    if(names == NULL)
+    {
+        return false;
+    }
+
+    profiler_walk(handle, profiler_folded_cb, out, names);
+
+    free(names);
+
+    return !ferror(out);
+}
+
+/**
+ * Writes the call stacks as a speedscope sampled profile, with each unique call stack written
+ * as a single sample weighted by its cycle count.
+ */
+static bool profiler_write_speedscope(profiler_t handle, FILE *out)
+{
+    const char **names = profiler_resolve_names(handle);
+    uint32_t index;
+
+    if(names == NULL)
+    {
+        return false;
+    }
+
+    fprintf(out, "{\"$schema\":\"https://www.speedscope.app/file-format-schema.json\",\"exporter\":\"cbemu\",");
+    fprintf(out, "\"shared\":{\"frames\":[");
+
+    for(index = 1; index < handle->num_funcs; ++index)
+    {
+        fprintf(out, "%s{\"name\":\"", (index > 1) ? "," : "");
+        profiler_write_name(out, names[index], handle->funcs[index].address, true);
+        fprintf(out, "\"}");
+    }
+
+    fprintf(out, "]},\"profiles\":[{\"type\":\"sampled\",\"name\":\"cycles\",\"unit\":\"none\",");
+    fprintf(out, "\"startValue\":0,\"endValue\":%" PRIu64 ",\"samples\":[", profiler_get_total_cycles(handle));
+
+    /* The walk order is stable, so the weights line up with the samples. */
+    profiler_walk(handle, profiler_samples_cb, out, names);
+    fprintf(out, "],\"weights\":[");
+    profiler_walk(handle, profiler_weights_cb, out, names);
+    fprintf(out, "]}]}\n");
+
+    free(names);
+
+    return !ferror(out);
+}
+
+/**
+ * Creates a profiler and attaches it to an emulator instance. Profiling begins immediately.
+ *
+ * @param[in] emulator  The emulator instance to profile.
+ *
+ * @return The profiler instance, or NULL if there was an error.
+ */
+profiler_t profiler_init(cbemu_t emulator)
+{
+    profiler_t handle;
+
+    if(emulator == NULL)
+    {
+        return NULL;
+    }
+
+    handle = malloc(sizeof(struct profiler_s));
+
+    if(handle == NULL)
+    {
+        return NULL;
+    }
+
+    memset(handle, 0, sizeof(struct profiler_s));
+
+    handle->emu = emulator;
+    handle->funcs = malloc(sizeof(prof_func_t) * PROFILER_INIT_FUNCS);
+    handle->alloc_funcs = PROFILER_INIT_FUNCS;
+    handle->nodes = malloc(sizeof(prof_node_t) * PROFILER_INIT_NODES);
+    handle->alloc_nodes = PROFILER_INIT_NODES;
+
+    if(handle->funcs != NULL && handle->nodes != NULL)
+    {
+        handle->hook = cpu_add_hook(emulator, profiler_cpu_hook, handle);
+    }
+
+    if(handle->hook == NULL)
+    {
+        free(handle->nodes);
+        free(handle->funcs);
+        free(handle);
+        return NULL;
+    }
+
+    profiler_reset(handle);
+
+    return handle;
+}
+
+/**
+ * Provide the profiler with cc65 debug info used to symbolize function addresses.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] dbginfo   The debug info to use, or NULL to clear it.
+ */
+void profiler_set_dbginfo(profiler_t handle, cc65_dbginfo dbginfo)
+{
+    if(handle != NULL)
+    {
+        handle->dbginfo = dbginfo;
+    }
+}
+
+/**
+ * Discards all collected profiling data and restarts profiling from the current cycle.
+ *
+ * @param[in] handle The profiler handle.
+ */
+void profiler_reset(profiler_t handle)
+{
+    const cpu_callstack_t *stack;
+    prof_func_t *func;
+    uint32_t index;
+
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    stack = &handle->emu->cpu.callstack;
+
+    memset(handle->index, 0, sizeof(handle->index));
+    handle->num_funcs = 1;
+    handle->start_cycle = handle->emu->cpu.cycles;
+    handle->last_cycle = handle->start_cycle;
+
+    memset(&handle->nodes[PROFILER_ROOT_NODE], 0, sizeof(prof_node_t));
+    handle->num_nodes = 1;
+    handle->cur_node = PROFILER_ROOT_NODE;
+    handle->dropped = stack->dropped;
+
+    /* Frames already on the call stack are treated as having been entered now. */
+    for(index = 0; index < stack->depth; ++index)
+    {
+        handle->cur_node = profiler_get_node(handle, handle->cur_node, stack->frames[index].target);
+        handle->node_stack[index] = handle->cur_node;
+
+        func = profiler_get_func(handle, stack->frames[index].target);
+
+        if(func != NULL && func->active++ == 0)
+        {
+            func->entry_cycle = handle->start_cycle;
+            func->interrupt = (stack->frames[index].type != CPU_CALL_JSR && stack->frames[index].type != CPU_CALL_RESET);
+        }
+    }
+}
+
+/**
+ * Gets the number of cycles elapsed since profiling was started or reset.
+ *
+ * @param[in] handle The profiler handle.
+ *
+ * @return Total profiled cycles.
+ */
+uint64_t profiler_get_total_cycles(profiler_t handle)
+{
+    if(handle == NULL)
+    {
+        return 0;
+    }
+
+    return handle->emu->cpu.cycles - handle->start_cycle;
+}
+
+/**
+ * Gets the collected profiling information, sorted by exclusive cycles in descending order.
+ * Functions still executing are included with the cycles consumed so far.
+ *
+ * @param[in] handle The profiler handle.
+ * @param[in,out] num_funcs On entry, indicates the number of entries available in the supplied buffer.
+ *                          On return, indicates the number of entries populated into the buffer.
+ * @param[out] funcs Buffer of function information structures to populate.
+ * @param[out] total_funcs If supplied, populated with the total number of profiled functions.
+ */
+void profiler_get_functions(profiler_t handle, unsigned int *num_funcs, profiler_func_info_t *funcs, unsigned int *total_funcs)
+{
+    profiler_func_info_t *infos;
+    unsigned int num_infos = 0;
+
+    if(handle != NULL)
+    {
+        infos = profiler_snapshot(handle, &num_infos);
+
+        if(num_funcs != NULL && funcs != NULL && infos != NULL)
+        {
+            if(*num_funcs > num_infos)
+            {
+                *num_funcs = num_infos;
+            }
+
+            memcpy(funcs, infos, sizeof(profiler_func_info_t) * *num_funcs);
+        }
+
+        free(infos);
+    }
+    else if(num_funcs != NULL)
+    {
+        *num_funcs = 0;
+    }
+
+    if(total_funcs != NULL)
+    {
+        *total_funcs = num_infos;
+    }
+}
+
+/**
+ * Writes a human readable profile report.
+ *
+ * @param[in] handle        The profiler handle.
+ * @param[in] out           Stream to write the report to.
+ * @param[in] max_entries   Maximum number of functions to report, or 0 for all of them.
+ */
+void profiler_report(profiler_t handle, FILE *out, unsigned int max_entries)
+{
+    profiler_func_info_t *infos;
+    unsigned int num_infos;
+    unsigned int index;
+    uint64_t total;
+    double scale;
+
+    if(handle == NULL || out == NULL)
+    {
+        return;
+    }
+
+    infos = profiler_snapshot(handle, &num_infos);
+    total = profiler_get_total_cycles(handle);
+    scale = (total > 0) ? (100.0 / (double)total) : 0.0;
+
+    fprintf(out, "Profiled %" PRIu64 " cycles, %u functions\n", total, num_infos);
+    fprintf(out, "%14s %7s %14s %7s %10s  %s\n", "Exclusive", "Excl%", "Inclusive", "Incl%", "Calls", "Function");
+
+    if(max_entries == 0 || max_entries > num_infos)
+    {
+        max_entries = num_infos;
+    }
+
+    for(index = 0; index < max_entries; ++index)
+    {
+        fprintf(out, "%14" PRIu64 " %6.2f%% %14" PRIu64 " %6.2f%% %10" PRIu64 "  ",
+                infos[index].exclusive, (double)infos[index].exclusive * scale,
+                infos[index].inclusive, (double)infos[index].inclusive * scale,
+                infos[index].calls);
+
+        if(infos[index].name != NULL)
+        {
+            fprintf(out, "%s", infos[index].name);
+        }
+        else
+        {
+            fprintf(out, "$%04x", infos[index].address);
+        }
+
+        fprintf(out, "%s\n", infos[index].interrupt ? " [int]" : "");
+    }
+
+    free(infos);
+}
+
+/**
+ * Writes the full profile in the given format.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] out       Stream to write the profile to.
+ * @param[in] format    The output format.
+ *
+ * @return true if the profile was written successfully.
+ */
+bool profiler_write(profiler_t handle, FILE *out, profiler_format_t format)
+{
+    if(handle == NULL || out == NULL)
+    {
+        return false;
+    }
+
+    switch(format)
+    {
+        case PROFILER_FORMAT_REPORT:
+            profiler_report(handle, out, 0);
+            return !ferror(out);
+        case PROFILER_FORMAT_FOLDED:
+            return profiler_write_folded(handle, out);
+        case PROFILER_FORMAT_SPEEDSCOPE:
+            return profiler_write_speedscope(handle, out);
+        default:
+            return false;
+    }
+}
+
+/**
+ * Writes the full profile in the given format to a file.
+ *
+ * @param[in] handle    The profiler handle.
+ * @param[in] filename  The file to write.
+ * @param[in] format    The output format.
+ *
+ * @return true if the profile was written successfully.
+ */
+bool profiler_dump(profiler_t handle, const char *filename, profiler_format_t format)
+{
+    FILE *out;
+    bool result;
+
+    if(handle == NULL || filename == NULL)
+    {
+        return false;
+    }
+
+    out = fopen(filename, "w");
+
+    if(out == NULL)
+    {
+        return false;
+    }
+
+    result = profiler_write(handle, out, format);
+
+    return (fclose(out) == 0) && result;
+}
+
+/**
+ * Detaches a profiler from its emulator and frees it.
+ *
+ * @param[in] handle The profiler handle.
+ */
+void profiler_cleanup(profiler_t handle)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    cpu_remove_hook(handle->emu, handle->hook);
+
+    free(handle->nodes);
+    free(handle->funcs);
+    free(handle);
+}
@@ -0,0 +1,331 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "recorder.h"
+#include "tracefile_priv.h"
+#include "cpu_priv.h"
+#include "log.h"
+
+/** Number of records in the ring. Must be a power of 2. */
+#define RECORDER_RING_RECORDS   0x10000
+#define RECORDER_RING_MASK      (RECORDER_RING_RECORDS - 1)
+
+/** Number of pending records the writer waits for before writing, unless stopping. */
+#define RECORDER_BATCH_RECORDS  0x1000
+
+/** How long the writer sleeps while waiting for a batch. */
+#define RECORDER_IDLE_NS        1000000
+
+/** Size of the file's stdio buffer. */
+#define RECORDER_FILE_BUFFER    0x40000
+
+/** Padding used to keep the producer and consumer indices on separate cache lines. */
+#define RECORDER_CACHE_LINE     64
+
+struct recorder_s
+{
+    cbemu_t emu;
+    bus_cb_handle_t tracer;
+    FILE *file;
+    pthread_t thread;
+    atomic_bool stop;
+    bool error;                 /**< Set by the writer thread if a write fails. */
+    bool index_error;           /**< Set by the writer thread if the index can't be grown. */
+    tracefile_index_t index;    /**< Index of the records written, appended to the file on cleanup. */
+
+    /* Producer state, only accessed by the emulation thread. */
+    uint64_t tail_cache;        /**< Last tail index read by the producer. */
+    uint64_t stalls;
+
+    atomic_uint_fast64_t head;  /**< Index of the next record to be produced. */
+    uint8_t pad[RECORDER_CACHE_LINE];
+    atomic_uint_fast64_t tail;  /**< Index of the next record to be written to the file. */
+    uint8_t pad2[RECORDER_CACHE_LINE];
+
+    recorder_record_t ring[RECORDER_RING_RECORDS];
+};
+
+static void recorder_bus_trace(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata)
+{
+    recorder_t handle = (recorder_t)userdata;
+    recorder_record_t *record;
+    uint64_t head;
+
+    head = atomic_load_explicit(&handle->head, memory_order_relaxed);
+
+    if(head - handle->tail_cache == RECORDER_RING_RECORDS)
+    {
+        handle->tail_cache = atomic_load_explicit(&handle->tail, memory_order_acquire);
+
+        if(head - handle->tail_cache == RECORDER_RING_RECORDS)
+        {
+            /* The writer has fallen behind, so wait for it rather than lose records. */
+            ++handle->stalls;
+
+            do
+            {
+                sched_yield();
+                handle->tail_cache = atomic_load_explicit(&handle->tail, memory_order_acquire);
+            } while(head - handle->tail_cache == RECORDER_RING_RECORDS);
+        }
+    }
+
+    record = &handle->ring[head & RECORDER_RING_MASK];
+    record->cycle = handle->emu->cpu.cycles;
+    record->pc = handle->emu->cpu.opaddr;
+    record->addr = addr;
+    record->value = value;
+    record->flags = (write ? RECORD_WRITE : 0) | ((flags & SYNC) ? RECORD_SYNC : 0) | ((flags & DUMMY) ? RECORD_DUMMY : 0);
+    record->reserved = 0;
+
+    atomic_store_explicit(&handle->head, head + 1, memory_order_release);
+}
+
+static void *recorder_thread(void *param)
+{
+    static const struct timespec idle = { 0, RECORDER_IDLE_NS };
+    recorder_t handle = (recorder_t)param;
+    uint64_t head;
+    uint64_t tail;
+    size_t index;
+    size_t count;
+    bool stop;
+
+    tail = atomic_load_explicit(&handle->tail, memory_order_relaxed);
+
+    for(;;)
+    {
+        /* The producer is finished once stop is set, so the head read after it is final. */
+        stop = atomic_load_explicit(&handle->stop, memory_order_acquire);
+        head = atomic_load_explicit(&handle->head, memory_order_acquire);
+
+        if(head == tail && stop)
+        {
+            break;
+        }
+
+        if(head - tail < RECORDER_BATCH_RECORDS && !stop)
+        {
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        /* Write up to the end of the ring, and pick up the rest on the next pass. */
+        index = (size_t)(tail & RECORDER_RING_MASK);
+        count = (size_t)(head - tail);
+
+        if(count > RECORDER_RING_RECORDS - index)
+        {
+            count = RECORDER_RING_RECORDS - index;
+        }
+
+        if(!handle->error && fwrite(&handle->ring[index], sizeof(recorder_record_t), count, handle->file) != count)
+        {
+            /* Keep draining so the emulator isn't blocked, but stop writing. */
+            handle->error = true;
+        }
+
+        /* The records must be indexed before the space is handed back to the producer. */
+        if(!handle->index_error && !tracefile_index_add(&handle->index, &handle->ring[index], count))
+        {
+            handle->index_error = true;
+        }
+
+        tail += count;
+        atomic_store_explicit(&handle->tail, tail, memory_order_release);
+    }
+
+    return NULL;
+}
+
+/**
+ * Appends the index and footer to the trace file.
+ *
+ * @param[in] handle    The recorder handle, with the writer thread stopped.
+ *
+ * @return true if the index was written.
+ */
+static bool recorder_write_index(recorder_t handle)
+{
+    tracefile_footer_t footer;
+
+    memset(&footer, 0, sizeof(footer));
+    memcpy(footer.magic, TRACEFILE_INDEX_MAGIC, sizeof(footer.magic));
+    footer.index_offset = sizeof(recorder_file_header_t) + handle->index.num_records * sizeof(recorder_record_t);
+    footer.num_blocks = handle->index.num_blocks;
+    footer.num_records = handle->index.num_records;
+
+    if(fwrite(handle->index.blocks, sizeof(tracefile_block_t), (size_t)footer.num_blocks, handle->file) != footer.num_blocks ||
+       fwrite(&footer, sizeof(footer), 1, handle->file) != 1)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Creates a recorder and starts recording bus transactions to a file.
+ *
+ * @param[in] emulator  The emulator instance to record.
+ * @param[in] filename  The file to record to. It is truncated if it exists.
+ * @param[in] filter    Filter for the transactions to record, or NULL to record all of them.
+ *
+ * @return The recorder instance, or NULL if there was an error.
+ */
+recorder_t recorder_init(cbemu_t emulator, const char *filename, const bus_trace_filter_t *filter)
+{
+    recorder_t handle;
+    recorder_file_header_t header;
+
+    if(emulator == NULL || filename == NULL)
+    {
+        return NULL;
+    }
+
+    handle = malloc(sizeof(struct recorder_s));
+
+    if(handle == NULL)
+    {
+        return NULL;
+    }
+
+    memset(handle, 0, sizeof(struct recorder_s));
+
+    handle->emu = emulator;
+    atomic_init(&handle->stop, false);
+    atomic_init(&handle->head, 0);
+    atomic_init(&handle->tail, 0);
+
+    handle->file = fopen(filename, "wb");
+
+    if(handle->file == NULL)
+    {
+        log_print(lWARNING, "Unable to open trace file %s", filename);
+        free(handle);
+        return NULL;
+    }
+
+    setvbuf(handle->file, NULL, _IOFBF, RECORDER_FILE_BUFFER);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDER_MAGIC, sizeof(header.magic));
+    header.version = RECORDER_VERSION;
+    header.record_size = sizeof(recorder_record_t);
+
+    if(fwrite(&header, sizeof(header), 1, handle->file) != 1 ||
+       pthread_create(&handle->thread, NULL, recorder_thread, handle) != 0)
+    {
+        fclose(handle->file);
+        free(handle);
+        return NULL;
+    }
+
+    if(filter != NULL)
+    {
+        handle->tracer = emu_bus_add_tracer_filtered(emulator, filter, recorder_bus_trace, handle);
+    }
+    else
+    {
+        handle->tracer = emu_bus_add_tracer(emulator, recorder_bus_trace, handle);
+    }
+
+    if(handle->tracer == NULL)
+    {
+        recorder_cleanup(handle);
+        return NULL;
+    }
+
+    return handle;
+}
+
+/**
+ * Gets the number of records made so far.
+ *
+ * @param[in] handle    The recorder handle.
+ *
+ * @return The number of records.
+ */
+uint64_t recorder_get_count(recorder_t handle)
+{
+    if(handle == NULL)
+    {
+        return 0;
+    }
+
+    return atomic_load_explicit(&handle->head, memory_order_relaxed);
+}
+
+/**
+ * Gets the number of times recording had to wait for the writer thread to free space in the ring.
+ *
+ * @param[in] handle    The recorder handle.
+ *
+ * @return The number of waits.
+ */
+uint64_t recorder_get_stalls(recorder_t handle)
+{
+    if(handle == NULL)
+    {
+        return 0;
+    }
+
+    return handle->stalls;
+}
+
+/**
+ * Stops recording, writes any remaining records, closes the file and frees the recorder.
+ *
+ * @param[in] handle    The recorder handle.
+ *
+ * @return true if every record was written to the file.
+ */
+bool recorder_cleanup(recorder_t handle)
+{
+    bool success;
+
+    if(handle == NULL)
+    {
+        return false;
+    }
+
+    if(handle->tracer != NULL)
+    {
+        emu_bus_remove_tracer(handle->emu, handle->tracer);
+    }
+
+    atomic_store_explicit(&handle->stop, true, memory_order_release);
+    pthread_join(handle->thread, NULL);
+
+    success = !handle->error;
+
+    /* A file without an index is still readable, it just has to be indexed when opened. */
+    if(success && !handle->index_error && !recorder_write_index(handle))
+    {
+        success = false;
+    }
+
+    if(fclose(handle->file) != 0)
+    {
+        success = false;
+    }
+
+    if(!success)
+    {
+        log_print(lWARNING, "Failed to write bus trace");
+    }
+
+    tracefile_index_free(&handle->index);
+    free(handle);
+
+    return success;
+}
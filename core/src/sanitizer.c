@@ -0,0 +1,381 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "sanitizer.h"
+#include "cpu_priv.h"
+#include "bus_priv.h"
+#include "log.h"
+
+#define SANITIZER_NUM_ADDRS     0x10000
+#define SANITIZER_STACK_ADDR    0x0100
+
+/** Maximum distance from a label for it to be used to symbolize an address. */
+#define SANITIZER_SYMBOL_RANGE  0x100
+
+/** Per-byte shadow state. */
+typedef enum
+{
+    SHADOW_RAM      = 0x01, /**< Byte is in a RAM region. */
+    SHADOW_ROM      = 0x02, /**< Byte is in a ROM region. */
+    SHADOW_INIT     = 0x04, /**< RAM byte has been written. */
+    SHADOW_REPORTED = 0x08, /**< A condition has already been reported for this byte. */
+} shadow_flags_t;
+
+struct sanitizer_s
+{
+    cbemu_t emu;
+    cpu_hook_t *hook;
+    cc65_dbginfo dbginfo;
+    sanitizer_report_cb_t callback;
+    void *userdata;
+    unsigned int counts[SANITIZER_NUM_ERRORS];
+    uint8_t shadow[SANITIZER_NUM_ADDRS];
+};
+
+static const char *const error_names[SANITIZER_NUM_ERRORS] = {
+    "uninitialized read",
+    "stack overflow",
+    "stack underflow",
+    "ROM write"
+};
+
+/**
+ * Finds the nearest label at or before an address.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] addr      The address to symbolize.
+ * @param[out] offset   Offset of the address from the returned label.
+ *
+ * @return The label name, or NULL if none was found.
+ */
+static const char *sanitizer_symbolize(sanitizer_t handle, uint16_t addr, uint16_t *offset)
+{
+    const cc65_symbolinfo *syminfo;
+    const cc65_symboldata *sym;
+    const cc65_symboldata *best = NULL;
+    const char *name = NULL;
+    unsigned int index;
+    uint16_t start;
+
+    if(handle->dbginfo == NULL)
+    {
+        return NULL;
+    }
+
+    start = (addr >= SANITIZER_SYMBOL_RANGE) ? (uint16_t)(addr - SANITIZER_SYMBOL_RANGE + 1) : 0;
+
+    syminfo = cc65_symbol_inrange(handle->dbginfo, start, addr);
+
+    if(syminfo == NULL)
+    {
+        return NULL;
+    }
+
+    for(index = 0; index < syminfo->count; ++index)
+    {
+        sym = &syminfo->data[index];
+
+        if(sym->symbol_type != CC65_SYM_LABEL || sym->symbol_value > addr)
+        {
+            continue;
+        }
+
+        /* Prefer the closest label, and a global label over a cheap local one at the same address. */
+        if(best == NULL || sym->symbol_value > best->symbol_value ||
+           (sym->symbol_value == best->symbol_value && sym->parent_id == CC65_INV_ID))
+        {
+            best = sym;
+        }
+    }
+
+    if(best != NULL)
+    {
+        /* The name pointer remains valid for the lifetime of the debug info. */
+        name = best->symbol_name;
+        *offset = (uint16_t)(addr - best->symbol_value);
+    }
+
+    cc65_free_symbolinfo(handle->dbginfo, syminfo);
+
+    return name;
+}
+
+/**
+ * Builds and delivers a report for a detected condition.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] error     The condition detected.
+ * @param[in] addr      The address accessed.
+ */
+static void sanitizer_report(sanitizer_t handle, sanitizer_error_t error, uint16_t addr)
+{
+    sanitizer_report_t report;
+    char buffer[128];
+
+    report.error = error;
+    report.pc = handle->emu->cpu.opaddr;
+    report.addr = addr;
+    report.offset = 0;
+    report.symbol = sanitizer_symbolize(handle, report.pc, &report.offset);
+    report.cycle = handle->emu->cpu.cycles;
+
+    ++handle->counts[error];
+
+    if(handle->callback != NULL)
+    {
+        handle->callback(&report, handle->userdata);
+    }
+    else
+    {
+        sanitizer_format_report(&report, buffer, sizeof(buffer));
+        log_print(lWARNING, "%s", buffer);
+    }
+}
+
+static void sanitizer_bus_monitor(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata)
+{
+    sanitizer_t handle = (sanitizer_t)userdata;
+    uint8_t *shadow = &handle->shadow[addr];
+
+    if(write)
+    {
+        if(*shadow & SHADOW_RAM)
+        {
+            *shadow |= SHADOW_INIT;
+        }
+        else if((*shadow & (SHADOW_ROM | SHADOW_REPORTED)) == SHADOW_ROM)
+        {
+            *shadow |= SHADOW_REPORTED;
+            sanitizer_report(handle, SANITIZER_ROM_WRITE, addr);
+        }
+    }
+    else if(!(flags & DUMMY))
+    {
+        /* Dummy reads are discarded by the CPU, so reading uninitialized RAM is harmless. */
+        if((*shadow & (SHADOW_RAM | SHADOW_INIT | SHADOW_REPORTED)) == SHADOW_RAM)
+        {
+            *shadow |= SHADOW_REPORTED;
+            sanitizer_report(handle, SANITIZER_UNINIT_READ, addr);
+        }
+    }
+}
+
+static void sanitizer_cpu_hook(cbemu_t emu, cpu_event_t event, const cpu_call_frame_t *frame, void *userdata)
+{
+    sanitizer_t handle = (sanitizer_t)userdata;
+
+    if(event == CPU_EVENT_STACK_OVERFLOW)
+    {
+        sanitizer_report(handle, SANITIZER_STACK_OVERFLOW, SANITIZER_STACK_ADDR);
+    }
+    else if(event == CPU_EVENT_STACK_UNDERFLOW)
+    {
+        sanitizer_report(handle, SANITIZER_STACK_UNDERFLOW, SANITIZER_STACK_ADDR);
+    }
+}
+
+/**
+ * Creates a sanitizer and attaches it to an emulator instance. No memory is checked until
+ * regions are added. Only one sanitizer may be attached to an emulator at a time.
+ *
+ * @param[in] emulator  The emulator instance to check.
+ *
+ * @return The sanitizer instance, or NULL if there was an error.
+ */
+sanitizer_t sanitizer_init(cbemu_t emulator)
+{
+    sanitizer_t handle;
+
+    if(emulator == NULL)
+    {
+        return NULL;
+    }
+
+    handle = malloc(sizeof(struct sanitizer_s));
+
+    if(handle == NULL)
+    {
+        return NULL;
+    }
+
+    memset(handle, 0, sizeof(struct sanitizer_s));
+
+    handle->emu = emulator;
+
+    if(!bus_set_monitor(emulator, sanitizer_bus_monitor, handle))
+    {
+        free(handle);
+        return NULL;
+    }
+
+    handle->hook = cpu_add_hook(emulator, sanitizer_cpu_hook, handle);
+
+    if(handle->hook == NULL)
+    {
+        bus_set_monitor(emulator, NULL, NULL);
+        free(handle);
+        return NULL;
+    }
+
+    return handle;
+}
+
+/**
+ * Adds a region of memory to be checked. All RAM in the region is marked as uninitialized.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] start     The first address of the region.
+ * @param[in] end       The last address of the region (inclusive).
+ * @param[in] type      The type of memory in the region.
+ *
+ * @return true if the region was added.
+ */
+bool sanitizer_add_region(sanitizer_t handle, uint16_t start, uint16_t end, sanitizer_region_t type)
+{
+    uint8_t flags;
+
+    if(handle == NULL || end < start)
+    {
+        return false;
+    }
+
+    switch(type)
+    {
+        case SANITIZER_REGION_RAM:
+            flags = SHADOW_RAM;
+            break;
+        case SANITIZER_REGION_ROM:
+            flags = SHADOW_ROM;
+            break;
+        default:
+            return false;
+    }
+
+    memset(&handle->shadow[start], flags, (size_t)(end - start) + 1);
+    bus_monitor_pages(handle->emu, (uint8_t)(start >> 8), (uint8_t)(end >> 8), true);
+
+    return true;
+}
+
+/**
+ * Marks RAM as initialized, such as after it has been loaded externally.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] start     The first address to mark.
+ * @param[in] end       The last address to mark (inclusive).
+ */
+void sanitizer_mark_initialized(sanitizer_t handle, uint16_t start, uint16_t end)
+{
+    uint32_t addr;
+
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    for(addr = start; addr <= end; ++addr)
+    {
+        if(handle->shadow[addr] & SHADOW_RAM)
+        {
+            handle->shadow[addr] |= SHADOW_INIT;
+        }
+    }
+}
+
+/**
+ * Provide the sanitizer with cc65 debug info used to symbolize reports.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] dbginfo   The debug info to use, or NULL to clear it.
+ */
+void sanitizer_set_dbginfo(sanitizer_t handle, cc65_dbginfo dbginfo)
+{
+    if(handle != NULL)
+    {
+        handle->dbginfo = dbginfo;
+    }
+}
+
+/**
+ * Sets the callback used to deliver reports. By default, reports are logged as warnings.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] callback  The callback, or NULL to restore logging.
+ * @param[in] userdata  Userdata supplied to the callback.
+ */
+void sanitizer_set_callback(sanitizer_t handle, sanitizer_report_cb_t callback, void *userdata)
+{
+    if(handle != NULL)
+    {
+        handle->callback = callback;
+        handle->userdata = userdata;
+    }
+}
+
+/**
+ * Gets the number of times a condition has been reported.
+ *
+ * @param[in] handle    The sanitizer handle.
+ * @param[in] error     The condition.
+ *
+ * @return The number of reports.
+ */
+unsigned int sanitizer_get_count(sanitizer_t handle, sanitizer_error_t error)
+{
+    if(handle == NULL || error >= SANITIZER_NUM_ERRORS)
+    {
+        return 0;
+    }
+
+    return handle->counts[error];
+}
+
+/**
+ * Formats a report as a single line of text.
+ *
+ * @param[in] report    The report to format.
+ * @param[out] buffer   Buffer to populate.
+ * @param[in] size      Size of the buffer.
+ */
+void sanitizer_format_report(const sanitizer_report_t *report, char *buffer, size_t size)
+{
+    if(report == NULL || buffer == NULL || size == 0)
+    {
+        return;
+    }
+
+    if(report->symbol != NULL)
+    {
+        snprintf(buffer, size, "Sanitizer: %s of $%04x at PC $%04x (%s+%u), cycle %" PRIu64,
+                 error_names[report->error], report->addr, report->pc, report->symbol, report->offset, report->cycle);
+    }
+    else
+    {
+        snprintf(buffer, size, "Sanitizer: %s of $%04x at PC $%04x, cycle %" PRIu64,
+                 error_names[report->error], report->addr, report->pc, report->cycle);
+    }
+}
+
+/**
+ * Detaches a sanitizer from its emulator and frees it.
+ *
+ * @param[in] handle The sanitizer handle.
+ */
+void sanitizer_cleanup(sanitizer_t handle)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    bus_set_monitor(handle->emu, NULL, NULL);
+    cpu_remove_hook(handle->emu, handle->hook);
+
+    free(handle);
+}
@@ -0,0 +1,992 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+#include "snapshot_priv.h"
+#include "clock_priv.h"
+#include "emu_priv_types.h"
+#include "util.h"
+
+#define SNAPSHOT_MAGIC      0x53534243  /* "CBSS" */
+#define SNAPSHOT_VERSION    2
+
+/** Capacity of a snapshot buffer when first saved into. It grows as needed. */
+#define SNAPSHOT_INITIAL_CAPACITY   0x4000
+
+/**
+ * Header at the start of a snapshot.
+ */
+typedef struct
+{
+    uint32_t magic;     /**< SNAPSHOT_MAGIC */
+    uint32_t version;   /**< SNAPSHOT_VERSION */
+    uint32_t sections;  /**< Number of sections following the header */
+    uint32_t reserved;  /**< Zero */
+    uint64_t seq;       /**< Number of the snapshot */
+    uint64_t parent;    /**< Number of the snapshot a delta follows, or 0 for a full snapshot */
+} snapshot_header_t;
+
+/**
+ * Header at the start of each section, followed by the state written by the hook. Any pages
+ * written follow the rest of the state.
+ */
+typedef struct
+{
+    char name[SNAPSHOT_MAX_NAME];   /**< Name of the hook, zero padded */
+    uint32_t size;                  /**< Size of the state in bytes */
+    uint32_t plain;                 /**< Size of the state before the first block of pages */
+} snapshot_section_t;
+
+/**
+ * Header at the start of a block of pages, followed by each page's number and contents, in
+ * ascending order. The last page of a memory may be short.
+ */
+typedef struct
+{
+    uint32_t size;      /**< Size of the memory in bytes */
+    uint32_t count;     /**< Number of pages in the block */
+} snapshot_pages_t;
+
+/**
+ * Position within a block of pages being merged.
+ */
+typedef struct
+{
+    const uint8_t *data;    /**< Contents of the snapshot */
+    size_t offset;          /**< Offset of the next page */
+    size_t end;             /**< End of the pages of the section */
+    uint32_t size;          /**< Size of the memory */
+    uint32_t remaining;     /**< Number of pages left in the block */
+    uint32_t page;          /**< Number of the next page */
+    size_t len;             /**< Length of the next page */
+} snapshot_page_cursor_t;
+
+/**
+ * Registered snapshot hooks
+ */
+struct snapshot_hook_s
+{
+    char name[SNAPSHOT_MAX_NAME];   /**< Name of the device */
+    snapshot_save_cb_t save;        /**< Hook serializing the device's state */
+    snapshot_restore_cb_t restore;  /**< Hook deserializing the device's state */
+    void *userdata;                 /**< Passed to the hooks */
+    listnode_t node;                /**< List entry node */
+};
+
+/**
+ * Snapshot buffer
+ */
+struct snapshot_s
+{
+    uint8_t *data;      /**< Serialized contents */
+    size_t size;        /**< Size of the contents */
+    size_t capacity;    /**< Allocated size of data */
+    size_t cursor;      /**< Read position within the section being restored */
+    size_t end;         /**< End of the section being restored */
+    bool delta;         /**< Indicates a delta is being saved */
+    size_t section;     /**< Offset of the section being saved */
+    bool paged;         /**< Indicates pages have been written to the section being saved */
+    size_t plain;       /**< Size of the section being saved before its first pages */
+};
+
+/**
+ * Makes room in a snapshot buffer for more contents.
+ *
+ * @param[in] snap  The snapshot handle
+ * @param[in] size  Number of bytes to be appended
+ *
+ * @return true if there is room
+ */
+static bool snapshot_reserve(snapshot_t snap, size_t size)
+{
+    size_t capacity;
+    uint8_t *data;
+
+    if(size <= snap->capacity - snap->size)
+    {
+        return true;
+    }
+
+    capacity = (snap->capacity == 0) ? SNAPSHOT_INITIAL_CAPACITY : snap->capacity;
+
+    while(size > capacity - snap->size)
+    {
+        capacity *= 2;
+    }
+
+    data = realloc(snap->data, capacity);
+
+    if(data == NULL)
+    {
+        return false;
+    }
+
+    snap->data = data;
+    snap->capacity = capacity;
+
+    return true;
+}
+
+/**
+ * Appends to the contents of a snapshot.
+ *
+ * @param[in] snap  The snapshot handle
+ * @param[in] data  The contents to append
+ * @param[in] size  Size of the contents in bytes
+ *
+ * @return true if the contents were appended
+ */
+static bool snapshot_append(snapshot_t snap, const void *data, size_t size)
+{
+    if(!snapshot_reserve(snap, size))
+    {
+        return false;
+    }
+
+    memcpy(&snap->data[snap->size], data, size);
+    snap->size += size;
+
+    return true;
+}
+
+/**
+ * Gets the header of a snapshot, checking it is one.
+ *
+ * @param[in] snap      The snapshot handle
+ * @param[out] header   Filled in with the header
+ *
+ * @return true if the snapshot has a valid header
+ */
+static bool snapshot_get_header(snapshot_t snap, snapshot_header_t *header)
+{
+    if(snap->size < sizeof(snapshot_header_t))
+    {
+        return false;
+    }
+
+    memcpy(header, snap->data, sizeof(snapshot_header_t));
+
+    return (header->magic == SNAPSHOT_MAGIC) && (header->version == SNAPSHOT_VERSION);
+}
+
+/**
+ * Gets the length of a page of a memory.
+ *
+ * @param[in] size  Size of the memory
+ * @param[in] page  Number of the page
+ *
+ * @return The length of the page, which is only short for the last page
+ */
+static size_t snapshot_page_len(uint32_t size, uint32_t page)
+{
+    size_t offset = (size_t)page << SNAPSHOT_PAGE_SHIFT;
+
+    return (size - offset < SNAPSHOT_PAGE_SIZE) ? (size - offset) : SNAPSHOT_PAGE_SIZE;
+}
+
+/**
+ * Starts walking a block of pages.
+ *
+ * @param[out] cursor   The cursor to start
+ * @param[in] data      Contents of the snapshot
+ * @param[in] offset    Offset of the block
+ * @param[in] end       End of the section holding the block
+ *
+ * @return true if the block header is valid
+ */
+static bool snapshot_pages_start(snapshot_page_cursor_t *cursor, const uint8_t *data, size_t offset, size_t end)
+{
+    snapshot_pages_t pages;
+
+    if(end - offset < sizeof(snapshot_pages_t))
+    {
+        return false;
+    }
+
+    memcpy(&pages, &data[offset], sizeof(snapshot_pages_t));
+
+    cursor->data = data;
+    cursor->offset = offset + sizeof(snapshot_pages_t);
+    cursor->end = end;
+    cursor->size = pages.size;
+    cursor->remaining = pages.count;
+    cursor->page = 0;
+    cursor->len = 0;
+
+    return true;
+}
+
+/**
+ * Moves a cursor to the next page of a block, checking it is valid.
+ *
+ * @param[in,out] cursor    The cursor
+ *
+ * @return true if there is a valid next page, or false at the end of the block or on error
+ */
+static bool snapshot_pages_next(snapshot_page_cursor_t *cursor)
+{
+    uint32_t page;
+
+    if(cursor->remaining == 0 || cursor->end - cursor->offset < sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    memcpy(&page, &cursor->data[cursor->offset], sizeof(uint32_t));
+
+    /* Pages are in ascending order, after any page already passed. */
+    if(((size_t)page << SNAPSHOT_PAGE_SHIFT) >= cursor->size || (cursor->len != 0 && page <= cursor->page))
+    {
+        return false;
+    }
+
+    cursor->page = page;
+    cursor->len = snapshot_page_len(cursor->size, page);
+
+    return (cursor->end - cursor->offset - sizeof(uint32_t)) >= cursor->len;
+}
+
+/**
+ * Appends the page at a cursor to a snapshot, and moves past it.
+ *
+ * @param[in] snap      The snapshot to append to
+ * @param[in,out] cursor The cursor
+ *
+ * @return true if the page was appended
+ */
+static bool snapshot_pages_copy(snapshot_t snap, snapshot_page_cursor_t *cursor)
+{
+    size_t len = sizeof(uint32_t) + cursor->len;
+
+    if(!snapshot_append(snap, &cursor->data[cursor->offset], len))
+    {
+        return false;
+    }
+
+    cursor->offset += len;
+    --cursor->remaining;
+
+    return true;
+}
+
+/**
+ * Merges the pages of a section of a delta into those of the matching section of its base.
+ *
+ * @param[in] snap      The snapshot being built
+ * @param[in] base      Contents of the base
+ * @param[in] boffset   Offset of the first block of pages of the base section
+ * @param[in] bend      End of the base section
+ * @param[in] delta     Contents of the delta
+ * @param[in] doffset   Offset of the first block of pages of the delta section
+ * @param[in] dend      End of the delta section
+ *
+ * @return true if the blocks match and were merged
+ */
+static bool snapshot_merge_pages(snapshot_t snap, const uint8_t *base, size_t boffset, size_t bend,
+                                 const uint8_t *delta, size_t doffset, size_t dend)
+{
+    snapshot_page_cursor_t bcur;
+    snapshot_page_cursor_t dcur;
+    snapshot_pages_t pages;
+    size_t start;
+    bool bvalid;
+    bool dvalid;
+
+    while(boffset < bend || doffset < dend)
+    {
+        if(!snapshot_pages_start(&bcur, base, boffset, bend) ||
+           !snapshot_pages_start(&dcur, delta, doffset, dend) ||
+           bcur.size != dcur.size)
+        {
+            return false;
+        }
+
+        start = snap->size;
+        pages.size = bcur.size;
+        pages.count = 0;
+
+        if(!snapshot_append(snap, &pages, sizeof(snapshot_pages_t)))
+        {
+            return false;
+        }
+
+        bvalid = snapshot_pages_next(&bcur);
+        dvalid = snapshot_pages_next(&dcur);
+
+        /* Take the pages of both in order, with the delta's replacing the base's. */
+        while(bvalid || dvalid)
+        {
+            if(dvalid && (!bvalid || dcur.page <= bcur.page))
+            {
+                if(bvalid && bcur.page == dcur.page)
+                {
+                    bcur.offset += sizeof(uint32_t) + bcur.len;
+                    --bcur.remaining;
+                    bvalid = snapshot_pages_next(&bcur);
+                }
+
+                if(!snapshot_pages_copy(snap, &dcur))
+                {
+                    return false;
+                }
+
+                dvalid = snapshot_pages_next(&dcur);
+            }
+            else
+            {
+                if(!snapshot_pages_copy(snap, &bcur))
+                {
+                    return false;
+                }
+
+                bvalid = snapshot_pages_next(&bcur);
+            }
+
+            ++pages.count;
+        }
+
+        /* Every page of both blocks must have been valid. */
+        if(bcur.remaining != 0 || dcur.remaining != 0)
+        {
+            return false;
+        }
+
+        memcpy(&snap->data[start], &pages, sizeof(snapshot_pages_t));
+        boffset = bcur.offset;
+        doffset = dcur.offset;
+    }
+
+    return true;
+}
+
+/**
+ * Walks the sections of a snapshot alongside the registered hooks, checking they match.
+ *
+ * @param[in] emu   The emulator instance
+ * @param[in] snap  The snapshot to check
+ *
+ * @return true if every section has a matching hook and the sections fit in the snapshot
+ */
+static bool snapshot_check(cbemu_t emu, snapshot_t snap)
+{
+    snapshot_header_t header;
+    snapshot_section_t section;
+    struct snapshot_hook_s *hook;
+    listnode_t *node;
+    size_t offset;
+    uint32_t count = 0;
+
+    /* Deltas have to be collapsed onto their base first. */
+    if(!snapshot_get_header(snap, &header) || header.parent != 0)
+    {
+        return false;
+    }
+
+    offset = sizeof(snapshot_header_t);
+
+    list_iterate(&emu->snapshot_hooks, node)
+    {
+        hook = list_container(node, struct snapshot_hook_s, node);
+
+        if(count == header.sections || snap->size - offset < sizeof(snapshot_section_t))
+        {
+            return false;
+        }
+
+        memcpy(&section, &snap->data[offset], sizeof(snapshot_section_t));
+        offset += sizeof(snapshot_section_t);
+
+        if(memcmp(section.name, hook->name, SNAPSHOT_MAX_NAME) != 0 || section.size > snap->size - offset ||
+           section.plain > section.size)
+        {
+            return false;
+        }
+
+        offset += section.size;
+        ++count;
+    }
+
+    return (count == header.sections) && (offset == snap->size);
+}
+
+/**
+ * Registers the hooks of a device. Sections are saved and restored in the order the hooks are
+ * registered.
+ *
+ * @param[in] emu       The emulator instance.
+ * @param[in] name      Name of the device, identifying its section. Names need not be unique.
+ * @param[in] save      The hook serializing the device's state.
+ * @param[in] restore   The hook deserializing the device's state.
+ * @param[in] userdata  Passed to the hooks.
+ *
+ * @return A handle for the registered hooks, or NULL on error.
+ */
+snapshot_hook_t snapshot_register(cbemu_t emu, const char *name, snapshot_save_cb_t save, snapshot_restore_cb_t restore, void *userdata)
+{
+    snapshot_hook_t hook;
+
+    if(emu == NULL || name == NULL || save == NULL || restore == NULL || strlen(name) >= SNAPSHOT_MAX_NAME)
+    {
+        return NULL;
+    }
+
+    hook = malloc(sizeof(struct snapshot_hook_s));
+
+    if(hook == NULL)
+    {
+        return NULL;
+    }
+
+    /* The name is zero padded, so it can be compared with the section header directly. */
+    memset(hook, 0, sizeof(struct snapshot_hook_s));
+    strcpy(hook->name, name);
+    hook->save = save;
+    hook->restore = restore;
+    hook->userdata = userdata;
+
+    list_add_tail(&emu->snapshot_hooks, &hook->node);
+
+    return hook;
+}
+
+/**
+ * Unregisters the hooks of a device.
+ *
+ * @param[in] hook  Handle returned by snapshot_register.
+ */
+void snapshot_unregister(snapshot_hook_t hook)
+{
+    if(hook == NULL)
+    {
+        return;
+    }
+
+    list_remove(&hook->node);
+    free(hook);
+}
+
+/**
+ * Frees any hooks still registered with an emulator.
+ *
+ * @param[in] emu   The emulator instance
+ */
+void snapshot_free_hooks(cbemu_t emu)
+{
+    list_free_offset(&emu->snapshot_hooks, struct snapshot_hook_s, node);
+}
+
+/**
+ * Creates an empty snapshot buffer. A buffer can be saved into repeatedly, reusing its memory.
+ *
+ * @return The snapshot handle, or NULL on error.
+ */
+snapshot_t snapshot_init(void)
+{
+    snapshot_t snap;
+
+    snap = malloc(sizeof(struct snapshot_s));
+
+    if(snap != NULL)
+    {
+        memset(snap, 0, sizeof(struct snapshot_s));
+    }
+
+    return snap;
+}
+
+/**
+ * Frees a snapshot buffer.
+ *
+ * @param[in] snap  The snapshot handle.
+ */
+void snapshot_cleanup(snapshot_t snap)
+{
+    if(snap == NULL)
+    {
+        return;
+    }
+
+    free(snap->data);
+    free(snap);
+}
+
+/**
+ * Captures the state of an emulator, replacing the contents of a snapshot.
+ *
+ * @param[in] emu       The emulator instance
+ * @param[in] snap      The snapshot to save into
+ * @param[in] parent    Number of the snapshot a delta follows, or 0 for a full snapshot
+ *
+ * @return true if the state was captured
+ */
+static bool snapshot_capture(cbemu_t emu, snapshot_t snap, uint64_t parent)
+{
+    snapshot_header_t header;
+    snapshot_section_t section;
+    struct snapshot_hook_s *hook;
+    listnode_t *node;
+    bool result = true;
+
+    /* Bring lazily synchronized devices up to date, so their hooks capture the current state. */
+    clock_sync_all(emu);
+
+    snap->size = 0;
+    snap->delta = (parent != 0);
+
+    memset(&header, 0, sizeof(snapshot_header_t));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.seq = emu->snapshot_count + 1;
+    header.parent = parent;
+
+    result = snapshot_append(snap, &header, sizeof(snapshot_header_t));
+
+    list_iterate(&emu->snapshot_hooks, node)
+    {
+        if(!result)
+        {
+            break;
+        }
+
+        hook = list_container(node, struct snapshot_hook_s, node);
+
+        /* Reserve the section header, and fill in its sizes once the state is written. */
+        memset(&section, 0, sizeof(snapshot_section_t));
+        memcpy(section.name, hook->name, SNAPSHOT_MAX_NAME);
+
+        snap->section = snap->size;
+        snap->paged = false;
+
+        result = snapshot_append(snap, &section, sizeof(snapshot_section_t)) && hook->save(snap, hook->userdata);
+
+        if(result)
+        {
+            section.size = (uint32_t)(snap->size - snap->section - sizeof(snapshot_section_t));
+            section.plain = snap->paged ? (uint32_t)snap->plain : section.size;
+            memcpy(&snap->data[snap->section], &section, sizeof(snapshot_section_t));
+            ++header.sections;
+        }
+    }
+
+    snap->paged = false;
+
+    /* The dirty pages of some hooks may have been cleared, so no delta can follow a failed save. */
+    if(!result)
+    {
+        snap->size = 0;
+        emu->snapshot_seq = 0;
+        return false;
+    }
+
+    memcpy(snap->data, &header, sizeof(snapshot_header_t));
+
+    emu->snapshot_count = header.seq;
+    emu->snapshot_seq = header.seq;
+
+    return true;
+}
+
+/**
+ * Captures the state of an emulator, replacing the contents of a snapshot.
+ *
+ * @param[in] emu   The emulator instance.
+ * @param[in] snap  The snapshot to save into.
+ *
+ * @return true if the state was captured.
+ */
+bool snapshot_save(cbemu_t emu, snapshot_t snap)
+{
+    if(emu == NULL || snap == NULL)
+    {
+        return false;
+    }
+
+    return snapshot_capture(emu, snap, 0);
+}
+
+/**
+ * Captures the changes to an emulator since it was saved to or restored from a snapshot, replacing
+ * the contents of another snapshot. Pages of memory that haven't been written are left out.
+ *
+ * @param[in] emu       The emulator instance.
+ * @param[in] snap      The snapshot to save into.
+ * @param[in] parent    The snapshot the emulator was last saved to or restored from.
+ *
+ * @return true if the changes were captured, or false if the parent is not the last snapshot.
+ */
+bool snapshot_save_delta(cbemu_t emu, snapshot_t snap, snapshot_t parent)
+{
+    snapshot_header_t header;
+
+    if(emu == NULL || snap == NULL || parent == NULL || snap == parent || !snapshot_get_header(parent, &header))
+    {
+        return false;
+    }
+
+    /* The dirty pages are only relative to the last snapshot. */
+    if(emu->snapshot_seq == 0 || header.seq != emu->snapshot_seq)
+    {
+        return false;
+    }
+
+    return snapshot_capture(emu, snap, header.seq);
+}
+
+/**
+ * Applies a delta snapshot to the snapshot it follows. The result replaces the contents of the
+ * base, and is a full snapshot if the base was, or a delta covering both otherwise.
+ *
+ * @param[in] base  The snapshot the delta was saved relative to.
+ * @param[in] delta The delta snapshot.
+ *
+ * @return true if the delta was applied.
+ */
+bool snapshot_collapse(snapshot_t base, snapshot_t delta)
+{
+    struct snapshot_s merged;
+    snapshot_header_t bheader;
+    snapshot_header_t dheader;
+    snapshot_header_t header;
+    snapshot_section_t bsection;
+    snapshot_section_t dsection;
+    snapshot_section_t section;
+    size_t boffset;
+    size_t doffset;
+    size_t start;
+    uint32_t index;
+    bool result;
+
+    if(base == NULL || delta == NULL || base == delta ||
+       !snapshot_get_header(base, &bheader) || !snapshot_get_header(delta, &dheader))
+    {
+        return false;
+    }
+
+    if(dheader.parent == 0 || dheader.parent != bheader.seq || dheader.sections != bheader.sections)
+    {
+        return false;
+    }
+
+    memset(&merged, 0, sizeof(struct snapshot_s));
+
+    header = dheader;
+    header.parent = bheader.parent;
+
+    result = snapshot_append(&merged, &header, sizeof(snapshot_header_t));
+    boffset = sizeof(snapshot_header_t);
+    doffset = sizeof(snapshot_header_t);
+
+    for(index = 0; index < dheader.sections && result; ++index)
+    {
+        if(base->size - boffset < sizeof(snapshot_section_t) || delta->size - doffset < sizeof(snapshot_section_t))
+        {
+            result = false;
+            break;
+        }
+
+        memcpy(&bsection, &base->data[boffset], sizeof(snapshot_section_t));
+        memcpy(&dsection, &delta->data[doffset], sizeof(snapshot_section_t));
+        boffset += sizeof(snapshot_section_t);
+        doffset += sizeof(snapshot_section_t);
+
+        if(memcmp(bsection.name, dsection.name, SNAPSHOT_MAX_NAME) != 0 ||
+           bsection.size > base->size - boffset || bsection.plain > bsection.size ||
+           dsection.size > delta->size - doffset || dsection.plain > dsection.size)
+        {
+            result = false;
+            break;
+        }
+
+        /* The rest of the state is always whole, so the delta's replaces the base's. */
+        start = merged.size;
+        section = dsection;
+
+        result = snapshot_append(&merged, &section, sizeof(snapshot_section_t)) &&
+                 snapshot_append(&merged, &delta->data[doffset], dsection.plain) &&
+                 snapshot_merge_pages(&merged, base->data, boffset + bsection.plain, boffset + bsection.size,
+                                      delta->data, doffset + dsection.plain, doffset + dsection.size);
+
+        if(result)
+        {
+            section.size = (uint32_t)(merged.size - start - sizeof(snapshot_section_t));
+            memcpy(&merged.data[start], &section, sizeof(snapshot_section_t));
+        }
+
+        boffset += bsection.size;
+        doffset += dsection.size;
+    }
+
+    if(!result || boffset != base->size || doffset != delta->size)
+    {
+        free(merged.data);
+        return false;
+    }
+
+    free(base->data);
+    base->data = merged.data;
+    base->size = merged.size;
+    base->capacity = merged.capacity;
+
+    return true;
+}
+
+/**
+ * Checks whether a snapshot is a delta, which must be collapsed before it can be restored.
+ *
+ * @param[in] snap  The snapshot handle.
+ *
+ * @return true if the snapshot holds a delta.
+ */
+bool snapshot_is_delta(snapshot_t snap)
+{
+    snapshot_header_t header;
+
+    return (snap != NULL) && snapshot_get_header(snap, &header) && (header.parent != 0);
+}
+
+/**
+ * Restores the state of an emulator from a snapshot. The sections are checked against the
+ * registered hooks before anything is restored, but if a hook then fails, the emulator is left
+ * partly restored.
+ *
+ * @param[in] emu   The emulator instance.
+ * @param[in] snap  The snapshot to restore.
+ *
+ * @return true if the state was restored.
+ */
+bool snapshot_restore(cbemu_t emu, snapshot_t snap)
+{
+    snapshot_header_t header;
+    snapshot_section_t section;
+    struct snapshot_hook_s *hook;
+    listnode_t *node;
+    size_t offset;
+    bool result = true;
+
+    if(emu == NULL || snap == NULL || !snapshot_check(emu, snap))
+    {
+        return false;
+    }
+
+    memcpy(&header, snap->data, sizeof(snapshot_header_t));
+
+    offset = sizeof(snapshot_header_t);
+
+    list_iterate(&emu->snapshot_hooks, node)
+    {
+        hook = list_container(node, struct snapshot_hook_s, node);
+
+        memcpy(&section, &snap->data[offset], sizeof(snapshot_section_t));
+        offset += sizeof(snapshot_section_t);
+
+        snap->cursor = offset;
+        snap->end = offset + section.size;
+
+        /* Each hook must consume exactly what it saved. */
+        if(!hook->restore(snap, hook->userdata) || snap->cursor != snap->end)
+        {
+            result = false;
+            break;
+        }
+
+        offset = snap->end;
+    }
+
+    snap->cursor = 0;
+    snap->end = 0;
+
+    /* Deltas can follow the restored snapshot, as its hooks have cleared their dirty pages. */
+    emu->snapshot_seq = result ? header.seq : 0;
+
+    return result;
+}
+
+/**
+ * Gets the serialized contents of a snapshot, such as to write to a file.
+ *
+ * @param[in] snap  The snapshot handle.
+ * @param[out] size Set to the size of the contents in bytes.
+ *
+ * @return The contents, which remain valid until the snapshot is next changed.
+ */
+const uint8_t *snapshot_get_data(snapshot_t snap, size_t *size)
+{
+    if(snap == NULL || size == NULL)
+    {
+        return NULL;
+    }
+
+    *size = snap->size;
+
+    return snap->data;
+}
+
+/**
+ * Replaces the contents of a snapshot with previously serialized contents. They are checked
+ * when restored.
+ *
+ * @param[in] snap  The snapshot handle.
+ * @param[in] data  The serialized contents.
+ * @param[in] size  Size of the contents in bytes.
+ *
+ * @return true if the contents were copied.
+ */
+bool snapshot_set_data(snapshot_t snap, const uint8_t *data, size_t size)
+{
+    if(snap == NULL || data == NULL)
+    {
+        return false;
+    }
+
+    snap->size = 0;
+
+    return snapshot_append(snap, data, size);
+}
+
+/**
+ * Appends state to the section being saved. Only valid within a save hook.
+ *
+ * @param[in] snap  The snapshot being saved.
+ * @param[in] data  The state to append.
+ * @param[in] size  Size of the state in bytes.
+ *
+ * @return true if the state was appended.
+ */
+bool snapshot_write(snapshot_t snap, const void *data, size_t size)
+{
+    /* Pages must come after the rest of the state of a section. */
+    if(snap == NULL || data == NULL || snap->paged)
+    {
+        return false;
+    }
+
+    return snapshot_append(snap, data, size);
+}
+
+/**
+ * Reads the next state from the section being restored. Only valid within a restore hook.
+ *
+ * @param[in] snap  The snapshot being restored.
+ * @param[out] data Filled in with the state.
+ * @param[in] size  Size of the state in bytes.
+ *
+ * @return true if the state was read, or false if the section is too short.
+ */
+bool snapshot_read(snapshot_t snap, void *data, size_t size)
+{
+    if(snap == NULL || data == NULL || size > snap->end - snap->cursor)
+    {
+        return false;
+    }
+
+    memcpy(data, &snap->data[snap->cursor], size);
+    snap->cursor += size;
+
+    return true;
+}
+
+/**
+ * Appends the pages of a memory to the section being saved. A full snapshot holds every page,
+ * while a delta only holds those marked in the dirty bitmap, which is then cleared. Only valid
+ * within a save hook, after any other state has been written.
+ *
+ * @param[in] snap      The snapshot being saved.
+ * @param[in] data      The memory.
+ * @param[in] size      Size of the memory in bytes.
+ * @param[in,out] dirty Bitmap of pages written since the last snapshot, of SNAPSHOT_DIRTY_SIZE(size).
+ *
+ * @return true if the pages were appended.
+ */
+bool snapshot_write_pages(snapshot_t snap, const uint8_t *data, size_t size, uint8_t *dirty)
+{
+    snapshot_pages_t pages;
+    size_t start;
+    uint32_t page;
+    size_t len;
+
+    if(snap == NULL || data == NULL || dirty == NULL || size > UINT32_MAX)
+    {
+        return false;
+    }
+
+    if(!snap->paged)
+    {
+        snap->paged = true;
+        snap->plain = snap->size - snap->section - sizeof(snapshot_section_t);
+    }
+
+    start = snap->size;
+    pages.size = (uint32_t)size;
+    pages.count = 0;
+
+    if(!snapshot_append(snap, &pages, sizeof(snapshot_pages_t)))
+    {
+        return false;
+    }
+
+    for(page = 0; ((size_t)page << SNAPSHOT_PAGE_SHIFT) < size; ++page)
+    {
+        if(snap->delta && !(dirty[page >> 3] & (1 << (page & 0x07))))
+        {
+            continue;
+        }
+
+        len = snapshot_page_len(pages.size, page);
+
+        if(!snapshot_append(snap, &page, sizeof(page)) ||
+           !snapshot_append(snap, &data[(size_t)page << SNAPSHOT_PAGE_SHIFT], len))
+        {
+            return false;
+        }
+
+        ++pages.count;
+    }
+
+    memcpy(&snap->data[start], &pages, sizeof(snapshot_pages_t));
+    memset(dirty, 0, SNAPSHOT_DIRTY_SIZE(size));
+
+    return true;
+}
+
+/**
+ * Reads the pages of a memory from the section being restored, and clears its dirty bitmap. Only
+ * valid within a restore hook.
+ *
+ * @param[in] snap      The snapshot being restored.
+ * @param[out] data     The memory.
+ * @param[in] size      Size of the memory in bytes, which must match the size saved.
+ * @param[out] dirty    Bitmap of pages written since the last snapshot, of SNAPSHOT_DIRTY_SIZE(size).
+ *
+ * @return true if the pages were read.
+ */
+bool snapshot_read_pages(snapshot_t snap, uint8_t *data, size_t size, uint8_t *dirty)
+{
+    snapshot_page_cursor_t cursor;
+
+    if(snap == NULL || data == NULL || dirty == NULL ||
+       !snapshot_pages_start(&cursor, snap->data, snap->cursor, snap->end) || cursor.size != size)
+    {
+        return false;
+    }
+
+    while(snapshot_pages_next(&cursor))
+    {
+        memcpy(&data[(size_t)cursor.page << SNAPSHOT_PAGE_SHIFT], &cursor.data[cursor.offset + sizeof(uint32_t)], cursor.len);
+        cursor.offset += sizeof(uint32_t) + cursor.len;
+        --cursor.remaining;
+    }
+
+    if(cursor.remaining != 0)
+    {
+        return false;
+    }
+
+    snap->cursor = cursor.offset;
+    memset(dirty, 0, SNAPSHOT_DIRTY_SIZE(size));
+
+    return true;
+}
@@ -0,0 +1,610 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tracefile_priv.h"
+
+struct tracefile_s
+{
+    const uint8_t *map;                 /**< The mapped file. */
+    size_t size;                        /**< Size of the mapping. */
+    const recorder_record_t *records;   /**< Records within the mapping. */
+    uint64_t num_records;
+    const tracefile_block_t *blocks;    /**< Index blocks, either mapped or built. */
+    uint64_t num_blocks;
+    tracefile_index_t built;            /**< Index built on open if the file has none. */
+};
+
+#define PAGE_BIT_SET(bitmap, page) ((bitmap)[(page) >> 3] & (1 << ((page) & 0x07)))
+
+/**
+ * Adds records to an index.
+ *
+ * @param[in] index     The index to update.
+ * @param[in] records   The records to add.
+ * @param[in] count     The number of records.
+ *
+ * @return true if the records were added, or false if memory could not be allocated.
+ */
+bool tracefile_index_add(tracefile_index_t *index, const recorder_record_t *records, size_t count)
+{
+    const recorder_record_t *record;
+    tracefile_block_t *block;
+    tracefile_block_t *blocks;
+    uint64_t capacity;
+    uint8_t page;
+    size_t pos;
+
+    for(pos = 0; pos < count; ++pos)
+    {
+        record = &records[pos];
+
+        if(index->num_records % TRACEFILE_BLOCK_RECORDS == 0)
+        {
+            if(index->num_blocks == index->capacity)
+            {
+                capacity = (index->capacity != 0) ? index->capacity * 2 : 64;
+                blocks = realloc(index->blocks, (size_t)capacity * sizeof(tracefile_block_t));
+
+                if(blocks == NULL)
+                {
+                    return false;
+                }
+
+                index->blocks = blocks;
+                index->capacity = capacity;
+            }
+
+            block = &index->blocks[index->num_blocks++];
+            memset(block, 0, sizeof(tracefile_block_t));
+            block->first_cycle = record->cycle;
+            block->min_pc = 0xFFFF;
+        }
+
+        block = &index->blocks[index->num_blocks - 1];
+        block->last_cycle = record->cycle;
+
+        if(record->pc < block->min_pc)
+            block->min_pc = record->pc;
+
+        if(record->pc > block->max_pc)
+            block->max_pc = record->pc;
+
+        if(record->flags & RECORD_SYNC)
+            ++block->syncs;
+
+        page = (uint8_t)(record->addr >> 8);
+        block->pages[page >> 3] |= (uint8_t)(1 << (page & 0x07));
+
+        if(record->flags & RECORD_WRITE)
+            block->writes[page >> 3] |= (uint8_t)(1 << (page & 0x07));
+
+        ++index->num_records;
+    }
+
+    return true;
+}
+
+/**
+ * Frees the memory used by an index.
+ *
+ * @param[in] index     The index to free.
+ */
+void tracefile_index_free(tracefile_index_t *index)
+{
+    free(index->blocks);
+    memset(index, 0, sizeof(tracefile_index_t));
+}
+
+/**
+ * Locates the index at the end of a mapped trace file.
+ *
+ * @param[in] handle    The trace file handle, with the file mapped.
+ *
+ * @return true if a valid index was found.
+ */
+static bool tracefile_find_index(tracefile_t handle)
+{
+    tracefile_footer_t footer;
+    uint64_t records_size;
+
+    if(handle->size < sizeof(recorder_file_header_t) + sizeof(footer))
+    {
+        return false;
+    }
+
+    memcpy(&footer, handle->map + handle->size - sizeof(footer), sizeof(footer));
+
+    if(memcmp(footer.magic, TRACEFILE_INDEX_MAGIC, sizeof(footer.magic)) != 0 ||
+       footer.num_records > handle->size / sizeof(recorder_record_t) ||
+       footer.num_blocks > handle->size / sizeof(tracefile_block_t))
+    {
+        return false;
+    }
+
+    records_size = footer.num_records * sizeof(recorder_record_t);
+
+    /* The index must immediately follow the records, and the footer the index. */
+    if(footer.index_offset != sizeof(recorder_file_header_t) + records_size ||
+       footer.index_offset + footer.num_blocks * sizeof(tracefile_block_t) + sizeof(footer) != handle->size ||
+       footer.num_blocks != (footer.num_records + TRACEFILE_BLOCK_RECORDS - 1) / TRACEFILE_BLOCK_RECORDS)
+    {
+        return false;
+    }
+
+    handle->num_records = footer.num_records;
+    handle->blocks = (const tracefile_block_t *)(handle->map + footer.index_offset);
+    handle->num_blocks = footer.num_blocks;
+
+    return true;
+}
+
+/**
+ * Opens and maps a trace file.
+ *
+ * @param[in] filename  The trace file to open.
+ *
+ * @return The trace file handle, or NULL if the file could not be opened or is not a trace file.
+ */
+tracefile_t tracefile_open(const char *filename)
+{
+    tracefile_t handle;
+    recorder_file_header_t header;
+    struct stat info;
+    void *map;
+    int fd;
+
+    if(filename == NULL)
+    {
+        return NULL;
+    }
+
+    fd = open(filename, O_RDONLY);
+
+    if(fd < 0)
+    {
+        return NULL;
+    }
+
+    if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(header))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    memcpy(&header, map, sizeof(header));
+
+    if(memcmp(header.magic, RECORDER_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version > RECORDER_VERSION || header.record_size != sizeof(recorder_record_t))
+    {
+        munmap(map, (size_t)info.st_size);
+        return NULL;
+    }
+
+    handle = malloc(sizeof(struct tracefile_s));
+
+    if(handle == NULL)
+    {
+        munmap(map, (size_t)info.st_size);
+        return NULL;
+    }
+
+    memset(handle, 0, sizeof(struct tracefile_s));
+
+    handle->map = map;
+    handle->size = (size_t)info.st_size;
+    handle->records = (const recorder_record_t *)(handle->map + sizeof(header));
+
+    if(!tracefile_find_index(handle))
+    {
+        /* Index whatever complete records the file contains. */
+        handle->num_records = (handle->size - sizeof(header)) / sizeof(recorder_record_t);
+
+        if(!tracefile_index_add(&handle->built, handle->records, (size_t)handle->num_records))
+        {
+            tracefile_close(handle);
+            return NULL;
+        }
+
+        handle->blocks = handle->built.blocks;
+        handle->num_blocks = handle->built.num_blocks;
+    }
+
+    return handle;
+}
+
+/**
+ * Gets the number of records in a trace file.
+ *
+ * @param[in] handle    The trace file handle.
+ *
+ * @return The number of records.
+ */
+uint64_t tracefile_get_count(tracefile_t handle)
+{
+    if(handle == NULL)
+    {
+        return 0;
+    }
+
+    return handle->num_records;
+}
+
+/**
+ * Gets a record by its position in a trace file.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] index     The index of the record.
+ *
+ * @return The record, or NULL if the index is out of range.
+ */
+const recorder_record_t *tracefile_get_record(tracefile_t handle, uint64_t index)
+{
+    if(handle == NULL || index >= handle->num_records)
+    {
+        return NULL;
+    }
+
+    return &handle->records[index];
+}
+
+/**
+ * Finds the first record made on or after a cycle.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] cycle     The cycle to find.
+ *
+ * @return The index of the record, or the number of records if there is none.
+ */
+uint64_t tracefile_find_cycle(tracefile_t handle, uint64_t cycle)
+{
+    uint64_t low = 0;
+    uint64_t high;
+    uint64_t mid;
+
+    if(handle == NULL)
+    {
+        return 0;
+    }
+
+    /* Find the first block that ends at or after the cycle... */
+    high = handle->num_blocks;
+
+    while(low < high)
+    {
+        mid = low + (high - low) / 2;
+
+        if(handle->blocks[mid].last_cycle < cycle)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if(low == handle->num_blocks)
+    {
+        return handle->num_records;
+    }
+
+    /* ...then the first record within it. */
+    high = (low + 1) * TRACEFILE_BLOCK_RECORDS;
+    low = low * TRACEFILE_BLOCK_RECORDS;
+
+    if(high > handle->num_records)
+        high = handle->num_records;
+
+    while(low < high)
+    {
+        mid = low + (high - low) / 2;
+
+        if(handle->records[mid].cycle < cycle)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/**
+ * Finds the last write to an address made before a cycle.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] addr      The address written.
+ * @param[in] before    Only writes made before this cycle are considered.
+ *
+ * @return The write record, or NULL if the address was not written.
+ */
+const recorder_record_t *tracefile_last_write(tracefile_t handle, uint16_t addr, uint64_t before)
+{
+    const recorder_record_t *record;
+    uint64_t end;
+    uint64_t block;
+    uint64_t index;
+    uint8_t page = (uint8_t)(addr >> 8);
+
+    if(handle == NULL)
+    {
+        return NULL;
+    }
+
+    end = tracefile_find_cycle(handle, before);
+
+    if(end == 0)
+    {
+        return NULL;
+    }
+
+    block = (end - 1) / TRACEFILE_BLOCK_RECORDS;
+
+    for(;;)
+    {
+        if(PAGE_BIT_SET(handle->blocks[block].writes, page))
+        {
+            for(index = end; index-- > block * TRACEFILE_BLOCK_RECORDS;)
+            {
+                record = &handle->records[index];
+
+                if((record->flags & RECORD_WRITE) && record->addr == addr)
+                {
+                    return record;
+                }
+            }
+        }
+
+        if(block == 0)
+        {
+            break;
+        }
+
+        end = block * TRACEFILE_BLOCK_RECORDS;
+        --block;
+    }
+
+    return NULL;
+}
+
+/**
+ * Determines if a block may contain records matching a query.
+ *
+ * @param[in] block     The index block.
+ * @param[in] query     The query parameters.
+ *
+ * @return true if the block needs to be searched.
+ */
+static bool tracefile_block_matches(const tracefile_block_t *block, const tracefile_query_t *query)
+{
+    const uint8_t *bitmap = query->writes_only ? block->writes : block->pages;
+    unsigned int page;
+
+    if(block->max_pc < query->pc_start || block->min_pc > query->pc_end)
+    {
+        return false;
+    }
+
+    for(page = query->addr_start >> 8; page <= (unsigned int)(query->addr_end >> 8); ++page)
+    {
+        if(PAGE_BIT_SET(bitmap, page))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Calls back for each record matching a query, in the order they were recorded.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] query     The query parameters.
+ * @param[in] callback  Callback made for each matching record.
+ * @param[in] userdata  Userdata supplied to the callback.
+ *
+ * @return The number of matching records.
+ */
+uint64_t tracefile_query(tracefile_t handle, const tracefile_query_t *query, tracefile_cb_t callback, void *userdata)
+{
+    const recorder_record_t *record;
+    uint64_t count = 0;
+    uint64_t index;
+    uint64_t block;
+    uint64_t end;
+
+    if(handle == NULL || query == NULL || query->addr_start > query->addr_end || query->pc_start > query->pc_end)
+    {
+        return 0;
+    }
+
+    index = tracefile_find_cycle(handle, query->cycle_start);
+
+    for(block = index / TRACEFILE_BLOCK_RECORDS;
+        block < handle->num_blocks && handle->blocks[block].first_cycle <= query->cycle_end;
+        ++block)
+    {
+        end = (block + 1) * TRACEFILE_BLOCK_RECORDS;
+
+        if(end > handle->num_records)
+            end = handle->num_records;
+
+        if(!tracefile_block_matches(&handle->blocks[block], query))
+        {
+            index = end;
+            continue;
+        }
+
+        for(; index < end; ++index)
+        {
+            record = &handle->records[index];
+
+            if(record->cycle > query->cycle_end)
+            {
+                return count;
+            }
+
+            if(record->addr < query->addr_start || record->addr > query->addr_end ||
+               record->pc < query->pc_start || record->pc > query->pc_end ||
+               (query->writes_only && !(record->flags & RECORD_WRITE)))
+            {
+                continue;
+            }
+
+            ++count;
+
+            if(callback != NULL && !callback(record, userdata))
+            {
+                return count;
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Calls back for the opcode fetches around a cycle, in the order they were recorded. This gives
+ * the history of instructions executed leading up to and following an event.
+ *
+ * @param[in] handle    The trace file handle.
+ * @param[in] cycle     The cycle of the event.
+ * @param[in] before    Maximum number of fetches made before the cycle.
+ * @param[in] after     Maximum number of fetches made on or after the cycle.
+ * @param[in] callback  Callback made for each fetch.
+ * @param[in] userdata  Userdata supplied to the callback.
+ *
+ * @return The number of fetches.
+ */
+uint64_t tracefile_pc_history(tracefile_t handle, uint64_t cycle, unsigned int before, unsigned int after,
+                              tracefile_cb_t callback, void *userdata)
+{
+    const recorder_record_t *record;
+    uint64_t count = 0;
+    uint64_t mid;
+    uint64_t index;
+    uint64_t block;
+    unsigned int found;
+
+    if(handle == NULL)
+    {
+        return 0;
+    }
+
+    mid = tracefile_find_cycle(handle, cycle);
+
+    /* Walk back to the earliest fetch to report, skipping blocks without any. */
+    index = mid;
+    found = 0;
+
+    while(found < before && index > 0)
+    {
+        block = (index - 1) / TRACEFILE_BLOCK_RECORDS;
+
+        if(handle->blocks[block].syncs == 0)
+        {
+            index = block * TRACEFILE_BLOCK_RECORDS;
+            continue;
+        }
+
+        --index;
+
+        if(handle->records[index].flags & RECORD_SYNC)
+            ++found;
+    }
+
+    for(; index < mid; ++index)
+    {
+        record = &handle->records[index];
+
+        if(record->flags & RECORD_SYNC)
+        {
+            ++count;
+
+            if(callback != NULL && !callback(record, userdata))
+            {
+                return count;
+            }
+        }
+    }
+
+    found = 0;
+
+    while(found < after && index < handle->num_records)
+    {
+        block = index / TRACEFILE_BLOCK_RECORDS;
+
+        if(index % TRACEFILE_BLOCK_RECORDS == 0 && handle->blocks[block].syncs == 0)
+        {
+            index += TRACEFILE_BLOCK_RECORDS;
+            continue;
+        }
+
+        record = &handle->records[index++];
+
+        if(record->flags & RECORD_SYNC)
+        {
+            ++found;
+            ++count;
+
+            if(callback != NULL && !callback(record, userdata))
+            {
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Formats a record as a single line of text.
+ *
+ * @param[in] record    The record to format.
+ * @param[out] buffer   Buffer to populate.
+ * @param[in] size      Size of the buffer.
+ */
+void tracefile_format_record(const recorder_record_t *record, char *buffer, size_t size)
+{
+    if(record == NULL || buffer == NULL || size == 0)
+    {
+        return;
+    }
+
+    snprintf(buffer, size, "%12" PRIu64 "  PC $%04x  %c $%04x = $%02x%s%s",
+             record->cycle, record->pc, (record->flags & RECORD_WRITE) ? 'W' : 'R', record->addr, record->value,
+             (record->flags & RECORD_SYNC) ? "  SYNC" : "",
+             (record->flags & RECORD_DUMMY) ? "  DUMMY" : "");
+}
+
+/**
+ * Unmaps and closes a trace file.
+ *
+ * @param[in] handle    The trace file handle.
+ */
+void tracefile_close(tracefile_t handle)
+{
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    munmap((void *)handle->map, handle->size);
+    tracefile_index_free(&handle->built);
+
+    free(handle);
+}
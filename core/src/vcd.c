@@ -0,0 +1,527 @@
+/*
+ * (c) 2022 Matt Seabold
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "vcd.h"
+#include "clock.h"
+#include "cpu_priv.h"
+#include "log.h"
+
+/** Number of changes in the ring. Must be a power of 2. */
+#define VCD_RING_CHANGES    0x10000
+#define VCD_RING_MASK       (VCD_RING_CHANGES - 1)
+
+/** Number of pending changes the writer waits for before writing, unless stopping. */
+#define VCD_BATCH_CHANGES   0x1000
+
+/** How long the writer sleeps while waiting for a batch. */
+#define VCD_IDLE_NS         1000000
+
+/** Size of the file's stdio buffer. */
+#define VCD_FILE_BUFFER     0x40000
+
+/** Padding used to keep the producer and consumer indices on separate cache lines. */
+#define VCD_CACHE_LINE      64
+
+/** Maximum length of scope and signal names, including the terminator. */
+#define VCD_NAME_LEN        32
+
+/** First printable character used for signal identifiers. */
+#define VCD_ID_BASE         '!'
+
+/** Signals included in every capture. */
+enum
+{
+    VCD_CPU_ADDR,
+    VCD_CPU_DATA,
+    VCD_CPU_RWB,
+    VCD_CPU_SYNC,
+    VCD_CPU_IRQB,
+    VCD_CPU_NMIB,
+    VCD_CPU_RDY,
+};
+
+typedef struct
+{
+    char scope[VCD_NAME_LEN];
+    char name[VCD_NAME_LEN];
+    uint8_t width;
+    uint32_t value;     /**< Current value, only accessed by the emulation thread once started. */
+} vcd_signal_info_t;
+
+/** A single value change queued for the writer. */
+typedef struct
+{
+    uint64_t cycle;     /**< CPU cycle of the change. */
+    uint32_t value;     /**< New value of the signal. */
+    uint16_t signal;    /**< The signal that changed. */
+    uint16_t reserved;
+} vcd_change_t;
+
+struct vcd_s
+{
+    cbemu_t emu;
+    FILE *file;
+    pthread_t thread;
+    bus_cb_handle_t tracer;
+    bus_cb_handle_t watcher;
+    bool started;
+    atomic_bool stop;
+    bool error;                 /**< Set by the writer thread if a write fails. */
+    clk_period_t period;        /**< Period of the main clock in ns. */
+    uint64_t last_time;         /**< Last timestamp written, owned by the writer thread. */
+
+    vcd_signal_info_t signals[VCD_MAX_SIGNALS];
+    unsigned int num_signals;
+
+    /* Producer state, only accessed by the emulation thread. */
+    uint64_t tail_cache;        /**< Last tail index read by the producer. */
+
+    atomic_uint_fast64_t head;  /**< Index of the next change to be produced. */
+    uint8_t pad[VCD_CACHE_LINE];
+    atomic_uint_fast64_t tail;  /**< Index of the next change to be written to the file. */
+    uint8_t pad2[VCD_CACHE_LINE];
+
+    vcd_change_t ring[VCD_RING_CHANGES];
+};
+
+static void vcd_queue(vcd_t handle, vcd_signal_t signal, uint32_t value)
+{
+    vcd_change_t *change;
+    uint64_t head;
+
+    head = atomic_load_explicit(&handle->head, memory_order_relaxed);
+
+    if(head - handle->tail_cache == VCD_RING_CHANGES)
+    {
+        /* The writer has fallen behind, so wait for it rather than lose changes. */
+        do
+        {
+            handle->tail_cache = atomic_load_explicit(&handle->tail, memory_order_acquire);
+
+            if(head - handle->tail_cache == VCD_RING_CHANGES)
+            {
+                sched_yield();
+            }
+        } while(head - handle->tail_cache == VCD_RING_CHANGES);
+    }
+
+    change = &handle->ring[head & VCD_RING_MASK];
+    change->cycle = handle->emu->cpu.cycles;
+    change->value = value;
+    change->signal = (uint16_t)signal;
+    change->reserved = 0;
+
+    atomic_store_explicit(&handle->head, head + 1, memory_order_release);
+}
+
+static void vcd_bus_trace(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata)
+{
+    vcd_t handle = (vcd_t)userdata;
+
+    vcd_set_signal(handle, VCD_CPU_ADDR, addr);
+    vcd_set_signal(handle, VCD_CPU_DATA, value);
+    vcd_set_signal(handle, VCD_CPU_RWB, write ? 0 : 1);
+    vcd_set_signal(handle, VCD_CPU_SYNC, (flags & SYNC) ? 1 : 0);
+}
+
+static void vcd_sig_watch(bus_signal_t signal, bool asserted, void *userdata)
+{
+    vcd_t handle = (vcd_t)userdata;
+
+    /* The pins are all active low. */
+    switch(signal)
+    {
+        case BUS_SIG_IRQ:
+            vcd_set_signal(handle, VCD_CPU_IRQB, asserted ? 0 : 1);
+            break;
+        case BUS_SIG_NMI:
+            vcd_set_signal(handle, VCD_CPU_NMIB, asserted ? 0 : 1);
+            break;
+        case BUS_SIG_RDY:
+            vcd_set_signal(handle, VCD_CPU_RDY, asserted ? 0 : 1);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Writes a value for a signal, in the format used by both the initial dump and value changes.
+ *
+ * @param[in] handle    The VCD writer handle.
+ * @param[in] signal    The signal.
+ * @param[in] value     The value of the signal.
+ */
+static void vcd_write_value(vcd_t handle, unsigned int signal, uint32_t value)
+{
+    char buffer[VCD_MAX_WIDTH + 4];
+    uint8_t width = handle->signals[signal].width;
+    unsigned int pos = 0;
+    int bit;
+
+    if(width == 1)
+    {
+        buffer[pos++] = value ? '1' : '0';
+    }
+    else
+    {
+        buffer[pos++] = 'b';
+
+        for(bit = width - 1; bit >= 0; --bit)
+        {
+            buffer[pos++] = (value & (1UL << bit)) ? '1' : '0';
+        }
+
+        buffer[pos++] = ' ';
+    }
+
+    buffer[pos++] = (char)(VCD_ID_BASE + signal);
+    buffer[pos++] = '\n';
+
+    fwrite(buffer, 1, pos, handle->file);
+}
+
+static void *vcd_thread(void *param)
+{
+    static const struct timespec idle = { 0, VCD_IDLE_NS };
+    vcd_t handle = (vcd_t)param;
+    const vcd_change_t *change;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t time;
+    bool stop;
+
+    tail = atomic_load_explicit(&handle->tail, memory_order_relaxed);
+
+    for(;;)
+    {
+        /* The producer is finished once stop is set, so the head read after it is final. */
+        stop = atomic_load_explicit(&handle->stop, memory_order_acquire);
+        head = atomic_load_explicit(&handle->head, memory_order_acquire);
+
+        if(head == tail && stop)
+        {
+            break;
+        }
+
+        if(head - tail < VCD_BATCH_CHANGES && !stop)
+        {
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        for(; tail != head; ++tail)
+        {
+            change = &handle->ring[tail & VCD_RING_MASK];
+            time = change->cycle * handle->period;
+
+            if(time != handle->last_time)
+            {
+                fprintf(handle->file, "#%" PRIu64 "\n", time);
+                handle->last_time = time;
+            }
+
+            vcd_write_value(handle, change->signal, change->value);
+
+            /* Hand space back in batches, rather than contending on every change. */
+            if((tail & (VCD_BATCH_CHANGES - 1)) == VCD_BATCH_CHANGES - 1)
+            {
+                atomic_store_explicit(&handle->tail, tail + 1, memory_order_release);
+            }
+        }
+
+        if(ferror(handle->file))
+        {
+            /* Keep draining so the emulator isn't blocked, but the file is incomplete. */
+            handle->error = true;
+        }
+
+        atomic_store_explicit(&handle->tail, tail, memory_order_release);
+    }
+
+    return NULL;
+}
+
+/**
+ * Creates a VCD writer. Signals may be added until the capture is started.
+ *
+ * @param[in] emulator  The emulator instance to capture.
+ * @param[in] filename  The file to write. It is truncated if it exists.
+ *
+ * @return The VCD writer instance, or NULL if there was an error.
+ */
+vcd_t vcd_init(cbemu_t emulator, const char *filename)
+{
+    vcd_t handle;
+
+    if(emulator == NULL || filename == NULL)
+    {
+        return NULL;
+    }
+
+    handle = malloc(sizeof(struct vcd_s));
+
+    if(handle == NULL)
+    {
+        return NULL;
+    }
+
+    memset(handle, 0, sizeof(struct vcd_s));
+
+    handle->emu = emulator;
+    handle->period = clock_get_period(clock_get_core_clk(emulator));
+    atomic_init(&handle->stop, false);
+    atomic_init(&handle->head, 0);
+    atomic_init(&handle->tail, 0);
+
+    /* The CPU signals, in the order of their fixed indices. */
+    vcd_add_signal(handle, "cpu", "addr", 16, 0);
+    vcd_add_signal(handle, "cpu", "data", 8, 0);
+    vcd_add_signal(handle, "cpu", "rwb", 1, 1);
+    vcd_add_signal(handle, "cpu", "sync", 1, 0);
+    vcd_add_signal(handle, "cpu", "irqb", 1, emu_bus_sig_asserted(emulator, BUS_SIG_IRQ) ? 0 : 1);
+    vcd_add_signal(handle, "cpu", "nmib", 1, emu_bus_sig_asserted(emulator, BUS_SIG_NMI) ? 0 : 1);
+    vcd_add_signal(handle, "cpu", "rdy", 1, emu_bus_sig_asserted(emulator, BUS_SIG_RDY) ? 0 : 1);
+
+    handle->file = fopen(filename, "w");
+
+    if(handle->file == NULL)
+    {
+        log_print(lWARNING, "Unable to open VCD file %s", filename);
+        free(handle);
+        return NULL;
+    }
+
+    setvbuf(handle->file, NULL, _IOFBF, VCD_FILE_BUFFER);
+
+    return handle;
+}
+
+/**
+ * Adds a signal to the capture.
+ *
+ * @param[in] handle    The VCD writer handle.
+ * @param[in] scope     Name of the module the signal belongs to.
+ * @param[in] name      Name of the signal.
+ * @param[in] width     Width of the signal in bits, from 1 to VCD_MAX_WIDTH.
+ * @param[in] initial   Value of the signal when the capture starts.
+ *
+ * @return The signal handle, or VCD_INVALID_SIGNAL if it could not be added or the capture has
+ *         already started.
+ */
+vcd_signal_t vcd_add_signal(vcd_t handle, const char *scope, const char *name, uint8_t width, uint32_t initial)
+{
+    vcd_signal_info_t *info;
+
+    if(handle == NULL || scope == NULL || name == NULL || handle->started ||
+       handle->num_signals == VCD_MAX_SIGNALS || width == 0 || width > VCD_MAX_WIDTH ||
+       strlen(scope) >= VCD_NAME_LEN || strlen(name) >= VCD_NAME_LEN)
+    {
+        return VCD_INVALID_SIGNAL;
+    }
+
+    info = &handle->signals[handle->num_signals];
+    strcpy(info->scope, scope);
+    strcpy(info->name, name);
+    info->width = width;
+    info->value = (width < 32) ? (initial & ((1UL << width) - 1)) : initial;
+
+    return (vcd_signal_t)handle->num_signals++;
+}
+
+/**
+ * Writes the file header and starts capturing.
+ *
+ * @param[in] handle    The VCD writer handle.
+ *
+ * @return true if the capture was started.
+ */
+bool vcd_start(vcd_t handle)
+{
+    vcd_signal_info_t *info;
+    unsigned int scope;
+    unsigned int index;
+    unsigned int prev;
+
+    if(handle == NULL || handle->started)
+    {
+        return false;
+    }
+
+    fprintf(handle->file, "$version CB6502-emu $end\n");
+    fprintf(handle->file, "$timescale 1ns $end\n");
+
+    /* Group the signals by scope, in the order each scope was first used. */
+    for(scope = 0; scope < handle->num_signals; ++scope)
+    {
+        for(prev = 0; prev < scope; ++prev)
+        {
+            if(strcmp(handle->signals[prev].scope, handle->signals[scope].scope) == 0)
+                break;
+        }
+
+        if(prev < scope)
+        {
+            continue;
+        }
+
+        fprintf(handle->file, "$scope module %s $end\n", handle->signals[scope].scope);
+
+        for(index = scope; index < handle->num_signals; ++index)
+        {
+            info = &handle->signals[index];
+
+            if(strcmp(info->scope, handle->signals[scope].scope) == 0)
+            {
+                fprintf(handle->file, "$var wire %u %c %s $end\n", info->width, (char)(VCD_ID_BASE + index), info->name);
+            }
+        }
+
+        fprintf(handle->file, "$upscope $end\n");
+    }
+
+    handle->last_time = handle->emu->cpu.cycles * handle->period;
+
+    fprintf(handle->file, "$enddefinitions $end\n");
+    fprintf(handle->file, "#%" PRIu64 "\n$dumpvars\n", handle->last_time);
+
+    for(index = 0; index < handle->num_signals; ++index)
+    {
+        vcd_write_value(handle, index, handle->signals[index].value);
+    }
+
+    fprintf(handle->file, "$end\n");
+
+    if(ferror(handle->file) || pthread_create(&handle->thread, NULL, vcd_thread, handle) != 0)
+    {
+        return false;
+    }
+
+    handle->started = true;
+    handle->tracer = emu_bus_add_tracer(handle->emu, vcd_bus_trace, handle);
+    handle->watcher = emu_bus_add_sig_watcher(handle->emu, vcd_sig_watch, handle);
+
+    return handle->tracer != NULL && handle->watcher != NULL;
+}
+
+/**
+ * Sets the value of a signal at the current emulated time. Setting a signal to its current value
+ * does nothing. Values set before the capture starts become the initial value.
+ *
+ * @param[in] handle    The VCD writer handle.
+ * @param[in] signal    The signal to set.
+ * @param[in] value     The new value of the signal.
+ */
+void vcd_set_signal(vcd_t handle, vcd_signal_t signal, uint32_t value)
+{
+    vcd_signal_info_t *info;
+
+    if(handle == NULL || signal < 0 || (unsigned int)signal >= handle->num_signals)
+    {
+        return;
+    }
+
+    info = &handle->signals[signal];
+
+    if(info->width < 32)
+    {
+        value &= (1UL << info->width) - 1;
+    }
+
+    if(info->value == value)
+    {
+        return;
+    }
+
+    info->value = value;
+
+    if(handle->started)
+    {
+        vcd_queue(handle, signal, value);
+    }
+}
+
+/**
+ * Gets the number of value changes captured so far.
+ *
+ * @param[in] handle    The VCD writer handle.
+ *
+ * @return The number of value changes.
+ */
+uint64_t vcd_get_count(vcd_t handle)
+{
+    if(handle == NULL)
+    {
+        return 0;
+    }
+
+    return atomic_load_explicit(&handle->head, memory_order_relaxed);
+}
+
+/**
+ * Stops capturing, writes any remaining changes, closes the file and frees the writer.
+ *
+ * @param[in] handle    The VCD writer handle.
+ *
+ * @return true if every change was written to the file.
+ */
+bool vcd_cleanup(vcd_t handle)
+{
+    uint64_t time;
+    bool success;
+
+    if(handle == NULL)
+    {
+        return false;
+    }
+
+    if(handle->tracer != NULL)
+    {
+        emu_bus_remove_tracer(handle->emu, handle->tracer);
+    }
+
+    if(handle->watcher != NULL)
+    {
+        emu_bus_remove_sig_watcher(handle->emu, handle->watcher);
+    }
+
+    if(handle->started)
+    {
+        atomic_store_explicit(&handle->stop, true, memory_order_release);
+        pthread_join(handle->thread, NULL);
+
+        /* Mark the end of the capture, so the last values extend to it. */
+        time = handle->emu->cpu.cycles * handle->period;
+
+        if(time != handle->last_time)
+        {
+            fprintf(handle->file, "#%" PRIu64 "\n", time);
+        }
+    }
+
+    success = !handle->error && !ferror(handle->file);
+
+    if(fclose(handle->file) != 0)
+    {
+        success = false;
+    }
+
+    if(!success)
+    {
+        log_print(lWARNING, "Failed to write VCD file");
+    }
+
+    free(handle);
+
+    return success;
+}
@@ -2,14 +2,25 @@
 #define __DBGCLI_H__
 
 #include "emulator.h"
+#include "profiler.h"
+#include "sanitizer.h"
 
 typedef struct dbgcli_config_s
 {
     uint32_t valid_flags;
     const char *label_file;
+    const char *dbginfo_file;
+    const char *profile_file;
+    profiler_format_t profile_format;
+    const char *coverage_file;
+    sanitizer_t sanitizer;
 } dbgcli_config_t;
 
-#define DBGCLI_CONFIG_FLAG_LABEL_FILE_VALID 0x00000001
+#define DBGCLI_CONFIG_FLAG_LABEL_FILE_VALID     0x00000001
+#define DBGCLI_CONFIG_FLAG_DBGINFO_FILE_VALID   0x00000002
+#define DBGCLI_CONFIG_FLAG_PROFILE_FILE_VALID   0x00000004
+#define DBGCLI_CONFIG_FLAG_COVERAGE_FILE_VALID  0x00000008
+#define DBGCLI_CONFIG_FLAG_SANITIZER_VALID      0x00000010
 
 /**
  * Take control of the program execution and begins the debugger CLI
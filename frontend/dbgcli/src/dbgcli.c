@@ -1,14 +1,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "dbgcli.h"
 #include "debugger.h"
 #include "disassemble.h"
+#include "profiler.h"
+#include "coverage.h"
+#include "recorder.h"
+#include "tracefile.h"
 #include "os_signal.h"
+#include "os_notify.h"
 
 #define CMD_DELIM " "
 #define MAX_PARAMS 10
+#define DEFAULT_PROFILE_ENTRIES 20
+#define DEFAULT_TRACE_HISTORY 10
+#define MAX_HEATMAP_CONNS 32
 
 typedef struct cmd_param_s
 {
@@ -30,6 +39,11 @@ typedef struct dbgcli_context_s
 {
     cbemu_t emulator;
     debug_t debugger;
+    profiler_t profiler;
+    coverage_t coverage;
+    cc65_dbginfo dbginfo;
+    recorder_t recorder;
+    tracefile_t tracefile;
     bool exit;
 } dbgcli_context_t;
 
@@ -43,6 +57,11 @@ static void cmd_registers(uint32_t num_params, cmd_param_t *params);
 static void cmd_quit(uint32_t num_params, cmd_param_t *params);
 static void cmd_examine(uint32_t num_params, cmd_param_t *params);
 static void cmd_finish(uint32_t num_params, cmd_param_t *params);
+static void cmd_profile(uint32_t num_params, cmd_param_t *params);
+static void cmd_coverage(uint32_t num_params, cmd_param_t *params);
+static void cmd_trace(uint32_t num_params, cmd_param_t *params);
+static void cmd_watch(uint32_t num_params, cmd_param_t *params);
+static void cmd_heatmap(uint32_t num_params, cmd_param_t *params);
 
 static const dbg_cmd_t dbg_cmd_list[] = {
     { "continue", 'c', cmd_continue },
@@ -53,32 +72,43 @@ static const dbg_cmd_t dbg_cmd_list[] = {
     { "quit", 'q', cmd_quit },
     { "examine", 'x', cmd_examine },
     { "finish", 'f', cmd_finish },
+    { "profile", 'p', cmd_profile },
+    { "coverage", 'v', cmd_coverage },
+    { "trace", 't', cmd_trace },
+    { "watch", 'w', cmd_watch },
+    { "heatmap", 'h', cmd_heatmap },
 };
 
 #define NUM_CMDS (sizeof(dbg_cmd_list)/sizeof(dbg_cmd_t))
 
-static void cmd_continue(uint32_t num_params, cmd_param_t *params)
+static void print_break(debug_breakpoint_t bp)
 {
-    debug_breakpoint_t bp;
-
-    debug_run(cxt.debugger, &bp);
+    debug_watch_hit_t hit;
 
     if(bp == BREAKPOINT_HANDLE_SW_REQUEST)
         printf("\nSW Break requested\n");
+    else if(debug_get_watch_hit(cxt.debugger, &hit) && hit.handle == bp)
+        printf("Watchpoint #%u hit: %s 0x%02x at 0x%04x by 0x%04x\n", bp, hit.write ? "write" : "read", hit.value, hit.address, hit.pc);
     else
         printf("Breakpoint #%u hit\n", bp);
 }
 
+static void cmd_continue(uint32_t num_params, cmd_param_t *params)
+{
+    debug_breakpoint_t bp;
+
+    debug_run(cxt.debugger, &bp);
+
+    print_break(bp);
+}
+
 static void cmd_next(uint32_t num_params, cmd_param_t *params)
 {
     debug_breakpoint_t bp;
 
     if(debug_next(cxt.debugger, &bp))
     {
-        if(bp == BREAKPOINT_HANDLE_SW_REQUEST)
-            printf("\nSW Break requested\n");
-        else
-            printf("Breakpoint #%u hit\n", bp);
+        print_break(bp);
     }
 }
 
@@ -88,10 +118,7 @@ static void cmd_finish(uint32_t num_params, cmd_param_t *params)
 
     if(debug_finish(cxt.debugger, &bp))
     {
-        if(bp == BREAKPOINT_HANDLE_SW_REQUEST)
-            printf("\nSW Break requested\n");
-        else
-            printf("Breakpoint #%u hit\n", bp);
+        print_break(bp);
     }
 }
 
@@ -119,8 +146,8 @@ static void cmd_registers(uint32_t num_params, cmd_param_t *params)
 
 static void cmd_breakpoint(uint32_t num_params, cmd_param_t *params)
 {
-    breakpoint_info_t breakpoints[8];
-    uint32_t num_breakpoints = 8;
+    breakpoint_info_t breakpoints[DEBUG_MAX_BREAKPOINTS];
+    uint32_t num_breakpoints = DEBUG_MAX_BREAKPOINTS;
     uint32_t index;
     debug_breakpoint_t bp;
     bool result;
@@ -131,7 +158,17 @@ static void cmd_breakpoint(uint32_t num_params, cmd_param_t *params)
 
         for (index = 0; index < num_breakpoints; ++index)
         {
-            printf("#%u: 0x%04x\n", breakpoints[index].handle, breakpoints[index].address);
+            if(breakpoints[index].watch_ops != 0)
+            {
+                printf("#%u: watch 0x%04x-0x%04x %s%s%s\n", breakpoints[index].handle, breakpoints[index].address, breakpoints[index].end_address,
+                       (breakpoints[index].watch_ops & DEBUG_WATCH_READ) ? "r" : "",
+                       (breakpoints[index].watch_ops & DEBUG_WATCH_WRITE) ? "w" : "",
+                       (breakpoints[index].watch_ops & DEBUG_WATCH_CHANGE) ? "c" : "");
+            }
+            else
+            {
+                printf("#%u: 0x%04x\n", breakpoints[index].handle, breakpoints[index].address);
+            }
         }
     }
     else
@@ -182,7 +219,7 @@ static void cmd_examine(uint32_t num_params, cmd_param_t *params)
         return;
     }
 
-    debug_dump(cxt.debugger, addr, &len, buf);
+    debug_dump_fast(cxt.debugger, addr, &len, buf);
 
     for(i=0,col=0; i<len; ++i)
     {
@@ -206,6 +243,409 @@ static void cmd_examine(uint32_t num_params, cmd_param_t *params)
 
 }
 
+static void cmd_profile(uint32_t num_params, cmd_param_t *params)
+{
+    unsigned int max_entries = DEFAULT_PROFILE_ENTRIES;
+
+    if(cxt.profiler == NULL)
+    {
+        printf("Profiler not enabled, set a profile output file to use it\n");
+        return;
+    }
+
+    if(num_params > 0)
+    {
+        if(params[0].int_valid)
+        {
+            max_entries = (unsigned int)params[0].ival;
+        }
+        else if(strcasecmp(params[0].sval, "reset") == 0)
+        {
+            profiler_reset(cxt.profiler);
+            printf("Profile reset\n");
+            return;
+        }
+        else if(num_params == 2 && strcasecmp(params[0].sval, "folded") == 0)
+        {
+            if(!profiler_dump(cxt.profiler, params[1].sval, PROFILER_FORMAT_FOLDED))
+                printf("Unable to write %s\n", params[1].sval);
+            return;
+        }
+        else if(num_params == 2 && strcasecmp(params[0].sval, "speedscope") == 0)
+        {
+            if(!profiler_dump(cxt.profiler, params[1].sval, PROFILER_FORMAT_SPEEDSCOPE))
+                printf("Unable to write %s\n", params[1].sval);
+            return;
+        }
+        else
+        {
+            printf("Usage: profile [reset | <count> | folded <file> | speedscope <file>]\n");
+            return;
+        }
+    }
+
+    profiler_report(cxt.profiler, stdout, max_entries);
+}
+
+static void cmd_coverage(uint32_t num_params, cmd_param_t *params)
+{
+    if(cxt.coverage == NULL)
+    {
+        printf("Coverage not enabled, set a coverage output file to use it\n");
+        return;
+    }
+
+    if(num_params > 0)
+    {
+        if(strcasecmp(params[0].sval, "reset") == 0)
+        {
+            coverage_reset(cxt.coverage);
+            printf("Coverage reset\n");
+            return;
+        }
+        else if(num_params == 2 && strcasecmp(params[0].sval, "lcov") == 0)
+        {
+            if(cxt.dbginfo == NULL)
+                printf("Debug info required for lcov output\n");
+            else if(!coverage_dump_lcov(cxt.coverage, cxt.dbginfo, params[1].sval, NULL))
+                printf("Unable to write %s\n", params[1].sval);
+            return;
+        }
+        else
+        {
+            printf("Usage: coverage [reset | lcov <file>]\n");
+            return;
+        }
+    }
+
+    printf("%u addresses executed\n", coverage_get_executed_count(cxt.coverage));
+}
+
+static bool trace_print_record(const recorder_record_t *record, void *userdata)
+{
+    char buffer[80];
+
+    tracefile_format_record(record, buffer, sizeof(buffer));
+    printf("%s\n", buffer);
+
+    return true;
+}
+
+static void trace_usage(void)
+{
+    printf("Usage: trace [record <file> | stop | open <file> | lastwrite <addr> [cycle] |\n"
+           "             access <start> <end> [<cycle> <cycle>] | pc <cycle> [count]]\n");
+}
+
+static void cmd_trace(uint32_t num_params, cmd_param_t *params)
+{
+    const recorder_record_t *record;
+    tracefile_query_t query;
+    uint64_t cycle;
+    unsigned int history;
+
+    if(num_params == 0)
+    {
+        if(cxt.recorder != NULL)
+            printf("Recording, %llu records\n", (unsigned long long)recorder_get_count(cxt.recorder));
+
+        if(cxt.tracefile != NULL)
+            printf("Trace file open, %llu records\n", (unsigned long long)tracefile_get_count(cxt.tracefile));
+        else if(cxt.recorder == NULL)
+            printf("No trace\n");
+
+        return;
+    }
+
+    if(num_params == 2 && strcasecmp(params[0].sval, "record") == 0)
+    {
+        if(cxt.recorder != NULL)
+        {
+            printf("Already recording\n");
+            return;
+        }
+
+        cxt.recorder = recorder_init(cxt.emulator, params[1].sval, NULL);
+
+        if(cxt.recorder == NULL)
+            printf("Unable to record to %s\n", params[1].sval);
+    }
+    else if(num_params == 1 && strcasecmp(params[0].sval, "stop") == 0)
+    {
+        if(cxt.recorder == NULL)
+        {
+            printf("Not recording\n");
+            return;
+        }
+
+        if(!recorder_cleanup(cxt.recorder))
+            printf("Trace incomplete\n");
+
+        cxt.recorder = NULL;
+    }
+    else if(num_params == 2 && strcasecmp(params[0].sval, "open") == 0)
+    {
+        tracefile_close(cxt.tracefile);
+        cxt.tracefile = tracefile_open(params[1].sval);
+
+        if(cxt.tracefile == NULL)
+            printf("Unable to open %s\n", params[1].sval);
+        else
+            printf("%llu records\n", (unsigned long long)tracefile_get_count(cxt.tracefile));
+    }
+    else if(cxt.tracefile == NULL)
+    {
+        printf("No trace file open\n");
+    }
+    else if((num_params == 2 || num_params == 3) && strcasecmp(params[0].sval, "lastwrite") == 0 &&
+            params[1].int_valid && (num_params == 2 || params[2].int_valid))
+    {
+        cycle = (num_params == 3) ? (uint64_t)params[2].ival : UINT64_MAX;
+        record = tracefile_last_write(cxt.tracefile, (uint16_t)params[1].ival, cycle);
+
+        if(record != NULL)
+            trace_print_record(record, NULL);
+        else
+            printf("Not written\n");
+    }
+    else if((num_params == 3 || num_params == 5) && strcasecmp(params[0].sval, "access") == 0 &&
+            params[1].int_valid && params[2].int_valid &&
+            (num_params == 3 || (params[3].int_valid && params[4].int_valid)))
+    {
+        memset(&query, 0, sizeof(query));
+        query.addr_start = (uint16_t)params[1].ival;
+        query.addr_end = (uint16_t)params[2].ival;
+        query.pc_end = 0xFFFF;
+        query.cycle_start = (num_params == 5) ? (uint64_t)params[3].ival : 0;
+        query.cycle_end = (num_params == 5) ? (uint64_t)params[4].ival : UINT64_MAX;
+
+        printf("%llu accesses\n", (unsigned long long)tracefile_query(cxt.tracefile, &query, trace_print_record, NULL));
+    }
+    else if((num_params == 2 || num_params == 3) && strcasecmp(params[0].sval, "pc") == 0 &&
+            params[1].int_valid && (num_params == 2 || params[2].int_valid))
+    {
+        history = (num_params == 3) ? (unsigned int)params[2].ival : DEFAULT_TRACE_HISTORY;
+        tracefile_pc_history(cxt.tracefile, (uint64_t)params[1].ival, history, history, trace_print_record, NULL);
+    }
+    else
+    {
+        trace_usage();
+    }
+}
+
+static void watch_usage(void)
+{
+    printf("Usage: watch <addr> [end] [r|w|rw|c] [=value]\n"
+           "       r: reads, w: writes, c: writes that change the value (default)\n");
+}
+
+static void cmd_watch(uint32_t num_params, cmd_param_t *params)
+{
+    debug_watch_t watch;
+    debug_breakpoint_t bp;
+    char *endptr;
+    uint32_t index;
+    long value;
+
+    if(num_params == 0 || !params[0].int_valid || params[0].ival < 0 || params[0].ival > 0xffff)
+    {
+        watch_usage();
+        return;
+    }
+
+    watch.addr_start = (uint16_t)params[0].ival;
+    watch.addr_end = watch.addr_start;
+    watch.ops = 0;
+    watch.match_value = false;
+    watch.value = 0;
+
+    for(index = 1; index < num_params; ++index)
+    {
+        if(params[index].int_valid && index == 1 && params[index].ival >= 0 && params[index].ival <= 0xffff)
+        {
+            watch.addr_end = (uint16_t)params[index].ival;
+        }
+        else if(params[index].sval[0] == '=')
+        {
+            value = strtol(&params[index].sval[1], &endptr, 0);
+
+            if(params[index].sval[1] == '\0' || *endptr != '\0' || value < 0 || value > 0xff)
+            {
+                watch_usage();
+                return;
+            }
+
+            watch.match_value = true;
+            watch.value = (uint8_t)value;
+        }
+        else if(strcmp(params[index].sval, "r") == 0)
+            watch.ops |= DEBUG_WATCH_READ;
+        else if(strcmp(params[index].sval, "w") == 0)
+            watch.ops |= DEBUG_WATCH_WRITE;
+        else if(strcmp(params[index].sval, "rw") == 0)
+            watch.ops |= DEBUG_WATCH_READ | DEBUG_WATCH_WRITE;
+        else if(strcmp(params[index].sval, "c") == 0)
+            watch.ops |= DEBUG_WATCH_CHANGE;
+        else
+        {
+            watch_usage();
+            return;
+        }
+    }
+
+    if(watch.ops == 0)
+        watch.ops = DEBUG_WATCH_CHANGE;
+
+    if(debug_set_watchpoint(cxt.debugger, &bp, &watch))
+        printf("Watchpoint #%u set\n", bp);
+    else
+        printf("Unable to set watchpoint\n");
+}
+
+/* Shades for the heatmap, from no accesses to the busiest page. */
+static const char heat_shades[] = " .:-=+*#%@";
+
+#define NUM_HEAT_SHADES (sizeof(heat_shades) - 1)
+
+/* Picks a shade on a log2 scale, so quiet pages remain visible next to the busy ones. */
+static char heat_shade(uint64_t count, uint64_t max)
+{
+    unsigned int count_bits = 0;
+    unsigned int max_bits = 0;
+
+    if(count == 0)
+        return heat_shades[0];
+
+    while(count_bits < 64 && (count >> count_bits) != 0)
+        ++count_bits;
+
+    while(max_bits < 64 && (max >> max_bits) != 0)
+        ++max_bits;
+
+    return heat_shades[1 + ((count_bits - 1) * (NUM_HEAT_SHADES - 2)) / (max_bits > 1 ? max_bits - 1 : 1)];
+}
+
+static uint64_t heat_count(const bus_counters_t *counters, char ops)
+{
+    switch(ops)
+    {
+        case 'r':
+            return counters->reads;
+        case 'w':
+            return counters->writes;
+        case 'f':
+            return counters->fetches;
+        default:
+            return counters->reads + counters->writes + counters->fetches;
+    }
+}
+
+static void heatmap_usage(void)
+{
+    printf("Usage: heatmap [on | off | reset | r | w | f]\n"
+           "       r: reads, w: writes, f: opcode fetches (default all accesses)\n");
+}
+
+static void cmd_heatmap(uint32_t num_params, cmd_param_t *params)
+{
+    static bus_counters_t pages[BUS_COUNTER_PAGES];
+    bus_conn_counters_t conns[MAX_HEATMAP_CONNS];
+    unsigned int num_conns;
+    unsigned int index;
+    unsigned int row, col;
+    uint64_t max = 0;
+    uint64_t total = 0;
+    uint64_t count;
+    char ops = 'a';
+    char range[24];
+
+    if(num_params > 0)
+    {
+        if(strcmp(params[0].sval, "on") == 0)
+        {
+            emu_bus_enable_counters(cxt.emulator, true);
+            printf("Counting bus accesses\n");
+            return;
+        }
+        else if(strcmp(params[0].sval, "off") == 0)
+        {
+            emu_bus_enable_counters(cxt.emulator, false);
+            printf("Stopped counting bus accesses\n");
+            return;
+        }
+        else if(strcmp(params[0].sval, "reset") == 0)
+        {
+            emu_bus_reset_counters(cxt.emulator);
+            return;
+        }
+        else if(strcmp(params[0].sval, "r") == 0 || strcmp(params[0].sval, "w") == 0 || strcmp(params[0].sval, "f") == 0)
+        {
+            ops = params[0].sval[0];
+        }
+        else
+        {
+            heatmap_usage();
+            return;
+        }
+    }
+
+    emu_bus_get_page_counters(cxt.emulator, pages);
+
+    for(index = 0; index < BUS_COUNTER_PAGES; ++index)
+    {
+        count = heat_count(&pages[index], ops);
+        total += count;
+
+        if(count > max)
+            max = count;
+    }
+
+    if(total == 0)
+    {
+        printf("No bus accesses counted. Use \"heatmap on\" to start counting.\n");
+        return;
+    }
+
+    /* One character per page, 16 pages (4K) per row. */
+    printf("      0123456789abcdef\n");
+
+    for(row = 0; row < BUS_COUNTER_PAGES / 16; ++row)
+    {
+        printf("%04x |", row << 12);
+
+        for(col = 0; col < 16; ++col)
+            putchar(heat_shade(heat_count(&pages[row * 16 + col], ops), max));
+
+        printf("|\n");
+    }
+
+    printf("Scale: '%s' (log2, max %llu)\n\n", &heat_shades[1], (unsigned long long)max);
+
+    num_conns = emu_bus_get_conn_counters(cxt.emulator, conns, MAX_HEATMAP_CONNS);
+
+    printf("%-10s %-14s %12s %12s %12s %7s\n", "Device", "Decode", "Reads", "Writes", "Fetches", "Share");
+
+    for(index = 0; index < num_conns && index < MAX_HEATMAP_CONNS; ++index)
+    {
+        if(conns[index].params.type == BUSDECODE_RANGE)
+            snprintf(range, sizeof(range), "%04x-%04x", conns[index].params.value.range.addr_start, conns[index].params.value.range.addr_end);
+        else if(conns[index].params.type == BUSDECODE_MASK)
+            snprintf(range, sizeof(range), "%04x/%04x", conns[index].params.value.mask.addr_value, conns[index].params.value.mask.addr_mask);
+        else
+            snprintf(range, sizeof(range), "custom");
+
+        printf("%-10s %-14s %12llu %12llu %12llu %6.2f%%\n",
+               conns[index].name != NULL ? conns[index].name : "?", range,
+               (unsigned long long)conns[index].counters.reads,
+               (unsigned long long)conns[index].counters.writes,
+               (unsigned long long)conns[index].counters.fetches,
+               100.0 * (double)heat_count(&conns[index].counters, ops) / (double)total);
+    }
+
+    if(num_conns > MAX_HEATMAP_CONNS)
+        printf("(%u more devices not shown)\n", num_conns - MAX_HEATMAP_CONNS);
+}
+
 static void cmd_step(uint32_t num_params, cmd_param_t *params)
 {
     debug_step(cxt.debugger);
@@ -278,6 +718,22 @@ static const dbg_cmd_t *parse_cmd(char *input, uint32_t *num_params, cmd_param_t
     return ret;
 }
 
+static void dbgcli_dbginfo_error(const cc65_parseerror *error)
+{
+    fprintf(stderr, "Dbg Parse Error: %c: %s %u:%u %s\n", error->type == CC65_ERROR ? 'E' : 'W', error->name, error->line, error->column, error->errormsg);
+}
+
+static void dbgcli_sanitizer_report(const sanitizer_report_t *report, void *userdata)
+{
+    char buffer[128];
+
+    sanitizer_format_report(report, buffer, sizeof(buffer));
+    printf("%s\n", buffer);
+
+    /* Stop at the offending instruction. */
+    debug_break((debug_t)userdata);
+}
+
 static void dbgcli_ctrlc_handler(os_signal_t signal, void *userdata)
 {
     if(userdata == NULL || signal != OS_CTRLC)
@@ -288,6 +744,103 @@ static void dbgcli_ctrlc_handler(os_signal_t signal, void *userdata)
     debug_break((debug_t)userdata);
 }
 
+/* Reads a line from stdin. Commands posted to the debugger by other threads are run while waiting,
+ * as the emulator is stopped at the prompt and nothing else would run them. */
+static char *dbgcli_read_line(char *buf, int size)
+{
+    int fds[2];
+
+    fds[0] = fileno(stdin);
+    fds[1] = debug_get_command_fd(cxt.debugger);
+
+    while(fds[1] >= 0 && os_wait_fds(fds, 2) == 1)
+    {
+        debug_process_commands(cxt.debugger);
+    }
+
+    return fgets(buf, size, stdin);
+}
+
+/* Loads the configured files and creates the tools asked for. Whatever was set up before a failure
+ * is left for dbgcli_cleanup to release. */
+static bool dbgcli_setup(cbemu_t emulator, dbgcli_config_t *config)
+{
+    if(config == NULL)
+        return true;
+
+    if(config->valid_flags & DBGCLI_CONFIG_FLAG_LABEL_FILE_VALID)
+    {
+        if(!debug_load_labels(cxt.debugger, config->label_file))
+            return false;
+
+        printf("labels loaded\n");
+    }
+
+    /* The profiler and coverage map hook every instruction, so only pay for them when their output
+     * has been asked for. */
+    if(config->valid_flags & DBGCLI_CONFIG_FLAG_PROFILE_FILE_VALID)
+        cxt.profiler = profiler_init(emulator);
+
+    if(config->valid_flags & DBGCLI_CONFIG_FLAG_COVERAGE_FILE_VALID)
+        cxt.coverage = coverage_init(emulator);
+
+    if(config->valid_flags & DBGCLI_CONFIG_FLAG_DBGINFO_FILE_VALID)
+    {
+        cxt.dbginfo = cc65_read_dbginfo(config->dbginfo_file, dbgcli_dbginfo_error);
+
+        if(cxt.dbginfo == NULL)
+            return false;
+
+        debug_set_dbginfo(cxt.debugger, 1, &cxt.dbginfo);
+        profiler_set_dbginfo(cxt.profiler, cxt.dbginfo);
+
+        printf("debug info loaded\n");
+    }
+
+    if(config->valid_flags & DBGCLI_CONFIG_FLAG_SANITIZER_VALID)
+    {
+        sanitizer_set_dbginfo(config->sanitizer, cxt.dbginfo);
+        sanitizer_set_callback(config->sanitizer, dbgcli_sanitizer_report, cxt.debugger);
+    }
+
+    return true;
+}
+
+/* Releases everything created by dbgcli_run and dbgcli_setup, including the debugger. */
+static void dbgcli_cleanup(dbgcli_config_t *config)
+{
+    profiler_cleanup(cxt.profiler);
+    cxt.profiler = NULL;
+
+    coverage_cleanup(cxt.coverage);
+    cxt.coverage = NULL;
+
+    if(cxt.recorder != NULL)
+    {
+        recorder_cleanup(cxt.recorder);
+        cxt.recorder = NULL;
+    }
+
+    tracefile_close(cxt.tracefile);
+    cxt.tracefile = NULL;
+
+    if(config && (config->valid_flags & DBGCLI_CONFIG_FLAG_SANITIZER_VALID))
+    {
+        sanitizer_set_callback(config->sanitizer, NULL, NULL);
+        sanitizer_set_dbginfo(config->sanitizer, NULL);
+    }
+
+    if(cxt.dbginfo != NULL)
+    {
+        debug_set_dbginfo(cxt.debugger, 0, NULL);
+        cc65_free_dbginfo(cxt.dbginfo);
+        cxt.dbginfo = NULL;
+    }
+
+    debug_cleanup(cxt.debugger);
+    cxt.debugger = NULL;
+}
+
 int dbgcli_run(cbemu_t emulator, dbgcli_config_t *config)
 {
     disassemble_string_t disbuf;
@@ -303,15 +856,10 @@ int dbgcli_run(cbemu_t emulator, dbgcli_config_t *config)
     if(cxt.debugger == NULL)
         return 1;
 
-    if(config)
+    if(!dbgcli_setup(emulator, config))
     {
-        if(config->valid_flags & DBGCLI_CONFIG_FLAG_LABEL_FILE_VALID)
-        {
-            if(!debug_load_labels(cxt.debugger, config->label_file))
-                return 1;
-
-            printf("labels loaded\n");
-        }
+        dbgcli_cleanup(config);
+        return 1;
     }
 
     cxt.exit = false;
@@ -319,13 +867,16 @@ int dbgcli_run(cbemu_t emulator, dbgcli_config_t *config)
 
     sighandle = os_register_signal(OS_CTRLC, dbgcli_ctrlc_handler, cxt.debugger);
 
+    /* Input is waited on through its file descriptor, so none may be left sitting in a buffer. */
+    setvbuf(stdin, NULL, _IONBF, 0);
+
     while(!cxt.exit)
     {
         disassemble_pc_string(cxt.emulator, &disbuf);
         printf("%s\n", disbuf.opcode_str);
         printf(">");
         fflush(stdout);
-        input = fgets(inbuf, sizeof(inbuf), stdin);
+        input = dbgcli_read_line(inbuf, sizeof(inbuf));
 
         if(input == NULL)
         {
@@ -354,5 +905,21 @@ int dbgcli_run(cbemu_t emulator, dbgcli_config_t *config)
         os_unregister_signal(sighandle);
     }
 
+    if(config && (config->valid_flags & DBGCLI_CONFIG_FLAG_PROFILE_FILE_VALID))
+    {
+        if(!profiler_dump(cxt.profiler, config->profile_file, config->profile_format))
+            fprintf(stderr, "Unable to write profile to %s\n", config->profile_file);
+    }
+
+    if(config && (config->valid_flags & DBGCLI_CONFIG_FLAG_COVERAGE_FILE_VALID))
+    {
+        if(cxt.dbginfo == NULL)
+            fprintf(stderr, "Debug info required to write coverage\n");
+        else if(!coverage_dump_lcov(cxt.coverage, cxt.dbginfo, config->coverage_file, NULL))
+            fprintf(stderr, "Unable to write coverage to %s\n", config->coverage_file);
+    }
+
+    dbgcli_cleanup(config);
+
     return 0;
 }
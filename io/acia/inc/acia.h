@@ -9,6 +9,11 @@ typedef uint8_t (*acia_trans_read_t)(void *handle);
 typedef void (*acia_trans_write_t)(void *handle, uint8_t data);
 typedef void (*acia_trans_cleanup_t)(void *handle);
 
+/* Gets a file descriptor that polls readable while the transport has data available, so the host
+ * can block on it while the emulated system waits for input. Returns -1 if there is none. This
+ * is optional, and may be NULL in the interface. */
+typedef int (*acia_trans_wait_fd_t)(void *handle);
+
 typedef struct
 {
     acia_trans_init_t init;
@@ -16,6 +21,7 @@ typedef struct
     acia_trans_read_t read;
     acia_trans_write_t write;
     acia_trans_cleanup_t cleanup;
+    acia_trans_wait_fd_t wait_fd;
 } acia_trans_interface_t;
 
 typedef struct acia_s *acia_t;
@@ -26,5 +32,6 @@ void acia_write(acia_t handle, uint8_t reg, uint8_t val);
 uint8_t acia_read(acia_t handle, uint8_t reg);
 void acia_cleanup(acia_t handle);
 void acia_tick(acia_t handle);
+int acia_get_wait_fd(acia_t handle);
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "acia.h"
 #include "clock.h"
+#include "snapshot.h"
 #include "log.h"
 
 #define ACIA_RS_TX_DATA 0x00
@@ -111,8 +112,9 @@ struct acia_s
     bus_cb_handle_t bus_handle;
     uint16_t base;
     clk_t bit_clock;
-    clock_cb_handle_t clock_cb;
+    clock_sync_handle_t sync;
     bus_signal_voter_t voter;
+    snapshot_hook_t snapshot;
 
     const acia_trans_interface_t *transport;
     void *trans_param;
@@ -164,11 +166,6 @@ static uint8_t acia_bus_read_cb(uint16_t addr, bus_flags_t flags, void *userdata
     return acia_read(handle, reg);
 }
 
-static void acia_tick_cb(clk_t clock, clock_edge_t edge, void *userdata)
-{
-    acia_tick((acia_t)userdata);
-}
-
 static const bus_handlers_t acia_bus_handlers =
 {
     acia_bus_write_cb,
@@ -205,6 +202,133 @@ static unsigned int acia_get_ticks_per_word(acia_t handle)
     return data_ticks + stop_ticks;
 }
 
+/**
+ * Schedules the next time the ACIA must be synchronized without being accessed, which is when a
+ * word completes. While idle with DTR set, the transport is also polled once every word time.
+ *
+ * @param[in] handle    The ACIA instance
+ */
+static void acia_schedule(acia_t handle)
+{
+    uint64_t next = 0;
+
+    if(handle->rx_ticks > 0)
+    {
+        next = handle->rx_ticks;
+    }
+    else if(handle->cmd_reg & ACIA_CMD_DTR_MASK)
+    {
+        next = acia_get_ticks_per_word(handle);
+    }
+
+    if((handle->tx_ticks > 0) && ((next == 0) || (handle->tx_ticks < next)))
+    {
+        next = handle->tx_ticks;
+    }
+
+    clock_sync_schedule(handle->sync, next);
+}
+
+/**
+ * Catches the ACIA up with its bit clock. The ticks between word boundaries are consumed in
+ * bulk, and only the ticks that start or complete a word are run individually.
+ *
+ * @param[in] clock     The bit clock
+ * @param[in] cycles    Number of bit clock ticks to catch up
+ * @param[in] userdata  The ACIA instance
+ */
+static void acia_sync_cb(clk_t clock, uint64_t cycles, void *userdata)
+{
+    acia_t handle = (acia_t)userdata;
+    uint64_t step;
+
+    while(cycles > 0)
+    {
+        step = cycles;
+
+        /* Data that arrived while idle is taken to have arrived just after the last sync. */
+        if((handle->rx_ticks == 0) && (handle->cmd_reg & ACIA_CMD_DTR_MASK) && handle->transport->available(handle->trans_handle))
+        {
+            step = 1;
+        }
+
+        if((handle->rx_ticks > 0) && (handle->rx_ticks < step))
+        {
+            step = handle->rx_ticks;
+        }
+
+        if((handle->tx_ticks > 0) && (handle->tx_ticks < step))
+        {
+            step = handle->tx_ticks;
+        }
+
+        if(handle->rx_ticks > 0)
+        {
+            handle->rx_ticks -= (unsigned int)(step - 1);
+        }
+
+        if(handle->tx_ticks > 0)
+        {
+            handle->tx_ticks -= (unsigned int)(step - 1);
+        }
+
+        acia_tick(handle);
+        cycles -= step;
+    }
+
+    acia_schedule(handle);
+}
+
+/**
+ * Brings the ACIA up to date with its bit clock.
+ *
+ * @param[in] handle    The ACIA instance
+ */
+static void acia_sync(acia_t handle)
+{
+    clock_sync(handle->sync);
+}
+
+static bool acia_snapshot_save(snapshot_t snap, void *userdata)
+{
+    acia_t handle = (acia_t)userdata;
+    uint8_t irq_pend = handle->irq_pend ? 1 : 0;
+
+    return snapshot_write(snap, &handle->ctl_reg.val, sizeof(handle->ctl_reg.val)) &&
+           snapshot_write(snap, &handle->cmd_reg, sizeof(handle->cmd_reg)) &&
+           snapshot_write(snap, &handle->stat_reg, sizeof(handle->stat_reg)) &&
+           snapshot_write(snap, &irq_pend, sizeof(irq_pend)) &&
+           snapshot_write(snap, &handle->tx_ticks, sizeof(handle->tx_ticks)) &&
+           snapshot_write(snap, &handle->rx_ticks, sizeof(handle->rx_ticks)) &&
+           snapshot_write(snap, &handle->write_val, sizeof(handle->write_val)) &&
+           snapshot_write(snap, &handle->read_val, sizeof(handle->read_val));
+}
+
+static bool acia_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    acia_t handle = (acia_t)userdata;
+    uint8_t irq_pend;
+
+    if(!snapshot_read(snap, &handle->ctl_reg.val, sizeof(handle->ctl_reg.val)) ||
+       !snapshot_read(snap, &handle->cmd_reg, sizeof(handle->cmd_reg)) ||
+       !snapshot_read(snap, &handle->stat_reg, sizeof(handle->stat_reg)) ||
+       !snapshot_read(snap, &irq_pend, sizeof(irq_pend)) ||
+       !snapshot_read(snap, &handle->tx_ticks, sizeof(handle->tx_ticks)) ||
+       !snapshot_read(snap, &handle->rx_ticks, sizeof(handle->rx_ticks)) ||
+       !snapshot_read(snap, &handle->write_val, sizeof(handle->write_val)) ||
+       !snapshot_read(snap, &handle->read_val, sizeof(handle->read_val)))
+    {
+        return false;
+    }
+
+    handle->irq_pend = (irq_pend != 0);
+
+    /* The clocks have been restored already, so the next word completes relative to now. */
+    acia_schedule(handle);
+
+    return true;
+}
+
 acia_t acia_init(cbemu_t emu, const acia_trans_interface_t *transport, void *transport_params, clk_t bit_clock)
 {
     bool error = false;
@@ -240,9 +364,19 @@ acia_t acia_init(cbemu_t emu, const acia_trans_interface_t *transport, void *tra
     if(!error)
     {
         cxt->bit_clock = bit_clock;
-        cxt->clock_cb = clock_register_tick(cxt->bit_clock, acia_tick_cb, cxt);
+        cxt->sync = clock_register_sync(cxt->bit_clock, acia_sync_cb, cxt);
+
+        if(cxt->sync == NULL)
+        {
+            error = true;
+        }
+    }
+
+    if(!error)
+    {
+        cxt->snapshot = snapshot_register(emu, "acia", acia_snapshot_save, acia_snapshot_restore, cxt);
 
-        if(cxt->clock_cb == NULL)
+        if(cxt->snapshot == NULL)
         {
             error = true;
         }
@@ -273,6 +407,7 @@ bool acia_register(acia_t handle, const bus_decode_params_t *decoder, uint16_t b
         if(handle->bus_handle != NULL)
         {
             handle->base = base_addr;
+            emu_bus_set_name(handle->emu, handle->bus_handle, "acia");
         }
         else
         {
@@ -308,6 +443,8 @@ void acia_write(acia_t handle, uint8_t reg, uint8_t val)
     if(handle == NULL)
         return;
 
+    acia_sync(handle);
+
     switch(reg)
     {
         case ACIA_RS_TX_DATA:
@@ -344,6 +481,8 @@ void acia_write(acia_t handle, uint8_t reg, uint8_t val)
             }
             break;
     }
+
+    acia_schedule(handle);
 }
 
 uint8_t acia_read(acia_t handle, uint8_t reg)
@@ -353,6 +492,8 @@ uint8_t acia_read(acia_t handle, uint8_t reg)
     if(handle == NULL)
         return 0xff;
 
+    acia_sync(handle);
+
     switch(reg)
     {
         case ACIA_RS_RX_DATA:
@@ -385,6 +526,14 @@ uint8_t acia_read(acia_t handle, uint8_t reg)
     return ret;
 }
 
+int acia_get_wait_fd(acia_t handle)
+{
+    if(handle == NULL || handle->trans_handle == NULL || handle->transport->wait_fd == NULL)
+        return -1;
+
+    return handle->transport->wait_fd(handle->trans_handle);
+}
+
 void acia_cleanup(acia_t handle)
 {
     if(handle == NULL)
@@ -405,13 +554,18 @@ void acia_cleanup(acia_t handle)
         emu_bus_unregister_sig_voter(handle->emu, handle->voter);
     }
 
-    if(handle->clock_cb != NULL)
+    if(handle->sync != NULL)
     {
-        clock_unregister_tick(handle->clock_cb);
+        clock_unregister_sync(handle->sync);
     }
+
+    snapshot_unregister(handle->snapshot);
+
     free(handle);
 }
 
+/* Advances the ACIA by a single bit clock tick. The ACIA follows its bit clock lazily, so this
+ * is only needed to drive it by hand. */
 void acia_tick(acia_t handle)
 {
     if(handle == NULL)
@@ -463,6 +617,7 @@ void acia_tick(acia_t handle)
         if(handle->tx_ticks == 0)
         {
             handle->transport->write(handle->trans_handle, handle->write_val);
+            emu_raise_events(handle->emu, EMU_EVENT_OUTPUT);
         }
     }
 }
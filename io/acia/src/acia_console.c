@@ -29,13 +29,20 @@ static void acia_console_cleanup(void *handle)
 {
 }
 
+static int acia_console_wait_fd(void *handle)
+{
+    /* No input, so nothing to wait on. */
+    return -1;
+}
+
 static const acia_trans_interface_t acia_console_iface =
 {
     acia_console_init,
     acia_console_available,
     acia_console_read,
     acia_console_write,
-    acia_console_cleanup
+    acia_console_cleanup,
+    acia_console_wait_fd
 };
 
 const acia_trans_interface_t *acia_console_get_iface(void)
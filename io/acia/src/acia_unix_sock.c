@@ -28,6 +28,7 @@ struct acia_unix_s
     int server_sock;
     int client_sock;
     int eventfd;
+    int rx_eventfd;
     bool shutdown;
 
     pthread_t thread_handle;
@@ -103,9 +104,13 @@ static void process_client(acia_unix_t cxt)
                         if(cxt->write_idx >= RING_BUFFER_SIZE)
                             cxt->write_idx -= RING_BUFFER_SIZE;
 
-                        /* Lock the context to change the number of bytes. */
+                        /* Lock the context to change the number of bytes. The rx eventfd is
+                         * kept readable for as long as the buffer isn't empty. */
                         pthread_mutex_lock(&cxt->lock);
 
+                        if(cxt->num_bytes == 0)
+                            eventfd_write(cxt->rx_eventfd, 1);
+
                         cxt->num_bytes += result;
 
                         pthread_mutex_unlock(&cxt->lock);
@@ -209,6 +214,9 @@ static void destroy_context(acia_unix_t cxt)
     if(cxt->eventfd >= 0)
         close(cxt->eventfd);
 
+    if(cxt->rx_eventfd >= 0)
+        close(cxt->rx_eventfd);
+
     unlink(cxt->sockname);
     free(cxt);
 }
@@ -235,6 +243,7 @@ static void *acia_unix_init(void *params)
     cxt->server_sock = -1;
     cxt->client_sock = -1;
     cxt->eventfd = -1;
+    cxt->rx_eventfd = -1;
     cxt->sockname = unix_p->sockname;
 
     if(pthread_mutex_init(&cxt->lock, NULL) < 0)
@@ -262,6 +271,16 @@ static void *acia_unix_init(void *params)
 
     cxt->eventfd = fd;
 
+    fd = eventfd(0, EFD_NONBLOCK);
+
+    if(fd < 0)
+    {
+        log_print(lNOTICE, "Unable to create eventfd: %s\n", strerror(errno));
+        goto error;
+    }
+
+    cxt->rx_eventfd = fd;
+
     fd = socket(AF_UNIX, SOCK_STREAM, 0);
 
     if(fd < 0)
@@ -338,6 +357,14 @@ static uint8_t acia_unix_read(void *handle)
     --cxt->num_bytes;
     pthread_cond_signal(&cxt->cond);
 
+    if(cxt->num_bytes == 0)
+    {
+        eventfd_t count;
+
+        /* The buffer is empty, so stop the rx eventfd from polling readable. */
+        (void)eventfd_read(cxt->rx_eventfd, &count);
+    }
+
     pthread_mutex_unlock(&cxt->lock);
 
     return data;
@@ -365,6 +392,16 @@ static void acia_unix_write(void *handle, uint8_t data)
     pthread_mutex_unlock(&cxt->lock);
 }
 
+static int acia_unix_wait_fd(void *handle)
+{
+    acia_unix_t cxt = (acia_unix_t)handle;
+
+    if(cxt == NULL)
+        return -1;
+
+    return cxt->rx_eventfd;
+}
+
 static void acia_unix_cleanup(void *handle)
 {
     acia_unix_t cxt = (acia_unix_t)handle;
@@ -394,7 +431,8 @@ const acia_trans_interface_t acia_unix_iface =
     acia_unix_available,
     acia_unix_read,
     acia_unix_write,
-    acia_unix_cleanup
+    acia_unix_cleanup,
+    acia_unix_wait_fd
 };
 
 const acia_trans_interface_t *acia_unix_get_iface(void)
@@ -3,6 +3,7 @@
  */
 #include "at28c256.h"
 #include "clock.h"
+#include "snapshot.h"
 #include "log.h"
 #include <stdlib.h>
 #include <string.h>
@@ -60,6 +61,7 @@ struct at28c256_s
     clk_t main_clk;
     clock_cb_handle_t tick_cb;
     uint8_t image[IMAGE_SIZE];
+    uint8_t dirty[SNAPSHOT_DIRTY_SIZE(IMAGE_SIZE)];
     uint32_t flags;
     uint8_t page_buffer[PAGE_SIZE];
     uint64_t page_mask;
@@ -71,6 +73,7 @@ struct at28c256_s
     sdp_seq_t sdp_state;
     cbemu_t emulator;
     bus_cb_handle_t bus_handle;
+    snapshot_hook_t snapshot;
     uint16_t base;
 };
 
@@ -109,6 +112,17 @@ static const char *sdp_state_dbg_str[] =
 static inline void change_write_state(at28c256_t handle, write_state_t new_state)
 {
     log_print(lDEBUG, "at28c256 write state: %s => %s", write_state_dbg_str[handle->write_state], write_state_dbg_str[new_state]);
+
+    /* Time only matters while a write is in progress, so only tick then. */
+    if(new_state == IDLE)
+    {
+        clock_suspend_tick(handle->tick_cb);
+    }
+    else if(handle->write_state == IDLE)
+    {
+        clock_resume_tick(handle->tick_cb);
+    }
+
     handle->write_state = new_state;
 }
 
@@ -191,11 +205,90 @@ static uint8_t at28c256_read_cb(uint16_t addr, bus_flags_t flags, void *userdata
     return at28c256_read(handle, local);
 }
 
+static uint8_t *at28c256_direct_cb(uint16_t addr, bool write, void *userdata)
+{
+    at28c256_t handle = (at28c256_t)userdata;
+    uint16_t local;
+
+    /* Reads of the address being written return polling status rather than the image. */
+    if(handle == NULL || handle->write_state != IDLE)
+    {
+        return NULL;
+    }
+
+    local = addr - handle->base;
+
+    if((uint32_t)local + 0x100 > IMAGE_SIZE)
+    {
+        return NULL;
+    }
+
+    /* The page is written through the pointer without a bus write, so it must be marked here. */
+    if(write)
+    {
+        SNAPSHOT_MARK_DIRTY(handle->dirty, local);
+        SNAPSHOT_MARK_DIRTY(handle->dirty, local + 0xFF);
+    }
+
+    return &handle->image[local];
+}
+
+static bool at28c256_snapshot_save(snapshot_t snap, void *userdata)
+{
+    at28c256_t handle = (at28c256_t)userdata;
+    uint32_t write_state = (uint32_t)handle->write_state;
+    uint32_t sdp_state = (uint32_t)handle->sdp_state;
+
+    return snapshot_write(snap, &handle->flags, sizeof(handle->flags)) &&
+           snapshot_write(snap, handle->page_buffer, sizeof(handle->page_buffer)) &&
+           snapshot_write(snap, &handle->page_mask, sizeof(handle->page_mask)) &&
+           snapshot_write(snap, &handle->page_addr, sizeof(handle->page_addr)) &&
+           snapshot_write(snap, &handle->last_write, sizeof(handle->last_write)) &&
+           snapshot_write(snap, &handle->last_write_addr, sizeof(handle->last_write_addr)) &&
+           snapshot_write(snap, &write_state, sizeof(write_state)) &&
+           snapshot_write(snap, &handle->state_elapsed, sizeof(handle->state_elapsed)) &&
+           snapshot_write(snap, &sdp_state, sizeof(sdp_state)) &&
+           snapshot_write_pages(snap, handle->image, sizeof(handle->image), handle->dirty);
+}
+
+static bool at28c256_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    at28c256_t handle = (at28c256_t)userdata;
+    uint32_t write_state;
+    uint32_t sdp_state;
+
+    if(!snapshot_read(snap, &handle->flags, sizeof(handle->flags)) ||
+       !snapshot_read(snap, handle->page_buffer, sizeof(handle->page_buffer)) ||
+       !snapshot_read(snap, &handle->page_mask, sizeof(handle->page_mask)) ||
+       !snapshot_read(snap, &handle->page_addr, sizeof(handle->page_addr)) ||
+       !snapshot_read(snap, &handle->last_write, sizeof(handle->last_write)) ||
+       !snapshot_read(snap, &handle->last_write_addr, sizeof(handle->last_write_addr)) ||
+       !snapshot_read(snap, &write_state, sizeof(write_state)) ||
+       !snapshot_read(snap, &handle->state_elapsed, sizeof(handle->state_elapsed)) ||
+       !snapshot_read(snap, &sdp_state, sizeof(sdp_state)) ||
+       !snapshot_read_pages(snap, handle->image, sizeof(handle->image), handle->dirty))
+    {
+        return false;
+    }
+
+    if(write_state > WRITE_CYCLE || sdp_state > SDP_DIS_55)
+    {
+        return false;
+    }
+
+    /* Suspends or resumes the tick to match the restored state. */
+    change_write_state(handle, (write_state_t)write_state);
+    handle->sdp_state = (sdp_seq_t)sdp_state;
+
+    return true;
+}
+
 static const bus_handlers_t at28c256_bus_handlers =
 {
     at28c256_write_cb,
     at28c256_read_cb,
     at28c256_read_cb,
+    at28c256_direct_cb,
 };
 
 at28c256_t at28c256_init(clk_t main_clk, uint32_t flags)
@@ -227,14 +320,22 @@ at28c256_t at28c256_init(clk_t main_clk, uint32_t flags)
         free(handle);
         handle = NULL;
     }
+    else
+    {
+        clock_suspend_tick(handle->tick_cb);
+    }
 
     return handle;
 }
 
 void at28c256_destroy(at28c256_t handle)
 {
-    if(handle != NULL)
-        free(handle);
+    if(handle == NULL)
+        return;
+
+    clock_unregister_tick(handle->tick_cb);
+    snapshot_unregister(handle->snapshot);
+    free(handle);
 }
 
 bool at28c256_register(at28c256_t handle, const cbemu_t emu, const bus_decode_params_t *decoder, uint16_t base_addr)
@@ -250,6 +351,15 @@ bool at28c256_register(at28c256_t handle, const cbemu_t emu, const bus_decode_pa
     {
         handle->emulator = emu;
         handle->base = base_addr;
+        emu_bus_set_name(emu, handle->bus_handle, "at28c256");
+
+        handle->snapshot = snapshot_register(emu, "at28c256", at28c256_snapshot_save, at28c256_snapshot_restore, handle);
+
+        if(handle->snapshot == NULL)
+        {
+            emu_bus_unregister(emu, handle->bus_handle);
+            handle->bus_handle = NULL;
+        }
     }
 
     return (handle->bus_handle != NULL);
@@ -267,6 +377,7 @@ bool at28c256_load_image(at28c256_t handle, uint16_t image_size, uint8_t *image,
         memset(handle->image, IMAGE_FILL, IMAGE_SIZE);
 
     memcpy(handle->image+offset, image, image_size);
+    memset(handle->dirty, 0xFF, sizeof(handle->dirty));
 
     return true;
 }
@@ -475,6 +586,7 @@ void at28c256_tick(at28c256_t handle, uint32_t nanos)
                             if(handle->page_mask & ((uint64_t)1 << i))
                             {
                                 handle->image[handle->page_addr + i] = handle->page_buffer[i];
+                                SNAPSHOT_MARK_DIRTY(handle->dirty, handle->page_addr + i);
                             }
                         }
                     }
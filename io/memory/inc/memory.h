@@ -2,6 +2,7 @@
 #define __MEMORY_H__
 
 #include "emulator.h"
+#include "sanitizer.h"
 
 typedef struct memory_s *memory_t;
 
@@ -38,6 +39,17 @@ memory_t memory_init(uint16_t size, memory_flags_t flags);
  */
 bool memory_register(memory_t memory, const cbemu_t emu, const bus_decode_params_t *decoder, uint16_t base_addr);
 
+/**
+ * Adds the address space decoded for a registered memory instance to a sanitizer. The
+ * instance's contents are checked as ROM or RAM based on its flags.
+ *
+ * @param[in] memory    The registered memory instance.
+ * @param[in] sanitizer The sanitizer to add the memory to.
+ *
+ * @return true if the memory was added. Memory using a custom decoder cannot be sanitized.
+ */
+bool memory_sanitize(memory_t memory, sanitizer_t sanitizer);
+
 /**
  * Destorys a memory instance
  *
@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include "memory.h"
+#include "snapshot.h"
 #include "log.h"
 
 struct memory_s
@@ -11,6 +12,9 @@ struct memory_s
     uint16_t base;
     cbemu_t emulator;
     bus_cb_handle_t bus_handle;
+    bus_decode_params_t decoder;
+    snapshot_hook_t snapshot;
+    uint8_t dirty[SNAPSHOT_DIRTY_SIZE(0x10000)];
     uint8_t buffer[];
 };
 
@@ -39,6 +43,7 @@ static void mem_bus_write_cb(uint16_t addr, uint8_t value, bus_flags_t flags, vo
     }
 
     handle->buffer[internal_addr] = value;
+    SNAPSHOT_MARK_DIRTY(handle->dirty, internal_addr);
 }
 
 static uint8_t mem_bus_read_cb(uint16_t addr, bus_flags_t flags, void *userdata)
@@ -62,11 +67,66 @@ static uint8_t mem_bus_read_cb(uint16_t addr, bus_flags_t flags, void *userdata)
     return handle->buffer[internal_addr];
 }
 
+static uint8_t *mem_bus_direct_cb(uint16_t addr, bool write, void *userdata)
+{
+    memory_t handle = (memory_t)userdata;
+    uint16_t internal_addr;
+
+    if(handle == NULL)
+    {
+        return NULL;
+    }
+
+    internal_addr = addr - handle->base;
+
+    /* The whole page must be within the buffer. */
+    if((uint32_t)internal_addr + 0x100 > handle->size)
+    {
+        return NULL;
+    }
+
+    /* The page is written through the pointer without a bus write, so it must be marked here. */
+    if(write)
+    {
+        SNAPSHOT_MARK_DIRTY(handle->dirty, internal_addr);
+        SNAPSHOT_MARK_DIRTY(handle->dirty, internal_addr + 0xFF);
+    }
+
+    return &handle->buffer[internal_addr];
+}
+
+static bool mem_snapshot_save(snapshot_t snap, void *userdata)
+{
+    memory_t handle = (memory_t)userdata;
+
+    if(!snapshot_write(snap, &handle->size, sizeof(handle->size)))
+    {
+        return false;
+    }
+
+    /* ROM is saved too, as it can be patched with bus_poke_range. Its pages are only dirty then. */
+    return snapshot_write_pages(snap, handle->buffer, handle->size, handle->dirty);
+}
+
+static bool mem_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    memory_t handle = (memory_t)userdata;
+    uint16_t size;
+
+    if(!snapshot_read(snap, &size, sizeof(size)) || size != handle->size)
+    {
+        return false;
+    }
+
+    return snapshot_read_pages(snap, handle->buffer, handle->size, handle->dirty);
+}
+
 static const bus_handlers_t mem_bus_handlers =
 {
     mem_bus_write_cb,
     mem_bus_read_cb,
-    mem_bus_read_cb
+    mem_bus_read_cb,
+    mem_bus_direct_cb
 };
 
 /**
@@ -120,11 +180,71 @@ bool memory_register(memory_t memory, const cbemu_t emu, const bus_decode_params
     {
         memory->base = base_addr;
         memory->emulator = emu;
+        memory->decoder = *decoder;
+        emu_bus_set_name(emu, memory->bus_handle, "memory");
+
+        memory->snapshot = snapshot_register(emu, "memory", mem_snapshot_save, mem_snapshot_restore, memory);
+
+        if(memory->snapshot == NULL)
+        {
+            emu_bus_unregister(emu, memory->bus_handle);
+            memory->bus_handle = NULL;
+        }
     }
 
     return (memory->bus_handle != NULL);
 }
 
+/**
+ * Adds the address space decoded for a registered memory instance to a sanitizer. The
+ * instance's contents are checked as ROM or RAM based on its flags.
+ *
+ * @param[in] memory    The registered memory instance.
+ * @param[in] sanitizer The sanitizer to add the memory to.
+ *
+ * @return true if the memory was added. Memory using a custom decoder cannot be sanitized.
+ */
+bool memory_sanitize(memory_t memory, sanitizer_t sanitizer)
+{
+    sanitizer_region_t type;
+    uint32_t addr;
+    uint32_t start;
+    bool result = true;
+
+    if((memory == NULL) || (sanitizer == NULL) || (memory->bus_handle == NULL))
+    {
+        return false;
+    }
+
+    type = (memory->flags & MEMFLAG_ROM) ? SANITIZER_REGION_ROM : SANITIZER_REGION_RAM;
+
+    switch(memory->decoder.type)
+    {
+        case BUSDECODE_RANGE:
+            result = sanitizer_add_region(sanitizer, memory->decoder.value.range.addr_start, memory->decoder.value.range.addr_end, type);
+            break;
+        case BUSDECODE_MASK:
+            /* Add each contiguous run of decoded addresses. */
+            for(addr = 0; addr < 0x10000 && result; ++addr)
+            {
+                if((addr & memory->decoder.value.mask.addr_mask) != memory->decoder.value.mask.addr_value)
+                {
+                    continue;
+                }
+
+                for(start = addr; (addr + 1) < 0x10000 && ((addr + 1) & memory->decoder.value.mask.addr_mask) == memory->decoder.value.mask.addr_value; ++addr);
+
+                result = sanitizer_add_region(sanitizer, (uint16_t)start, (uint16_t)addr, type);
+            }
+            break;
+        default:
+            result = false;
+            break;
+    }
+
+    return result;
+}
+
 /**
  * Destorys a memory instance
  *
@@ -142,6 +262,8 @@ void memory_cleanup(memory_t memory)
         emu_bus_unregister(memory->emulator, memory->bus_handle);
     }
 
+    snapshot_unregister(memory->snapshot);
+
     free(memory);
 }
 
@@ -183,6 +305,7 @@ void memory_write(memory_t memory, uint16_t addr, uint8_t value)
     if((memory != NULL) && (addr < memory->size))
     {
         memory->buffer[addr] = value;
+        SNAPSHOT_MARK_DIRTY(memory->dirty, addr);
     }
 }
 
@@ -241,6 +364,9 @@ void memory_load_data(memory_t memory, uint16_t data_size, uint8_t *data, uint16
 
     memcpy(&memory->buffer[offset], data, copy_size);
 
+    /* Loading is rare, so every page is taken to have changed. */
+    memset(memory->dirty, 0xFF, sizeof(memory->dirty));
+
     if(use_fill)
     {
         if(offset > 0)
@@ -3,10 +3,15 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "snapshot.h"
 
 bool sdcard_init(const char *image_file);
 void sdcard_spi_write(uint8_t byte);
 uint8_t sdcard_spi_get(void);
 bool sdcard_detect(void);
 
+/* Snapshot hooks for the card's state. The contents of the image are not captured. */
+bool sdcard_snapshot_save(snapshot_t snap, void *userdata);
+bool sdcard_snapshot_restore(snapshot_t snap, void *userdata);
+
 #endif /* end of include guard: __SDCARD_H__ */
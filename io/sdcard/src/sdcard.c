@@ -272,3 +272,62 @@ bool sdcard_detect(void)
 {
     return cxt.init;
 }
+
+bool sdcard_snapshot_save(snapshot_t snap, void *userdata)
+{
+    uint32_t card_state = (uint32_t)cxt.card_state;
+    uint32_t cmd_state = (uint32_t)cxt.cmd_state;
+    uint8_t acmd_pend = cxt.acmd_pend ? 1 : 0;
+
+    return snapshot_write(snap, cxt.sector_buf, sizeof(cxt.sector_buf)) &&
+           snapshot_write(snap, &card_state, sizeof(card_state)) &&
+           snapshot_write(snap, &cmd_state, sizeof(cmd_state)) &&
+           snapshot_write(snap, cxt.cmd_buf, sizeof(cxt.cmd_buf)) &&
+           snapshot_write(snap, cxt.rsp_buf, sizeof(cxt.rsp_buf)) &&
+           snapshot_write(snap, &cxt.cmd_buf_idx, sizeof(cxt.cmd_buf_idx)) &&
+           snapshot_write(snap, &cxt.rsp_buf_idx, sizeof(cxt.rsp_buf_idx)) &&
+           snapshot_write(snap, &cxt.out_reg, sizeof(cxt.out_reg)) &&
+           snapshot_write(snap, &acmd_pend, sizeof(acmd_pend)) &&
+           snapshot_write(snap, &cxt.acmd41_cnt, sizeof(cxt.acmd41_cnt)) &&
+           snapshot_write(snap, &cxt.block_cnt, sizeof(cxt.block_cnt));
+}
+
+bool sdcard_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    sdcard_context_t state = cxt;
+    uint32_t card_state;
+    uint32_t cmd_state;
+    uint8_t acmd_pend;
+
+    if(!snapshot_read(snap, state.sector_buf, sizeof(state.sector_buf)) ||
+       !snapshot_read(snap, &card_state, sizeof(card_state)) ||
+       !snapshot_read(snap, &cmd_state, sizeof(cmd_state)) ||
+       !snapshot_read(snap, state.cmd_buf, sizeof(state.cmd_buf)) ||
+       !snapshot_read(snap, state.rsp_buf, sizeof(state.rsp_buf)) ||
+       !snapshot_read(snap, &state.cmd_buf_idx, sizeof(state.cmd_buf_idx)) ||
+       !snapshot_read(snap, &state.rsp_buf_idx, sizeof(state.rsp_buf_idx)) ||
+       !snapshot_read(snap, &state.out_reg, sizeof(state.out_reg)) ||
+       !snapshot_read(snap, &acmd_pend, sizeof(acmd_pend)) ||
+       !snapshot_read(snap, &state.acmd41_cnt, sizeof(state.acmd41_cnt)) ||
+       !snapshot_read(snap, &state.block_cnt, sizeof(state.block_cnt)))
+    {
+        return false;
+    }
+
+    /* The indexes are used unchecked, so reject any that are out of range. */
+    if(card_state > READY || cmd_state > CRC2 ||
+       state.cmd_buf_idx >= sizeof(state.cmd_buf) || state.rsp_buf_idx >= sizeof(state.rsp_buf) ||
+       state.block_cnt > sizeof(state.sector_buf))
+    {
+        return false;
+    }
+
+    state.card_state = (card_state_t)card_state;
+    state.cmd_state = (cmd_state_t)cmd_state;
+    state.acmd_pend = (acmd_pend != 0);
+
+    /* The image stays open as it is. */
+    cxt = state;
+
+    return true;
+}
@@ -2,6 +2,7 @@
 #define __VIA_H__
 
 #include "emulator.h"
+#include "vcd.h"
 
 typedef enum {
     VIA_PORTA,
@@ -65,4 +66,16 @@ void via_write_ctrl(via_t handle, via_ctrl_pin_t pin, bool val);
 uint8_t via_read_data_port(via_t handle, bool porta);
 bool via_read_ctrl(via_t handle, via_ctrl_pin_t pin);
 
+/**
+ * Adds the port and control pins to a VCD capture, which must not have been started yet. The
+ * pins are then updated whenever they change, until the capture is removed.
+ *
+ * @param[in] handle    The VIA instance.
+ * @param[in] vcd       The VCD capture, or NULL to stop updating a previous capture.
+ * @param[in] scope     Scope name for the pins in the capture.
+ *
+ * @return true if the pins were added.
+ */
+bool via_set_vcd(via_t handle, vcd_t vcd, const char *scope);
+
 #endif /* __VIA_H__ */
@@ -6,6 +6,7 @@
 #include "util.h"
 
 #include "via.h"
+#include "snapshot.h"
 #include "log.h"
 
 /*
@@ -170,6 +171,18 @@ typedef struct
     bool c2_out;
 } via_port_state_t;
 
+/** Pins added to a VCD capture. */
+enum
+{
+    VIA_VCD_PORTA,
+    VIA_VCD_PORTB,
+    VIA_VCD_CA1,
+    VIA_VCD_CA2,
+    VIA_VCD_CB1,
+    VIA_VCD_CB2,
+    VIA_VCD_SIGNALS
+};
+
 struct via_s
 {
     via_port_state_t porta;
@@ -187,12 +200,16 @@ struct via_s
     uint32_t flags;
 
     clock_cb_handle_t clk_cb;
+    snapshot_hook_t snapshot;
     bus_cb_handle_t bus_handle;
     bus_signal_voter_t voter;
     cbemu_t emu;
     bool mask_base;
     uint16_t base;
     listnode_t callbacks;
+
+    vcd_t vcd;
+    vcd_signal_t vcd_signals[VIA_VCD_SIGNALS];
 };
 
 #define VIA_FLAG_CA2_TRIG_PEND          0x0001
@@ -262,6 +279,21 @@ static const bus_handlers_t via_bus_handlers =
     via_bus_read_cb /* TODO Implement a peek callback if for any read operations they may have actions on read. */
 };
 
+static void via_vcd_update(via_t handle)
+{
+    if(handle->vcd == NULL)
+    {
+        return;
+    }
+
+    vcd_set_signal(handle->vcd, handle->vcd_signals[VIA_VCD_PORTA], via_read_data_port(handle, true));
+    vcd_set_signal(handle->vcd, handle->vcd_signals[VIA_VCD_PORTB], via_read_data_port(handle, false));
+    vcd_set_signal(handle->vcd, handle->vcd_signals[VIA_VCD_CA1], via_read_ctrl(handle, VIA_CA1));
+    vcd_set_signal(handle->vcd, handle->vcd_signals[VIA_VCD_CA2], via_read_ctrl(handle, VIA_CA2));
+    vcd_set_signal(handle->vcd, handle->vcd_signals[VIA_VCD_CB1], via_read_ctrl(handle, VIA_CB1));
+    vcd_set_signal(handle->vcd, handle->vcd_signals[VIA_VCD_CB2], via_read_ctrl(handle, VIA_CB2));
+}
+
 static void via_make_callbacks(via_t handle, const via_event_data_t *event)
 {
     via_callback_info_t *info;
@@ -273,6 +305,9 @@ static void via_make_callbacks(via_t handle, const via_event_data_t *event)
 
         info->callback(handle, event, info->userdata);
     }
+
+    /* Update the capture after the callbacks, as they may drive inputs in response. */
+    via_vcd_update(handle);
 }
 
 static inline bool via_is_independent_int(via_t handle, bool porta)
@@ -528,6 +563,44 @@ static void via_clock_tick(clk_t clk, clock_edge_t edge, void *userdata)
     }
 }
 
+static bool via_snapshot_save(snapshot_t snap, void *userdata)
+{
+    via_t handle = (via_t)userdata;
+
+    /* The port states are saved as is, as snapshots are specific to a build. */
+    return snapshot_write(snap, &handle->porta, sizeof(handle->porta)) &&
+           snapshot_write(snap, &handle->portb, sizeof(handle->portb)) &&
+           snapshot_write(snap, &handle->acr.val, sizeof(handle->acr.val)) &&
+           snapshot_write(snap, &handle->pcr.val, sizeof(handle->pcr.val)) &&
+           snapshot_write(snap, &handle->ier, sizeof(handle->ier)) &&
+           snapshot_write(snap, &handle->ifr, sizeof(handle->ifr)) &&
+           snapshot_write(snap, &handle->t1l, sizeof(handle->t1l)) &&
+           snapshot_write(snap, &handle->t1c, sizeof(handle->t1c)) &&
+           snapshot_write(snap, &handle->t1pb7, sizeof(handle->t1pb7)) &&
+           snapshot_write(snap, &handle->flags, sizeof(handle->flags));
+}
+
+static bool via_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    via_t handle = (via_t)userdata;
+    bool result;
+
+    result = snapshot_read(snap, &handle->porta, sizeof(handle->porta)) &&
+             snapshot_read(snap, &handle->portb, sizeof(handle->portb)) &&
+             snapshot_read(snap, &handle->acr.val, sizeof(handle->acr.val)) &&
+             snapshot_read(snap, &handle->pcr.val, sizeof(handle->pcr.val)) &&
+             snapshot_read(snap, &handle->ier, sizeof(handle->ier)) &&
+             snapshot_read(snap, &handle->ifr, sizeof(handle->ifr)) &&
+             snapshot_read(snap, &handle->t1l, sizeof(handle->t1l)) &&
+             snapshot_read(snap, &handle->t1c, sizeof(handle->t1c)) &&
+             snapshot_read(snap, &handle->t1pb7, sizeof(handle->t1pb7)) &&
+             snapshot_read(snap, &handle->flags, sizeof(handle->flags));
+
+    via_vcd_update(handle);
+
+    return result;
+}
+
 via_t via_init(const cbemu_t emu)
 {
     via_t cxt;
@@ -548,10 +621,11 @@ via_t via_init(const cbemu_t emu)
     {
         cxt->emu = emu;
         cxt->clk_cb = clock_register_tick_edges(clock_get_core_clk(emu), via_clock_tick, (CLOCK_NEGEDGE | CLOCK_POSEDGE), cxt);
+        cxt->snapshot = snapshot_register(emu, "via", via_snapshot_save, via_snapshot_restore, cxt);
 
-        if(cxt->clk_cb == NULL)
+        if(cxt->clk_cb == NULL || cxt->snapshot == NULL)
         {
-            free(cxt);
+            via_cleanup(cxt);
             cxt = NULL;
         }
     }
@@ -583,6 +657,8 @@ void via_cleanup(via_t via)
         clock_unregister_tick(via->clk_cb);
     }
 
+    snapshot_unregister(via->snapshot);
+
     free(via);
 }
 
@@ -600,6 +676,7 @@ bool via_register(via_t handle, const bus_decode_params_t *decoder, uint16_t bas
     if(handle->bus_handle != NULL)
     {
         handle->base = base;
+        emu_bus_set_name(handle->emu, handle->bus_handle, "via");
     }
     else
     {
@@ -910,6 +987,8 @@ void via_write_data_port(via_t handle, bool porta, uint8_t mask, uint8_t data)
     {
         port->ir = port->pin_in;
     }
+
+    via_vcd_update(handle);
 }
 
 void via_write_ctrl(via_t handle, via_ctrl_pin_t pin, bool val)
@@ -966,6 +1045,8 @@ void via_write_ctrl(via_t handle, via_ctrl_pin_t pin, bool val)
 
     /* Check for CA1 latching edges. We already know this is an edge,
      * so check the new state against the configured edge. */
+
+    via_vcd_update(handle);
 }
 
 uint8_t via_read_data_port(via_t handle, bool porta)
@@ -1034,3 +1115,38 @@ bool via_read_ctrl(via_t handle, via_ctrl_pin_t pin)
             return false;
     }
 }
+
+bool via_set_vcd(via_t handle, vcd_t vcd, const char *scope)
+{
+    static const char *names[VIA_VCD_SIGNALS] = { "pa", "pb", "ca1", "ca2", "cb1", "cb2" };
+    static const uint8_t widths[VIA_VCD_SIGNALS] = { 8, 8, 1, 1, 1, 1 };
+    unsigned int index;
+
+    if(handle == NULL)
+    {
+        return false;
+    }
+
+    handle->vcd = NULL;
+
+    if(vcd == NULL)
+    {
+        return true;
+    }
+
+    for(index = 0; index < VIA_VCD_SIGNALS; ++index)
+    {
+        handle->vcd_signals[index] = vcd_add_signal(vcd, scope, names[index], widths[index], 0);
+
+        if(handle->vcd_signals[index] == VCD_INVALID_SIGNAL)
+        {
+            return false;
+        }
+    }
+
+    /* Set the initial pin states. */
+    handle->vcd = vcd;
+    via_vcd_update(handle);
+
+    return true;
+}
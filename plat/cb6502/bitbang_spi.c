@@ -21,6 +21,12 @@ typedef struct bitbang_spi_cxt_s
 
     bool sdcard_sel;
     uint8_t sdcard_in;
+
+    vcd_t vcd;
+    vcd_signal_t vcd_clk;
+    vcd_signal_t vcd_mosi;
+    vcd_signal_t vcd_miso;
+    vcd_signal_t vcd_ss;
 } bitbang_spi_cxt_t;
 
 static bitbang_spi_cxt_t cxt;
@@ -48,6 +54,11 @@ static void bitbang_spi_update_outputs()
     }
 
     via_write_data_port(cxt.via, false, (SPI_MISO | SPI_DETECT), data);
+
+    if(cxt.vcd != NULL)
+    {
+        vcd_set_signal(cxt.vcd, cxt.vcd_miso, (data & SPI_MISO) ? 1 : 0);
+    }
 }
 
 static void bitbang_portb_write(uint8_t data)
@@ -55,6 +66,13 @@ static void bitbang_portb_write(uint8_t data)
     /* SS is active low. */
     cxt.sdcard_sel = (data & SPI_SS_SDCARD) == 0;
 
+    if(cxt.vcd != NULL)
+    {
+        vcd_set_signal(cxt.vcd, cxt.vcd_clk, (data & SPI_CLK) ? 1 : 0);
+        vcd_set_signal(cxt.vcd, cxt.vcd_mosi, (data & SPI_MOSI) ? 1 : 0);
+        vcd_set_signal(cxt.vcd, cxt.vcd_ss, (data & SPI_SS_SDCARD) ? 1 : 0);
+    }
+
     if(data & SPI_CLK && !cxt.spi_clk_state)
     {
         /* Before we process the first clock edge, go ahead and latch what the SD Card
@@ -131,6 +149,67 @@ bool bitbang_spi_init(via_t via)
     return true;
 }
 
+bool bitbang_spi_set_vcd(vcd_t vcd)
+{
+    uint8_t data;
+
+    cxt.vcd = NULL;
+
+    if(vcd == NULL)
+    {
+        return true;
+    }
+
+    data = via_read_data_port(cxt.via, false);
+
+    cxt.vcd_clk = vcd_add_signal(vcd, "spi", "sclk", 1, (data & SPI_CLK) ? 1 : 0);
+    cxt.vcd_mosi = vcd_add_signal(vcd, "spi", "mosi", 1, (data & SPI_MOSI) ? 1 : 0);
+    cxt.vcd_miso = vcd_add_signal(vcd, "spi", "miso", 1, (data & SPI_MISO) ? 1 : 0);
+    cxt.vcd_ss = vcd_add_signal(vcd, "spi", "ss_sdcard", 1, (data & SPI_SS_SDCARD) ? 1 : 0);
+
+    if(cxt.vcd_clk == VCD_INVALID_SIGNAL || cxt.vcd_mosi == VCD_INVALID_SIGNAL ||
+       cxt.vcd_miso == VCD_INVALID_SIGNAL || cxt.vcd_ss == VCD_INVALID_SIGNAL)
+    {
+        return false;
+    }
+
+    cxt.vcd = vcd;
+
+    return true;
+}
+
+bool bitbang_spi_snapshot_save(snapshot_t snap, void *userdata)
+{
+    uint8_t spi_clk_state = cxt.spi_clk_state ? 1 : 0;
+    uint8_t sdcard_sel = cxt.sdcard_sel ? 1 : 0;
+
+    return snapshot_write(snap, &cxt.SPI_cnt, sizeof(cxt.SPI_cnt)) &&
+           snapshot_write(snap, &cxt.SPI_out, sizeof(cxt.SPI_out)) &&
+           snapshot_write(snap, &spi_clk_state, sizeof(spi_clk_state)) &&
+           snapshot_write(snap, &sdcard_sel, sizeof(sdcard_sel)) &&
+           snapshot_write(snap, &cxt.sdcard_in, sizeof(cxt.sdcard_in));
+}
+
+bool bitbang_spi_snapshot_restore(snapshot_t snap, void *userdata)
+{
+    uint8_t spi_clk_state;
+    uint8_t sdcard_sel;
+
+    if(!snapshot_read(snap, &cxt.SPI_cnt, sizeof(cxt.SPI_cnt)) ||
+       !snapshot_read(snap, &cxt.SPI_out, sizeof(cxt.SPI_out)) ||
+       !snapshot_read(snap, &spi_clk_state, sizeof(spi_clk_state)) ||
+       !snapshot_read(snap, &sdcard_sel, sizeof(sdcard_sel)) ||
+       !snapshot_read(snap, &cxt.sdcard_in, sizeof(cxt.sdcard_in)))
+    {
+        return false;
+    }
+
+    cxt.spi_clk_state = (spi_clk_state != 0);
+    cxt.sdcard_sel = (sdcard_sel != 0);
+
+    return true;
+}
+
 void bitbang_spi_cleanup(void)
 {
     if(cxt.via_cb != NULL)
@@ -138,4 +217,6 @@ void bitbang_spi_cleanup(void)
         via_unregister_callback(cxt.via, cxt.via_cb);
         cxt.via_cb = NULL;
     }
+
+    cxt.vcd = NULL;
 }
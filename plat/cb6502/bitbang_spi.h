@@ -2,8 +2,17 @@
 #define __BITBANG_SPI_H__
 
 #include "via.h"
+#include "vcd.h"
+#include "snapshot.h"
 
 bool bitbang_spi_init(via_t via);
 void bitbang_spi_cleanup(void);
 
+/* Adds the SPI pins to a VCD capture that hasn't been started, or stops updating it if NULL. */
+bool bitbang_spi_set_vcd(vcd_t vcd);
+
+/* Snapshot hooks for the state of a transfer in progress. */
+bool bitbang_spi_snapshot_save(snapshot_t snap, void *userdata);
+bool bitbang_spi_snapshot_restore(snapshot_t snap, void *userdata);
+
 #endif /* end of include guard: __BITBANG_SPI_H__ */
@@ -8,11 +8,13 @@
 #include <getopt.h>
 
 #include "emulator.h"
+#include "snapshot.h"
 #include "acia.h"
 #include "via.h"
 #include "sdcard.h"
 #include "at28c256.h"
 #include "memory.h"
+#include "vcd.h"
 #include "cb6502.h"
 #include "log.h"
 #include "syslog_log.h"
@@ -50,6 +52,9 @@ typedef struct
     at28c256_t rom;
     clk_t acia_clk;
     memory_t ram;
+    vcd_t vcd;
+    snapshot_hook_t sdcard_snapshot;
+    snapshot_hook_t spi_snapshot;
 } cb6502_cxt_t;
 
 static cb6502_cxt_t cb6502_cxt;
@@ -193,6 +198,7 @@ bool cb6502_init(const char *rom_file, const char *acia_socket, cbemu_t *emulato
 
     config.mainclk_config.timing_type = CLOCK_FREQ;
     config.mainclk_config.timing.freq = 1000000;
+    config.cpu_engine = CPU_ENGINE_CYCLE;
 
     *emulator = emu_init(&config);
 
@@ -230,6 +236,15 @@ bool cb6502_init(const char *rom_file, const char *acia_socket, cbemu_t *emulato
     {
         goto error;
     }
+
+    /* The SD card and SPI are not tied to the emulator, so register their snapshot hooks here. */
+    cb6502_cxt.sdcard_snapshot = snapshot_register(*emulator, "sdcard", sdcard_snapshot_save, sdcard_snapshot_restore, NULL);
+    cb6502_cxt.spi_snapshot = snapshot_register(*emulator, "bitbang_spi", bitbang_spi_snapshot_save, bitbang_spi_snapshot_restore, NULL);
+
+    if(cb6502_cxt.sdcard_snapshot == NULL || cb6502_cxt.spi_snapshot == NULL)
+    {
+        goto error;
+    }
     //printf("sdcard init %s\n", sdcard_init("/mnt/sdcard_fs.bin") ? "success" : "failure");
     //
 
@@ -240,8 +255,69 @@ error:
     return false;
 }
 
+bool cb6502_sanitize(sanitizer_t sanitizer)
+{
+    return memory_sanitize(cb6502_cxt.ram, sanitizer);
+}
+
+int cb6502_acia_wait_fd(void)
+{
+    return acia_get_wait_fd(cb6502_cxt.acia);
+}
+
+bool cb6502_vcd_start(const char *vcd_file)
+{
+    if(cb6502_cxt.vcd != NULL)
+    {
+        return false;
+    }
+
+    cb6502_cxt.vcd = vcd_init(cb6502_cxt.emulator, vcd_file);
+
+    if(cb6502_cxt.vcd == NULL)
+    {
+        return false;
+    }
+
+    if(!via_set_vcd(cb6502_cxt.via, cb6502_cxt.vcd, "via") ||
+       !bitbang_spi_set_vcd(cb6502_cxt.vcd) ||
+       !vcd_start(cb6502_cxt.vcd))
+    {
+        cb6502_vcd_stop();
+        return false;
+    }
+
+    return true;
+}
+
+bool cb6502_vcd_stop(void)
+{
+    bool result;
+
+    if(cb6502_cxt.vcd == NULL)
+    {
+        return false;
+    }
+
+    via_set_vcd(cb6502_cxt.via, NULL, NULL);
+    bitbang_spi_set_vcd(NULL);
+
+    result = vcd_cleanup(cb6502_cxt.vcd);
+    cb6502_cxt.vcd = NULL;
+
+    return result;
+}
+
 void cb6502_destroy(void)
 {
+    if(cb6502_cxt.vcd != NULL)
+    {
+        cb6502_vcd_stop();
+    }
+
+    snapshot_unregister(cb6502_cxt.spi_snapshot);
+    snapshot_unregister(cb6502_cxt.sdcard_snapshot);
+
     bitbang_spi_cleanup();
 
     if(cb6502_cxt.rom != NULL)
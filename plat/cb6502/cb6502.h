@@ -3,9 +3,22 @@
 
 #include <stdbool.h>
 #include "emulator.h"
+#include "sanitizer.h"
 
 /* TODO In the future this may need to return a context for multiple instances. */
 bool cb6502_init(const char *rom_file, const char *acia_socket, cbemu_t *emulator);
 void cb6502_destroy(void);
 
+/* Checks the system RAM with the given sanitizer. */
+bool cb6502_sanitize(sanitizer_t sanitizer);
+
+/* Gets a file descriptor that polls readable while the ACIA has input waiting, or -1. */
+int cb6502_acia_wait_fd(void);
+
+/* Starts capturing the CPU bus, VIA and SPI pins to a VCD file. */
+bool cb6502_vcd_start(const char *vcd_file);
+
+/* Stops a VCD capture started by cb6502_vcd_start. */
+bool cb6502_vcd_stop(void);
+
 #endif /* end of include guard: __CB6502_H__ */
@@ -278,6 +278,8 @@ int main(int argc, char *argv[])
     /* Cleanup the curses manager and restore the original terminal settings */
     cursmgr_cleanup();
 
+    debug_cleanup(debugger);
+
     if(dbginfo.handle != NULL)
     {
         cc65_free_dbginfo(dbginfo.handle);
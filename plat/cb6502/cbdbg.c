@@ -1,21 +1,48 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 
 #include "cb6502.h"
 #include "dbgcli.h"
+#include "pacer.h"
 
 #define ACIA_SOCKNAME "acia.sock"
 
+/* Pick the profile output format from the file extension. */
+static profiler_format_t profile_format(const char *filename)
+{
+    const char *ext = strrchr(filename, '.');
+
+    if(ext != NULL && strcmp(ext, ".folded") == 0)
+        return PROFILER_FORMAT_FOLDED;
+
+    if(ext != NULL && strcmp(ext, ".json") == 0)
+        return PROFILER_FORMAT_SPEEDSCOPE;
+
+    return PROFILER_FORMAT_REPORT;
+}
+
 int main(int argc, char *argv[])
 {
     char *labels_file = NULL;
+    char *dbginfo_file = NULL;
+    char *profile_file = NULL;
+    char *coverage_file = NULL;
+    char *vcd_file = NULL;
+    bool sanitize = false;
+    sanitizer_t sanitizer = NULL;
+    unsigned int turbo = 0;
+    pacer_t pacer = NULL;
+    char *endptr;
     char *acia_socket = (char *)ACIA_SOCKNAME;
     int c;
+    int result;
     cbemu_t emu;
 
     dbgcli_config_t dbg_cfg;
 
-    while((c = getopt(argc, argv, "l:s:")) != -1)
+    while((c = getopt(argc, argv, "l:s:d:p:c:w:r:S")) != -1)
     {
         switch(c)
         {
@@ -25,6 +52,30 @@ int main(int argc, char *argv[])
             case 's':
                 acia_socket = optarg;
                 break;
+            case 'd':
+                dbginfo_file = optarg;
+                break;
+            case 'p':
+                profile_file = optarg;
+                break;
+            case 'c':
+                coverage_file = optarg;
+                break;
+            case 'w':
+                vcd_file = optarg;
+                break;
+            case 'r':
+                turbo = (unsigned int)strtoul(optarg, &endptr, 10);
+
+                if(*endptr != '\0' || turbo == 0)
+                {
+                    fprintf(stderr, "Invalid speed multiplier %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'S':
+                sanitize = true;
+                break;
             case '?':
                 return 1;
             default:
@@ -34,7 +85,7 @@ int main(int argc, char *argv[])
 
     if(optind >= argc)
     {
-        fprintf(stderr, "Usage: %s [-l LABEL_FILE] [-s ACIA_SOCKET_PATH ] rom_file\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-l LABEL_FILE] [-d DBGINFO_FILE] [-p PROFILE_OUTPUT] [-c LCOV_OUTPUT] [-w VCD_OUTPUT] [-r SPEED] [-S] [-s ACIA_SOCKET_PATH ] rom_file\n", argv[0]);
         return 1;
     }
 
@@ -49,10 +100,80 @@ int main(int argc, char *argv[])
         dbg_cfg.label_file = labels_file;
     }
 
-    dbgcli_run(emu, &dbg_cfg);
+    if(dbginfo_file != NULL)
+    {
+        dbg_cfg.valid_flags |= DBGCLI_CONFIG_FLAG_DBGINFO_FILE_VALID;
+        dbg_cfg.dbginfo_file = dbginfo_file;
+    }
+
+    if(profile_file != NULL)
+    {
+        dbg_cfg.valid_flags |= DBGCLI_CONFIG_FLAG_PROFILE_FILE_VALID;
+        dbg_cfg.profile_file = profile_file;
+        dbg_cfg.profile_format = profile_format(profile_file);
+    }
+
+    if(coverage_file != NULL)
+    {
+        dbg_cfg.valid_flags |= DBGCLI_CONFIG_FLAG_COVERAGE_FILE_VALID;
+        dbg_cfg.coverage_file = coverage_file;
+    }
+
+    if(sanitize)
+    {
+        sanitizer = sanitizer_init(emu);
+
+        if(sanitizer == NULL || !cb6502_sanitize(sanitizer))
+        {
+            fprintf(stderr, "Unable to enable sanitizer\n");
+            sanitizer_cleanup(sanitizer);
+            cb6502_destroy();
+            return 1;
+        }
+
+        dbg_cfg.valid_flags |= DBGCLI_CONFIG_FLAG_SANITIZER_VALID;
+        dbg_cfg.sanitizer = sanitizer;
+    }
+
+    /* Run at a multiple of real time rather than flat out. */
+    if(turbo > 0)
+    {
+        pacer = pacer_init(emu, 0);
+
+        if(pacer == NULL)
+        {
+            fprintf(stderr, "Unable to enable real-time pacing\n");
+            sanitizer_cleanup(sanitizer);
+            cb6502_destroy();
+            return 1;
+        }
+
+        pacer_set_turbo(pacer, turbo);
+
+        /* Wake early for serial input rather than waiting out the slice. */
+        pacer_set_wait_fd(pacer, cb6502_acia_wait_fd());
+    }
+
+    if(vcd_file != NULL && !cb6502_vcd_start(vcd_file))
+    {
+        fprintf(stderr, "Unable to write VCD to %s\n", vcd_file);
+        pacer_cleanup(pacer);
+        sanitizer_cleanup(sanitizer);
+        cb6502_destroy();
+        return 1;
+    }
+
+    result = dbgcli_run(emu, &dbg_cfg);
+
+    pacer_cleanup(pacer);
+
+    if(vcd_file != NULL && !cb6502_vcd_stop())
+        fprintf(stderr, "Unable to write VCD to %s\n", vcd_file);
+
+    sanitizer_cleanup(sanitizer);
 
     cb6502_destroy();
 
-    return 0;
+    return result;
 }
 
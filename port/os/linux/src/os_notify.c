@@ -0,0 +1,129 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "os_notify.h"
+
+/* Most file descriptors waited on at once by os_wait_fds. */
+#define OS_WAIT_MAX_FDS 8
+
+typedef struct
+{
+    int fd;
+} notify_data_t;
+
+os_notify_t os_notify_create(void)
+{
+    notify_data_t *data;
+
+    data = malloc(sizeof(notify_data_t));
+
+    if(data == NULL)
+    {
+        return NULL;
+    }
+
+    data->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(data->fd < 0)
+    {
+        free(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+void os_notify_destroy(os_notify_t handle)
+{
+    notify_data_t *data = (notify_data_t *)handle;
+
+    if(data == NULL)
+    {
+        return;
+    }
+
+    close(data->fd);
+    free(data);
+}
+
+int os_notify_fd(os_notify_t handle)
+{
+    notify_data_t *data = (notify_data_t *)handle;
+
+    if(data == NULL)
+    {
+        return -1;
+    }
+
+    return data->fd;
+}
+
+void os_notify_set(os_notify_t handle)
+{
+    notify_data_t *data = (notify_data_t *)handle;
+
+    if(data == NULL)
+    {
+        return;
+    }
+
+    /* The count only matters as being non-zero, so a failure due to it saturating is fine. */
+    (void)eventfd_write(data->fd, 1);
+}
+
+void os_notify_clear(os_notify_t handle)
+{
+    notify_data_t *data = (notify_data_t *)handle;
+    eventfd_t count;
+
+    if(data == NULL)
+    {
+        return;
+    }
+
+    /* Reading resets the count. This fails harmlessly with EAGAIN if it is already clear. */
+    (void)eventfd_read(data->fd, &count);
+}
+
+int os_wait_fds(const int *fds, unsigned int count)
+{
+    struct pollfd pfds[OS_WAIT_MAX_FDS];
+    unsigned int index;
+    int result;
+
+    if(fds == NULL || count == 0 || count > OS_WAIT_MAX_FDS)
+    {
+        return -1;
+    }
+
+    for(index = 0; index < count; ++index)
+    {
+        pfds[index].fd = fds[index];
+        pfds[index].events = POLLIN;
+        pfds[index].revents = 0;
+    }
+
+    do
+    {
+        result = poll(pfds, count, -1);
+    } while(result < 0 && errno == EINTR);
+
+    if(result < 0)
+    {
+        return -1;
+    }
+
+    for(index = 0; index < count; ++index)
+    {
+        /* A hang up or error is reported as readable, so the caller finds out when it reads. */
+        if(pfds[index].revents != 0)
+        {
+            return (int)index;
+        }
+    }
+
+    return -1;
+}
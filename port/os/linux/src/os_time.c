@@ -0,0 +1,66 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include "os_time.h"
+
+#define NS_PER_SEC 1000000000ULL
+
+uint64_t os_time_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * NS_PER_SEC) + (uint64_t)now.tv_nsec;
+}
+
+void os_sleep_until_ns(uint64_t deadline)
+{
+    struct timespec until;
+
+    until.tv_sec = (time_t)(deadline / NS_PER_SEC);
+    until.tv_nsec = (long)(deadline % NS_PER_SEC);
+
+    /* Sleeping on an absolute deadline means being interrupted doesn't stretch the sleep. */
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR)
+    {
+    }
+}
+
+bool os_wait_fd_until_ns(int fd, uint64_t deadline)
+{
+    struct pollfd pfd;
+    struct timespec timeout;
+    uint64_t now;
+    int result;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    now = os_time_ns();
+
+    while(now < deadline)
+    {
+        timeout.tv_sec = (time_t)((deadline - now) / NS_PER_SEC);
+        timeout.tv_nsec = (long)((deadline - now) % NS_PER_SEC);
+
+        result = ppoll(&pfd, 1, &timeout, NULL);
+
+        if(result > 0)
+            return true;
+
+        /* Anything but an interruption means the descriptor can't be waited on, so fall back to
+         * sleeping. */
+        if(result < 0 && errno != EINTR)
+        {
+            os_sleep_until_ns(deadline);
+            return false;
+        }
+
+        now = os_time_ns();
+    }
+
+    return false;
+}
@@ -0,0 +1,35 @@
+#include <stdlib.h>
+
+#include "os_notify.h"
+
+/* There are no file descriptors to wait on here, so a notifier is just a placeholder and callers
+ * must poll for whatever it signals. */
+static char notify_placeholder;
+
+os_notify_t os_notify_create(void)
+{
+    return &notify_placeholder;
+}
+
+void os_notify_destroy(os_notify_t handle)
+{
+}
+
+int os_notify_fd(os_notify_t handle)
+{
+    return -1;
+}
+
+void os_notify_set(os_notify_t handle)
+{
+}
+
+void os_notify_clear(os_notify_t handle)
+{
+}
+
+int os_wait_fds(const int *fds, unsigned int count)
+{
+    /* Nothing can be waited on, so the caller falls back to blocking on whatever it reads. */
+    return -1;
+}
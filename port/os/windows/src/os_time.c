@@ -0,0 +1,43 @@
+#include <windows.h>
+
+#include "os_time.h"
+
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_MS  1000000ULL
+
+uint64_t os_time_ns(void)
+{
+    LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    uint64_t ticks;
+    uint64_t rate;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+
+    ticks = (uint64_t)count.QuadPart;
+    rate = (uint64_t)freq.QuadPart;
+
+    return ((ticks / rate) * NS_PER_SEC) + (((ticks % rate) * NS_PER_SEC) / rate);
+}
+
+void os_sleep_until_ns(uint64_t deadline)
+{
+    uint64_t now = os_time_ns();
+
+    /* Sleep only has millisecond resolution, so this may return up to 1ms early. */
+    while(now + NS_PER_MS <= deadline)
+    {
+        Sleep((DWORD)((deadline - now) / NS_PER_MS));
+        now = os_time_ns();
+    }
+}
+
+bool os_wait_fd_until_ns(int fd, uint64_t deadline)
+{
+    /* File descriptors can't be waited on alongside a timeout here, so just sleep. */
+    (void)fd;
+    os_sleep_until_ns(deadline);
+
+    return false;
+}
@@ -266,6 +266,80 @@ void test_tracer(void)
     }
 }
 
+void test_tracer_filtered(void)
+{
+    trace_log_entry_t entries[4];
+    trace_log_t log;
+    bus_cb_handle_t handle;
+    bus_trace_filter_t filter;
+
+    log.entries = entries;
+    log.num_entries = 0;
+    log.entries_size = 4;
+
+    filter.decode.type = BUSDECODE_CUSTOM;
+    filter.ops = BUS_TRACE_ALL;
+    filter.divisor = 0;
+    TEST_ASSERT_NULL(emu_bus_add_tracer_filtered(&emu, &filter, trace_cb, &log));
+
+    filter.decode.type = BUSDECODE_MASK;
+    filter.decode.value.mask.addr_mask = 0xFFF0;
+    filter.decode.value.mask.addr_value = 0x8010;
+    filter.ops = 0;
+    TEST_ASSERT_NULL(emu_bus_add_tracer_filtered(&emu, &filter, trace_cb, &log));
+
+    filter.ops = BUS_TRACE_READ | BUS_TRACE_WRITE;
+    handle = emu_bus_add_tracer_filtered(&emu, &filter, trace_cb, &log);
+    TEST_ASSERT_NOT_NULL(handle);
+
+    /* Only the page containing the mask is flagged in the decode table. */
+    TEST_ASSERT_EQUAL_UINT16(1, emu.bus.pages[0x80].tracers);
+    TEST_ASSERT_EQUAL_UINT16(0, emu.bus.pages[0x81].tracers);
+
+    bus_read(&emu, 0x8000);
+    bus_write(&emu, 0x9010, 0x12);
+    bus_sync_read(&emu, 0x8011);
+    bus_read(&emu, 0x801F);
+    bus_write(&emu, 0x8010, 0x34);
+
+    TEST_ASSERT_EQUAL_UINT8(2, log.num_entries);
+    TEST_ASSERT_EQUAL_UINT16(0x801F, entries[0].addr);
+    TEST_ASSERT_FALSE(entries[0].write);
+    TEST_ASSERT_EQUAL_UINT16(0x8010, entries[1].addr);
+    TEST_ASSERT_EQUAL_UINT8(0x34, entries[1].val);
+    TEST_ASSERT_TRUE(entries[1].write);
+
+    emu_bus_remove_tracer(&emu, handle);
+    TEST_ASSERT_EQUAL_UINT16(0, emu.bus.pages[0x80].tracers);
+
+    /* Trace every third opcode fetch in a range. */
+    log.num_entries = 0;
+    filter.decode.type = BUSDECODE_RANGE;
+    filter.decode.value.range.addr_start = 0x1000;
+    filter.decode.value.range.addr_end = 0x2fff;
+    filter.ops = BUS_TRACE_SYNC;
+    filter.divisor = 3;
+    handle = emu_bus_add_tracer_filtered(&emu, &filter, trace_cb, &log);
+    TEST_ASSERT_NOT_NULL(handle);
+    TEST_ASSERT_EQUAL_UINT16(1, emu.bus.pages[0x2f].tracers);
+    TEST_ASSERT_EQUAL_UINT16(0, emu.bus.pages[0x30].tracers);
+
+    bus_sync_read(&emu, 0x1000);
+    bus_sync_read(&emu, 0x1001);
+    bus_read(&emu, 0x1002);
+    bus_sync_read(&emu, 0x1003);
+    bus_sync_read(&emu, 0x3000);
+    bus_sync_read(&emu, 0x2000);
+    bus_sync_read(&emu, 0x2001);
+    bus_sync_read(&emu, 0x2002);
+
+    TEST_ASSERT_EQUAL_UINT8(2, log.num_entries);
+    TEST_ASSERT_EQUAL_UINT16(0x1003, entries[0].addr);
+    TEST_ASSERT_EQUAL_UINT16(0x2002, entries[1].addr);
+
+    emu_bus_remove_tracer(&emu, handle);
+}
+
 void test_register_voter(void)
 {
     bus_signal_voter_t voter;
@@ -358,6 +432,312 @@ void test_vote_nmi(void)
     TEST_ASSERT_BITS_HIGH(SV_NMI_EDGE_PENDING, emu.bus.sigvotes.flags);
 }
 
+static void sig_watch_cb(bus_signal_t signal, bool asserted, void *userdata)
+{
+    unsigned int *changes = (unsigned int *)userdata;
+
+    TEST_ASSERT_EQUAL(BUS_SIG_RDY, signal);
+    TEST_ASSERT_EQUAL(asserted, emu_bus_sig_asserted(&emu, BUS_SIG_RDY));
+
+    ++(*changes);
+}
+
+void test_sig_watcher(void)
+{
+    bus_signal_voter_t voter, voter2;
+    bus_cb_handle_t handle;
+    unsigned int changes = 0;
+
+    voter = emu_bus_register_sig_voter(&emu);
+    voter2 = emu_bus_register_sig_voter(&emu);
+
+    handle = emu_bus_add_sig_watcher(&emu, sig_watch_cb, &changes);
+    TEST_ASSERT_NOT_NULL(handle);
+
+    /* Only the first vote and the last release change the signal. */
+    emu_bus_sig_vote(&emu, voter, BUS_SIG_RDY, true);
+    TEST_ASSERT_EQUAL_UINT(1, changes);
+    emu_bus_sig_vote(&emu, voter2, BUS_SIG_RDY, true);
+    emu_bus_sig_vote(&emu, voter, BUS_SIG_RDY, false);
+    TEST_ASSERT_EQUAL_UINT(1, changes);
+    TEST_ASSERT_TRUE(emu_bus_sig_asserted(&emu, BUS_SIG_RDY));
+    emu_bus_sig_vote(&emu, voter2, BUS_SIG_RDY, false);
+    TEST_ASSERT_EQUAL_UINT(2, changes);
+    TEST_ASSERT_FALSE(emu_bus_sig_asserted(&emu, BUS_SIG_RDY));
+
+    emu_bus_remove_sig_watcher(&emu, handle);
+
+    emu_bus_sig_vote(&emu, voter, BUS_SIG_RDY, true);
+    TEST_ASSERT_EQUAL_UINT(2, changes);
+
+    /* Leave a watcher registered for cleanup to free. */
+    TEST_ASSERT_NOT_NULL(emu_bus_add_sig_watcher(&emu, sig_watch_cb, &changes));
+}
+
+static unsigned int overlap_reads;
+
+static uint8_t overlap_read_cb(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    ++overlap_reads;
+    return 0x11;
+}
+
+static const bus_handlers_t overlap_handlers = {
+    NULL,
+    overlap_read_cb,
+    overlap_read_cb
+};
+
+static bool custom_decode(uint16_t addr, bool write, void *userdata)
+{
+    return addr == 0x3080;
+}
+
+static bool is_shared(uint16_t addr)
+{
+    return (emu.bus.shared[addr >> 3] & (1 << (addr & 7))) != 0;
+}
+
+void test_overlap(void)
+{
+    bus_decode_params_t params;
+    bus_cb_handle_t wide, page, custom;
+    unsigned int addr;
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0x1000;
+    params.value.range.addr_end = 0x1FFF;
+    wide = emu_bus_register(&emu, &params, &overlap_handlers, NULL);
+    TEST_ASSERT_NOT_NULL(wide);
+
+    params.type = BUSDECODE_MASK;
+    params.value.mask.addr_mask = 0xFF00;
+    params.value.mask.addr_value = 0x1800;
+    page = emu_bus_register(&emu, &params, &overlap_handlers, NULL);
+    TEST_ASSERT_NOT_NULL(page);
+
+    /* Neighbours sharing a page without overlapping. */
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0x2000;
+    params.value.range.addr_end = 0x200F;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(&emu, &params, &overlap_handlers, NULL));
+    params.value.range.addr_start = 0x2010;
+    params.value.range.addr_end = 0x201F;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(&emu, &params, &overlap_handlers, NULL));
+
+    for(addr = 0; addr < 0x10000; ++addr)
+    {
+        TEST_ASSERT_EQUAL((addr & 0xFF00) == 0x1800, is_shared((uint16_t)addr));
+    }
+
+    /* Overlapping addresses read every connection, others stop at the first. */
+    overlap_reads = 0;
+    (void)bus_read(&emu, 0x1800);
+    TEST_ASSERT_EQUAL_UINT(2, overlap_reads);
+
+    overlap_reads = 0;
+    (void)bus_read(&emu, 0x1900);
+    (void)bus_read(&emu, 0x2010);
+    TEST_ASSERT_EQUAL_UINT(2, overlap_reads);
+
+    emu_bus_unregister(&emu, page);
+    TEST_ASSERT_FALSE(is_shared(0x1800));
+
+    /* A custom decoder can't be analysed, so the pages it shares are checked in full. */
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0x3000;
+    params.value.range.addr_end = 0x30FF;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(&emu, &params, &overlap_handlers, NULL));
+
+    params.type = BUSDECODE_CUSTOM;
+    params.value.custom = custom_decode;
+    custom = emu_bus_register(&emu, &params, &overlap_handlers, NULL);
+    TEST_ASSERT_NOT_NULL(custom);
+
+    TEST_ASSERT_TRUE(is_shared(0x3000));
+    TEST_ASSERT_TRUE(is_shared(0x30FF));
+    TEST_ASSERT_TRUE(is_shared(0x1000));
+    TEST_ASSERT_FALSE(is_shared(0x4000));
+
+    overlap_reads = 0;
+    (void)bus_read(&emu, 0x3080);
+    TEST_ASSERT_EQUAL_UINT(2, overlap_reads);
+
+    emu_bus_unregister(&emu, custom);
+    TEST_ASSERT_FALSE(is_shared(0x3000));
+    TEST_ASSERT_FALSE(is_shared(0x1000));
+}
+
+static unsigned int decode_calls;
+static unsigned int decode_bank;
+
+/* Decodes reads of $4000-$40FF and writes of $4000-$43FF. */
+static bool static_decode(uint16_t addr, bool write, void *userdata)
+{
+    ++decode_calls;
+    return (addr & 0xFC00) == 0x4000 && (write || addr < 0x4100);
+}
+
+/* Decodes the 4K block selected by the bank. */
+static bool bank_decode(uint16_t addr, bool write, void *userdata)
+{
+    ++decode_calls;
+    return (addr >> 12) == decode_bank;
+}
+
+void test_custom_cached(void)
+{
+    bus_decode_params_t params;
+    bus_cb_handle_t fixed, banked;
+
+    /* A static decoder is evaluated for every address and direction at registration only. */
+    decode_calls = 0;
+    params.type = BUSDECODE_CUSTOM_STATIC;
+    params.value.custom = static_decode;
+    fixed = emu_bus_register(&emu, &params, &overlap_handlers, NULL);
+    TEST_ASSERT_NOT_NULL(fixed);
+    TEST_ASSERT_EQUAL_UINT(2 * 0x10000, decode_calls);
+
+    decode_calls = 0;
+    overlap_reads = 0;
+    (void)bus_read(&emu, 0x4000);
+    (void)bus_read(&emu, 0x40FF);
+    (void)bus_read(&emu, 0x4100);
+    TEST_ASSERT_EQUAL_UINT(0, decode_calls);
+    TEST_ASSERT_EQUAL_UINT(2, overlap_reads);
+
+    /* Its results are analysed like any other decoder, so only real overlaps are shared. */
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0x40F0;
+    params.value.range.addr_end = 0x410F;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(&emu, &params, &overlap_handlers, NULL));
+    TEST_ASSERT_FALSE(is_shared(0x40EF));
+    TEST_ASSERT_TRUE(is_shared(0x40F0));
+    TEST_ASSERT_TRUE(is_shared(0x410F));
+    TEST_ASSERT_FALSE(is_shared(0x4110));
+
+    decode_calls = 0;
+    emu_bus_decode_invalidate(&emu, fixed);
+    TEST_ASSERT_EQUAL_UINT(2 * 0x10000, decode_calls);
+    TEST_ASSERT_TRUE(is_shared(0x40F0));
+
+    /* A dynamic decoder is evaluated a page at a time, on first access. */
+    decode_bank = 0x8;
+    decode_calls = 0;
+    params.type = BUSDECODE_CUSTOM_DYNAMIC;
+    params.value.custom = bank_decode;
+    banked = emu_bus_register(&emu, &params, &overlap_handlers, NULL);
+    TEST_ASSERT_NOT_NULL(banked);
+
+    overlap_reads = 0;
+    decode_calls = 0;
+    (void)bus_read(&emu, 0x8000);
+    (void)bus_read(&emu, 0x80FF);
+    TEST_ASSERT_EQUAL_UINT(2 * 0x100, decode_calls);
+    TEST_ASSERT_EQUAL_UINT(2, overlap_reads);
+
+    /* Changing the mapping has no effect on cached pages until the cache is invalidated. */
+    decode_bank = 0x9;
+    overlap_reads = 0;
+    (void)bus_read(&emu, 0x8000);
+    (void)bus_read(&emu, 0x80FF);
+    TEST_ASSERT_EQUAL_UINT(2, overlap_reads);
+
+    emu_bus_decode_invalidate(&emu, banked);
+    overlap_reads = 0;
+    (void)bus_read(&emu, 0x8000);
+    (void)bus_read(&emu, 0x9000);
+    TEST_ASSERT_EQUAL_UINT(1, overlap_reads);
+
+    emu_bus_unregister(&emu, banked);
+    emu_bus_unregister(&emu, fixed);
+    TEST_ASSERT_FALSE(is_shared(0x40F0));
+
+    /* Custom decoders need a callback. */
+    params.type = BUSDECODE_CUSTOM_STATIC;
+    params.value.custom = NULL;
+    TEST_ASSERT_NULL(emu_bus_register(&emu, &params, &overlap_handlers, NULL));
+}
+
+void test_counters(void)
+{
+    static bus_counters_t pages[BUS_COUNTER_PAGES];
+    bus_conn_counters_t conns[2];
+    bus_decode_params_t params;
+    bus_cb_handle_t low, high;
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0x0000;
+    params.value.range.addr_end = 0x1FFF;
+    low = emu_bus_register(&emu, &params, &handlers, NULL);
+    TEST_ASSERT_NOT_NULL(low);
+    emu_bus_set_name(&emu, low, "low");
+
+    params.type = BUSDECODE_MASK;
+    params.value.mask.addr_mask = 0xF000;
+    params.value.mask.addr_value = 0x1000;
+    high = emu_bus_register(&emu, &params, &handlers, NULL);
+    TEST_ASSERT_NOT_NULL(high);
+
+    /* Nothing is counted until enabled. */
+    (void)bus_read(&emu, 0x0010);
+    emu_bus_get_page_counters(&emu, pages);
+    TEST_ASSERT_EQUAL_UINT64(0, pages[0x00].reads);
+
+    emu_bus_enable_counters(&emu, true);
+
+    (void)bus_read(&emu, 0x0010);
+    (void)bus_sync_read(&emu, 0x0020);
+    (void)bus_sync_read(&emu, 0x0030);
+    bus_dummy_read(&emu, 0x1234);
+    bus_write(&emu, 0x1250, 0x00);
+    bus_write(&emu, 0x8000, 0x00);
+
+    /* Peeks aren't bus transactions. */
+    (void)bus_peek(&emu, 0x0010);
+
+    emu_bus_get_page_counters(&emu, pages);
+    TEST_ASSERT_EQUAL_UINT64(1, pages[0x00].reads);
+    TEST_ASSERT_EQUAL_UINT64(2, pages[0x00].fetches);
+    TEST_ASSERT_EQUAL_UINT64(0, pages[0x00].writes);
+    TEST_ASSERT_EQUAL_UINT64(1, pages[0x12].reads);
+    TEST_ASSERT_EQUAL_UINT64(1, pages[0x12].writes);
+    TEST_ASSERT_EQUAL_UINT64(1, pages[0x80].writes);
+    TEST_ASSERT_EQUAL_UINT64(0, pages[0x01].reads);
+
+    /* Accesses to 0x1000-0x1FFF are decoded by both connections. */
+    TEST_ASSERT_EQUAL_UINT(2, emu_bus_get_conn_counters(&emu, conns, 2));
+    TEST_ASSERT_EQUAL_PTR(low, conns[0].handle);
+    TEST_ASSERT_EQUAL_STRING("low", conns[0].name);
+    TEST_ASSERT_EQUAL(BUSDECODE_RANGE, conns[0].params.type);
+    TEST_ASSERT_EQUAL_UINT64(2, conns[0].counters.reads);
+    TEST_ASSERT_EQUAL_UINT64(2, conns[0].counters.fetches);
+    TEST_ASSERT_EQUAL_UINT64(1, conns[0].counters.writes);
+
+    TEST_ASSERT_EQUAL_PTR(high, conns[1].handle);
+    TEST_ASSERT_NULL(conns[1].name);
+    TEST_ASSERT_EQUAL_UINT64(1, conns[1].counters.reads);
+    TEST_ASSERT_EQUAL_UINT64(0, conns[1].counters.fetches);
+    TEST_ASSERT_EQUAL_UINT64(1, conns[1].counters.writes);
+
+    /* The total is returned even if the buffer is too small. */
+    TEST_ASSERT_EQUAL_UINT(2, emu_bus_get_conn_counters(&emu, conns, 1));
+
+    /* Disabling keeps the counts. */
+    emu_bus_enable_counters(&emu, false);
+    (void)bus_read(&emu, 0x0010);
+    emu_bus_get_page_counters(&emu, pages);
+    TEST_ASSERT_EQUAL_UINT64(1, pages[0x00].reads);
+
+    emu_bus_reset_counters(&emu);
+    emu_bus_get_page_counters(&emu, pages);
+    TEST_ASSERT_EQUAL_UINT64(0, pages[0x00].fetches);
+    TEST_ASSERT_EQUAL_UINT64(0, pages[0x12].writes);
+    emu_bus_get_conn_counters(&emu, conns, 2);
+    TEST_ASSERT_EQUAL_UINT64(0, conns[0].counters.reads);
+    TEST_ASSERT_EQUAL_UINT64(0, conns[1].counters.writes);
+}
+
 void setUp(void)
 {
     memset(&emu, 0, sizeof(emu));
@@ -381,9 +761,14 @@ int main(int argc, char *argv[])
     RUN_TEST(test_bus_mask);
     RUN_TEST(test_register_unregister_mult);
     RUN_TEST(test_tracer);
+    RUN_TEST(test_tracer_filtered);
     RUN_TEST(test_register_voter);
     RUN_TEST(test_register_max_voters);
     RUN_TEST(test_vote_irq);
     RUN_TEST(test_vote_nmi);
+    RUN_TEST(test_sig_watcher);
+    RUN_TEST(test_counters);
+    RUN_TEST(test_overlap);
+    RUN_TEST(test_custom_cached);
     return UNITY_END();
 }
@@ -71,6 +71,36 @@ void test_add_clock_period(void)
     TEST_ASSERT_EQUAL_UINT32(4901961, clk->freq);
 }
 
+void test_add_clock_unschedulable(void)
+{
+    clock_config_t config;
+    uint64_t timebase;
+    uint64_t phase;
+
+    /* Restart with a main clock whose frequency is a large prime. */
+    clock_cleanup(&emu);
+    config.timing_type = CLOCK_FREQ;
+    config.timing.freq = 999999937;
+    clock_init(&emu, &config, main_tick_handler);
+
+    config.timing.freq = 999999929;
+    TEST_ASSERT_NOT_NULL(clock_add(&emu, &config));
+    config.timing.freq = 3;
+    TEST_ASSERT_NOT_NULL(clock_add(&emu, &config));
+
+    timebase = emu.clk.timebase;
+    phase = emu.clk.mainClk->phase;
+
+    /* 2/7 Hz doubles the timebase, but its own phase would then overflow. */
+    config.timing_type = CLOCK_PERIOD;
+    config.timing.period = 3500000000u;
+    TEST_ASSERT_NULL(clock_add(&emu, &config));
+
+    /* The existing clocks are left alone. */
+    TEST_ASSERT_EQUAL_UINT64(timebase, emu.clk.timebase);
+    TEST_ASSERT_EQUAL_UINT64(phase, emu.clk.mainClk->phase);
+}
+
 void test_register_tick_main(void)
 {
     clock_cb_handle_t handle;
@@ -155,6 +185,218 @@ void test_three_clocks_half_double(void)
     TEST_ASSERT_EQUAL_UINT32(4, thrdCnt);
 }
 
+void test_exact_ratio(void)
+{
+    clk_t clk, clk2;
+    uint32_t mainCnt = 0;
+    uint32_t secCnt = 0;
+    uint32_t thrdCnt = 0;
+    uint32_t index;
+    clock_config_t config;
+
+    /* Neither clock has a whole nanosecond period or a whole hertz frequency respectively. */
+    config.timing_type = CLOCK_FREQ;
+    config.timing.freq = 1843200;
+    clk = clock_add(&emu, &config);
+    TEST_ASSERT_NOT_NULL(clk);
+
+    config.timing_type = CLOCK_PERIOD;
+    config.timing.period = 3000;
+    clk2 = clock_add(&emu, &config);
+    TEST_ASSERT_NOT_NULL(clk2);
+
+    TEST_ASSERT_NOT_NULL(clock_register_tick(emu.clk.mainClk, counter_tick_cb, &mainCnt));
+    TEST_ASSERT_NOT_NULL(clock_register_tick(clk, counter_tick_cb, &secCnt));
+    TEST_ASSERT_NOT_NULL(clock_register_tick(clk2, counter_tick_cb, &thrdCnt));
+
+    /* One second of the main clock is exactly one second of the others, without drift. */
+    for(index = 0; index < MAIN_CLK_FREQ; index++)
+    {
+        clock_main_tick(&emu);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(MAIN_CLK_FREQ, mainCnt);
+    TEST_ASSERT_EQUAL_UINT32(1843200, secCnt);
+    TEST_ASSERT_EQUAL_UINT32(333333, thrdCnt);
+}
+
+static clock_cb_handle_t gated_handle;
+
+static void self_suspend_tick_cb(clk_t clk, clock_edge_t edge, void *userdata)
+{
+    *(uint32_t *)userdata += 1;
+    clock_suspend_tick(gated_handle);
+}
+
+static void resume_tick_cb(clk_t clk, clock_edge_t edge, void *userdata)
+{
+    clock_resume_tick(gated_handle);
+}
+
+void test_suspend_tick(void)
+{
+    uint32_t gatedCnt = 0;
+    uint32_t mainCnt = 0;
+
+    gated_handle = clock_register_tick(emu.clk.mainClk, counter_tick_cb, &gatedCnt);
+    TEST_ASSERT_NOT_NULL(gated_handle);
+    TEST_ASSERT_NOT_NULL(clock_register_tick(emu.clk.mainClk, counter_tick_cb, &mainCnt));
+
+    clock_suspend_tick(gated_handle);
+    clock_suspend_tick(gated_handle);
+    clock_main_tick(&emu);
+
+    TEST_ASSERT_EQUAL_UINT32(0, gatedCnt);
+    TEST_ASSERT_EQUAL_UINT32(1, mainCnt);
+
+    clock_resume_tick(gated_handle);
+    clock_main_tick(&emu);
+
+    TEST_ASSERT_EQUAL_UINT32(1, gatedCnt);
+    TEST_ASSERT_EQUAL_UINT32(2, mainCnt);
+
+    /* Suspended handlers can still be unregistered. */
+    clock_suspend_tick(gated_handle);
+    clock_unregister_tick(gated_handle);
+    clock_main_tick(&emu);
+
+    TEST_ASSERT_EQUAL_UINT32(1, gatedCnt);
+    TEST_ASSERT_EQUAL_UINT32(3, mainCnt);
+}
+
+void test_suspend_tick_in_callback(void)
+{
+    uint32_t gatedCnt = 0;
+    uint32_t mainCnt = 0;
+
+    /* A handler suspending itself doesn't stop the handlers after it. */
+    gated_handle = clock_register_tick(emu.clk.mainClk, self_suspend_tick_cb, &gatedCnt);
+    TEST_ASSERT_NOT_NULL(gated_handle);
+    TEST_ASSERT_NOT_NULL(clock_register_tick(emu.clk.mainClk, counter_tick_cb, &mainCnt));
+
+    clock_main_tick(&emu);
+    clock_main_tick(&emu);
+
+    TEST_ASSERT_EQUAL_UINT32(1, gatedCnt);
+    TEST_ASSERT_EQUAL_UINT32(2, mainCnt);
+
+    /* Resuming from the last handler calls the resumed one on the same edge. */
+    TEST_ASSERT_NOT_NULL(clock_register_tick(emu.clk.mainClk, resume_tick_cb, NULL));
+    clock_main_tick(&emu);
+
+    TEST_ASSERT_EQUAL_UINT32(2, gatedCnt);
+    TEST_ASSERT_EQUAL_UINT32(3, mainCnt);
+}
+
+typedef struct
+{
+    unsigned int calls;
+    uint64_t cycles;
+    uint64_t reschedule;
+    clock_sync_handle_t handle;
+} sync_data_t;
+
+static void sync_cb(clk_t clk, uint64_t cycles, void *userdata)
+{
+    sync_data_t *data = (sync_data_t *)userdata;
+
+    data->calls++;
+    data->cycles += cycles;
+
+    if(data->reschedule > 0)
+    {
+        clock_sync_schedule(data->handle, data->reschedule);
+    }
+}
+
+void test_sync(void)
+{
+    sync_data_t data = { 0 };
+    unsigned int index;
+
+    data.handle = clock_register_sync(emu.clk.mainClk, sync_cb, &data);
+    TEST_ASSERT_NOT_NULL(data.handle);
+
+    /* Without a deadline the handler is only called when synced, with the elapsed cycles. */
+    for(index = 0; index < 10; index++)
+    {
+        clock_main_tick(&emu);
+    }
+
+    TEST_ASSERT_EQUAL_UINT(0, data.calls);
+    clock_sync(data.handle);
+    TEST_ASSERT_EQUAL_UINT(1, data.calls);
+    TEST_ASSERT_EQUAL_UINT64(10, data.cycles);
+
+    /* Nothing has elapsed since. */
+    clock_sync(data.handle);
+    TEST_ASSERT_EQUAL_UINT(1, data.calls);
+
+    /* A deadline is relative to the last sync and is called on the cycle it is reached. */
+    clock_sync_schedule(data.handle, 5);
+
+    for(index = 0; index < 4; index++)
+    {
+        clock_main_tick(&emu);
+    }
+
+    TEST_ASSERT_EQUAL_UINT(1, data.calls);
+    clock_main_tick(&emu);
+    TEST_ASSERT_EQUAL_UINT(2, data.calls);
+    TEST_ASSERT_EQUAL_UINT64(15, data.cycles);
+
+    /* A deadline is one-shot unless the handler schedules another. */
+    data.reschedule = 3;
+    clock_sync_schedule(data.handle, 3);
+
+    for(index = 0; index < 9; index++)
+    {
+        clock_main_tick(&emu);
+    }
+
+    TEST_ASSERT_EQUAL_UINT(5, data.calls);
+    TEST_ASSERT_EQUAL_UINT64(24, data.cycles);
+
+    /* Cancelling the deadline. */
+    clock_sync_schedule(data.handle, 0);
+
+    for(index = 0; index < 9; index++)
+    {
+        clock_main_tick(&emu);
+    }
+
+    TEST_ASSERT_EQUAL_UINT(5, data.calls);
+    TEST_ASSERT_EQUAL_UINT64(CLOCK_SYNC_NONE, emu.clk.mainClk->deadline);
+
+    clock_unregister_sync(data.handle);
+}
+
+void test_sync_derived(void)
+{
+    sync_data_t data = { 0 };
+    clock_config_t config;
+    clk_t clk;
+    unsigned int index;
+
+    config.timing_type = CLOCK_FREQ;
+    config.timing.freq = MAIN_CLK_FREQ * 2;
+    clk = clock_add(&emu, &config);
+    TEST_ASSERT_NOT_NULL(clk);
+
+    /* Cycles and deadlines count edges of the clock the handler follows. */
+    data.handle = clock_register_sync(clk, sync_cb, &data);
+    TEST_ASSERT_NOT_NULL(data.handle);
+    clock_sync_schedule(data.handle, 6);
+
+    for(index = 0; index < 3; index++)
+    {
+        clock_main_tick(&emu);
+    }
+
+    TEST_ASSERT_EQUAL_UINT(1, data.calls);
+    TEST_ASSERT_EQUAL_UINT64(6, data.cycles);
+}
+
 void setUp(void)
 {
     clock_config_t config;
@@ -178,9 +420,15 @@ int main(int argc, char *argv[])
     RUN_TEST(test_clock_add);
     RUN_TEST(test_clock_add_freq_round);
     RUN_TEST(test_add_clock_period);
+    RUN_TEST(test_add_clock_unschedulable);
     RUN_TEST(test_register_tick_main);
     RUN_TEST(test_main_clock_tick);
     RUN_TEST(test_two_clocks_half_freq);
     RUN_TEST(test_three_clocks_half_double);
+    RUN_TEST(test_exact_ratio);
+    RUN_TEST(test_suspend_tick);
+    RUN_TEST(test_suspend_tick_in_callback);
+    RUN_TEST(test_sync);
+    RUN_TEST(test_sync_derived);
     return UNITY_END();
 }
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "coverage.h"
+
+#define DBGINFO_FILE "coverage_tester.dbg"
+
+static cbemu_t emu;
+static coverage_t coverage;
+static uint8_t memory[0x10000];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+
+/*
+ * test.s, assembled at $0200:
+ *   1: LDX #2
+ *   2: loop: DEX
+ *   3: BNE loop
+ *   4: BEQ done
+ *   5: BCC *
+ *   6: done: JMP done
+ *   7: .byte $55
+ */
+static const uint8_t program[] = {
+    0xa2, 0x02, 0xca, 0xd0, 0xfd, 0xf0, 0x02, 0x90, 0xfe, 0x4c, 0x09, 0x02, 0x55
+};
+
+static const char dbginfo_text[] =
+    "version\tmajor=2,minor=0\n"
+    "info\tcsym=0,file=1,lib=0,line=7,mod=1,scope=1,seg=1,span=7,sym=0,type=1\n"
+    "file\tid=0,name=\"test.s\",size=100,mtime=0x00000000,mod=0\n"
+    "line\tid=0,file=0,line=1,span=0\n"
+    "line\tid=1,file=0,line=2,span=1\n"
+    "line\tid=2,file=0,line=3,span=2\n"
+    "line\tid=3,file=0,line=4,span=3\n"
+    "line\tid=4,file=0,line=5,span=4\n"
+    "line\tid=5,file=0,line=6,span=5\n"
+    "line\tid=6,file=0,line=7,span=6\n"
+    "mod\tid=0,name=\"test.o\",file=0\n"
+    "scope\tid=0,name=\"\",mod=0,size=13,span=0+1+2+3+4+5+6\n"
+    "seg\tid=0,name=\"CODE\",start=0x000200,size=0x000D,addrsize=absolute,type=ro\n"
+    "span\tid=0,seg=0,start=0,size=2\n"
+    "span\tid=1,seg=0,start=2,size=1\n"
+    "span\tid=2,seg=0,start=3,size=2\n"
+    "span\tid=3,seg=0,start=5,size=2\n"
+    "span\tid=4,seg=0,start=7,size=2\n"
+    "span\tid=5,seg=0,start=9,size=3\n"
+    "span\tid=6,seg=0,start=12,size=1,type=0\n"
+    "type\tid=0,val=\"800120\"\n";
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static void run(unsigned int cycles)
+{
+    while(cycles-- > 0)
+    {
+        emu_tick(emu);
+    }
+}
+
+static void dbginfo_error(const cc65_parseerror *error)
+{
+    printf("%s:%u:%u %s\n", error->name, error->line, error->column, error->errormsg);
+}
+
+void test_executed(void)
+{
+    /* Reset (7) + LDX (2) + DEX (2) + BNE (3) + DEX (2) + BNE (2) + BEQ (3) + 2 JMPs (6). */
+    run(27);
+
+    TEST_ASSERT_TRUE(coverage_is_executed(coverage, 0x0200));
+    TEST_ASSERT_FALSE(coverage_is_executed(coverage, 0x0201));
+    TEST_ASSERT_TRUE(coverage_is_executed(coverage, 0x0202));
+    TEST_ASSERT_TRUE(coverage_is_executed(coverage, 0x0203));
+    TEST_ASSERT_TRUE(coverage_is_executed(coverage, 0x0205));
+    TEST_ASSERT_FALSE(coverage_is_executed(coverage, 0x0207));
+    TEST_ASSERT_TRUE(coverage_is_executed(coverage, 0x0209));
+    TEST_ASSERT_EQUAL_UINT(5, coverage_get_executed_count(coverage));
+
+    TEST_ASSERT_EQUAL_UINT(COVERAGE_BRANCH_TAKEN | COVERAGE_BRANCH_NOT_TAKEN, coverage_get_branch(coverage, 0x0203));
+    TEST_ASSERT_EQUAL_UINT(COVERAGE_BRANCH_TAKEN, coverage_get_branch(coverage, 0x0205));
+    TEST_ASSERT_EQUAL_UINT(COVERAGE_BRANCH_NONE, coverage_get_branch(coverage, 0x0207));
+
+    coverage_reset(coverage);
+    TEST_ASSERT_EQUAL_UINT(0, coverage_get_executed_count(coverage));
+
+    run(3);
+    TEST_ASSERT_EQUAL_UINT(1, coverage_get_executed_count(coverage));
+    TEST_ASSERT_TRUE(coverage_is_executed(coverage, 0x0209));
+}
+
+void test_lcov(void)
+{
+    cc65_dbginfo dbginfo;
+    FILE *out;
+    char buffer[512];
+    size_t len;
+
+    out = fopen(DBGINFO_FILE, "w");
+    TEST_ASSERT_NOT_NULL(out);
+    fputs(dbginfo_text, out);
+    fclose(out);
+
+    dbginfo = cc65_read_dbginfo(DBGINFO_FILE, dbginfo_error);
+    remove(DBGINFO_FILE);
+    TEST_ASSERT_NOT_NULL(dbginfo);
+
+    run(27);
+
+    out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_TRUE(coverage_write_lcov(coverage, dbginfo, out, "firmware"));
+
+    rewind(out);
+    len = fread(buffer, 1, sizeof(buffer) - 1, out);
+    buffer[len] = '\0';
+    fclose(out);
+
+    /* The data span on line 7 is not reported, and the unexecuted branch on line 5 is
+     * reported as never evaluated. */
+    TEST_ASSERT_EQUAL_STRING(
+        "TN:firmware\n"
+        "SF:test.s\n"
+        "BRDA:3,0,0,1\n"
+        "BRDA:3,0,1,1\n"
+        "BRDA:4,0,0,1\n"
+        "BRDA:4,0,1,0\n"
+        "BRDA:5,0,0,-\n"
+        "BRDA:5,0,1,-\n"
+        "BRF:6\n"
+        "BRH:3\n"
+        "DA:1,1\n"
+        "DA:2,1\n"
+        "DA:3,1\n"
+        "DA:4,1\n"
+        "DA:5,0\n"
+        "DA:6,1\n"
+        "LF:6\n"
+        "LH:5\n"
+        "end_of_record\n", buffer);
+
+    cc65_free_dbginfo(dbginfo);
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    memset(memory, 0, sizeof(memory));
+    memcpy(&memory[0x0200], program, sizeof(program));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+
+    coverage = coverage_init(emu);
+    TEST_ASSERT_NOT_NULL(coverage);
+
+    /* Only one coverage map can be attached at a time. */
+    TEST_ASSERT_NULL(coverage_init(emu));
+}
+
+void tearDown(void)
+{
+    coverage_cleanup(coverage);
+    coverage = NULL;
+
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_executed);
+    RUN_TEST(test_lcov);
+
+    return UNITY_END();
+}
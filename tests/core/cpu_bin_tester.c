@@ -126,6 +126,7 @@ void setUp(void)
 
     config.mainclk_config.timing_type = CLOCK_FREQ;
     config.mainclk_config.timing.freq = 1000000;
+    config.cpu_engine = CPU_ENGINE_CYCLE;
     emu = emu_init(&config);
 
     in_opcode = false;
@@ -0,0 +1,553 @@
+/*
+ * Differential fuzzer for the CPU execution engines.
+ *
+ * Each case fills memory and the registers with random data and runs the resulting instruction
+ * stream on both the cycle-accurate reference engine and a candidate engine, each in its own
+ * emulator instance. After every instruction the registers, cycle counts, bus accesses (including
+ * the cycle each was made on), CPU events and call stacks are compared. Memory and coverage are
+ * compared at the end of each case. IRQ, NMI and RDY are randomly driven before every cycle, the
+ * same on both engines, so they also change partway through instructions.
+ *
+ * The candidate is FUZZ_ENGINE. Until there is an engine besides the reference, the reference is
+ * run against itself, which checks that it is deterministic.
+ *
+ * Cases are spread across all host cores. Every case is derived from its own seed, which is
+ * reported on divergence and can be replayed alone:
+ *
+ *   cpu_fuzz_tester [-s SEED] [-n CASES] [-i INSTRUCTIONS] [-j THREADS]
+ *   cpu_fuzz_tester -r CASE_SEED [-i INSTRUCTIONS]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "coverage.h"
+#include "cpu_priv.h"
+
+#define FUZZ_DEFAULT_SEED           0x6502
+#define FUZZ_DEFAULT_CASES          2048
+#define FUZZ_DEFAULT_INSTRUCTIONS   256
+
+/* Engine checked against the reference. */
+#ifndef FUZZ_ENGINE
+#define FUZZ_ENGINE                 CPU_ENGINE_CYCLE
+#endif
+
+/* Most accesses made by a single instruction or vector sequence is 7. */
+#define FUZZ_LOG_MAX                16
+#define FUZZ_NUM_EVENTS             (CPU_EVENT_STACK_UNDERFLOW + 1)
+
+typedef struct
+{
+    uint64_t cycle;
+    uint16_t addr;
+    uint8_t value;
+    bool write;
+    bus_flags_t flags;
+} fuzz_access_t;
+
+typedef struct
+{
+    cbemu_t emu;
+    coverage_t coverage;
+    cpu_hook_t *hook;
+    bus_signal_voter_t voter;
+    unsigned int log_cnt;
+    fuzz_access_t log[FUZZ_LOG_MAX];
+    unsigned int events[FUZZ_NUM_EVENTS];
+    uint8_t memory[0x10000];
+} fuzz_engine_t;
+
+typedef struct
+{
+    bool irq;
+    bool nmi;
+    bool rdy;
+} fuzz_signals_t;
+
+typedef struct
+{
+    pthread_t thread;
+    unsigned int index;
+    unsigned int failures;
+    fuzz_engine_t engines[2];
+} fuzz_worker_t;
+
+static uint64_t master_seed = FUZZ_DEFAULT_SEED;
+static unsigned int num_cases = FUZZ_DEFAULT_CASES;
+static unsigned int num_instructions = FUZZ_DEFAULT_INSTRUCTIONS;
+static unsigned int num_threads;
+static uint64_t replay_seed;
+static bool replay;
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const engine_names[2] = { "reference", "candidate" };
+
+/* splitmix64 */
+static uint64_t fuzz_rand(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+static uint64_t fuzz_case_seed(unsigned int index)
+{
+    uint64_t state = master_seed ^ ((uint64_t)index << 32);
+
+    return fuzz_rand(&state);
+}
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return ((fuzz_engine_t *)userdata)->memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    ((fuzz_engine_t *)userdata)->memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static void trace_cb(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata)
+{
+    fuzz_engine_t *engine = (fuzz_engine_t *)userdata;
+    fuzz_access_t *access;
+
+    if(engine->log_cnt < FUZZ_LOG_MAX)
+    {
+        access = &engine->log[engine->log_cnt];
+        access->cycle = engine->emu->cpu.cycles;
+        access->addr = addr;
+        access->value = value;
+        access->write = write;
+        access->flags = flags;
+    }
+
+    ++engine->log_cnt;
+}
+
+static void hook_cb(cbemu_t emu, cpu_event_t event, const cpu_call_frame_t *frame, void *userdata)
+{
+    ++((fuzz_engine_t *)userdata)->events[event];
+}
+
+static bool engine_init(fuzz_engine_t *engine, cpu_engine_t type)
+{
+    emu_config_t config;
+    bus_decode_params_t params;
+
+    memset(&config, 0, sizeof(config));
+    config.mainclk_config.timing_type = CLOCK_FREQ;
+    config.mainclk_config.timing.freq = 1000000;
+    config.cpu_engine = type;
+
+    engine->emu = emu_init(&config);
+
+    if(engine->emu == NULL)
+        return false;
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+
+    engine->voter = emu_bus_register_sig_voter(engine->emu);
+    engine->coverage = coverage_init(engine->emu);
+    engine->hook = cpu_add_hook(engine->emu, hook_cb, engine);
+
+    return emu_bus_register(engine->emu, &params, &mem_handlers, engine) != NULL &&
+           emu_bus_add_tracer(engine->emu, trace_cb, engine) != NULL &&
+           engine->voter != BUS_SIGNAL_INVALID_VOTER &&
+           engine->coverage != NULL &&
+           engine->hook != NULL;
+}
+
+static void engine_cleanup(fuzz_engine_t *engine)
+{
+    coverage_cleanup(engine->coverage);
+    emu_cleanup(engine->emu);
+
+    engine->coverage = NULL;
+    engine->emu = NULL;
+}
+
+static void engine_vote(fuzz_engine_t *engine, const fuzz_signals_t *signals)
+{
+    emu_bus_sig_vote(engine->emu, engine->voter, BUS_SIG_IRQ, signals->irq);
+    emu_bus_sig_vote(engine->emu, engine->voter, BUS_SIG_NMI, signals->nmi);
+    emu_bus_sig_vote(engine->emu, engine->voter, BUS_SIG_RDY, signals->rdy);
+}
+
+/**
+ * Runs both engines a tick at a time through a single instruction, vector sequence or RDY stall.
+ *
+ * @param[in] worker    The worker whose engines to run.
+ * @param[in] state     Random state to drive the signals from before each tick, or NULL to leave
+ *                      them alone.
+ * @param[in] signals   The signals, updated as they are driven.
+ *
+ * @return true if both engines finished the step on the same tick.
+ */
+static bool worker_step(fuzz_worker_t *worker, uint64_t *state, fuzz_signals_t *signals)
+{
+    fuzz_engine_t *ref = &worker->engines[0];
+    fuzz_engine_t *cand = &worker->engines[1];
+    uint64_t random;
+    bool ref_done;
+    bool cand_done;
+
+    ref->log_cnt = 0;
+    cand->log_cnt = 0;
+    memset(ref->events, 0, sizeof(ref->events));
+    memset(cand->events, 0, sizeof(cand->events));
+
+    do
+    {
+        if(state != NULL)
+        {
+            random = fuzz_rand(state);
+
+            /* Occasionally toggle IRQ, raise or drop NMI, and stall the CPU with RDY. */
+            if((random & 0x3f) == 0)
+                signals->irq = !signals->irq;
+
+            if(((random >> 6) & 0xff) == 0)
+                signals->nmi = !signals->nmi;
+
+            signals->rdy = ((random >> 14) & 0x0f) == 0;
+
+            engine_vote(ref, signals);
+            engine_vote(cand, signals);
+        }
+
+        emu_tick(ref->emu);
+        emu_tick(cand->emu);
+
+        ref_done = (ref->emu->cpu.op_state == OPCODE);
+        cand_done = (cand->emu->cpu.op_state == OPCODE);
+    } while(!ref_done && !cand_done);
+
+    return ref_done == cand_done;
+}
+
+static void print_engine(const fuzz_engine_t *engine, const char *name)
+{
+    const cpu_regs_t *regs = &engine->emu->cpu.regs;
+    unsigned int index;
+
+    printf("  %s: PC=$%04x A=$%02x X=$%02x Y=$%02x SP=$%02x P=$%02x cycle=%" PRIu64 " depth=%u\n",
+           name, regs->pc, regs->a, regs->x, regs->y, regs->sp, regs->status,
+           engine->emu->cpu.cycles, engine->emu->cpu.callstack.depth);
+
+    for(index = 0; index < engine->log_cnt && index < FUZZ_LOG_MAX; ++index)
+    {
+        printf("    %" PRIu64 ": %c $%04x $%02x%s%s\n", engine->log[index].cycle,
+               engine->log[index].write ? 'W' : 'R', engine->log[index].addr, engine->log[index].value,
+               (engine->log[index].flags & SYNC) ? " SYNC" : "",
+               (engine->log[index].flags & DUMMY) ? " DUMMY" : "");
+    }
+}
+
+/* Compares the state of both engines after a step, returning a description of the first difference. */
+static const char *compare_step(const fuzz_worker_t *worker, bool together)
+{
+    const fuzz_engine_t *ref = &worker->engines[0];
+    const fuzz_engine_t *cand = &worker->engines[1];
+    const cpu_t *ref_cpu = &ref->emu->cpu;
+    const cpu_t *cand_cpu = &cand->emu->cpu;
+    const cpu_call_frame_t *ref_frame;
+    const cpu_call_frame_t *cand_frame;
+    unsigned int index;
+
+    if(!together || ref_cpu->cycles != cand_cpu->cycles)
+        return "cycle count";
+
+    if(ref_cpu->regs.pc != cand_cpu->regs.pc || ref_cpu->regs.sp != cand_cpu->regs.sp ||
+       ref_cpu->regs.a != cand_cpu->regs.a || ref_cpu->regs.x != cand_cpu->regs.x ||
+       ref_cpu->regs.y != cand_cpu->regs.y || ref_cpu->regs.status != cand_cpu->regs.status)
+    {
+        return "registers";
+    }
+
+    if(ref->log_cnt != cand->log_cnt)
+        return "number of bus accesses";
+
+    for(index = 0; index < ref->log_cnt && index < FUZZ_LOG_MAX; ++index)
+    {
+        if(ref->log[index].cycle != cand->log[index].cycle ||
+           ref->log[index].addr != cand->log[index].addr ||
+           ref->log[index].value != cand->log[index].value ||
+           ref->log[index].write != cand->log[index].write ||
+           ref->log[index].flags != cand->log[index].flags)
+        {
+            return "bus access";
+        }
+    }
+
+    if(memcmp(ref->events, cand->events, sizeof(ref->events)) != 0)
+        return "CPU events";
+
+    if(ref_cpu->callstack.depth != cand_cpu->callstack.depth ||
+       ref_cpu->callstack.dropped != cand_cpu->callstack.dropped)
+    {
+        return "call stack depth";
+    }
+
+    if(ref_cpu->callstack.depth > 0)
+    {
+        ref_frame = &ref_cpu->callstack.frames[ref_cpu->callstack.depth - 1];
+        cand_frame = &cand_cpu->callstack.frames[cand_cpu->callstack.depth - 1];
+
+        if(ref_frame->target != cand_frame->target ||
+           ref_frame->sp != cand_frame->sp ||
+           ref_frame->type != cand_frame->type ||
+           ref_frame->entry_cycle != cand_frame->entry_cycle)
+        {
+            return "call stack frame";
+        }
+    }
+
+    return NULL;
+}
+
+/* Compares state that is only checked at the end of a case. */
+static const char *compare_final(const fuzz_worker_t *worker)
+{
+    const fuzz_engine_t *ref = &worker->engines[0];
+    const fuzz_engine_t *cand = &worker->engines[1];
+
+    if(memcmp(ref->memory, cand->memory, sizeof(ref->memory)) != 0)
+        return "memory";
+
+    if(memcmp(ref->emu->cpu.coverage, cand->emu->cpu.coverage, sizeof(cpu_coverage_t)) != 0)
+        return "coverage";
+
+    return NULL;
+}
+
+static void report(const fuzz_worker_t *worker, uint64_t seed, unsigned int step, uint16_t pc, const char *what)
+{
+    pthread_mutex_lock(&report_lock);
+
+    printf("Case 0x%016" PRIx64 " diverged in %s at step %u (PC $%04x, opcode $%02x)\n",
+           seed, what, step, pc, worker->engines[0].memory[pc]);
+
+    if(replay)
+    {
+        print_engine(&worker->engines[0], engine_names[0]);
+        print_engine(&worker->engines[1], engine_names[1]);
+    }
+    else
+    {
+        printf("  Replay with: cpu_fuzz_tester -r 0x%016" PRIx64 " -i %u\n", seed, num_instructions);
+    }
+
+    pthread_mutex_unlock(&report_lock);
+}
+
+/**
+ * Runs a single fuzz case.
+ *
+ * @param[in] worker    The worker to run the case on.
+ * @param[in] seed      The seed of the case.
+ *
+ * @return true if both engines matched.
+ */
+static bool run_case(fuzz_worker_t *worker, uint64_t seed)
+{
+    fuzz_engine_t *ref = &worker->engines[0];
+    fuzz_engine_t *cand = &worker->engines[1];
+    uint64_t state = seed;
+    uint64_t random = 0;
+    unsigned int step;
+    unsigned int index;
+    const char *what = NULL;
+    cpu_regs_t regs;
+    fuzz_signals_t signals = { false, false, false };
+    uint16_t pc;
+
+    if(!engine_init(ref, CPU_ENGINE_CYCLE) || !engine_init(cand, FUZZ_ENGINE))
+    {
+        engine_cleanup(ref);
+        engine_cleanup(cand);
+        report(worker, seed, 0, 0, "initialization");
+        return false;
+    }
+
+    for(index = 0; index < sizeof(ref->memory); ++index)
+    {
+        if((index & 0x07) == 0)
+            random = fuzz_rand(&state);
+
+        ref->memory[index] = (uint8_t)random;
+        random >>= 8;
+    }
+
+    memcpy(cand->memory, ref->memory, sizeof(ref->memory));
+
+    /* Reset sequence. */
+    what = compare_step(worker, worker_step(worker, NULL, &signals));
+    pc = 0;
+    step = 0;
+
+    if(what == NULL)
+    {
+        /* Start from a random register state. */
+        random = fuzz_rand(&state);
+        regs.a = (uint8_t)random;
+        regs.x = (uint8_t)(random >> 8);
+        regs.y = (uint8_t)(random >> 16);
+        regs.sp = (uint8_t)(random >> 24);
+        /* The unused status bit always reads as set. */
+        regs.status = (uint8_t)(random >> 32) | 0x20;
+        regs.pc = (uint16_t)(random >> 40);
+
+        ref->emu->cpu.regs = regs;
+        cand->emu->cpu.regs = regs;
+    }
+
+    for(step = 1; step <= num_instructions && what == NULL; ++step)
+    {
+        pc = ref->emu->cpu.regs.pc;
+
+        what = compare_step(worker, worker_step(worker, &state, &signals));
+    }
+
+    if(what == NULL)
+    {
+        what = compare_final(worker);
+    }
+
+    if(what != NULL)
+    {
+        report(worker, seed, step - 1, pc, what);
+    }
+
+    engine_cleanup(ref);
+    engine_cleanup(cand);
+
+    return what == NULL;
+}
+
+static void *worker_thread(void *param)
+{
+    fuzz_worker_t *worker = (fuzz_worker_t *)param;
+    unsigned int index;
+
+    for(index = worker->index; index < num_cases; index += num_threads)
+    {
+        if(!run_case(worker, fuzz_case_seed(index)))
+        {
+            ++worker->failures;
+        }
+    }
+
+    return NULL;
+}
+
+void test_differential(void)
+{
+    fuzz_worker_t *workers;
+    unsigned int index;
+    unsigned int failures = 0;
+
+    if(replay)
+    {
+        num_threads = 1;
+    }
+
+    workers = calloc(num_threads, sizeof(fuzz_worker_t));
+    TEST_ASSERT_NOT_NULL(workers);
+
+    if(replay)
+    {
+        failures = run_case(&workers[0], replay_seed) ? 0 : 1;
+    }
+    else
+    {
+        for(index = 0; index < num_threads; ++index)
+        {
+            workers[index].index = index;
+            TEST_ASSERT_EQUAL_INT(0, pthread_create(&workers[index].thread, NULL, worker_thread, &workers[index]));
+        }
+
+        for(index = 0; index < num_threads; ++index)
+        {
+            pthread_join(workers[index].thread, NULL);
+            failures += workers[index].failures;
+        }
+    }
+
+    free(workers);
+
+    TEST_ASSERT_EQUAL_UINT(0, failures);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+int main(int argc, char *argv[])
+{
+    long cores;
+    int opt;
+
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = (cores > 0) ? (unsigned int)cores : 1;
+
+    while((opt = getopt(argc, argv, "s:n:i:j:r:")) != -1)
+    {
+        switch(opt)
+        {
+            case 's':
+                master_seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                num_cases = (unsigned int)strtoul(optarg, NULL, 0);
+                break;
+            case 'i':
+                num_instructions = (unsigned int)strtoul(optarg, NULL, 0);
+                break;
+            case 'j':
+                num_threads = (unsigned int)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                replay_seed = strtoull(optarg, NULL, 0);
+                replay = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-s SEED] [-n CASES] [-i INSTRUCTIONS] [-j THREADS] [-r CASE_SEED]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(num_threads == 0)
+        num_threads = 1;
+
+    if(!replay)
+        printf("Seed 0x%" PRIx64 ", %u cases of %u instructions on %u threads\n", master_seed, num_cases, num_instructions, num_threads);
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_differential);
+
+    return UNITY_END();
+}
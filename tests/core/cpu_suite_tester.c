@@ -0,0 +1,261 @@
+/*
+ * Full-program CPU conformance runner and throughput benchmark.
+ *
+ * Runs a flat 64K image, such as the 6502/65C02 functional and decimal test suites, on each CPU
+ * engine until the program traps (an instruction that jumps or branches to itself). The run passes
+ * if the trap is at the expected success address and, optionally, a result byte in memory holds the
+ * expected value. Instructions per second and effective clock rate are reported for each engine, so
+ * the same workload covers both correctness and speed regressions.
+ *
+ * With no image, a small built-in checksum program is run instead.
+ *
+ *   cpu_suite_tester [-e cycle] [-l LOAD_ADDR] [-s START_PC] [-p SUCCESS_PC]
+ *                    [-c ADDR=VALUE] [-m MAX_CYCLES] [IMAGE]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "cpu_priv.h"
+
+#define SUITE_DEFAULT_MAX_CYCLES    2000000000ULL
+
+/* Sums X over 256x256 iterations into $10/$11, then checks for the expected $8000. */
+#define BUILTIN_LOAD        0x0400
+#define BUILTIN_SUCCESS     0x0424
+
+static const uint8_t builtin_program[] = {
+    0xa2, 0x00,             /* 0400: LDX #0     */
+    0xa0, 0x00,             /* 0402: LDY #0     */
+    0xa9, 0x00,             /* 0404: LDA #0     */
+    0x85, 0x10,             /* 0406: STA $10    */
+    0x85, 0x11,             /* 0408: STA $11    */
+    0x18,                   /* 040a: CLC        */
+    0x8a,                   /* 040b: TXA        */
+    0x65, 0x10,             /* 040c: ADC $10    */
+    0x85, 0x10,             /* 040e: STA $10    */
+    0x90, 0x02,             /* 0410: BCC $0414  */
+    0xe6, 0x11,             /* 0412: INC $11    */
+    0xca,                   /* 0414: DEX        */
+    0xd0, 0xf3,             /* 0415: BNE $040a  */
+    0x88,                   /* 0417: DEY        */
+    0xd0, 0xf0,             /* 0418: BNE $040a  */
+    0xa5, 0x10,             /* 041a: LDA $10    */
+    0xd0, 0x0c,             /* 041c: BNE $042a  */
+    0xa5, 0x11,             /* 041e: LDA $11    */
+    0xc9, 0x80,             /* 0420: CMP #$80   */
+    0xd0, 0x06,             /* 0422: BNE $042a  */
+    0x4c, 0x24, 0x04,       /* 0424: JMP $0424  */
+    0xea, 0xea, 0xea,       /* 0427: NOP x3     */
+    0x4c, 0x2a, 0x04        /* 042a: JMP $042a  */
+};
+
+static cbemu_t emu;
+static uint8_t image[0x10000];
+static uint8_t memory[0x10000];
+static const char *image_path;
+static uint16_t load_addr;
+static uint16_t start_pc;
+static bool start_pc_set;
+static uint16_t success_pc;
+static uint16_t check_addr;
+static uint8_t check_value;
+static bool check_set;
+static uint64_t max_cycles = SUITE_DEFAULT_MAX_CYCLES;
+static bool run_cycle = true;
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static bool load_image(void)
+{
+    FILE *file;
+    size_t len;
+
+    memset(image, 0, sizeof(image));
+
+    if(image_path == NULL)
+    {
+        load_addr = BUILTIN_LOAD;
+        memcpy(&image[BUILTIN_LOAD], builtin_program, sizeof(builtin_program));
+        image[0xfffc] = (uint8_t)(BUILTIN_LOAD & 0xff);
+        image[0xfffd] = (uint8_t)(BUILTIN_LOAD >> 8);
+        success_pc = BUILTIN_SUCCESS;
+        return true;
+    }
+
+    file = fopen(image_path, "rb");
+
+    if(file == NULL)
+    {
+        perror(image_path);
+        return false;
+    }
+
+    len = fread(&image[load_addr], 1, sizeof(image) - load_addr, file);
+    fclose(file);
+
+    if(len == 0)
+    {
+        fprintf(stderr, "%s: empty image\n", image_path);
+        return false;
+    }
+
+    return true;
+}
+
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void run_suite(cpu_engine_t engine, const char *name)
+{
+    emu_config_t config;
+    bus_decode_params_t params;
+    struct timespec start;
+    struct timespec end;
+    uint64_t instructions = 0;
+    uint64_t cycles;
+    double secs;
+    bool trapped = false;
+
+    memset(&config, 0, sizeof(config));
+    config.mainclk_config.timing_type = CLOCK_FREQ;
+    config.mainclk_config.timing.freq = 1000000;
+    config.cpu_engine = engine;
+
+    memcpy(memory, image, sizeof(memory));
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+
+    /* Complete the reset sequence, then optionally override the vector's start address. */
+    do
+    {
+        emu_tick(emu);
+    } while(emu->cpu.op_state != OPCODE);
+
+    if(start_pc_set)
+        emu->cpu.regs.pc = start_pc;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while(!trapped && emu->cpu.cycles < max_cycles)
+    {
+        do
+        {
+            emu_tick(emu);
+        } while(emu->cpu.op_state != OPCODE);
+
+        ++instructions;
+        trapped = (emu->cpu.regs.pc == emu->cpu.opaddr);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    cycles = emu->cpu.cycles;
+    secs = elapsed(&start, &end);
+
+    printf("%s: trap at $%04x after %" PRIu64 " instructions, %" PRIu64 " cycles in %.3f s: %.2f M instr/s, %.2f MHz effective\n",
+           name, emu->cpu.regs.pc, instructions, cycles, secs,
+           (secs > 0) ? instructions / secs / 1e6 : 0.0,
+           (secs > 0) ? cycles / secs / 1e6 : 0.0);
+
+    TEST_ASSERT_TRUE_MESSAGE(trapped, "Cycle limit reached without trapping");
+    TEST_ASSERT_EQUAL_HEX16_MESSAGE(success_pc, emu->cpu.regs.pc, "Trapped at a failure address");
+
+    if(check_set)
+        TEST_ASSERT_EQUAL_HEX8_MESSAGE(check_value, memory[check_addr], "Unexpected result byte");
+}
+
+void test_cycle_engine(void)
+{
+    if(!run_cycle)
+        TEST_IGNORE();
+
+    run_suite(CPU_ENGINE_CYCLE, "cycle");
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    char *sep;
+    int opt;
+
+    while((opt = getopt(argc, argv, "e:l:s:p:c:m:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'e':
+                run_cycle = (strcmp(optarg, "cycle") == 0);
+                break;
+            case 'l':
+                load_addr = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                start_pc = (uint16_t)strtoul(optarg, NULL, 0);
+                start_pc_set = true;
+                break;
+            case 'p':
+                success_pc = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                check_addr = (uint16_t)strtoul(optarg, &sep, 0);
+                check_value = (*sep == '=') ? (uint8_t)strtoul(sep + 1, NULL, 0) : 0;
+                check_set = true;
+                break;
+            case 'm':
+                max_cycles = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-e cycle] [-l LOAD_ADDR] [-s START_PC] [-p SUCCESS_PC] [-c ADDR=VALUE] [-m MAX_CYCLES] [IMAGE]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(optind < argc)
+        image_path = argv[optind];
+
+    if(!load_image())
+        return 1;
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_cycle_engine);
+
+    return UNITY_END();
+}
@@ -0,0 +1,365 @@
+#include <string.h>
+#include <pthread.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "debugger.h"
+#include "emu_priv_types.h"
+#include "bus_priv.h"
+#include "os_notify.h"
+
+static cbemu_t emu;
+static debug_t debugger;
+static uint8_t memory[0x10000];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+
+/* The JMP at the end of the program, used to stop runs that don't hit a watchpoint. */
+#define LOOP_ADDR   0x020f
+
+static const uint8_t program[] = {
+    0xa9, 0x00,         /* 0200: LDA #$00 */
+    0x85, 0x10,         /* 0202: STA $10 */
+    0xa5, 0x11,         /* 0204: LDA $11 */
+    0xa9, 0x55,         /* 0206: LDA #$55 */
+    0x85, 0x10,         /* 0208: STA $10 */
+    0xa9, 0xaa,         /* 020a: LDA #$AA */
+    0x8d, 0x00, 0x03,   /* 020c: STA $0300 */
+    0x4c, 0x00, 0x02,   /* 020f: JMP $0200 */
+};
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static void other_watch(uint16_t addr, uint8_t value, bool write, bus_flags_t flags, void *userdata)
+{
+}
+
+/* State shared with the commands, which run on the emulation thread. */
+static pthread_t emu_thread;
+static debug_breakpoint_t cmd_bp;
+static unsigned int cmd_count;
+
+static void cmd_poke_break(debug_t handle, void *userdata)
+{
+    TEST_ASSERT_TRUE(pthread_equal(emu_thread, pthread_self()));
+
+    memory[0x0300] = *(uint8_t *)userdata;
+    ++cmd_count;
+    debug_break(handle);
+}
+
+static void cmd_set_breakpoint(debug_t handle, void *userdata)
+{
+    TEST_ASSERT_TRUE(pthread_equal(emu_thread, pthread_self()));
+    TEST_ASSERT_TRUE(debug_set_breakpoint_addr(handle, &cmd_bp, (uint16_t)(uintptr_t)userdata));
+    ++cmd_count;
+}
+
+static void *call_thread(void *param)
+{
+    debug_call(debugger, cmd_set_breakpoint, (void *)(uintptr_t)0x0206);
+
+    return NULL;
+}
+
+/* Runs with a breakpoint on the loop, returning the handle that stopped execution. */
+static debug_breakpoint_t run_to_loop(void)
+{
+    debug_breakpoint_t loop;
+    debug_breakpoint_t hit;
+
+    TEST_ASSERT_TRUE(debug_set_breakpoint_addr(debugger, &loop, LOOP_ADDR));
+    debug_run(debugger, &hit);
+    debug_clear_breakpoint(debugger, loop);
+
+    return (hit == loop) ? BREAKPOINT_HANDLE_SW_REQUEST : hit;
+}
+
+static void set_watch(debug_breakpoint_t *bp, uint16_t start, uint16_t end, uint8_t ops)
+{
+    debug_watch_t watch;
+
+    watch.addr_start = start;
+    watch.addr_end = end;
+    watch.ops = ops;
+    watch.match_value = false;
+    watch.value = 0;
+
+    TEST_ASSERT_TRUE(debug_set_watchpoint(debugger, bp, &watch));
+}
+
+void test_write(void)
+{
+    debug_breakpoint_t bp;
+    debug_watch_hit_t hit;
+
+    set_watch(&bp, 0x0010, 0x0010, DEBUG_WATCH_WRITE);
+    TEST_ASSERT_EQUAL_UINT32(bp, run_to_loop());
+
+    TEST_ASSERT_TRUE(debug_get_watch_hit(debugger, &hit));
+    TEST_ASSERT_EQUAL_UINT32(bp, hit.handle);
+    TEST_ASSERT_EQUAL_HEX16(0x0010, hit.address);
+    TEST_ASSERT_EQUAL_HEX8(0x00, hit.value);
+    TEST_ASSERT_TRUE(hit.write);
+    TEST_ASSERT_EQUAL_HEX16(0x0202, hit.pc);
+
+    /* Execution stops once the instruction has completed. */
+    TEST_ASSERT_EQUAL_HEX16(0x0204, emu->cpu.regs.pc);
+
+    TEST_ASSERT_EQUAL_UINT32(bp, run_to_loop());
+    TEST_ASSERT_TRUE(debug_get_watch_hit(debugger, &hit));
+    TEST_ASSERT_EQUAL_HEX8(0x55, hit.value);
+    TEST_ASSERT_EQUAL_HEX16(0x0208, hit.pc);
+
+    /* A run that stops elsewhere has no hit. */
+    debug_clear_breakpoint(debugger, bp);
+    TEST_ASSERT_EQUAL_UINT32(BREAKPOINT_HANDLE_SW_REQUEST, run_to_loop());
+    TEST_ASSERT_FALSE(debug_get_watch_hit(debugger, &hit));
+}
+
+void test_change(void)
+{
+    debug_breakpoint_t bp;
+    debug_watch_hit_t hit;
+
+    /* Writing the value already in memory isn't a change. */
+    set_watch(&bp, 0x0010, 0x0010, DEBUG_WATCH_CHANGE);
+    TEST_ASSERT_EQUAL_UINT32(bp, run_to_loop());
+
+    TEST_ASSERT_TRUE(debug_get_watch_hit(debugger, &hit));
+    TEST_ASSERT_EQUAL_HEX8(0x55, hit.value);
+    TEST_ASSERT_EQUAL_HEX16(0x0208, hit.pc);
+    TEST_ASSERT_EQUAL_HEX8(0x55, memory[0x0010]);
+}
+
+void test_read(void)
+{
+    debug_breakpoint_t bp;
+    debug_watch_hit_t hit;
+
+    /* Writes to $10 are in range but don't trigger a read watchpoint. */
+    memory[0x0011] = 0x42;
+    set_watch(&bp, 0x0010, 0x0011, DEBUG_WATCH_READ);
+    TEST_ASSERT_EQUAL_UINT32(bp, run_to_loop());
+
+    TEST_ASSERT_TRUE(debug_get_watch_hit(debugger, &hit));
+    TEST_ASSERT_EQUAL_HEX16(0x0011, hit.address);
+    TEST_ASSERT_EQUAL_HEX8(0x42, hit.value);
+    TEST_ASSERT_FALSE(hit.write);
+    TEST_ASSERT_EQUAL_HEX16(0x0204, hit.pc);
+}
+
+void test_match_value(void)
+{
+    debug_watch_t watch;
+    debug_breakpoint_t bp;
+    debug_watch_hit_t hit;
+
+    watch.addr_start = 0x0010;
+    watch.addr_end = 0x0010;
+    watch.ops = DEBUG_WATCH_WRITE;
+    watch.match_value = true;
+    watch.value = 0x55;
+
+    TEST_ASSERT_TRUE(debug_set_watchpoint(debugger, &bp, &watch));
+    TEST_ASSERT_EQUAL_UINT32(bp, run_to_loop());
+
+    TEST_ASSERT_TRUE(debug_get_watch_hit(debugger, &hit));
+    TEST_ASSERT_EQUAL_HEX16(0x0208, hit.pc);
+}
+
+void test_pages(void)
+{
+    debug_breakpoint_t first, second;
+    unsigned int page;
+
+    set_watch(&first, 0x0300, 0x0300, DEBUG_WATCH_WRITE);
+    set_watch(&second, 0x12f0, 0x1410, DEBUG_WATCH_READ);
+
+    for(page = 0; page < BUS_NUM_PAGES; ++page)
+    {
+        TEST_ASSERT_EQUAL(page == 0x03 || (page >= 0x12 && page <= 0x14), (emu->bus.pages[page].flags & BUS_PAGE_WATCH) != 0);
+    }
+
+    /* Clearing one watchpoint leaves the pages of the other flagged. */
+    debug_clear_breakpoint(debugger, second);
+    TEST_ASSERT_TRUE(emu->bus.pages[0x03].flags & BUS_PAGE_WATCH);
+    TEST_ASSERT_FALSE(emu->bus.pages[0x13].flags & BUS_PAGE_WATCH);
+
+    /* The bus watch is released with the last watchpoint. */
+    debug_clear_breakpoint(debugger, first);
+    TEST_ASSERT_FALSE(emu->bus.pages[0x03].flags & BUS_PAGE_WATCH);
+    TEST_ASSERT_NULL(emu->bus.watch);
+}
+
+void test_handles(void)
+{
+    breakpoint_info_t info[DEBUG_MAX_BREAKPOINTS];
+    unsigned int num = DEBUG_MAX_BREAKPOINTS;
+    unsigned int total;
+    debug_breakpoint_t exec, watch;
+
+    TEST_ASSERT_TRUE(debug_set_breakpoint_addr(debugger, &exec, 0x0300));
+    set_watch(&watch, 0x0300, 0x0301, DEBUG_WATCH_READ | DEBUG_WATCH_WRITE);
+    TEST_ASSERT_NOT_EQUAL(exec, watch);
+
+    debug_get_breakpoints(debugger, &num, info, &total);
+    TEST_ASSERT_EQUAL_UINT(2, num);
+    TEST_ASSERT_EQUAL_UINT(2, total);
+
+    TEST_ASSERT_EQUAL_UINT32(exec, info[0].handle);
+    TEST_ASSERT_EQUAL_UINT8(0, info[0].watch_ops);
+    TEST_ASSERT_EQUAL_HEX16(0x0300, info[0].end_address);
+
+    TEST_ASSERT_EQUAL_UINT32(watch, info[1].handle);
+    TEST_ASSERT_EQUAL_UINT8(DEBUG_WATCH_READ | DEBUG_WATCH_WRITE, info[1].watch_ops);
+    TEST_ASSERT_EQUAL_HEX16(0x0300, info[1].address);
+    TEST_ASSERT_EQUAL_HEX16(0x0301, info[1].end_address);
+}
+
+void test_invalid(void)
+{
+    debug_watch_t watch;
+    debug_breakpoint_t bp;
+
+    watch.addr_start = 0x0020;
+    watch.addr_end = 0x0010;
+    watch.ops = DEBUG_WATCH_WRITE;
+    watch.match_value = false;
+    watch.value = 0;
+    TEST_ASSERT_FALSE(debug_set_watchpoint(debugger, &bp, &watch));
+
+    watch.addr_end = 0x0020;
+    watch.ops = 0;
+    TEST_ASSERT_FALSE(debug_set_watchpoint(debugger, &bp, &watch));
+
+    /* The bus watch is owned by someone else. */
+    watch.ops = DEBUG_WATCH_WRITE;
+    TEST_ASSERT_TRUE(bus_set_watch(emu, other_watch, NULL));
+    TEST_ASSERT_FALSE(debug_set_watchpoint(debugger, &bp, &watch));
+    TEST_ASSERT_TRUE(bus_set_watch(emu, NULL, NULL));
+}
+
+void test_post(void)
+{
+    debug_breakpoint_t hit;
+    uint8_t value = 0x99;
+
+    /* A command posted while stopped waits for the next run. */
+    TEST_ASSERT_TRUE(debug_post(debugger, cmd_poke_break, &value));
+    TEST_ASSERT_EQUAL_UINT(0, cmd_count);
+
+    debug_run(debugger, &hit);
+    TEST_ASSERT_EQUAL_UINT32(BREAKPOINT_HANDLE_SW_REQUEST, hit);
+    TEST_ASSERT_EQUAL_UINT(1, cmd_count);
+    TEST_ASSERT_EQUAL_HEX8(0x99, memory[0x0300]);
+
+    /* Or can be run directly. */
+    value = 0x42;
+    TEST_ASSERT_TRUE(debug_post(debugger, cmd_poke_break, &value));
+    TEST_ASSERT_TRUE(debug_post(debugger, cmd_poke_break, &value));
+    debug_process_commands(debugger);
+    TEST_ASSERT_EQUAL_UINT(3, cmd_count);
+    TEST_ASSERT_EQUAL_HEX8(0x42, memory[0x0300]);
+}
+
+void test_call(void)
+{
+    pthread_t thread;
+    debug_breakpoint_t hit;
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, call_thread, NULL));
+
+    /* The breakpoint is set from the other thread whenever the mailbox is next checked. The
+     * program loops forever, so the run only stops once it has been hit. */
+    debug_run(debugger, &hit);
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, NULL));
+    TEST_ASSERT_EQUAL_UINT(1, cmd_count);
+    TEST_ASSERT_EQUAL_UINT32(cmd_bp, hit);
+    TEST_ASSERT_EQUAL_HEX16(0x0206, emu->cpu.regs.pc);
+}
+
+void test_call_stopped(void)
+{
+    pthread_t thread;
+    int fd;
+
+    fd = debug_get_command_fd(debugger);
+    TEST_ASSERT_TRUE(fd >= 0);
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, call_thread, NULL));
+
+    /* While stopped, the call only returns once the woken thread runs the mailbox. */
+    TEST_ASSERT_EQUAL_INT(0, os_wait_fds(&fd, 1));
+    debug_process_commands(debugger);
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, NULL));
+    TEST_ASSERT_EQUAL_UINT(1, cmd_count);
+    TEST_ASSERT_NOT_EQUAL(BREAKPOINT_HANDLE_SW_REQUEST, cmd_bp);
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    memset(memory, 0, sizeof(memory));
+    memcpy(&memory[0x0200], program, sizeof(program));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+
+    debugger = debug_init(emu);
+    TEST_ASSERT_NOT_NULL(debugger);
+
+    emu_thread = pthread_self();
+    cmd_count = 0;
+}
+
+void tearDown(void)
+{
+    debug_cleanup(debugger);
+    debugger = NULL;
+
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_write);
+    RUN_TEST(test_change);
+    RUN_TEST(test_read);
+    RUN_TEST(test_match_value);
+    RUN_TEST(test_pages);
+    RUN_TEST(test_handles);
+    RUN_TEST(test_invalid);
+    RUN_TEST(test_post);
+    RUN_TEST(test_call);
+    RUN_TEST(test_call_stopped);
+
+    return UNITY_END();
+}
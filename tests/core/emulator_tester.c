@@ -0,0 +1,210 @@
+#include <poll.h>
+#include <string.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "debugger.h"
+#include "emu_priv_types.h"
+
+static cbemu_t emu;
+static int event_fd;
+static bool stop_on_store;
+static uint8_t memory[0x10000];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+
+/* LDA #$55; STA $0300; loop: JMP loop */
+static const uint8_t program[] = { 0xa9, 0x55, 0x8d, 0x00, 0x03, 0x4c, 0x05, 0x02 };
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+
+    /* A store to $0300 can stop the slice, like a device would. */
+    if(stop_on_store && addr == 0x0300)
+        emu_stop(emu);
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static bool readable(void)
+{
+    struct pollfd pfd;
+
+    pfd.fd = event_fd;
+    pfd.events = POLLIN;
+
+    return poll(&pfd, 1, 0) == 1;
+}
+
+void test_slice(void)
+{
+    /* Reset (7) + LDA (2) + STA (4). The write is on the last cycle of the STA, and the slice
+     * ends straight after it. */
+    stop_on_store = true;
+    TEST_ASSERT_FALSE(readable());
+    TEST_ASSERT_EQUAL_UINT64(13, emu_run_slice(emu, 1000));
+    TEST_ASSERT_EQUAL_HEX8(0x55, memory[0x0300]);
+
+    TEST_ASSERT_TRUE(readable());
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_SLICE | EMU_EVENT_BREAK, emu_get_events(emu));
+    TEST_ASSERT_FALSE(readable());
+
+    /* The rest of the program only loops. */
+    TEST_ASSERT_EQUAL_UINT64(1000, emu_run_slice(emu, 1000));
+    TEST_ASSERT_EQUAL_UINT64(1013, emu->cpu.cycles);
+
+    TEST_ASSERT_TRUE(readable());
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_SLICE, emu_get_events(emu));
+    TEST_ASSERT_EQUAL_UINT32(0, emu_get_events(emu));
+}
+
+void test_stop_before_slice(void)
+{
+    /* A stop posted between slices ends the next one before it runs. */
+    emu_stop(emu);
+    TEST_ASSERT_EQUAL_UINT64(0, emu_run_slice(emu, 1000));
+    TEST_ASSERT_EQUAL_UINT64(0, emu->cpu.cycles);
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_SLICE | EMU_EVENT_BREAK, emu_get_events(emu));
+
+    /* The stop is consumed by that slice. */
+    TEST_ASSERT_EQUAL_UINT64(100, emu_run_slice(emu, 100));
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_SLICE, emu_get_events(emu));
+}
+
+void test_debug_slice(void)
+{
+    debug_t debugger;
+    debug_breakpoint_t bp;
+    debug_breakpoint_t hit;
+
+    debugger = debug_init(emu);
+    TEST_ASSERT_NOT_NULL(debugger);
+    TEST_ASSERT_TRUE(debug_set_breakpoint_addr(debugger, &bp, 0x0202));
+
+    /* The slice stops at the breakpoint after the reset and LDA. */
+    TEST_ASSERT_TRUE(debug_run_slice(debugger, 1000, &hit));
+    TEST_ASSERT_EQUAL_UINT32(bp, hit);
+    TEST_ASSERT_EQUAL_UINT64(9, emu->cpu.cycles);
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_SLICE | EMU_EVENT_BREAK, emu_get_events(emu));
+
+    /* Once past the breakpoint, the slice runs in whole instructions to at least its length. */
+    debug_clear_breakpoint(debugger, bp);
+    TEST_ASSERT_FALSE(debug_run_slice(debugger, 100, &hit));
+    TEST_ASSERT_TRUE(emu->cpu.cycles >= 109 && emu->cpu.cycles < 112);
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_SLICE, emu_get_events(emu));
+
+    debug_cleanup(debugger);
+}
+
+void test_debug_slice_stop(void)
+{
+    debug_t debugger;
+    debug_breakpoint_t hit;
+
+    debugger = debug_init(emu);
+    TEST_ASSERT_NOT_NULL(debugger);
+
+    /* Breaks and stops requested between slices end the next one before it runs. */
+    debug_break(debugger);
+    TEST_ASSERT_TRUE(debug_run_slice(debugger, 1000, &hit));
+    TEST_ASSERT_EQUAL_UINT32(BREAKPOINT_HANDLE_SW_REQUEST, hit);
+    TEST_ASSERT_EQUAL_UINT64(0, emu->cpu.cycles);
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_SLICE | EMU_EVENT_BREAK, emu_get_events(emu));
+
+    emu_stop(emu);
+    TEST_ASSERT_TRUE(debug_run_slice(debugger, 1000, &hit));
+    TEST_ASSERT_EQUAL_UINT64(0, emu->cpu.cycles);
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_SLICE | EMU_EVENT_BREAK, emu_get_events(emu));
+
+    /* A stop during the slice ends it too, after the store completes. */
+    stop_on_store = true;
+    TEST_ASSERT_TRUE(debug_run_slice(debugger, 1000, &hit));
+    TEST_ASSERT_EQUAL_HEX8(0x55, memory[0x0300]);
+    TEST_ASSERT_TRUE(emu->cpu.cycles < 20);
+
+    /* Each was consumed. */
+    stop_on_store = false;
+    TEST_ASSERT_FALSE(debug_run_slice(debugger, 100, &hit));
+
+    debug_cleanup(debugger);
+}
+
+void test_debug_run_stop(void)
+{
+    debug_t debugger;
+    debug_breakpoint_t bp;
+    debug_breakpoint_t hit;
+
+    debugger = debug_init(emu);
+    TEST_ASSERT_NOT_NULL(debugger);
+
+    /* A stop during a run breaks it, and is consumed so the next slice still runs. */
+    stop_on_store = true;
+    debug_run(debugger, &hit);
+    TEST_ASSERT_EQUAL_UINT32(BREAKPOINT_HANDLE_SW_REQUEST, hit);
+    TEST_ASSERT_EQUAL_HEX8(0x55, memory[0x0300]);
+
+    stop_on_store = false;
+    TEST_ASSERT_FALSE(debug_run_slice(debugger, 100, &hit));
+
+    /* A stop raised before a run is dropped. */
+    emu_stop(emu);
+    TEST_ASSERT_TRUE(debug_set_breakpoint_addr(debugger, &bp, 0x0205));
+    debug_run(debugger, &hit);
+    TEST_ASSERT_EQUAL_UINT32(bp, hit);
+    debug_clear_breakpoint(debugger, bp);
+    TEST_ASSERT_FALSE(debug_run_slice(debugger, 100, &hit));
+
+    debug_cleanup(debugger);
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    memset(memory, 0, sizeof(memory));
+    memcpy(&memory[0x0200], program, sizeof(program));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+
+    stop_on_store = false;
+    event_fd = emu_get_event_fd(emu);
+    TEST_ASSERT_TRUE(event_fd >= 0);
+}
+
+void tearDown(void)
+{
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_slice);
+    RUN_TEST(test_stop_before_slice);
+    RUN_TEST(test_debug_slice);
+    RUN_TEST(test_debug_slice_stop);
+    RUN_TEST(test_debug_run_stop);
+
+    return UNITY_END();
+}
@@ -0,0 +1,173 @@
+#include <string.h>
+#include <unistd.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "pacer.h"
+#include "os_time.h"
+
+#define NS_PER_MS   1000000ULL
+
+static cbemu_t emu;
+static pacer_t pacer;
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+
+/* Every byte is a NOP, so the CPU just runs. */
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return 0xea;
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static void run(unsigned int cycles)
+{
+    while(cycles-- > 0)
+    {
+        emu_tick(emu);
+    }
+}
+
+void test_realtime(void)
+{
+    pacer_stats_t stats;
+    uint64_t start;
+
+    /* 50ms of emulated time takes at least as long to run. */
+    start = os_time_ns();
+    pacer_resync(pacer);
+    run(50000);
+
+    TEST_ASSERT_TRUE(os_time_ns() - start >= 49 * NS_PER_MS);
+
+    pacer_get_stats(pacer, &stats);
+    TEST_ASSERT_EQUAL_UINT64(50, stats.slices);
+    TEST_ASSERT_TRUE(stats.slept_ns > 0);
+}
+
+void test_turbo(void)
+{
+    pacer_stats_t stats;
+    uint64_t start;
+
+    pacer_set_turbo(pacer, 5);
+
+    start = os_time_ns();
+    run(50000);
+
+    TEST_ASSERT_TRUE(os_time_ns() - start >= 9 * NS_PER_MS);
+
+    pacer_get_stats(pacer, &stats);
+    TEST_ASSERT_EQUAL_UINT64(50, stats.slices);
+
+    /* Without pacing, slices aren't even counted. */
+    pacer_set_turbo(pacer, 0);
+    run(50000);
+
+    pacer_get_stats(pacer, &stats);
+    TEST_ASSERT_EQUAL_UINT64(50, stats.slices);
+}
+
+void test_catchup(void)
+{
+    pacer_stats_t stats;
+
+    pacer_set_catchup(pacer, 5000);
+    pacer_resync(pacer);
+    run(1000);
+
+    /* Stall the host, so the emulator falls 30ms behind. Only 5ms of that is made up. */
+    os_sleep_until_ns(os_time_ns() + 30 * NS_PER_MS);
+    run(1000);
+
+    pacer_get_stats(pacer, &stats);
+    TEST_ASSERT_EQUAL_UINT64(2, stats.slices);
+    TEST_ASSERT_TRUE(stats.late_slices >= 1);
+
+    /* Host delays only add to what is dropped, so there is no upper bound. */
+    TEST_ASSERT_TRUE(stats.dropped_ns >= 20 * NS_PER_MS);
+}
+
+void test_wait_fd(void)
+{
+    pacer_stats_t stats;
+    uint64_t start;
+    int fds[2];
+
+    TEST_ASSERT_EQUAL_INT(0, pipe(fds));
+    pacer_set_wait_fd(pacer, fds[0]);
+
+    /* Nothing to read, so every sleep runs to its deadline. */
+    pacer_resync(pacer);
+    run(10000);
+
+    pacer_get_stats(pacer, &stats);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.woken_slices);
+
+    /* Input left unread wakes at most every other sleep, so the emulator never runs more than a slice
+     * ahead of wall-clock time. */
+    TEST_ASSERT_EQUAL_INT(1, write(fds[1], "x", 1));
+
+    start = os_time_ns();
+    pacer_resync(pacer);
+    run(20000);
+
+    TEST_ASSERT_TRUE(os_time_ns() - start >= 18 * NS_PER_MS);
+
+    pacer_get_stats(pacer, &stats);
+    TEST_ASSERT_EQUAL_UINT64(30, stats.slices);
+    TEST_ASSERT_TRUE(stats.woken_slices > 0);
+
+    /* Slices that end late don't sleep at all, so on a loaded host fewer may be woken. */
+    TEST_ASSERT_TRUE(stats.woken_slices <= 10);
+
+    pacer_set_wait_fd(pacer, -1);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+
+    pacer = pacer_init(emu, 1000);
+    TEST_ASSERT_NOT_NULL(pacer);
+}
+
+void tearDown(void)
+{
+    pacer_cleanup(pacer);
+    pacer = NULL;
+
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_realtime);
+    RUN_TEST(test_turbo);
+    RUN_TEST(test_catchup);
+    RUN_TEST(test_wait_fd);
+
+    return UNITY_END();
+}
@@ -0,0 +1,322 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "profiler.h"
+#include "cpu_priv.h"
+
+static cbemu_t emu;
+static profiler_t profiler;
+static uint8_t memory[0x10000];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static void load(uint16_t addr, const uint8_t *data, size_t len)
+{
+    memcpy(&memory[addr], data, len);
+}
+
+static void run(unsigned int cycles)
+{
+    while(cycles-- > 0)
+    {
+        emu_tick(emu);
+    }
+}
+
+static const profiler_func_info_t *find_func(const profiler_func_info_t *funcs, unsigned int num_funcs, uint16_t addr)
+{
+    unsigned int index;
+
+    for(index = 0; index < num_funcs; ++index)
+    {
+        if(funcs[index].address == addr)
+        {
+            return &funcs[index];
+        }
+    }
+
+    return NULL;
+}
+
+void test_nested_calls(void)
+{
+    /* main: JSR outer; JMP * */
+    static const uint8_t main_code[] = { 0x20, 0x00, 0x03, 0x4c, 0x03, 0x02 };
+    /* outer: JSR inner; RTS */
+    static const uint8_t outer_code[] = { 0x20, 0x00, 0x04, 0x60 };
+    /* inner: NOP; NOP; RTS */
+    static const uint8_t inner_code[] = { 0xea, 0xea, 0x60 };
+    profiler_func_info_t funcs[4];
+    unsigned int num_funcs = 4;
+    unsigned int total_funcs;
+    const profiler_func_info_t *func;
+
+    load(0x0200, main_code, sizeof(main_code));
+    load(0x0300, outer_code, sizeof(outer_code));
+    load(0x0400, inner_code, sizeof(inner_code));
+
+    /* Reset (7) + JSR (6) + JSR (6) + NOP (2) + NOP (2) + RTS (6) + RTS (6) + 10 JMPs (30). */
+    run(65);
+
+    TEST_ASSERT_EQUAL_UINT32(1, emu->cpu.callstack.depth);
+    TEST_ASSERT_EQUAL_UINT64(65, profiler_get_total_cycles(profiler));
+
+    profiler_get_functions(profiler, &num_funcs, funcs, &total_funcs);
+    TEST_ASSERT_EQUAL_UINT(3, total_funcs);
+    TEST_ASSERT_EQUAL_UINT(3, num_funcs);
+
+    /* Sorted by exclusive cycles. */
+    TEST_ASSERT_EQUAL_UINT16(0x0200, funcs[0].address);
+
+    func = find_func(funcs, num_funcs, 0x0200);
+    TEST_ASSERT_NOT_NULL(func);
+    TEST_ASSERT_EQUAL_UINT64(1, func->calls);
+    TEST_ASSERT_EQUAL_UINT64(36, func->exclusive);
+    TEST_ASSERT_EQUAL_UINT64(58, func->inclusive);
+    TEST_ASSERT_FALSE(func->interrupt);
+
+    func = find_func(funcs, num_funcs, 0x0300);
+    TEST_ASSERT_NOT_NULL(func);
+    TEST_ASSERT_EQUAL_UINT64(1, func->calls);
+    TEST_ASSERT_EQUAL_UINT64(12, func->exclusive);
+    TEST_ASSERT_EQUAL_UINT64(22, func->inclusive);
+    TEST_ASSERT_FALSE(func->interrupt);
+
+    func = find_func(funcs, num_funcs, 0x0400);
+    TEST_ASSERT_NOT_NULL(func);
+    TEST_ASSERT_EQUAL_UINT64(1, func->calls);
+    TEST_ASSERT_EQUAL_UINT64(10, func->exclusive);
+    TEST_ASSERT_EQUAL_UINT64(10, func->inclusive);
+}
+
+static void read_output(FILE *out, char *buffer, size_t size)
+{
+    size_t len;
+
+    rewind(out);
+    len = fread(buffer, 1, size - 1, out);
+    buffer[len] = '\0';
+}
+
+void test_stack_export(void)
+{
+    /* main: JSR outer; JSR inner; JMP * */
+    static const uint8_t main_code[] = { 0x20, 0x00, 0x03, 0x20, 0x00, 0x04, 0x4c, 0x06, 0x02 };
+    /* outer: JSR inner; RTS */
+    static const uint8_t outer_code[] = { 0x20, 0x00, 0x04, 0x60 };
+    /* inner: NOP; NOP; RTS */
+    static const uint8_t inner_code[] = { 0xea, 0xea, 0x60 };
+    char buffer[512];
+    FILE *out;
+
+    load(0x0200, main_code, sizeof(main_code));
+    load(0x0300, outer_code, sizeof(outer_code));
+    load(0x0400, inner_code, sizeof(inner_code));
+
+    /* Reset (7) + JSR outer (6) + outer (22) + JSR inner (6) + inner (10) + 3 JMPs (9). */
+    run(60);
+
+    out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+
+    /* inner is called from two different stacks, and is reported separately for each. */
+    TEST_ASSERT_TRUE(profiler_write(profiler, out, PROFILER_FORMAT_FOLDED));
+    read_output(out, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("$0200 21\n$0200;$0400 10\n$0200;$0300 12\n$0200;$0300;$0400 10\n", buffer);
+
+    fclose(out);
+    out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+
+    TEST_ASSERT_TRUE(profiler_write(profiler, out, PROFILER_FORMAT_SPEEDSCOPE));
+    read_output(out, buffer, sizeof(buffer));
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"frames\":[{\"name\":\"$0200\"},{\"name\":\"$0300\"},{\"name\":\"$0400\"}]"));
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"endValue\":60,"));
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"samples\":[[0],[0,2],[0,1],[0,1,2]],\"weights\":[21,10,12,10]"));
+
+    fclose(out);
+}
+
+void test_recursion(void)
+{
+    /* main: LDX #3; JSR recurse; JMP * */
+    static const uint8_t main_code[] = { 0xa2, 0x03, 0x20, 0x00, 0x03, 0x4c, 0x05, 0x02 };
+    /* recurse: DEX; BEQ done; JSR recurse; done: RTS */
+    static const uint8_t recurse_code[] = { 0xca, 0xf0, 0x03, 0x20, 0x00, 0x03, 0x60 };
+    profiler_func_info_t funcs[4];
+    unsigned int num_funcs = 4;
+    const profiler_func_info_t *func;
+    uint64_t start;
+
+    load(0x0200, main_code, sizeof(main_code));
+    load(0x0300, recurse_code, sizeof(recurse_code));
+
+    run(200);
+
+    profiler_get_functions(profiler, &num_funcs, funcs, NULL);
+    TEST_ASSERT_EQUAL_UINT(2, num_funcs);
+
+    func = find_func(funcs, num_funcs, 0x0300);
+    TEST_ASSERT_NOT_NULL(func);
+    TEST_ASSERT_EQUAL_UINT64(3, func->calls);
+
+    /* Inclusive time is only counted once for the recursive calls, so it matches the
+     * exclusive time as the function makes no other calls. */
+    TEST_ASSERT_EQUAL_UINT64(func->exclusive, func->inclusive);
+
+    /* Reset discards all data and restarts from the current cycle. */
+    start = emu->cpu.cycles;
+    profiler_reset(profiler);
+    run(9);
+
+    num_funcs = 4;
+    profiler_get_functions(profiler, &num_funcs, funcs, NULL);
+    TEST_ASSERT_EQUAL_UINT(1, num_funcs);
+    TEST_ASSERT_EQUAL_UINT16(0x0200, funcs[0].address);
+    TEST_ASSERT_EQUAL_UINT64(0, funcs[0].calls);
+    TEST_ASSERT_EQUAL_UINT64(emu->cpu.cycles - start, funcs[0].exclusive);
+}
+
+void test_deep_stack(void)
+{
+    /* main: LDX #140; JSR recurse; JMP * */
+    static const uint8_t main_code[] = { 0xa2, 0x8c, 0x20, 0x00, 0x03, 0x4c, 0x05, 0x02 };
+    /* recurse: DEX; BEQ done; JSR recurse; done: JMP done */
+    static const uint8_t recurse_code[] = { 0xca, 0xf0, 0x03, 0x20, 0x00, 0x03, 0x4c, 0x06, 0x03 };
+    profiler_func_info_t funcs[4];
+    unsigned int num_funcs = 4;
+    static char buffer[0x20000];
+    uint64_t total = 0;
+    unsigned int lines = 0;
+    char *line;
+    FILE *out;
+
+    load(0x0200, main_code, sizeof(main_code));
+    load(0x0300, recurse_code, sizeof(recurse_code));
+
+    /* The recursion ends 140 calls deep, well past the depth the output can hold. */
+    run(2000);
+
+    profiler_get_functions(profiler, &num_funcs, funcs, NULL);
+    TEST_ASSERT_EQUAL_UINT(2, num_funcs);
+
+    out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_TRUE(profiler_write(profiler, out, PROFILER_FORMAT_FOLDED));
+    read_output(out, buffer, sizeof(buffer));
+    fclose(out);
+
+    for(line = strtok(buffer, "\n"); line != NULL; line = strtok(NULL, "\n"))
+    {
+        total += strtoull(strrchr(line, ' ') + 1, NULL, 10);
+        ++lines;
+    }
+
+    /* Cycles from the calls that were cut off are charged to the deepest stack written. */
+    TEST_ASSERT_EQUAL_UINT(CPU_CALLSTACK_DEPTH, lines);
+    TEST_ASSERT_EQUAL_UINT64(funcs[0].exclusive + funcs[1].exclusive, total);
+}
+
+void test_interrupt(void)
+{
+    /* main: CLI; JMP * */
+    static const uint8_t main_code[] = { 0x58, 0x4c, 0x01, 0x02 };
+    /* irq: RTI */
+    static const uint8_t irq_code[] = { 0x40 };
+    bus_signal_voter_t voter;
+    profiler_func_info_t funcs[4];
+    unsigned int num_funcs = 4;
+    const profiler_func_info_t *func;
+
+    load(0x0200, main_code, sizeof(main_code));
+    load(0x0500, irq_code, sizeof(irq_code));
+    memory[0xfffe] = 0x00;
+    memory[0xffff] = 0x05;
+
+    voter = emu_bus_register_sig_voter(emu);
+    TEST_ASSERT_NOT_EQUAL(BUS_SIGNAL_INVALID_VOTER, voter);
+
+    /* Reset + CLI + one JMP, then raise IRQ. */
+    run(12);
+    emu_bus_sig_vote(emu, voter, BUS_SIG_IRQ, true);
+
+    /* The interrupt sequence enters the handler. */
+    run(7);
+    TEST_ASSERT_EQUAL_UINT32(2, emu->cpu.callstack.depth);
+    TEST_ASSERT_EQUAL_INT(CPU_CALL_IRQ, emu->cpu.callstack.frames[1].type);
+    TEST_ASSERT_EQUAL_UINT16(0x0500, emu->cpu.callstack.frames[1].target);
+
+    emu_bus_sig_vote(emu, voter, BUS_SIG_IRQ, false);
+
+    /* RTI pops the interrupt frame. */
+    run(6);
+    TEST_ASSERT_EQUAL_UINT32(1, emu->cpu.callstack.depth);
+
+    profiler_get_functions(profiler, &num_funcs, funcs, NULL);
+
+    func = find_func(funcs, num_funcs, 0x0500);
+    TEST_ASSERT_NOT_NULL(func);
+    TEST_ASSERT_EQUAL_UINT64(1, func->calls);
+    TEST_ASSERT_EQUAL_UINT64(6, func->exclusive);
+    TEST_ASSERT_TRUE(func->interrupt);
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    memset(memory, 0, sizeof(memory));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+
+    profiler = profiler_init(emu);
+    TEST_ASSERT_NOT_NULL(profiler);
+}
+
+void tearDown(void)
+{
+    profiler_cleanup(profiler);
+    profiler = NULL;
+
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_nested_calls);
+    RUN_TEST(test_stack_export);
+    RUN_TEST(test_recursion);
+    RUN_TEST(test_deep_stack);
+    RUN_TEST(test_interrupt);
+
+    return UNITY_END();
+}
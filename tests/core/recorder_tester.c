@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <string.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "recorder.h"
+#include "tracefile.h"
+
+#define TRACE_FILE "recorder_tester.trace"
+
+static cbemu_t emu;
+static uint8_t memory[0x10000];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static void run(unsigned int cycles)
+{
+    while(cycles-- > 0)
+    {
+        emu_tick(emu);
+    }
+}
+
+/* Opens the trace file and checks its header. */
+static FILE *open_trace(void)
+{
+    recorder_file_header_t header;
+    FILE *trace;
+
+    trace = fopen(TRACE_FILE, "rb");
+    TEST_ASSERT_NOT_NULL(trace);
+    TEST_ASSERT_EQUAL_UINT(1, fread(&header, sizeof(header), 1, trace));
+    TEST_ASSERT_EQUAL_MEMORY(RECORDER_MAGIC, header.magic, sizeof(header.magic));
+    TEST_ASSERT_EQUAL_UINT16(RECORDER_VERSION, header.version);
+    TEST_ASSERT_EQUAL_UINT16(sizeof(recorder_record_t), header.record_size);
+
+    return trace;
+}
+
+/* Checks that the index follows the last record, and closes the trace file. */
+static void close_trace(FILE *trace, uint64_t count)
+{
+    tracefile_footer_t footer;
+    long offset;
+
+    offset = ftell(trace);
+    TEST_ASSERT_EQUAL_INT(0, fseek(trace, -(long)sizeof(footer), SEEK_END));
+    TEST_ASSERT_EQUAL_UINT(1, fread(&footer, sizeof(footer), 1, trace));
+    TEST_ASSERT_EQUAL_MEMORY(TRACEFILE_INDEX_MAGIC, footer.magic, sizeof(footer.magic));
+    TEST_ASSERT_EQUAL_UINT64(count, footer.num_records);
+    TEST_ASSERT_EQUAL_UINT64(offset, footer.index_offset);
+    TEST_ASSERT_EQUAL_UINT64((count + TRACEFILE_BLOCK_RECORDS - 1) / TRACEFILE_BLOCK_RECORDS, footer.num_blocks);
+    TEST_ASSERT_EQUAL_UINT64(offset + footer.num_blocks * sizeof(tracefile_block_t) + sizeof(footer), ftell(trace));
+
+    fclose(trace);
+    remove(TRACE_FILE);
+}
+
+void test_record_all(void)
+{
+    /* LDX #0; loop: STX $10; INX; JMP loop */
+    static const uint8_t code[] = { 0xa2, 0x00, 0x86, 0x10, 0xe8, 0x4c, 0x02, 0x02 };
+    recorder_record_t record;
+    recorder_t recorder;
+    FILE *trace;
+    unsigned int index;
+
+    memcpy(&memory[0x0200], code, sizeof(code));
+
+    recorder = recorder_init(emu, TRACE_FILE, NULL);
+    TEST_ASSERT_NOT_NULL(recorder);
+
+    /* Reset (7) + LDX (2) + STX (3). */
+    run(12);
+    TEST_ASSERT_EQUAL_UINT64(12, recorder_get_count(recorder));
+    TEST_ASSERT_TRUE(recorder_cleanup(recorder));
+
+    trace = open_trace();
+
+    for(index = 0; index < 12; ++index)
+    {
+        TEST_ASSERT_EQUAL_UINT(1, fread(&record, sizeof(record), 1, trace));
+        TEST_ASSERT_EQUAL_UINT64(index + 1, record.cycle);
+    }
+
+    /* The last record is the write made by STX. */
+    TEST_ASSERT_EQUAL_UINT16(0x0202, record.pc);
+    TEST_ASSERT_EQUAL_UINT16(0x0010, record.addr);
+    TEST_ASSERT_EQUAL_UINT8(0x00, record.value);
+    TEST_ASSERT_EQUAL_UINT8(RECORD_WRITE, record.flags);
+
+    close_trace(trace, 12);
+}
+
+void test_record_filtered(void)
+{
+    /* LDX #0; loop: STX $10; INX; JMP loop */
+    static const uint8_t code[] = { 0xa2, 0x00, 0x86, 0x10, 0xe8, 0x4c, 0x02, 0x02 };
+    bus_trace_filter_t filter;
+    recorder_record_t record;
+    recorder_t recorder;
+    FILE *trace;
+    unsigned int index;
+    uint64_t count;
+
+    memcpy(&memory[0x0200], code, sizeof(code));
+
+    filter.decode.type = BUSDECODE_RANGE;
+    filter.decode.value.range.addr_start = 0x0000;
+    filter.decode.value.range.addr_end = 0x00ff;
+    filter.ops = BUS_TRACE_WRITE;
+    filter.divisor = 0;
+
+    recorder = recorder_init(emu, TRACE_FILE, &filter);
+    TEST_ASSERT_NOT_NULL(recorder);
+
+    /* Record enough writes to wrap the ring several times. Each loop takes 8 cycles. */
+    run(9 + 8 * 300000);
+    count = recorder_get_count(recorder);
+    TEST_ASSERT_EQUAL_UINT64(300000, count);
+    TEST_ASSERT_TRUE(recorder_cleanup(recorder));
+
+    trace = open_trace();
+
+    for(index = 0; index < count; ++index)
+    {
+        TEST_ASSERT_EQUAL_UINT(1, fread(&record, sizeof(record), 1, trace));
+        TEST_ASSERT_EQUAL_UINT64(12 + 8 * (uint64_t)index, record.cycle);
+        TEST_ASSERT_EQUAL_UINT16(0x0010, record.addr);
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)index, record.value);
+    }
+
+    close_trace(trace, count);
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    memset(memory, 0, sizeof(memory));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+}
+
+void tearDown(void)
+{
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_record_all);
+    RUN_TEST(test_record_filtered);
+
+    return UNITY_END();
+}
@@ -0,0 +1,178 @@
+#include <string.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "sanitizer.h"
+
+static cbemu_t emu;
+static sanitizer_t sanitizer;
+static uint8_t memory[0x10000];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+static sanitizer_report_t last_report;
+static unsigned int num_reports;
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static void report_cb(const sanitizer_report_t *report, void *userdata)
+{
+    last_report = *report;
+    ++num_reports;
+}
+
+static void load(uint16_t addr, const uint8_t *data, size_t len)
+{
+    memcpy(&memory[addr], data, len);
+}
+
+static void run(unsigned int cycles)
+{
+    while(cycles-- > 0)
+    {
+        emu_tick(emu);
+    }
+}
+
+void test_reset(void)
+{
+    static const uint8_t code[] = { 0x4c, 0x00, 0x02 };
+
+    load(0x0200, code, sizeof(code));
+
+    /* The reset sequence wraps the stack pointer, which must not be reported. */
+    run(20);
+    TEST_ASSERT_EQUAL_UINT(0, num_reports);
+}
+
+void test_uninit_read(void)
+{
+    /* LDA $10; STA $11; LDA $11; JSR sub; JMP * */
+    static const uint8_t code[] = { 0xa5, 0x10, 0x85, 0x11, 0xa5, 0x11, 0x20, 0x00, 0x03, 0x4c, 0x09, 0x02 };
+    /* sub: RTS */
+    static const uint8_t sub[] = { 0x60 };
+
+    load(0x0200, code, sizeof(code));
+    load(0x0300, sub, sizeof(sub));
+
+    /* Reset (7) + LDA (3). */
+    run(10);
+    TEST_ASSERT_EQUAL_UINT(1, num_reports);
+    TEST_ASSERT_EQUAL_INT(SANITIZER_UNINIT_READ, last_report.error);
+    TEST_ASSERT_EQUAL_UINT16(0x0200, last_report.pc);
+    TEST_ASSERT_EQUAL_UINT16(0x0010, last_report.addr);
+    TEST_ASSERT_NULL(last_report.symbol);
+
+    /* Reading back a written value is fine, as are the dummy stack reads made by JSR/RTS. */
+    run(30);
+    TEST_ASSERT_EQUAL_UINT(1, num_reports);
+    TEST_ASSERT_EQUAL_UINT(1, sanitizer_get_count(sanitizer, SANITIZER_UNINIT_READ));
+}
+
+void test_stack_overflow(void)
+{
+    /* LDX #0; TXS; PHA; JMP * */
+    static const uint8_t code[] = { 0xa2, 0x00, 0x9a, 0x48, 0x4c, 0x04, 0x02 };
+
+    load(0x0200, code, sizeof(code));
+
+    run(20);
+    TEST_ASSERT_EQUAL_UINT(1, num_reports);
+    TEST_ASSERT_EQUAL_INT(SANITIZER_STACK_OVERFLOW, last_report.error);
+    TEST_ASSERT_EQUAL_UINT16(0x0203, last_report.pc);
+    TEST_ASSERT_EQUAL_UINT16(0x0100, last_report.addr);
+}
+
+void test_stack_underflow(void)
+{
+    /* LDX #$FF; TXS; PLA; JMP * */
+    static const uint8_t code[] = { 0xa2, 0xff, 0x9a, 0x68, 0x4c, 0x04, 0x02 };
+
+    load(0x0200, code, sizeof(code));
+
+    run(20);
+    TEST_ASSERT_EQUAL_UINT(1, num_reports);
+    TEST_ASSERT_EQUAL_INT(SANITIZER_STACK_UNDERFLOW, last_report.error);
+    TEST_ASSERT_EQUAL_UINT16(0x0203, last_report.pc);
+}
+
+void test_rom_write(void)
+{
+    /* STA $0300; STA $0300; JMP * */
+    static const uint8_t code[] = { 0x8d, 0x00, 0x03, 0x8d, 0x00, 0x03, 0x4c, 0x06, 0x02 };
+    char buffer[128];
+
+    load(0x0200, code, sizeof(code));
+
+    run(20);
+    TEST_ASSERT_EQUAL_UINT(1, num_reports);
+    TEST_ASSERT_EQUAL_INT(SANITIZER_ROM_WRITE, last_report.error);
+    TEST_ASSERT_EQUAL_UINT16(0x0200, last_report.pc);
+    TEST_ASSERT_EQUAL_UINT16(0x0300, last_report.addr);
+
+    sanitizer_format_report(&last_report, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("Sanitizer: ROM write of $0300 at PC $0200, cycle 11", buffer);
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    memset(memory, 0, sizeof(memory));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+    num_reports = 0;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+
+    sanitizer = sanitizer_init(emu);
+    TEST_ASSERT_NOT_NULL(sanitizer);
+
+    /* Only one sanitizer can be attached at a time. */
+    TEST_ASSERT_NULL(sanitizer_init(emu));
+
+    sanitizer_set_callback(sanitizer, report_cb, NULL);
+    TEST_ASSERT_TRUE(sanitizer_add_region(sanitizer, 0x0000, 0x01ff, SANITIZER_REGION_RAM));
+    TEST_ASSERT_TRUE(sanitizer_add_region(sanitizer, 0x0200, 0xffff, SANITIZER_REGION_ROM));
+}
+
+void tearDown(void)
+{
+    sanitizer_cleanup(sanitizer);
+    sanitizer = NULL;
+
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_reset);
+    RUN_TEST(test_uninit_read);
+    RUN_TEST(test_stack_overflow);
+    RUN_TEST(test_stack_underflow);
+    RUN_TEST(test_rom_write);
+
+    return UNITY_END();
+}
@@ -0,0 +1,303 @@
+#include <string.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "clock.h"
+#include "emulator.h"
+#include "snapshot.h"
+#include "emu_priv_types.h"
+
+static cbemu_t emu;
+static snapshot_t snap;
+static uint8_t memory[0x10000];
+static uint8_t dirty[SNAPSHOT_DIRTY_SIZE(0x10000)];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+
+/* loop: INC $0300; INX; JMP loop */
+static const uint8_t program[] = { 0xee, 0x00, 0x03, 0xe8, 0x4c, 0x00, 0x02 };
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+    SNAPSHOT_MARK_DIRTY(dirty, addr);
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static bool save_mem(snapshot_t snap, void *userdata)
+{
+    return snapshot_write_pages(snap, memory, sizeof(memory), dirty);
+}
+
+static bool restore_mem(snapshot_t snap, void *userdata)
+{
+    return snapshot_read_pages(snap, memory, sizeof(memory), dirty);
+}
+
+static void run(uint64_t cycles)
+{
+    while(cycles-- > 0)
+        emu_tick(emu);
+}
+
+void test_restore(void)
+{
+    cpu_regs_t regs;
+    uint64_t cycles;
+    uint8_t counter;
+
+    run(1001);
+    TEST_ASSERT_TRUE(snapshot_save(emu, snap));
+
+    regs = emu->cpu.regs;
+    cycles = emu->cpu.cycles;
+    counter = memory[0x0300];
+
+    /* Run on, go back, and run on again. The second run must repeat the first exactly. */
+    run(500);
+    TEST_ASSERT_NOT_EQUAL(counter, memory[0x0300]);
+
+    TEST_ASSERT_TRUE(snapshot_restore(emu, snap));
+    TEST_ASSERT_EQUAL_MEMORY(&regs, &emu->cpu.regs, sizeof(regs));
+    TEST_ASSERT_EQUAL_UINT64(cycles, emu->cpu.cycles);
+    TEST_ASSERT_EQUAL_HEX8(counter, memory[0x0300]);
+
+    run(500);
+    regs = emu->cpu.regs;
+    counter = memory[0x0300];
+
+    TEST_ASSERT_TRUE(snapshot_restore(emu, snap));
+    run(500);
+    TEST_ASSERT_EQUAL_MEMORY(&regs, &emu->cpu.regs, sizeof(regs));
+    TEST_ASSERT_EQUAL_UINT64(cycles + 500, emu->cpu.cycles);
+    TEST_ASSERT_EQUAL_HEX8(counter, memory[0x0300]);
+}
+
+void test_copy(void)
+{
+    snapshot_t copy;
+    const uint8_t *data;
+    size_t size;
+    uint64_t cycles;
+
+    run(100);
+    TEST_ASSERT_TRUE(snapshot_save(emu, snap));
+    cycles = emu->cpu.cycles;
+
+    /* Snapshots can be copied out, such as to a file, and back in. */
+    data = snapshot_get_data(snap, &size);
+    TEST_ASSERT_NOT_NULL(data);
+
+    copy = snapshot_init();
+    TEST_ASSERT_NOT_NULL(copy);
+    TEST_ASSERT_TRUE(snapshot_set_data(copy, data, size));
+
+    run(100);
+    TEST_ASSERT_TRUE(snapshot_restore(emu, copy));
+    TEST_ASSERT_EQUAL_UINT64(cycles, emu->cpu.cycles);
+
+    snapshot_cleanup(copy);
+}
+
+void test_mismatch(void)
+{
+    snapshot_hook_t extra;
+    cpu_regs_t regs;
+    uint64_t cycles;
+    uint8_t *data;
+    size_t size;
+
+    run(100);
+    TEST_ASSERT_TRUE(snapshot_save(emu, snap));
+
+    run(100);
+    regs = emu->cpu.regs;
+    cycles = emu->cpu.cycles;
+
+    /* A snapshot without a section for every hook is rejected, leaving the state alone. */
+    extra = snapshot_register(emu, "extra", save_mem, restore_mem, NULL);
+    TEST_ASSERT_NOT_NULL(extra);
+    TEST_ASSERT_FALSE(snapshot_restore(emu, snap));
+    TEST_ASSERT_EQUAL_UINT64(cycles, emu->cpu.cycles);
+    TEST_ASSERT_EQUAL_MEMORY(&regs, &emu->cpu.regs, sizeof(regs));
+
+    snapshot_unregister(extra);
+    TEST_ASSERT_TRUE(snapshot_restore(emu, snap));
+
+    /* As is a truncated one. */
+    data = (uint8_t *)snapshot_get_data(snap, &size);
+    TEST_ASSERT_TRUE(snapshot_set_data(snap, data, size - 1));
+    TEST_ASSERT_FALSE(snapshot_restore(emu, snap));
+
+    TEST_ASSERT_FALSE(snapshot_register(emu, "a name that is too long", save_mem, restore_mem, NULL) != NULL);
+}
+
+void test_clock_added(void)
+{
+    clock_config_t config;
+    cpu_regs_t regs;
+    uint64_t cycles;
+
+    run(100);
+    TEST_ASSERT_TRUE(snapshot_save(emu, snap));
+
+    /* A snapshot taken with a different set of clocks is rejected before anything is restored, even
+     * when the new clock leaves the timebase as it was. */
+    config.timing_type = CLOCK_FREQ;
+    config.timing.freq = 500000;
+    TEST_ASSERT_NOT_NULL(clock_add(emu, &config));
+
+    run(100);
+    regs = emu->cpu.regs;
+    cycles = emu->clk.mainClk->cycles;
+
+    TEST_ASSERT_FALSE(snapshot_restore(emu, snap));
+    TEST_ASSERT_EQUAL_UINT64(cycles, emu->clk.mainClk->cycles);
+    TEST_ASSERT_EQUAL_MEMORY(&regs, &emu->cpu.regs, sizeof(regs));
+}
+
+static void irq_watcher(bus_signal_t signal, bool asserted, void *userdata)
+{
+    if(signal == BUS_SIG_IRQ)
+    {
+        *(int *)userdata = asserted ? 1 : 0;
+    }
+}
+
+void test_signal_watchers(void)
+{
+    bus_signal_voter_t voter;
+    bus_cb_handle_t watcher;
+    int irq = -1;
+
+    voter = emu_bus_register_sig_voter(emu);
+    TEST_ASSERT_NOT_EQUAL(BUS_SIGNAL_INVALID_VOTER, voter);
+    TEST_ASSERT_TRUE(snapshot_save(emu, snap));
+
+    watcher = emu_bus_add_sig_watcher(emu, irq_watcher, &irq);
+    TEST_ASSERT_NOT_NULL(watcher);
+
+    emu_bus_sig_vote(emu, voter, BUS_SIG_IRQ, true);
+    TEST_ASSERT_EQUAL_INT(1, irq);
+
+    /* Watchers hear about signals the restore changes, and only those. */
+    TEST_ASSERT_TRUE(snapshot_restore(emu, snap));
+    TEST_ASSERT_FALSE(emu_bus_sig_asserted(emu, BUS_SIG_IRQ));
+    TEST_ASSERT_EQUAL_INT(0, irq);
+
+    irq = -1;
+    TEST_ASSERT_TRUE(snapshot_restore(emu, snap));
+    TEST_ASSERT_EQUAL_INT(-1, irq);
+
+    emu_bus_remove_sig_watcher(emu, watcher);
+}
+
+void test_delta_chain(void)
+{
+    snapshot_t first;
+    snapshot_t second;
+    cpu_regs_t regs;
+    uint64_t cycles;
+    uint8_t counter;
+    size_t full_size;
+    size_t delta_size;
+
+    first = snapshot_init();
+    second = snapshot_init();
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NOT_NULL(second);
+
+    run(100);
+    TEST_ASSERT_TRUE(snapshot_save(emu, snap));
+
+    /* The program only writes to the counter and the stack on reset. */
+    run(100);
+    TEST_ASSERT_TRUE(snapshot_save_delta(emu, first, snap));
+    snapshot_get_data(snap, &full_size);
+    snapshot_get_data(first, &delta_size);
+    TEST_ASSERT_TRUE(delta_size < full_size / 64);
+
+    /* Each delta follows the last snapshot only. */
+    run(100);
+    TEST_ASSERT_FALSE(snapshot_save_delta(emu, second, snap));
+    TEST_ASSERT_TRUE(snapshot_save_delta(emu, second, first));
+
+    regs = emu->cpu.regs;
+    cycles = emu->cpu.cycles;
+    counter = memory[0x0300];
+
+    run(100);
+
+    /* Deltas collapse in order, onto a delta or a full snapshot. */
+    TEST_ASSERT_FALSE(snapshot_collapse(snap, second));
+    TEST_ASSERT_TRUE(snapshot_collapse(first, second));
+    TEST_ASSERT_TRUE(snapshot_is_delta(first));
+    TEST_ASSERT_FALSE(snapshot_restore(emu, first));
+    TEST_ASSERT_TRUE(snapshot_collapse(snap, first));
+    TEST_ASSERT_FALSE(snapshot_is_delta(snap));
+
+    TEST_ASSERT_TRUE(snapshot_restore(emu, snap));
+    TEST_ASSERT_EQUAL_MEMORY(&regs, &emu->cpu.regs, sizeof(regs));
+    TEST_ASSERT_EQUAL_UINT64(cycles, emu->cpu.cycles);
+    TEST_ASSERT_EQUAL_HEX8(counter, memory[0x0300]);
+
+    /* Deltas can follow a restored snapshot. */
+    run(100);
+    TEST_ASSERT_TRUE(snapshot_save_delta(emu, first, snap));
+
+    snapshot_cleanup(second);
+    snapshot_cleanup(first);
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    memset(memory, 0, sizeof(memory));
+    memset(dirty, 0, sizeof(dirty));
+    memcpy(&memory[0x0200], program, sizeof(program));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+    TEST_ASSERT_NOT_NULL(snapshot_register(emu, "memory", save_mem, restore_mem, NULL));
+
+    snap = snapshot_init();
+    TEST_ASSERT_NOT_NULL(snap);
+}
+
+void tearDown(void)
+{
+    snapshot_cleanup(snap);
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_restore);
+    RUN_TEST(test_copy);
+    RUN_TEST(test_mismatch);
+    RUN_TEST(test_clock_added);
+    RUN_TEST(test_signal_watchers);
+    RUN_TEST(test_delta_chain);
+
+    return UNITY_END();
+}
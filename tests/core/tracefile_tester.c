@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "recorder.h"
+#include "tracefile.h"
+
+#define TRACE_FILE      "tracefile_tester.trace"
+#define UNINDEXED_FILE  "tracefile_tester_unindexed.trace"
+#define RUN_CYCLES      200000
+#define MAX_HISTORY     64
+
+static cbemu_t emu;
+static tracefile_t trace;
+static uint8_t memory[0x10000];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+
+/* Writes $10 on every pass of the inner loop, and $11 and $0300 after every 256 passes. */
+static const uint8_t code[] = {
+    0xa2, 0x00,         /* $0200: LDX #0 */
+    0x86, 0x10,         /* $0202: STX $10 */
+    0xe8,               /* $0204: INX */
+    0xd0, 0xfb,         /* $0205: BNE $0202 */
+    0xe6, 0x11,         /* $0207: INC $11 */
+    0xa4, 0x11,         /* $0209: LDY $11 */
+    0x8c, 0x00, 0x03,   /* $020b: STY $0300 */
+    0x4c, 0x02, 0x02,   /* $020e: JMP $0202 */
+};
+
+typedef struct
+{
+    const recorder_record_t *records[MAX_HISTORY];
+    unsigned int count;
+} collected_t;
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static bool collect(const recorder_record_t *record, void *userdata)
+{
+    collected_t *collected = (collected_t *)userdata;
+
+    collected->records[collected->count++] = record;
+
+    /* Stop once full. */
+    return collected->count < MAX_HISTORY;
+}
+
+/* Scans every record for the last write to an address before a cycle. */
+static const recorder_record_t *scan_last_write(uint16_t addr, uint64_t before)
+{
+    const recorder_record_t *found = NULL;
+    const recorder_record_t *record;
+    uint64_t index;
+
+    for(index = 0; index < tracefile_get_count(trace); ++index)
+    {
+        record = tracefile_get_record(trace, index);
+
+        if(record->cycle >= before)
+            break;
+
+        if((record->flags & RECORD_WRITE) && record->addr == addr)
+            found = record;
+    }
+
+    return found;
+}
+
+static void check_last_write(uint16_t addr)
+{
+    static const uint64_t before[] = { 0, 1, 100, 2048, 4096, 50000, 123457, RUN_CYCLES - 1, UINT64_MAX };
+    unsigned int index;
+
+    for(index = 0; index < sizeof(before) / sizeof(before[0]); ++index)
+    {
+        TEST_ASSERT_EQUAL_PTR(scan_last_write(addr, before[index]), tracefile_last_write(trace, addr, before[index]));
+    }
+}
+
+void test_last_write(void)
+{
+    const recorder_record_t *record;
+
+    check_last_write(0x0010);
+    check_last_write(0x0011);
+    check_last_write(0x0300);
+
+    /* Never written, and only ever read. */
+    TEST_ASSERT_NULL(tracefile_last_write(trace, 0x0400, UINT64_MAX));
+    TEST_ASSERT_NULL(tracefile_last_write(trace, 0x0202, UINT64_MAX));
+
+    record = tracefile_last_write(trace, 0x0300, UINT64_MAX);
+    TEST_ASSERT_NOT_NULL(record);
+    TEST_ASSERT_EQUAL_UINT16(0x020b, record->pc);
+    TEST_ASSERT_EQUAL_UINT8(RECORD_WRITE, record->flags);
+    TEST_ASSERT_EQUAL_UINT8(memory[0x0300], record->value);
+}
+
+void test_query(void)
+{
+    tracefile_query_t query;
+    const recorder_record_t *record;
+    collected_t collected;
+    uint64_t expected;
+    uint64_t index;
+
+    memset(&query, 0, sizeof(query));
+    query.addr_start = 0x0300;
+    query.addr_end = 0x03ff;
+    query.pc_end = 0xffff;
+    query.cycle_start = 30000;
+    query.cycle_end = 150000;
+
+    for(expected = 0, index = 0; index < tracefile_get_count(trace); ++index)
+    {
+        record = tracefile_get_record(trace, index);
+
+        if(record->addr >= 0x0300 && record->addr <= 0x03ff && record->cycle >= 30000 && record->cycle <= 150000)
+            ++expected;
+    }
+
+    TEST_ASSERT_TRUE(expected > 0);
+    TEST_ASSERT_EQUAL_UINT64(expected, tracefile_query(trace, &query, NULL, NULL));
+
+    /* Only the code page is ever fetched from, and the zero page is never written from it. */
+    query.addr_start = 0x0200;
+    query.addr_end = 0x02ff;
+    query.writes_only = true;
+    TEST_ASSERT_EQUAL_UINT64(0, tracefile_query(trace, &query, NULL, NULL));
+
+    /* Writes to $10 made by STX, in order. */
+    memset(&query, 0, sizeof(query));
+    query.addr_start = 0x0010;
+    query.addr_end = 0x0010;
+    query.pc_start = 0x0202;
+    query.pc_end = 0x0202;
+    query.cycle_end = UINT64_MAX;
+    query.writes_only = true;
+
+    memset(&collected, 0, sizeof(collected));
+    TEST_ASSERT_EQUAL_UINT64(MAX_HISTORY, tracefile_query(trace, &query, collect, &collected));
+
+    for(index = 0; index < MAX_HISTORY; ++index)
+    {
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)index, collected.records[index]->value);
+
+        if(index > 0)
+            TEST_ASSERT_TRUE(collected.records[index]->cycle > collected.records[index - 1]->cycle);
+    }
+}
+
+void test_pc_history(void)
+{
+    static const uint64_t cycles[] = { 0, 5000, 4096 * 3, RUN_CYCLES - 3 };
+    const recorder_record_t *expected[MAX_HISTORY];
+    const recorder_record_t *record;
+    collected_t collected;
+    unsigned int count;
+    unsigned int after;
+    unsigned int index;
+    uint64_t mid;
+    uint64_t pos;
+
+    for(index = 0; index < sizeof(cycles) / sizeof(cycles[0]); ++index)
+    {
+        mid = tracefile_find_cycle(trace, cycles[index]);
+
+        /* Up to 8 fetches before the cycle... */
+        for(pos = mid, count = 0; pos > 0 && count < 8;)
+        {
+            if(tracefile_get_record(trace, --pos)->flags & RECORD_SYNC)
+                ++count;
+        }
+
+        for(count = 0; pos < mid; ++pos)
+        {
+            record = tracefile_get_record(trace, pos);
+
+            if(record->flags & RECORD_SYNC)
+                expected[count++] = record;
+        }
+
+        /* ...and up to 8 on or after it. */
+        for(after = 0; pos < tracefile_get_count(trace) && after < 8; ++pos)
+        {
+            record = tracefile_get_record(trace, pos);
+
+            if(record->flags & RECORD_SYNC)
+            {
+                expected[count++] = record;
+                ++after;
+            }
+        }
+
+        memset(&collected, 0, sizeof(collected));
+        TEST_ASSERT_EQUAL_UINT64(count, tracefile_pc_history(trace, cycles[index], 8, 8, collect, &collected));
+        TEST_ASSERT_EQUAL_UINT(count, collected.count);
+        TEST_ASSERT_EQUAL_MEMORY(expected, collected.records, count * sizeof(expected[0]));
+    }
+
+    /* The history starts from the first fetch. */
+    memset(&collected, 0, sizeof(collected));
+    TEST_ASSERT_EQUAL_UINT64(3, tracefile_pc_history(trace, 0, 8, 3, collect, &collected));
+    TEST_ASSERT_EQUAL_UINT16(0x0200, collected.records[0]->addr);
+    TEST_ASSERT_EQUAL_UINT16(0x0202, collected.records[1]->addr);
+}
+
+void test_unindexed(void)
+{
+    const recorder_record_t *record;
+    tracefile_t indexed = trace;
+    FILE *in;
+    FILE *out;
+    uint64_t remaining;
+    uint8_t buffer[sizeof(recorder_record_t)];
+
+    /* Copy the header and records, leaving out the index, as if recording had been interrupted. */
+    in = fopen(TRACE_FILE, "rb");
+    out = fopen(UNINDEXED_FILE, "wb");
+    TEST_ASSERT_NOT_NULL(in);
+    TEST_ASSERT_NOT_NULL(out);
+
+    remaining = tracefile_get_count(indexed) + 1;
+
+    while(remaining-- > 0)
+    {
+        TEST_ASSERT_EQUAL_UINT(1, fread(buffer, sizeof(buffer), 1, in));
+        TEST_ASSERT_EQUAL_UINT(1, fwrite(buffer, sizeof(buffer), 1, out));
+    }
+
+    /* Along with part of another record. */
+    TEST_ASSERT_EQUAL_UINT(1, fwrite(buffer, 5, 1, out));
+
+    fclose(in);
+    fclose(out);
+
+    trace = tracefile_open(UNINDEXED_FILE);
+    TEST_ASSERT_NOT_NULL(trace);
+    TEST_ASSERT_EQUAL_UINT64(tracefile_get_count(indexed), tracefile_get_count(trace));
+
+    check_last_write(0x0300);
+
+    record = tracefile_last_write(trace, 0x0011, UINT64_MAX);
+    TEST_ASSERT_NOT_NULL(record);
+    TEST_ASSERT_EQUAL_MEMORY(tracefile_last_write(indexed, 0x0011, UINT64_MAX), record, sizeof(*record));
+
+    tracefile_close(trace);
+    trace = indexed;
+    remove(UNINDEXED_FILE);
+}
+
+void test_invalid(void)
+{
+    FILE *out;
+
+    TEST_ASSERT_NULL(tracefile_open("tracefile_tester.missing"));
+
+    out = fopen(UNINDEXED_FILE, "wb");
+    TEST_ASSERT_NOT_NULL(out);
+    fputs("not a trace file", out);
+    fclose(out);
+
+    TEST_ASSERT_NULL(tracefile_open(UNINDEXED_FILE));
+    remove(UNINDEXED_FILE);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+int main(int argc, char *argv[])
+{
+    bus_decode_params_t params;
+    recorder_t recorder;
+    unsigned int cycles;
+    int result;
+
+    memcpy(&memory[0x0200], code, sizeof(code));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+
+    emu = emu_init(&config);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+
+    if(emu == NULL || emu_bus_register(emu, &params, &mem_handlers, NULL) == NULL)
+    {
+        return 1;
+    }
+
+    /* Record one trace for all of the queries. */
+    recorder = recorder_init(emu, TRACE_FILE, NULL);
+
+    if(recorder == NULL)
+    {
+        return 1;
+    }
+
+    for(cycles = 0; cycles < RUN_CYCLES; ++cycles)
+    {
+        emu_tick(emu);
+    }
+
+    if(!recorder_cleanup(recorder))
+    {
+        return 1;
+    }
+
+    trace = tracefile_open(TRACE_FILE);
+
+    if(trace == NULL)
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_last_write);
+    RUN_TEST(test_query);
+    RUN_TEST(test_pc_history);
+    RUN_TEST(test_unindexed);
+    RUN_TEST(test_invalid);
+
+    result = UNITY_END();
+
+    tracefile_close(trace);
+    emu_cleanup(emu);
+    remove(TRACE_FILE);
+
+    return result;
+}
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity/unity.h>
+
+#include "bus.h"
+#include "emulator.h"
+#include "vcd.h"
+
+#define VCD_FILE    "vcd_tester.vcd"
+#define MAX_EVENTS  0x40000
+
+/* Identifiers of the CPU signals, in the order they are added. */
+#define ID_ADDR     '!'
+#define ID_DATA     '"'
+#define ID_RWB      '#'
+#define ID_SYNC     '$'
+#define ID_IRQB     '%'
+
+/* The main clock runs at 1MHz, so each cycle is 1000ns. */
+#define CYCLE_NS    1000
+
+typedef struct
+{
+    uint64_t time;
+    uint32_t value;
+    char id;
+} vcd_event_t;
+
+static cbemu_t emu;
+static uint8_t memory[0x10000];
+static const emu_config_t config = { CLOCK_FREQ, 1000000 };
+static vcd_event_t events[MAX_EVENTS];
+static unsigned int num_events;
+static char header[4096];
+
+static uint8_t read_mem(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    return memory[addr];
+}
+
+static void write_mem(uint16_t addr, uint8_t value, bus_flags_t flags, void *userdata)
+{
+    memory[addr] = value;
+}
+
+static const bus_handlers_t mem_handlers = {
+    write_mem,
+    read_mem,
+    read_mem
+};
+
+static void run(unsigned int cycles)
+{
+    while(cycles-- > 0)
+    {
+        emu_tick(emu);
+    }
+}
+
+/* Reads the capture, keeping the header and recording every value, including the initial ones. */
+static void load_vcd(void)
+{
+    char line[128];
+    uint64_t time = 0;
+    uint64_t last_time = 0;
+    bool definitions = true;
+    size_t length = 0;
+    char *value;
+    FILE *file;
+
+    num_events = 0;
+    header[0] = '\0';
+
+    file = fopen(VCD_FILE, "r");
+    TEST_ASSERT_NOT_NULL(file);
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        if(definitions)
+        {
+            TEST_ASSERT_TRUE(length + strlen(line) < sizeof(header));
+            strcpy(&header[length], line);
+            length += strlen(line);
+
+            definitions = (strstr(line, "$enddefinitions") == NULL);
+            continue;
+        }
+
+        line[strcspn(line, "\n")] = '\0';
+
+        if(line[0] == '#')
+        {
+            time = strtoull(&line[1], NULL, 10);
+
+            /* Timestamps must always increase. */
+            TEST_ASSERT_TRUE(num_events == 0 || time > last_time);
+            last_time = time;
+        }
+        else if(line[0] == '0' || line[0] == '1')
+        {
+            TEST_ASSERT_TRUE(num_events < MAX_EVENTS);
+            events[num_events].time = time;
+            events[num_events].value = (uint32_t)(line[0] - '0');
+            events[num_events].id = line[1];
+            ++num_events;
+        }
+        else if(line[0] == 'b')
+        {
+            value = strchr(line, ' ');
+            TEST_ASSERT_NOT_NULL(value);
+            TEST_ASSERT_TRUE(num_events < MAX_EVENTS);
+            events[num_events].time = time;
+            events[num_events].value = (uint32_t)strtoul(&line[1], NULL, 2);
+            events[num_events].id = value[1];
+            ++num_events;
+        }
+        else
+        {
+            TEST_ASSERT_TRUE(strcmp(line, "$dumpvars") == 0 || strcmp(line, "$end") == 0);
+        }
+    }
+
+    fclose(file);
+    remove(VCD_FILE);
+
+    /* The last line marks the end of the capture. */
+    TEST_ASSERT_EQUAL_UINT64(last_time, time);
+}
+
+/* Gets the value of a signal at a time from the loaded capture. */
+static uint32_t value_at(char id, uint64_t time)
+{
+    uint32_t value = 0xFFFFFFFF;
+    unsigned int index;
+
+    for(index = 0; index < num_events && events[index].time <= time; ++index)
+    {
+        if(events[index].id == id)
+            value = events[index].value;
+    }
+
+    return value;
+}
+
+/* Counts the changes of a signal in the loaded capture, excluding its initial value. */
+static unsigned int count_changes(char id)
+{
+    unsigned int count = 0;
+    unsigned int index;
+    bool initial = true;
+
+    for(index = 0; index < num_events; ++index)
+    {
+        if(events[index].id == id)
+        {
+            if(!initial)
+                ++count;
+
+            initial = false;
+        }
+    }
+
+    return count;
+}
+
+void test_header(void)
+{
+    vcd_t vcd;
+
+    vcd = vcd_init(emu, VCD_FILE);
+    TEST_ASSERT_NOT_NULL(vcd);
+
+    TEST_ASSERT_EQUAL_INT(7, vcd_add_signal(vcd, "dev", "pin", 1, 1));
+    TEST_ASSERT_EQUAL_INT(8, vcd_add_signal(vcd, "dev", "port", 4, 0x1A));
+    TEST_ASSERT_EQUAL_INT(VCD_INVALID_SIGNAL, vcd_add_signal(vcd, "dev", "wide", VCD_MAX_WIDTH + 1, 0));
+    TEST_ASSERT_EQUAL_INT(VCD_INVALID_SIGNAL, vcd_add_signal(vcd, "dev", "none", 0, 0));
+
+    TEST_ASSERT_TRUE(vcd_start(vcd));
+    TEST_ASSERT_EQUAL_INT(VCD_INVALID_SIGNAL, vcd_add_signal(vcd, "dev", "late", 1, 0));
+    TEST_ASSERT_TRUE(vcd_cleanup(vcd));
+
+    load_vcd();
+
+    TEST_ASSERT_NOT_NULL(strstr(header, "$timescale 1ns $end\n"));
+    TEST_ASSERT_NOT_NULL(strstr(header, "$scope module cpu $end\n$var wire 16 ! addr $end\n$var wire 8 \" data $end\n"));
+    TEST_ASSERT_NOT_NULL(strstr(header, "$var wire 1 % irqb $end\n"));
+    TEST_ASSERT_NOT_NULL(strstr(header, "$upscope $end\n$scope module dev $end\n$var wire 1 ( pin $end\n$var wire 4 ) port $end\n$upscope $end\n"));
+
+    /* Initial values, with the port truncated to its width. */
+    TEST_ASSERT_EQUAL_UINT32(1, value_at(ID_RWB, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, value_at(ID_IRQB, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, value_at('(', 0));
+    TEST_ASSERT_EQUAL_UINT32(0xA, value_at(')', 0));
+}
+
+void test_capture(void)
+{
+    /* LDA #$55; STA $10; loop: JMP loop */
+    static const uint8_t code[] = { 0xa9, 0x55, 0x85, 0x10, 0x4c, 0x04, 0x02 };
+    bus_signal_voter_t voter;
+    vcd_signal_t pin;
+    vcd_t vcd;
+
+    memcpy(&memory[0x0200], code, sizeof(code));
+
+    voter = emu_bus_register_sig_voter(emu);
+    TEST_ASSERT_NOT_EQUAL(BUS_SIGNAL_INVALID_VOTER, voter);
+
+    vcd = vcd_init(emu, VCD_FILE);
+    TEST_ASSERT_NOT_NULL(vcd);
+    pin = vcd_add_signal(vcd, "dev", "pin", 1, 0);
+    TEST_ASSERT_TRUE(vcd_start(vcd));
+
+    /* Reset (7) + LDA (2) + STA (3). */
+    run(12);
+
+    vcd_set_signal(vcd, pin, 1);
+    emu_bus_sig_vote(emu, voter, BUS_SIG_IRQ, true);
+    run(3);
+    vcd_set_signal(vcd, pin, 0);
+
+    /* Setting the same value isn't a change. */
+    vcd_set_signal(vcd, pin, 0);
+
+    /* Run for enough changes to wrap the ring. */
+    run(3 * 20000);
+    TEST_ASSERT_TRUE(vcd_get_count(vcd) > 0x10000);
+    TEST_ASSERT_TRUE(vcd_cleanup(vcd));
+
+    load_vcd();
+
+    /* The write made by STA. */
+    TEST_ASSERT_EQUAL_UINT32(0x0010, value_at(ID_ADDR, 12 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT32(0x55, value_at(ID_DATA, 12 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT32(0, value_at(ID_RWB, 12 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT32(0, value_at(ID_SYNC, 12 * CYCLE_NS));
+
+    /* The fetch of the JMP opcode before it. */
+    TEST_ASSERT_EQUAL_UINT32(0x0204, value_at(ID_ADDR, 13 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT32(1, value_at(ID_RWB, 13 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT32(1, value_at(ID_SYNC, 13 * CYCLE_NS));
+
+    /* IRQB falls when voted and the pin pulses for 3 cycles. With interrupts disabled, the IRQ is
+     * never taken. */
+    TEST_ASSERT_EQUAL_UINT32(1, value_at(ID_IRQB, 11 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT32(0, value_at(ID_IRQB, 12 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT(1, count_changes(ID_IRQB));
+    TEST_ASSERT_EQUAL_UINT32(1, value_at('(', 12 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT32(0, value_at('(', 15 * CYCLE_NS));
+    TEST_ASSERT_EQUAL_UINT(2, count_changes('('));
+}
+
+void setUp(void)
+{
+    bus_decode_params_t params;
+
+    memset(memory, 0, sizeof(memory));
+    memory[0xfffc] = 0x00;
+    memory[0xfffd] = 0x02;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    params.type = BUSDECODE_RANGE;
+    params.value.range.addr_start = 0;
+    params.value.range.addr_end = 0xffff;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &params, &mem_handlers, NULL));
+}
+
+void tearDown(void)
+{
+    emu_cleanup(emu);
+    emu = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(test_header);
+    RUN_TEST(test_capture);
+
+    return UNITY_END();
+}
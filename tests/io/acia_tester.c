@@ -255,6 +255,40 @@ void test_send_byte_16x_5bit_1p5_stop(void)
     TEST_ASSERT_EQUAL_UINT8(0xAA, test_data.write_bytes[0]);
 }
 
+void test_send_byte_emu(void)
+{
+    unsigned int index;
+
+    acia = acia_init(emu, &acia_test_iface, NULL, clock_get_core_clk(emu));
+
+    TEST_ASSERT_NOT_NULL(acia);
+
+    /* Setup CTRL 16x baud + 8 bits + 1 Stop + Receiver internal baud */
+    acia_write(acia, 0x3, 0x10);
+
+    /* Setup CMD to enable DTR */
+    acia_write(acia, 0x2, 0x01);
+
+    acia_write(acia, 0x0, 0xA5);
+    TEST_ASSERT_EQUAL_UINT32(0, emu_get_events(emu));
+
+    /* The ACIA is synced lazily, but the byte is still written on the exact tick it completes. */
+    for(index = 0; index < (16 * 10) - 1; index++)
+    {
+        emu_tick(emu);
+
+        TEST_ASSERT_EQUAL_INT(0, test_data.write_cnt);
+    }
+
+    emu_tick(emu);
+
+    TEST_ASSERT_EQUAL_INT(1, test_data.write_cnt);
+    TEST_ASSERT_EQUAL_UINT8(0xA5, test_data.write_bytes[0]);
+
+    /* Output is reported to the host. */
+    TEST_ASSERT_EQUAL_UINT32(EMU_EVENT_OUTPUT, emu_get_events(emu));
+}
+
 void test_recv_byte_16x(void)
 {
     unsigned int index;
@@ -443,6 +477,7 @@ int main(int argc, char **argv)
     RUN_TEST(test_send_byte_19200);
     RUN_TEST(test_send_byte_16x_2stop);
     RUN_TEST(test_send_byte_16x_5bit_1p5_stop);
+    RUN_TEST(test_send_byte_emu);
     RUN_TEST(test_recv_byte_16x);
     RUN_TEST(test_recv_overflow);
     RUN_TEST(test_recv_irq);
@@ -1,11 +1,14 @@
 #include <unity/unity.h>
 #include "emulator.h"
 #include "memory.h"
+#include "snapshot.h"
 
 #include "bus_priv.h"
 
 static cbemu_t emu;
 static memory_t memory;
+static memory_t rom;
+static sanitizer_t sanitizer;
 static const emu_config_t config = { CLOCK_FREQ, 1000000 };
 
 void test_basic_init(void)
@@ -137,6 +140,278 @@ void test_rom_load_fill(void)
     }
 }
 
+void test_sanitize(void)
+{
+    bus_decode_params_t decoder;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    sanitizer = sanitizer_init(emu);
+    TEST_ASSERT_NOT_NULL(sanitizer);
+
+    memory = memory_init(0x1000, 0);
+    TEST_ASSERT_NOT_NULL(memory);
+
+    /* Memory must be registered to know what it decodes. */
+    TEST_ASSERT_FALSE(memory_sanitize(memory, sanitizer));
+
+    decoder.type = BUSDECODE_RANGE;
+    decoder.value.range.addr_start = 0x1000;
+    decoder.value.range.addr_end = 0x1FFF;
+    TEST_ASSERT_TRUE(memory_register(memory, emu, &decoder, 0x1000));
+    TEST_ASSERT_TRUE(memory_sanitize(memory, sanitizer));
+
+    rom = memory_init(0x1000, MEMFLAG_ROM);
+    TEST_ASSERT_NOT_NULL(rom);
+
+    decoder.type = BUSDECODE_MASK;
+    decoder.value.mask.addr_mask = 0xF000;
+    decoder.value.mask.addr_value = 0xF000;
+    TEST_ASSERT_TRUE(memory_register(rom, emu, &decoder, 0xF000));
+    TEST_ASSERT_TRUE(memory_sanitize(rom, sanitizer));
+
+    /* Written RAM can be read freely. */
+    bus_write(emu, 0x1000, 0xAA);
+    (void)bus_read(emu, 0x1000);
+    TEST_ASSERT_EQUAL_UINT(0, sanitizer_get_count(sanitizer, SANITIZER_UNINIT_READ));
+
+    /* Reads of unwritten RAM are reported once per address. */
+    (void)bus_read(emu, 0x1001);
+    (void)bus_read(emu, 0x1001);
+    TEST_ASSERT_EQUAL_UINT(1, sanitizer_get_count(sanitizer, SANITIZER_UNINIT_READ));
+
+    /* Peeks and dummy reads are not checked. */
+    (void)bus_peek(emu, 0x1002);
+    bus_dummy_read(emu, 0x1002);
+    TEST_ASSERT_EQUAL_UINT(1, sanitizer_get_count(sanitizer, SANITIZER_UNINIT_READ));
+
+    /* Writes to ROM are reported and ignored. */
+    bus_write(emu, 0xF123, 0x55);
+    TEST_ASSERT_EQUAL_UINT(1, sanitizer_get_count(sanitizer, SANITIZER_ROM_WRITE));
+    TEST_ASSERT_EQUAL_UINT8(0x00, memory_read(rom, 0x0123));
+
+    /* Other pages are not checked. */
+    bus_write(emu, 0x2000, 0x55);
+    (void)bus_read(emu, 0x2001);
+    TEST_ASSERT_EQUAL_UINT(1, sanitizer_get_count(sanitizer, SANITIZER_UNINIT_READ));
+    TEST_ASSERT_EQUAL_UINT(1, sanitizer_get_count(sanitizer, SANITIZER_ROM_WRITE));
+}
+
+static unsigned int io_reads;
+
+static uint8_t io_read_cb(uint16_t addr, bus_flags_t flags, void *userdata)
+{
+    ++io_reads;
+    return (uint8_t)(addr ^ 0x5A);
+}
+
+static const bus_handlers_t io_handlers =
+{
+    NULL,
+    io_read_cb,
+    io_read_cb
+};
+
+void test_peek_poke_range(void)
+{
+    static uint8_t range[0x10000];
+    uint8_t values[0x20];
+    bus_decode_params_t decoder;
+    unsigned int index;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    decoder.type = BUSDECODE_RANGE;
+    decoder.value.range.addr_start = 0x1000;
+    decoder.value.range.addr_end = 0x1FFF;
+    memory = memory_init(0x1000, 0);
+    TEST_ASSERT_NOT_NULL(memory);
+    TEST_ASSERT_TRUE(memory_register(memory, emu, &decoder, 0x1000));
+
+    decoder.type = BUSDECODE_MASK;
+    decoder.value.mask.addr_mask = 0xF000;
+    decoder.value.mask.addr_value = 0xF000;
+    rom = memory_init(0x1000, MEMFLAG_ROM);
+    TEST_ASSERT_NOT_NULL(rom);
+    TEST_ASSERT_TRUE(memory_register(rom, emu, &decoder, 0xF000));
+
+    /* Device registers sharing a page with no other connection. */
+    decoder.type = BUSDECODE_RANGE;
+    decoder.value.range.addr_start = 0x3010;
+    decoder.value.range.addr_end = 0x301F;
+    TEST_ASSERT_NOT_NULL(emu_bus_register(emu, &decoder, &io_handlers, NULL));
+
+    for(index = 0; index < 0x1000; ++index)
+    {
+        bus_write(emu, 0x1000 + index, (uint8_t)(index * 7));
+    }
+
+    /* The range matches peeking every address. */
+    io_reads = 0;
+    bus_peek_range(emu, 0x0000, 0x10000, range);
+
+    /* Only the page with the device registers was peeked a byte at a time. */
+    TEST_ASSERT_EQUAL_UINT(0x10, io_reads);
+
+    for(index = 0; index < 0x10000; ++index)
+    {
+        TEST_ASSERT_EQUAL_HEX8(bus_peek(emu, (uint16_t)index), range[index]);
+    }
+
+    /* A range that starts and ends within pages. */
+    bus_peek_range(emu, 0x1F80, 0x100, range);
+    TEST_ASSERT_EQUAL_HEX8(memory_read(memory, 0x0F80), range[0x00]);
+    TEST_ASSERT_EQUAL_HEX8(memory_read(memory, 0x0FFF), range[0x7F]);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, range[0x80]);
+
+    /* Pokes stop at the end of the memory. */
+    for(index = 0; index < sizeof(values); ++index)
+    {
+        values[index] = (uint8_t)(0xC0 + index);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0x10, bus_poke_range(emu, 0x1FF0, sizeof(values), values));
+    TEST_ASSERT_EQUAL_HEX8(0xC0, memory_read(memory, 0x0FF0));
+    TEST_ASSERT_EQUAL_HEX8(0xCF, memory_read(memory, 0x0FFF));
+
+    /* Pages with device registers can't be poked, but ROM can. */
+    TEST_ASSERT_EQUAL_UINT32(0, bus_poke_range(emu, 0x3010, 4, values));
+    TEST_ASSERT_EQUAL_UINT32(4, bus_poke_range(emu, 0xFFFC, 4, values));
+    TEST_ASSERT_EQUAL_HEX8(0xC3, memory_read(rom, 0x0FFF));
+}
+
+void test_snapshot_delta(void)
+{
+    bus_decode_params_t decoder;
+    snapshot_t base;
+    snapshot_t delta;
+    uint8_t value = 0x77;
+    size_t full_size;
+    size_t delta_size;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    decoder.type = BUSDECODE_RANGE;
+    decoder.value.range.addr_start = 0x1000;
+    decoder.value.range.addr_end = 0x1FFF;
+    memory = memory_init(0x1000, 0);
+    TEST_ASSERT_NOT_NULL(memory);
+    TEST_ASSERT_TRUE(memory_register(memory, emu, &decoder, 0x1000));
+
+    base = snapshot_init();
+    delta = snapshot_init();
+    TEST_ASSERT_NOT_NULL(base);
+    TEST_ASSERT_NOT_NULL(delta);
+
+    bus_write(emu, 0x1000, 0x11);
+    TEST_ASSERT_TRUE(snapshot_save(emu, base));
+
+    /* Change one page through the bus and another behind its back. */
+    bus_write(emu, 0x1234, 0xAA);
+    TEST_ASSERT_EQUAL_UINT32(1, bus_poke_range(emu, 0x1800, 1, &value));
+    TEST_ASSERT_TRUE(snapshot_save_delta(emu, delta, base));
+    TEST_ASSERT_TRUE(snapshot_is_delta(delta));
+
+    /* Only the two changed pages are held. */
+    snapshot_get_data(base, &full_size);
+    snapshot_get_data(delta, &delta_size);
+    TEST_ASSERT_TRUE(delta_size + 14 * SNAPSHOT_PAGE_SIZE <= full_size);
+
+    bus_write(emu, 0x1000, 0x22);
+    bus_write(emu, 0x1234, 0x33);
+    bus_write(emu, 0x1800, 0x44);
+
+    /* Deltas are restored by collapsing them onto their base. */
+    TEST_ASSERT_FALSE(snapshot_restore(emu, delta));
+    TEST_ASSERT_TRUE(snapshot_collapse(base, delta));
+    TEST_ASSERT_FALSE(snapshot_is_delta(base));
+    TEST_ASSERT_TRUE(snapshot_restore(emu, base));
+
+    TEST_ASSERT_EQUAL_HEX8(0x11, memory_read(memory, 0x0000));
+    TEST_ASSERT_EQUAL_HEX8(0xAA, memory_read(memory, 0x0234));
+    TEST_ASSERT_EQUAL_HEX8(0x77, memory_read(memory, 0x0800));
+
+    snapshot_cleanup(delta);
+    snapshot_cleanup(base);
+}
+
+void test_snapshot_peek(void)
+{
+    bus_decode_params_t decoder;
+    snapshot_t base;
+    snapshot_t peeked;
+    snapshot_t idle;
+    uint8_t range[0x1000];
+    size_t peeked_size;
+    size_t idle_size;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    decoder.type = BUSDECODE_RANGE;
+    decoder.value.range.addr_start = 0x1000;
+    decoder.value.range.addr_end = 0x1FFF;
+    memory = memory_init(0x1000, 0);
+    TEST_ASSERT_NOT_NULL(memory);
+    TEST_ASSERT_TRUE(memory_register(memory, emu, &decoder, 0x1000));
+
+    base = snapshot_init();
+    peeked = snapshot_init();
+    idle = snapshot_init();
+    TEST_ASSERT_NOT_NULL(base);
+    TEST_ASSERT_NOT_NULL(peeked);
+    TEST_ASSERT_NOT_NULL(idle);
+
+    TEST_ASSERT_TRUE(snapshot_save(emu, base));
+
+    /* Looking at the memory doesn't put its pages in the next delta, which is as small as one
+     * taken with nothing done at all. */
+    bus_peek_range(emu, 0x1000, sizeof(range), range);
+    TEST_ASSERT_TRUE(snapshot_save_delta(emu, peeked, base));
+    TEST_ASSERT_TRUE(snapshot_save_delta(emu, idle, peeked));
+
+    snapshot_get_data(peeked, &peeked_size);
+    snapshot_get_data(idle, &idle_size);
+    TEST_ASSERT_EQUAL_UINT(idle_size, peeked_size);
+
+    snapshot_cleanup(idle);
+    snapshot_cleanup(peeked);
+    snapshot_cleanup(base);
+}
+
+void test_snapshot_rom(void)
+{
+    bus_decode_params_t decoder;
+    snapshot_t snap;
+    uint8_t value = 0xEA;
+
+    emu = emu_init(&config);
+    TEST_ASSERT_NOT_NULL(emu);
+
+    decoder.type = BUSDECODE_RANGE;
+    decoder.value.range.addr_start = 0xF000;
+    decoder.value.range.addr_end = 0xFFFF;
+    rom = memory_init(0x1000, MEMFLAG_ROM);
+    TEST_ASSERT_NOT_NULL(rom);
+    TEST_ASSERT_TRUE(memory_register(rom, emu, &decoder, 0xF000));
+
+    snap = snapshot_init();
+    TEST_ASSERT_NOT_NULL(snap);
+
+    /* Patches to ROM are part of the state, so one made after the snapshot is undone. */
+    TEST_ASSERT_EQUAL_UINT32(1, bus_poke_range(emu, 0xF100, 1, &value));
+    TEST_ASSERT_TRUE(snapshot_save(emu, snap));
+    TEST_ASSERT_EQUAL_UINT32(1, bus_poke_range(emu, 0xF200, 1, &value));
+
+    TEST_ASSERT_TRUE(snapshot_restore(emu, snap));
+    TEST_ASSERT_EQUAL_HEX8(0xEA, memory_read(rom, 0x0100));
+    TEST_ASSERT_EQUAL_HEX8(0x00, memory_read(rom, 0x0200));
+
+    snapshot_cleanup(snap);
+}
 
 void setUp(void)
 {
@@ -144,6 +419,18 @@ void setUp(void)
 
 void tearDown(void)
 {
+    if(sanitizer != NULL)
+    {
+        sanitizer_cleanup(sanitizer);
+        sanitizer = NULL;
+    }
+
+    if(rom != NULL)
+    {
+        memory_cleanup(rom);
+        rom = NULL;
+    }
+
     if(memory != NULL)
     {
         memory_cleanup(memory);
@@ -167,6 +454,11 @@ int main(int argc, char *argv[])
     RUN_TEST(test_ram_bus_rw);
     RUN_TEST(test_rom_load_full);
     RUN_TEST(test_rom_load_fill);
+    RUN_TEST(test_sanitize);
+    RUN_TEST(test_peek_poke_range);
+    RUN_TEST(test_snapshot_delta);
+    RUN_TEST(test_snapshot_peek);
+    RUN_TEST(test_snapshot_rom);
 
     return UNITY_END();
 }